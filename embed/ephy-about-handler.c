@@ -23,11 +23,13 @@
 
 #include "ephy-embed-shell.h"
 #include "ephy-file-helpers.h"
+#include "ephy-metrics.h"
 #include "ephy-smaps.h"
 #include "ephy-web-app-utils.h"
 
 #include <gio/gio.h>
 #include <glib/gi18n.h>
+#include <string.h>
 #ifdef HAVE_WEBKIT2
 #include <webkit2/webkit2.h>
 #else
@@ -179,6 +181,32 @@ ephy_about_handler_handle_memory (GString *data_str)
   }
 }
 
+static void
+ephy_about_handler_handle_performance (GString *data_str)
+{
+  char *metrics, *json, *json_base64;
+
+  metrics = ephy_metrics_to_html ();
+  json = ephy_metrics_to_json ();
+  json_base64 = g_base64_encode ((guchar *)json, strlen (json));
+
+  g_string_append_printf (data_str, "<head><title>%s</title>"         \
+                          "<style type=\"text/css\">%s</style></head><body>",
+                          _("Performance"),
+                          css_style);
+
+  g_string_append_printf (data_str, "<h1>%s</h1>", _("Performance"));
+  g_string_append (data_str, metrics);
+  g_string_append_printf (data_str,
+                          "<p><a href=\"data:application/json;base64,%s\" download=\"performance.json\">%s</a></p>" \
+                          "</body>",
+                          json_base64, _("Export as JSON"));
+
+  g_free (json_base64);
+  g_free (json);
+  g_free (metrics);
+}
+
 static void
 ephy_about_handler_handle_epiphany (GString *data_str)
 {
@@ -288,6 +316,8 @@ ephy_about_handler_handle (const char *about)
     ephy_about_handler_handle_plugins (data_str);
   else if (!g_strcmp0 (about, "memory"))
     ephy_about_handler_handle_memory (data_str);
+  else if (!g_strcmp0 (about, "performance"))
+    ephy_about_handler_handle_performance (data_str);
   else if (!g_strcmp0 (about, "epiphany"))
     ephy_about_handler_handle_epiphany (data_str);
   else if (!g_strcmp0 (about, "applications"))
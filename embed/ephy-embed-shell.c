@@ -33,7 +33,9 @@
 #include "ephy-encodings.h"
 #include "ephy-file-helpers.h"
 #include "ephy-history-service.h"
+#include "ephy-predictor.h"
 #include "ephy-profile-utils.h"
+#include "ephy-settings.h"
 #include "ephy-snapshot-service.h"
 #ifdef HAVE_WEBKIT2
 #include "ephy-web-extension.h"
@@ -61,11 +63,13 @@ struct _EphyEmbedShellPrivate
   GtkPrintSettings *print_settings;
   EphyEmbedShellMode mode;
   EphyFrecentStore *frecent_store;
+  EphyPredictor *predictor;
   guint single_initialised : 1;
 #ifdef HAVE_WEBKIT2
   GDBusProxy *web_extension;
   guint web_extension_watch_name_id;
   guint web_extension_form_auth_save_signal_id;
+  guint web_extension_modified_forms_signal_id;
 #endif
 };
 
@@ -77,6 +81,7 @@ enum
   RESTORED_WINDOW,
   WEB_VIEW_CREATED,
   FORM_AUTH_DATA_SAVE_REQUESTED,
+  PAGE_HAS_MODIFIED_FORMS_CHANGED,
 
   LAST_SIGNAL
 };
@@ -105,6 +110,7 @@ ephy_embed_shell_dispose (GObject *object)
   g_clear_object (&priv->page_setup);
   g_clear_object (&priv->print_settings);
   g_clear_object (&priv->frecent_store);
+  g_clear_object (&priv->predictor);
   g_clear_object (&priv->global_history_service);
   g_clear_object (&priv->embed_single);
 #ifdef HAVE_WEBKIT2
@@ -117,6 +123,11 @@ ephy_embed_shell_dispose (GObject *object)
                                           priv->web_extension_form_auth_save_signal_id);
     priv->web_extension_form_auth_save_signal_id = 0;
   }
+  if (priv->web_extension_modified_forms_signal_id > 0) {
+    g_dbus_connection_signal_unsubscribe (g_dbus_proxy_get_connection (priv->web_extension),
+                                          priv->web_extension_modified_forms_signal_id);
+    priv->web_extension_modified_forms_signal_id = 0;
+  }
   g_clear_object (&priv->web_extension);
 #else
   g_clear_object (&priv->adblock_manager);
@@ -160,6 +171,23 @@ web_extension_form_auth_save_requested (GDBusConnection *connection,
                  request_id, page_id, hostname, username);
 }
 
+static void
+web_extension_has_modified_forms_changed (GDBusConnection *connection,
+                                          const char *sender_name,
+                                          const char *object_path,
+                                          const char *interface_name,
+                                          const char *signal_name,
+                                          GVariant *parameters,
+                                          EphyEmbedShell *shell)
+{
+  guint64 page_id;
+  gboolean has_modified_forms;
+
+  g_variant_get (parameters, "(tb)", &page_id, &has_modified_forms);
+  g_signal_emit (shell, signals[PAGE_HAS_MODIFIED_FORMS_CHANGED], 0,
+                 page_id, has_modified_forms);
+}
+
 static void
 web_extension_proxy_created_cb (GDBusProxy *proxy,
                                 GAsyncResult *result,
@@ -183,6 +211,17 @@ web_extension_proxy_created_cb (GDBusProxy *proxy,
                                           (GDBusSignalCallback)web_extension_form_auth_save_requested,
                                           shell,
                                           NULL);
+    shell->priv->web_extension_modified_forms_signal_id =
+      g_dbus_connection_signal_subscribe (g_dbus_proxy_get_connection (shell->priv->web_extension),
+                                          g_dbus_proxy_get_name (shell->priv->web_extension),
+                                          EPHY_WEB_EXTENSION_INTERFACE,
+                                          "HasModifiedFormsChanged",
+                                          EPHY_WEB_EXTENSION_OBJECT_PATH,
+                                          NULL,
+                                          G_DBUS_SIGNAL_FLAGS_NONE,
+                                          (GDBusSignalCallback)web_extension_has_modified_forms_changed,
+                                          shell,
+                                          NULL);
   }
 }
 
@@ -230,6 +269,16 @@ ephy_embed_shell_watch_web_extension (EphyEmbedShell *shell)
 }
 #endif
 
+static void
+history_retention_settings_changed_cb (GSettings *settings,
+                                       char *key,
+                                       EphyHistoryService *service)
+{
+  ephy_history_service_set_retention_policy (service,
+                                             MAX (0, g_settings_get_int (settings, EPHY_PREFS_HISTORY_MAX_AGE_DAYS)),
+                                             MAX (0, g_settings_get_int (settings, EPHY_PREFS_HISTORY_MAX_VISITS)));
+}
+
 /**
  * ephy_embed_shell_get_global_history_service:
  * @shell: the #EphyEmbedShell
@@ -248,6 +297,15 @@ ephy_embed_shell_get_global_history_service (EphyEmbedShell *shell)
     shell->priv->global_history_service = ephy_history_service_new (filename);
     g_free (filename);
     g_return_val_if_fail (shell->priv->global_history_service, NULL);
+
+    history_retention_settings_changed_cb (EPHY_SETTINGS_MAIN, NULL,
+                                           shell->priv->global_history_service);
+    g_signal_connect_object (EPHY_SETTINGS_MAIN, "changed::" EPHY_PREFS_HISTORY_MAX_AGE_DAYS,
+                             G_CALLBACK (history_retention_settings_changed_cb),
+                             shell->priv->global_history_service, 0);
+    g_signal_connect_object (EPHY_SETTINGS_MAIN, "changed::" EPHY_PREFS_HISTORY_MAX_VISITS,
+                             G_CALLBACK (history_retention_settings_changed_cb),
+                             shell->priv->global_history_service, 0);
   }
 
   return G_OBJECT (shell->priv->global_history_service);
@@ -306,6 +364,30 @@ ephy_embed_shell_get_frecent_store (EphyEmbedShell *shell)
   return shell->priv->frecent_store;
 }
 
+/**
+ * ephy_embed_shell_get_predictor:
+ * @shell: a #EphyEmbedShell
+ *
+ * Gets the #EphyPredictor that prefetches the hosts the user is likely
+ * to load next, learning from the visits in the global history.
+ *
+ * Returns: (transfer none): the #EphyPredictor
+ **/
+GObject *
+ephy_embed_shell_get_predictor (EphyEmbedShell *shell)
+{
+  g_return_val_if_fail (EPHY_IS_EMBED_SHELL (shell), NULL);
+
+  if (shell->priv->predictor == NULL) {
+    EphyHistoryService *history_service;
+
+    history_service = EPHY_HISTORY_SERVICE (ephy_embed_shell_get_global_history_service (shell));
+    shell->priv->predictor = ephy_predictor_new (history_service);
+  }
+
+  return G_OBJECT (shell->priv->predictor);
+}
+
 static GObject *
 impl_get_embed_single (EphyEmbedShell *shell)
 {
@@ -573,6 +655,25 @@ ephy_embed_shell_class_init (EphyEmbedShellClass *klass)
                   G_TYPE_STRING,
                   G_TYPE_STRING);
 
+  /*
+   * EphyEmbedShell::page-has-modified-forms-changed:
+   * @shell: the #EphyEmbedShell
+   * @page_id: the identifier of the web page
+   * @has_modified_forms: whether the page now has modified forms
+   *
+   * Emitted when the user modifies the forms of a web page, or
+   * when a page with modified forms loads a new document.
+   **/
+  signals[PAGE_HAS_MODIFIED_FORMS_CHANGED] =
+    g_signal_new ("page-has-modified-forms-changed",
+                  EPHY_TYPE_EMBED_SHELL,
+                  G_SIGNAL_RUN_FIRST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_generic,
+                  G_TYPE_NONE, 2,
+                  G_TYPE_UINT64,
+                  G_TYPE_BOOLEAN);
+
   g_type_class_add_private (object_class, sizeof (EphyEmbedShellPrivate));
 }
 
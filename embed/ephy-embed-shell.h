@@ -84,6 +84,7 @@ GObject           *ephy_embed_shell_get_global_history_service (EphyEmbedShell
 GObject           *ephy_embed_shell_get_encodings              (EphyEmbedShell   *shell);
 GObject           *ephy_embed_shell_get_embed_single           (EphyEmbedShell   *shell);
 GObject           *ephy_embed_shell_get_adblock_manager        (EphyEmbedShell   *shell);
+GObject           *ephy_embed_shell_get_predictor              (EphyEmbedShell   *shell);
 void               ephy_embed_shell_prepare_close              (EphyEmbedShell   *shell);
 void               ephy_embed_shell_restored_window            (EphyEmbedShell   *shell);
 void               ephy_embed_shell_set_page_setup             (EphyEmbedShell   *shell,
@@ -1279,6 +1279,22 @@ ephy_embed_has_load_pending (EphyEmbed *embed)
   return !!embed->priv->delayed_request;
 }
 
+/**
+ * ephy_embed_load_delayed_request:
+ * @embed: a #EphyEmbed
+ *
+ * Starts loading the request set with ephy_embed_set_delayed_load_request()
+ * without waiting for the tab to be switched to. Does nothing if there is
+ * no load pending.
+ */
+void
+ephy_embed_load_delayed_request (EphyEmbed *embed)
+{
+  g_return_if_fail (EPHY_IS_EMBED (embed));
+
+  ephy_embed_maybe_load_delayed_request (embed);
+}
+
 /**
  * ephy_embed_get_overview:
  * @embed: a #EphyEmbed
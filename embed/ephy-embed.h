@@ -69,6 +69,7 @@ void         ephy_embed_set_delayed_load_request (EphyEmbed *embed,
                                                   WebKitNetworkRequest *request);
 #endif
 gboolean     ephy_embed_has_load_pending         (EphyEmbed *embed);
+void         ephy_embed_load_delayed_request     (EphyEmbed *embed);
 void         ephy_embed_set_overview_mode        (EphyEmbed *embed,
                                                   gboolean   overview_mode);
 gboolean     ephy_embed_get_overview_mode        (EphyEmbed *embed);
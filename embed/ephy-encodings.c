@@ -28,12 +28,14 @@
 #include "ephy-settings.h"
 
 #include <glib/gi18n.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define EPHY_ENCODINGS_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), EPHY_TYPE_ENCODINGS, EphyEncodingsPrivate))
 
 struct _EphyEncodingsPrivate
 {
-  GHashTable *hash;
+  GHashTable *unknown;
   GSList *recent;
 };
 
@@ -138,6 +140,147 @@ encoding_entries [] =
 
 #define RECENT_MAX  4
 
+#define N_ENTRIES         G_N_ELEMENTS (encoding_entries)
+#define N_LANGUAGE_GROUPS 22
+
+/*
+ * The catalog of known encodings is the same for every EphyEncodings, so
+ * it is built once per process. Entries are only wrapped in an
+ * EphyEncoding when they are asked for, and the order by title (which
+ * depends on the locale) is computed once, the first time a sorted list
+ * is requested; after that the encodings menu, dialog and preferences
+ * get their lists without any hashing or sorting.
+ */
+typedef struct
+{
+  /* indices into encoding_entries, sorted by code */
+  guint by_code[N_ENTRIES];
+  EphyEncoding *wrappers[N_ENTRIES];
+
+  gboolean sorted;
+  /* indices into encoding_entries, sorted by collation key */
+  guint by_title[N_ENTRIES];
+  /* the same order, split by language group */
+  guint *by_group[N_LANGUAGE_GROUPS];
+  guint n_by_group[N_LANGUAGE_GROUPS];
+} EncodingsCatalog;
+
+static EncodingsCatalog *catalog = NULL;
+
+static int
+compare_entry_codes (gconstpointer a,
+                     gconstpointer b)
+{
+  return strcmp (encoding_entries[*(const guint *)a].code,
+                 encoding_entries[*(const guint *)b].code);
+}
+
+static int
+compare_code_with_entry (gconstpointer key,
+                         gconstpointer entry)
+{
+  return strcmp ((const char *)key,
+                 encoding_entries[*(const guint *)entry].code);
+}
+
+static EncodingsCatalog *
+get_catalog (void)
+{
+  guint i;
+
+  if (catalog != NULL)
+    return catalog;
+
+  catalog = g_new0 (EncodingsCatalog, 1);
+
+  for (i = 0; i < N_ENTRIES; i++)
+    catalog->by_code[i] = i;
+  qsort (catalog->by_code, N_ENTRIES, sizeof (guint), compare_entry_codes);
+
+  return catalog;
+}
+
+static EphyEncoding *
+catalog_get_entry (EncodingsCatalog *cat,
+                   guint i)
+{
+  if (cat->wrappers[i] == NULL)
+    cat->wrappers[i] = ephy_encoding_new (encoding_entries[i].code,
+                                          _(encoding_entries[i].title),
+                                          encoding_entries[i].groups);
+
+  return cat->wrappers[i];
+}
+
+static EphyEncoding *
+catalog_lookup (EncodingsCatalog *cat,
+                const char *code)
+{
+  guint *entry;
+
+  entry = bsearch (code, cat->by_code, N_ENTRIES, sizeof (guint),
+                   compare_code_with_entry);
+
+  return entry ? catalog_get_entry (cat, *entry) : NULL;
+}
+
+static int
+compare_encodings (EphyEncoding *a,
+                   EphyEncoding *b)
+{
+  return strcmp (ephy_encoding_get_collation_key (a),
+                 ephy_encoding_get_collation_key (b));
+}
+
+static int
+compare_entry_titles (gconstpointer a,
+                      gconstpointer b)
+{
+  return compare_encodings (catalog->wrappers[*(const guint *)a],
+                            catalog->wrappers[*(const guint *)b]);
+}
+
+static void
+catalog_ensure_sorted (EncodingsCatalog *cat)
+{
+  guint i, group;
+
+  if (cat->sorted)
+    return;
+
+  START_PROFILER ("Sorting encodings catalog")
+
+  for (i = 0; i < N_ENTRIES; i++) {
+    catalog_get_entry (cat, i);
+    cat->by_title[i] = i;
+  }
+  qsort (cat->by_title, N_ENTRIES, sizeof (guint), compare_entry_titles);
+
+  for (i = 0; i < N_ENTRIES; i++) {
+    EphyLanguageGroup groups = encoding_entries[cat->by_title[i]].groups;
+
+    for (group = 0; group < N_LANGUAGE_GROUPS; group++)
+      if (groups & (1 << group))
+        cat->n_by_group[group]++;
+  }
+
+  for (group = 0; group < N_LANGUAGE_GROUPS; group++) {
+    guint n = 0;
+
+    if (cat->n_by_group[group] == 0)
+      continue;
+
+    cat->by_group[group] = g_new (guint, cat->n_by_group[group]);
+    for (i = 0; i < N_ENTRIES; i++)
+      if (encoding_entries[cat->by_title[i]].groups & (1 << group))
+        cat->by_group[group][n++] = cat->by_title[i];
+  }
+
+  cat->sorted = TRUE;
+
+  STOP_PROFILER ("Sorting encodings catalog")
+}
+
 G_DEFINE_TYPE (EphyEncodings, ephy_encodings, G_TYPE_OBJECT)
 
 static void
@@ -145,7 +288,7 @@ ephy_encodings_finalize (GObject *object)
 {
   EphyEncodings *encodings = EPHY_ENCODINGS (object);
 
-  g_hash_table_destroy (encodings->priv->hash);
+  g_hash_table_destroy (encodings->priv->unknown);
 
   g_slist_foreach (encodings->priv->recent, (GFunc)g_free, NULL);
   g_slist_free (encodings->priv->recent);
@@ -190,7 +333,7 @@ add_encoding (EphyEncodings *encodings,
   /* Create node. */
   encoding = ephy_encoding_new (code, title, groups);
   /* Add it. */
-  g_hash_table_insert (encodings->priv->hash, g_strdup (code), encoding);
+  g_hash_table_insert (encodings->priv->unknown, g_strdup (code), encoding);
 
   g_signal_emit_by_name (encodings, "encoding-added", encoding);
 
@@ -206,7 +349,9 @@ ephy_encodings_get_encoding (EphyEncodings *encodings,
 
   g_return_val_if_fail (EPHY_IS_ENCODINGS (encodings), NULL);
 
-  encoding = g_hash_table_lookup (encodings->priv->hash, code);
+  encoding = catalog_lookup (get_catalog (), code);
+  if (encoding == NULL)
+    encoding = g_hash_table_lookup (encodings->priv->unknown, code);
 
   /* if it doesn't exist, add a node for it */
   if (!EPHY_IS_ENCODING (encoding) && add_if_not_found) {
@@ -223,57 +368,77 @@ ephy_encodings_get_encoding (EphyEncodings *encodings,
   return encoding;
 }
 
-typedef struct {
-  GList *list;
-  EphyLanguageGroup group_mask;
-} GetEncodingsData;
-
-static void
-get_encodings_foreach (gpointer key,
-                       gpointer value,
-                       gpointer user_data)
-{
-  GetEncodingsData *data = (GetEncodingsData*)user_data;
-  EphyLanguageGroup group;
-  
-  group = ephy_encoding_get_language_groups (EPHY_ENCODING (value));
-  if ((group & data->group_mask) != 0)
-    data->list = g_list_prepend (data->list, value);
-}
-
+/**
+ * ephy_encodings_get_encodings:
+ * @encodings: an #EphyEncodings
+ * @group_mask: the language groups to match
+ *
+ * Returns: (transfer container): the known encodings belonging to any
+ * of the groups in @group_mask, sorted by title
+ **/
 GList *
 ephy_encodings_get_encodings (EphyEncodings *encodings,
                               EphyLanguageGroup group_mask)
 {
+  EncodingsCatalog *cat;
   GList *list = NULL;
-  GetEncodingsData data;
+  int i;
 
-  data.list = list;
-  data.group_mask = group_mask;
+  g_return_val_if_fail (EPHY_IS_ENCODINGS (encodings), NULL);
 
-  g_hash_table_foreach (encodings->priv->hash, (GHFunc)get_encodings_foreach, &data);
+  cat = get_catalog ();
+  catalog_ensure_sorted (cat);
 
-  return list;
-}
+  /* The menu asks for the group of a single encoding, which is
+   * almost always one group: use its index directly. */
+  if (group_mask != 0 && (group_mask & (group_mask - 1)) == 0) {
+    int group = g_bit_nth_lsf (group_mask, -1);
 
-static void
-get_all_encodings (gpointer key,
-                   gpointer value,
-                   gpointer user_data)
-{
-  GList **l = (GList**)user_data;
+    if (group < N_LANGUAGE_GROUPS)
+      for (i = (int)cat->n_by_group[group] - 1; i >= 0; i--)
+        list = g_list_prepend (list, cat->wrappers[cat->by_group[group][i]]);
+
+    return list;
+  }
+
+  for (i = N_ENTRIES - 1; i >= 0; i--) {
+    guint entry = cat->by_title[i];
 
-  *l = g_list_prepend (*l, value);
+    if ((encoding_entries[entry].groups & group_mask) != 0)
+      list = g_list_prepend (list, cat->wrappers[entry]);
+  }
+
+  return list;
 }
 
+/**
+ * ephy_encodings_get_all:
+ * @encodings: an #EphyEncodings
+ *
+ * Returns: (transfer container): all the encodings, including the
+ * unknown ones that were added, sorted by title
+ **/
 GList *
 ephy_encodings_get_all (EphyEncodings *encodings)
 {
+  EncodingsCatalog *cat;
+  GHashTableIter iter;
+  gpointer value;
   GList *l = NULL;
+  int i;
 
   g_return_val_if_fail (EPHY_IS_ENCODINGS (encodings), NULL);
 
-  g_hash_table_foreach (encodings->priv->hash, (GHFunc)get_all_encodings, &l);
+  cat = get_catalog ();
+  catalog_ensure_sorted (cat);
+
+  for (i = N_ENTRIES - 1; i >= 0; i--)
+    l = g_list_prepend (l, cat->wrappers[cat->by_title[i]]);
+
+  /* There are rarely more than a couple of these. */
+  g_hash_table_iter_init (&iter, encodings->priv->unknown);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    l = g_list_insert_sorted (l, value, (GCompareFunc)compare_encodings);
 
   return l;
 }
@@ -354,17 +519,9 @@ ephy_encodings_init (EphyEncodings *encodings)
 
   LOG ("EphyEncodings initialising");
 
-  encodings->priv->hash = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                                 (GDestroyNotify)g_free,
-                                                 (GDestroyNotify)g_object_unref);
-
-  /* Fill the db. */
-  for (i = 0; i < G_N_ELEMENTS (encoding_entries); i++) {
-    add_encoding (encodings,
-                  _(encoding_entries[i].title),
-                  encoding_entries[i].code,
-                  encoding_entries[i].groups);
-  }
+  encodings->priv->unknown = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                    (GDestroyNotify)g_free,
+                                                    (GDestroyNotify)g_object_unref);
 
   /* Get the list of recently used encodings. */
   list = g_settings_get_strv (EPHY_SETTINGS_STATE,
@@ -0,0 +1,831 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+#include "ephy-predictor.h"
+
+#include "ephy-debug.h"
+#include "ephy-metrics.h"
+
+#include <libsoup/soup.h>
+#include <string.h>
+#ifdef HAVE_WEBKIT2
+#include <webkit2/webkit2.h>
+#else
+#include <webkit/webkit.h>
+#endif
+
+/**
+ * SECTION:ephy-predictor
+ * @short_description: Resolves the hosts the user is likely to need next
+ *
+ * The predictor learns, for every host the user visits, which hosts
+ * its pages load subresources from and which hosts the user goes on to
+ * from there. Visits are learned at the same point they are recorded
+ * in the #EphyHistoryService. Everything learned is forgotten when
+ * history is cleared, and what was learned about a host when its
+ * history is deleted.
+ *
+ * When the user is about to load a page, e.g. while typing in the
+ * location entry or hovering a link, ephy_predictor_predict() starts
+ * DNS resolution for that host and for the hosts its pages usually
+ * need. When a page has loaded, the likely next hosts are resolved.
+ *
+ * Each host whose statistics drive a prediction gets a small budget of
+ * prefetches per time window, and hosts nothing was learned about share
+ * a larger one. Prefetches are counted as hits when the
+ * host is actually used before the resolver would have expired it, and
+ * as misses otherwise; hosts whose predictions mostly miss only get the
+ * host itself prefetched.
+ */
+
+/* Hosts remembered, and targets remembered per host. */
+#define MAX_ORIGINS 512
+#define MAX_TARGETS 16
+
+/* Predicted hosts resolved at once, besides the target itself. */
+#define MAX_PREDICTIONS 4
+#define MIN_CONFIDENCE 0.2
+
+/* Roughly how long a resolved host stays in the resolver cache. */
+#define PREFETCH_TTL_USEC (60 * G_USEC_PER_SEC)
+
+#define BUDGET_WINDOW_USEC (10 * G_USEC_PER_SEC)
+#define BUDGET_PER_WINDOW 8
+/* Shared by every host that was never visited, so that hovering a page
+ * full of links does not run out of it at once. */
+#define TRANSIENT_BUDGET_PER_WINDOW 32
+
+/* Once a host has this many prefetches accounted for, predictions for
+ * it are only made while its hit rate stays above MIN_HIT_RATE. */
+#define MIN_SAMPLES 10
+#define MIN_HIT_RATE 0.2
+
+#define EPHY_PREDICTOR_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), EPHY_TYPE_PREDICTOR, EphyPredictorPrivate))
+
+typedef struct {
+  guint count;
+  guint last_load;
+} TargetStats;
+
+typedef struct {
+  char *host;
+  gint64 last_used;
+
+  guint n_loads;
+  GHashTable *subresource_hosts; /* host -> TargetStats */
+  GHashTable *next_hosts;        /* host -> TargetStats */
+
+  gint64 window_start;
+  guint n_in_window;
+  guint n_prefetches;
+  guint n_hits;
+} OriginStats;
+
+typedef struct {
+  char *origin;
+  gint64 time;
+} PrefetchRecord;
+
+struct _EphyPredictorPrivate {
+  EphyHistoryService *history_service;
+
+  GHashTable *origins;    /* host -> OriginStats */
+  GHashTable *prefetched; /* host -> PrefetchRecord */
+
+  /* Budget for prefetching hosts nothing was learned about. */
+  OriginStats transient;
+
+  guint n_prefetches;
+  guint n_hits;
+  guint n_misses;
+
+  EphyMetricsCounter *prefetches_metric;
+  EphyMetricsCounter *hits_metric;
+  EphyMetricsCounter *misses_metric;
+  EphyMetricsHistogram *ttfb_prefetched_metric;
+  EphyMetricsHistogram *ttfb_cold_metric;
+};
+
+enum {
+  PROP_0,
+  PROP_HISTORY_SERVICE
+};
+
+G_DEFINE_TYPE (EphyPredictor, ephy_predictor, G_TYPE_OBJECT)
+
+static char *
+get_host (const char *uri)
+{
+  SoupURI *soup_uri;
+  char *host = NULL;
+
+  if (uri == NULL)
+    return NULL;
+
+  soup_uri = soup_uri_new (uri);
+  if (soup_uri == NULL)
+    return NULL;
+
+  if (SOUP_URI_VALID_FOR_HTTP (soup_uri))
+    host = g_strdup (soup_uri->host);
+  soup_uri_free (soup_uri);
+
+  return host;
+}
+
+static void
+origin_stats_free (OriginStats *origin)
+{
+  g_free (origin->host);
+  g_hash_table_destroy (origin->subresource_hosts);
+  g_hash_table_destroy (origin->next_hosts);
+  g_slice_free (OriginStats, origin);
+}
+
+static void
+target_stats_free (TargetStats *target)
+{
+  g_slice_free (TargetStats, target);
+}
+
+static void
+prefetch_record_free (PrefetchRecord *record)
+{
+  g_free (record->origin);
+  g_slice_free (PrefetchRecord, record);
+}
+
+static OriginStats *
+lookup_origin (EphyPredictor *predictor,
+               const char *host,
+               gboolean create)
+{
+  EphyPredictorPrivate *priv = predictor->priv;
+  OriginStats *origin;
+
+  origin = g_hash_table_lookup (priv->origins, host);
+  if (origin != NULL || !create)
+    return origin;
+
+  /* Make room by forgetting the host that was used longest ago. */
+  if (g_hash_table_size (priv->origins) >= MAX_ORIGINS) {
+    GHashTableIter iter;
+    OriginStats *oldest = NULL;
+    gpointer value;
+
+    g_hash_table_iter_init (&iter, priv->origins);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+      OriginStats *candidate = value;
+
+      if (oldest == NULL || candidate->last_used < oldest->last_used)
+        oldest = candidate;
+    }
+
+    g_hash_table_remove (priv->origins, oldest->host);
+  }
+
+  origin = g_slice_new0 (OriginStats);
+  origin->host = g_strdup (host);
+  origin->subresource_hosts = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                     g_free, (GDestroyNotify)target_stats_free);
+  origin->next_hosts = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, (GDestroyNotify)target_stats_free);
+  g_hash_table_insert (priv->origins, origin->host, origin);
+
+  return origin;
+}
+
+/* Counts @host once per load of @origin in @targets. */
+static void
+add_target (OriginStats *origin,
+            GHashTable *targets,
+            const char *host)
+{
+  TargetStats *target;
+
+  target = g_hash_table_lookup (targets, host);
+  if (target == NULL) {
+    if (g_hash_table_size (targets) >= MAX_TARGETS) {
+      GHashTableIter iter;
+      gpointer key, value;
+      const char *weakest = NULL;
+      guint weakest_count = G_MAXUINT;
+
+      g_hash_table_iter_init (&iter, targets);
+      while (g_hash_table_iter_next (&iter, &key, &value)) {
+        if (((TargetStats *)value)->count < weakest_count) {
+          weakest = key;
+          weakest_count = ((TargetStats *)value)->count;
+        }
+      }
+
+      g_hash_table_remove (targets, weakest);
+    }
+
+    target = g_slice_new0 (TargetStats);
+    g_hash_table_insert (targets, g_strdup (host), target);
+  } else if (target->last_load == origin->n_loads) {
+    return;
+  }
+
+  target->count++;
+  target->last_load = origin->n_loads;
+}
+
+static void
+account_miss (EphyPredictor *predictor)
+{
+  predictor->priv->n_misses++;
+  ephy_metrics_counter_add (predictor->priv->misses_metric, 1);
+}
+
+/* Accounts for a use of @host, and returns whether it was prefetched. */
+static gboolean
+account_use (EphyPredictor *predictor,
+             const char *host)
+{
+  EphyPredictorPrivate *priv = predictor->priv;
+  PrefetchRecord *record;
+  OriginStats *origin;
+
+  record = g_hash_table_lookup (priv->prefetched, host);
+  if (record == NULL)
+    return FALSE;
+
+  if (g_get_monotonic_time () - record->time > PREFETCH_TTL_USEC) {
+    account_miss (predictor);
+    g_hash_table_remove (priv->prefetched, host);
+    return FALSE;
+  }
+
+  priv->n_hits++;
+  ephy_metrics_counter_add (priv->hits_metric, 1);
+
+  origin = record->origin ? lookup_origin (predictor, record->origin, FALSE) : NULL;
+  if (origin != NULL)
+    origin->n_hits++;
+
+  LOG ("Prefetched host %s was used", host);
+  g_hash_table_remove (priv->prefetched, host);
+
+  return TRUE;
+}
+
+static void
+expire_prefetches (EphyPredictor *predictor)
+{
+  GHashTableIter iter;
+  gpointer value;
+  gint64 now = g_get_monotonic_time ();
+
+  g_hash_table_iter_init (&iter, predictor->priv->prefetched);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    PrefetchRecord *record = value;
+
+    if (now - record->time > PREFETCH_TTL_USEC) {
+      account_miss (predictor);
+      g_hash_table_iter_remove (&iter);
+    }
+  }
+}
+
+static gboolean
+origin_has_budget (EphyPredictor *predictor,
+                   OriginStats *origin)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  if (now - origin->window_start > BUDGET_WINDOW_USEC) {
+    origin->window_start = now;
+    origin->n_in_window = 0;
+  }
+
+  if (origin == &predictor->priv->transient)
+    return origin->n_in_window < TRANSIENT_BUDGET_PER_WINDOW;
+
+  return origin->n_in_window < BUDGET_PER_WINDOW;
+}
+
+static gboolean
+origin_predicts_well (OriginStats *origin)
+{
+  if (origin->n_prefetches < MIN_SAMPLES)
+    return TRUE;
+
+  return origin->n_hits >= origin->n_prefetches * MIN_HIT_RATE;
+}
+
+static void
+prefetch_host (EphyPredictor *predictor,
+               OriginStats *origin,
+               const char *host)
+{
+  EphyPredictorPrivate *priv = predictor->priv;
+  PrefetchRecord *record;
+#ifdef HAVE_WEBKIT2
+  WebKitWebContext *context;
+#else
+  SoupSession *session;
+#endif
+
+  /* Still in the resolver cache, nothing to do. */
+  if (g_hash_table_contains (priv->prefetched, host))
+    return;
+
+  if (!origin_has_budget (predictor, origin))
+    return;
+
+  LOG ("Prefetching %s for %s", host, origin->host ? origin->host : host);
+
+#ifdef HAVE_WEBKIT2
+  context = webkit_web_context_get_default ();
+  webkit_web_context_prefetch_dns (context, host);
+#else
+  session = webkit_get_default_session ();
+  soup_session_prefetch_dns (session, host, NULL, NULL, NULL);
+#endif
+
+  record = g_slice_new (PrefetchRecord);
+  record->origin = g_strdup (origin->host);
+  record->time = g_get_monotonic_time ();
+  g_hash_table_insert (priv->prefetched, g_strdup (host), record);
+
+  origin->n_in_window++;
+  origin->n_prefetches++;
+  priv->n_prefetches++;
+  ephy_metrics_counter_add (priv->prefetches_metric, 1);
+}
+
+typedef struct {
+  const char *host;
+  double confidence;
+} Prediction;
+
+static int
+compare_predictions (gconstpointer a,
+                     gconstpointer b)
+{
+  double confidence_a = ((const Prediction *)a)->confidence;
+  double confidence_b = ((const Prediction *)b)->confidence;
+
+  return confidence_a < confidence_b ? 1 : confidence_a > confidence_b ? -1 : 0;
+}
+
+/* Prefetches the hosts in @targets that more than MIN_CONFIDENCE of
+ * the loads of @origin needed, most likely first. */
+static void
+prefetch_targets (EphyPredictor *predictor,
+                  OriginStats *origin,
+                  GHashTable *targets)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  GArray *predictions;
+  guint i;
+
+  if (origin->n_loads == 0 || !origin_predicts_well (origin))
+    return;
+
+  predictions = g_array_new (FALSE, FALSE, sizeof (Prediction));
+
+  g_hash_table_iter_init (&iter, targets);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    Prediction prediction;
+
+    prediction.host = key;
+    prediction.confidence = (double)((TargetStats *)value)->count / origin->n_loads;
+    if (prediction.confidence >= MIN_CONFIDENCE)
+      g_array_append_val (predictions, prediction);
+  }
+
+  g_array_sort (predictions, compare_predictions);
+
+  for (i = 0; i < predictions->len && i < MAX_PREDICTIONS; i++)
+    prefetch_host (predictor, origin, g_array_index (predictions, Prediction, i).host);
+
+  g_array_free (predictions, TRUE);
+}
+
+static void
+history_cleared_cb (EphyHistoryService *service,
+                    EphyPredictor *predictor)
+{
+  ephy_predictor_clear (predictor);
+}
+
+static void
+forget_uri_host (EphyPredictor *predictor,
+                 const char *uri)
+{
+  char *host;
+
+  host = get_host (uri);
+  if (host == NULL)
+    return;
+
+  ephy_predictor_forget_host (predictor, host);
+  g_free (host);
+}
+
+static void
+history_urls_deleted_cb (EphyHistoryService *service,
+                         char **urls,
+                         EphyPredictor *predictor)
+{
+  guint i;
+
+  for (i = 0; urls[i] != NULL; i++)
+    forget_uri_host (predictor, urls[i]);
+}
+
+static void
+history_host_deleted_cb (EphyHistoryService *service,
+                         const char *url,
+                         EphyPredictor *predictor)
+{
+  forget_uri_host (predictor, url);
+}
+
+static void
+ephy_predictor_set_property (GObject *object,
+                             guint prop_id,
+                             const GValue *value,
+                             GParamSpec *pspec)
+{
+  EphyPredictor *predictor = EPHY_PREDICTOR (object);
+
+  switch (prop_id) {
+  case PROP_HISTORY_SERVICE:
+    predictor->priv->history_service = g_value_dup_object (value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+ephy_predictor_constructed (GObject *object)
+{
+  EphyPredictorPrivate *priv = EPHY_PREDICTOR (object)->priv;
+
+  G_OBJECT_CLASS (ephy_predictor_parent_class)->constructed (object);
+
+  if (priv->history_service == NULL)
+    return;
+
+  g_signal_connect_object (priv->history_service, "cleared",
+                           G_CALLBACK (history_cleared_cb), object, 0);
+  g_signal_connect_object (priv->history_service, "urls-deleted",
+                           G_CALLBACK (history_urls_deleted_cb), object, 0);
+  g_signal_connect_object (priv->history_service, "host-deleted",
+                           G_CALLBACK (history_host_deleted_cb), object, 0);
+}
+
+static void
+ephy_predictor_dispose (GObject *object)
+{
+  EphyPredictorPrivate *priv = EPHY_PREDICTOR (object)->priv;
+
+  g_clear_object (&priv->history_service);
+
+  G_OBJECT_CLASS (ephy_predictor_parent_class)->dispose (object);
+}
+
+static void
+ephy_predictor_finalize (GObject *object)
+{
+  EphyPredictorPrivate *priv = EPHY_PREDICTOR (object)->priv;
+
+  g_hash_table_destroy (priv->origins);
+  g_hash_table_destroy (priv->prefetched);
+
+  G_OBJECT_CLASS (ephy_predictor_parent_class)->finalize (object);
+}
+
+static void
+ephy_predictor_init (EphyPredictor *predictor)
+{
+  EphyPredictorPrivate *priv;
+
+  priv = predictor->priv = EPHY_PREDICTOR_GET_PRIVATE (predictor);
+
+  priv->origins = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         NULL, (GDestroyNotify)origin_stats_free);
+  priv->prefetched = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                            g_free, (GDestroyNotify)prefetch_record_free);
+
+  priv->prefetches_metric = ephy_metrics_counter_get ("predictor.prefetches");
+  priv->hits_metric = ephy_metrics_counter_get ("predictor.hits");
+  priv->misses_metric = ephy_metrics_counter_get ("predictor.misses");
+  priv->ttfb_prefetched_metric = ephy_metrics_histogram_get ("predictor.ttfb-prefetched");
+  priv->ttfb_cold_metric = ephy_metrics_histogram_get ("predictor.ttfb-cold");
+}
+
+static void
+ephy_predictor_class_init (EphyPredictorClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->set_property = ephy_predictor_set_property;
+  object_class->constructed = ephy_predictor_constructed;
+  object_class->dispose = ephy_predictor_dispose;
+  object_class->finalize = ephy_predictor_finalize;
+
+  /**
+   * EphyPredictor:history-service:
+   *
+   * The #EphyHistoryService whose visits the predictor learns from.
+   * Clearing its history also clears the predictor.
+   */
+  g_object_class_install_property (object_class,
+                                   PROP_HISTORY_SERVICE,
+                                   g_param_spec_object ("history-service",
+                                                        "History service",
+                                                        "The history service",
+                                                        EPHY_TYPE_HISTORY_SERVICE,
+                                                        G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS));
+
+  g_type_class_add_private (object_class, sizeof (EphyPredictorPrivate));
+}
+
+/**
+ * ephy_predictor_new:
+ * @history_service: the #EphyHistoryService the visits are recorded in
+ *
+ * Returns: a new #EphyPredictor
+ **/
+EphyPredictor *
+ephy_predictor_new (EphyHistoryService *history_service)
+{
+  return g_object_new (EPHY_TYPE_PREDICTOR,
+                       "history-service", history_service,
+                       NULL);
+}
+
+/**
+ * ephy_predictor_predict:
+ * @predictor: an #EphyPredictor
+ * @uri: the URI the user is likely to load
+ *
+ * Starts resolving the host of @uri and the hosts its pages usually
+ * load subresources from. This does not count as a use of the host,
+ * hosts that were never visited share a prefetch budget of their own.
+ **/
+void
+ephy_predictor_predict (EphyPredictor *predictor,
+                        const char *uri)
+{
+  OriginStats *origin;
+  char *host;
+
+  g_return_if_fail (EPHY_IS_PREDICTOR (predictor));
+
+  host = get_host (uri);
+  if (host == NULL)
+    return;
+
+  expire_prefetches (predictor);
+
+  /* Only visits make a host worth remembering, what is hovered or
+   * typed must not push learned hosts out. */
+  origin = lookup_origin (predictor, host, FALSE);
+  if (origin == NULL) {
+    prefetch_host (predictor, &predictor->priv->transient, host);
+    g_free (host);
+    return;
+  }
+
+  prefetch_host (predictor, origin, host);
+  prefetch_targets (predictor, origin, origin->subresource_hosts);
+
+  g_free (host);
+}
+
+/**
+ * ephy_predictor_take_prefetched:
+ * @predictor: an #EphyPredictor
+ * @uri: the URI that is starting to load
+ *
+ * Accounts for a load of @uri starting. Call this when the load
+ * starts, before ephy_predictor_learn_navigation().
+ *
+ * Returns: %TRUE if the host of @uri had been prefetched and the
+ * load should not need to wait for DNS
+ **/
+gboolean
+ephy_predictor_take_prefetched (EphyPredictor *predictor,
+                                const char *uri)
+{
+  char *host;
+  gboolean prefetched;
+
+  g_return_val_if_fail (EPHY_IS_PREDICTOR (predictor), FALSE);
+
+  host = get_host (uri);
+  if (host == NULL)
+    return FALSE;
+
+  prefetched = account_use (predictor, host);
+  g_free (host);
+
+  return prefetched;
+}
+
+/**
+ * ephy_predictor_account_first_byte:
+ * @predictor: an #EphyPredictor
+ * @prefetched: what ephy_predictor_take_prefetched() returned for the load
+ * @usecs: time from the start of the load to its first byte
+ *
+ * Records how long a load took to get its first byte, split by whether
+ * its host had been prefetched.
+ **/
+void
+ephy_predictor_account_first_byte (EphyPredictor *predictor,
+                                   gboolean prefetched,
+                                   gint64 usecs)
+{
+  EphyPredictorPrivate *priv;
+
+  g_return_if_fail (EPHY_IS_PREDICTOR (predictor));
+
+  priv = predictor->priv;
+  ephy_metrics_histogram_add (prefetched ? priv->ttfb_prefetched_metric : priv->ttfb_cold_metric,
+                              usecs);
+}
+
+/**
+ * ephy_predictor_learn_navigation:
+ * @predictor: an #EphyPredictor
+ * @from_uri: (allow-none): the page the navigation started from
+ * @to_uri: the page that was loaded
+ *
+ * Records a visit to @to_uri, reached from @from_uri, and prefetches
+ * the hosts the user usually goes on to from the host of @to_uri.
+ **/
+void
+ephy_predictor_learn_navigation (EphyPredictor *predictor,
+                                 const char *from_uri,
+                                 const char *to_uri)
+{
+  OriginStats *origin;
+  char *from_host, *to_host;
+
+  g_return_if_fail (EPHY_IS_PREDICTOR (predictor));
+
+  to_host = get_host (to_uri);
+  if (to_host == NULL)
+    return;
+
+  from_host = get_host (from_uri);
+  if (from_host != NULL && strcmp (from_host, to_host) != 0) {
+    origin = lookup_origin (predictor, from_host, FALSE);
+    if (origin != NULL)
+      add_target (origin, origin->next_hosts, to_host);
+  }
+
+  origin = lookup_origin (predictor, to_host, TRUE);
+  origin->last_used = g_get_monotonic_time ();
+  origin->n_loads++;
+
+  expire_prefetches (predictor);
+  prefetch_targets (predictor, origin, origin->next_hosts);
+
+  g_free (from_host);
+  g_free (to_host);
+}
+
+/**
+ * ephy_predictor_learn_subresource:
+ * @predictor: an #EphyPredictor
+ * @page_uri: the page loading the resource
+ * @resource_uri: the URI of the resource
+ *
+ * Records that the page at @page_uri loads a resource from the host of
+ * @resource_uri. Each host is only counted once per load of the page.
+ **/
+void
+ephy_predictor_learn_subresource (EphyPredictor *predictor,
+                                  const char *page_uri,
+                                  const char *resource_uri)
+{
+  OriginStats *origin;
+  char *page_host, *resource_host;
+
+  g_return_if_fail (EPHY_IS_PREDICTOR (predictor));
+
+  resource_host = get_host (resource_uri);
+  if (resource_host == NULL)
+    return;
+
+  account_use (predictor, resource_host);
+
+  page_host = get_host (page_uri);
+  if (page_host != NULL && strcmp (page_host, resource_host) != 0) {
+    origin = lookup_origin (predictor, page_host, FALSE);
+    if (origin != NULL && origin->n_loads > 0)
+      add_target (origin, origin->subresource_hosts, resource_host);
+  }
+
+  g_free (page_host);
+  g_free (resource_host);
+}
+
+/**
+ * ephy_predictor_clear:
+ * @predictor: an #EphyPredictor
+ *
+ * Forgets everything @predictor has learned.
+ **/
+void
+ephy_predictor_clear (EphyPredictor *predictor)
+{
+  g_return_if_fail (EPHY_IS_PREDICTOR (predictor));
+
+  g_hash_table_remove_all (predictor->priv->origins);
+  g_hash_table_remove_all (predictor->priv->prefetched);
+}
+
+/**
+ * ephy_predictor_forget_host:
+ * @predictor: an #EphyPredictor
+ * @host: a host name
+ *
+ * Forgets what @predictor has learned about @host, both as a host the
+ * user visited and as a host other pages lead to.
+ **/
+void
+ephy_predictor_forget_host (EphyPredictor *predictor,
+                            const char *host)
+{
+  EphyPredictorPrivate *priv;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_return_if_fail (EPHY_IS_PREDICTOR (predictor));
+  g_return_if_fail (host != NULL);
+
+  priv = predictor->priv;
+
+  g_hash_table_remove (priv->origins, host);
+  g_hash_table_remove (priv->prefetched, host);
+
+  g_hash_table_iter_init (&iter, priv->origins);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    OriginStats *origin = value;
+
+    g_hash_table_remove (origin->subresource_hosts, host);
+    g_hash_table_remove (origin->next_hosts, host);
+  }
+}
+
+/**
+ * ephy_predictor_get_stats:
+ * @predictor: an #EphyPredictor
+ * @n_prefetches: (out) (allow-none): return location for the number of
+ * hosts prefetched
+ * @n_hits: (out) (allow-none): return location for the number of
+ * prefetched hosts that were used
+ * @n_misses: (out) (allow-none): return location for the number of
+ * prefetched hosts that expired unused
+ *
+ * Gets the prefetch statistics of @predictor. The same numbers are
+ * reported as the "predictor.*" metrics.
+ **/
+void
+ephy_predictor_get_stats (EphyPredictor *predictor,
+                          guint *n_prefetches,
+                          guint *n_hits,
+                          guint *n_misses)
+{
+  g_return_if_fail (EPHY_IS_PREDICTOR (predictor));
+
+  expire_prefetches (predictor);
+
+  if (n_prefetches)
+    *n_prefetches = predictor->priv->n_prefetches;
+  if (n_hits)
+    *n_hits = predictor->priv->n_hits;
+  if (n_misses)
+    *n_misses = predictor->priv->n_misses;
+}
@@ -0,0 +1,92 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#if !defined (__EPHY_EPIPHANY_H_INSIDE__) && !defined (EPIPHANY_COMPILATION)
+#error "Only <epiphany/epiphany.h> can be included directly."
+#endif
+
+#ifndef EPHY_PREDICTOR_H
+#define EPHY_PREDICTOR_H
+
+#include <glib-object.h>
+
+#include "ephy-history-service.h"
+
+G_BEGIN_DECLS
+
+#define EPHY_TYPE_PREDICTOR         (ephy_predictor_get_type ())
+#define EPHY_PREDICTOR(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), EPHY_TYPE_PREDICTOR, EphyPredictor))
+#define EPHY_PREDICTOR_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), EPHY_TYPE_PREDICTOR, EphyPredictorClass))
+#define EPHY_IS_PREDICTOR(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), EPHY_TYPE_PREDICTOR))
+#define EPHY_IS_PREDICTOR_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), EPHY_TYPE_PREDICTOR))
+#define EPHY_PREDICTOR_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), EPHY_TYPE_PREDICTOR, EphyPredictorClass))
+
+typedef struct _EphyPredictor        EphyPredictor;
+typedef struct _EphyPredictorClass   EphyPredictorClass;
+typedef struct _EphyPredictorPrivate EphyPredictorPrivate;
+
+struct _EphyPredictor
+{
+  GObject parent;
+
+  /*< private >*/
+  EphyPredictorPrivate *priv;
+};
+
+struct _EphyPredictorClass
+{
+  GObjectClass parent_class;
+};
+
+GType          ephy_predictor_get_type            (void);
+
+EphyPredictor *ephy_predictor_new                 (EphyHistoryService *history_service);
+
+void           ephy_predictor_predict             (EphyPredictor *predictor,
+                                                   const char    *uri);
+
+gboolean       ephy_predictor_take_prefetched     (EphyPredictor *predictor,
+                                                   const char    *uri);
+
+void           ephy_predictor_account_first_byte  (EphyPredictor *predictor,
+                                                   gboolean       prefetched,
+                                                   gint64         usecs);
+
+void           ephy_predictor_learn_navigation    (EphyPredictor *predictor,
+                                                   const char    *from_uri,
+                                                   const char    *to_uri);
+
+void           ephy_predictor_learn_subresource   (EphyPredictor *predictor,
+                                                   const char    *page_uri,
+                                                   const char    *resource_uri);
+
+void           ephy_predictor_clear               (EphyPredictor *predictor);
+
+void           ephy_predictor_forget_host         (EphyPredictor *predictor,
+                                                   const char    *host);
+
+void           ephy_predictor_get_stats           (EphyPredictor *predictor,
+                                                   guint         *n_prefetches,
+                                                   guint         *n_hits,
+                                                   guint         *n_misses);
+
+G_END_DECLS
+
+#endif
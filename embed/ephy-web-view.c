@@ -38,12 +38,18 @@
 #include "ephy-file-monitor.h"
 #include "ephy-form-auth-data.h"
 #include "ephy-history-service.h"
+#include "ephy-metrics.h"
 #include "ephy-overview.h"
+#include "ephy-predictor.h"
 #include "ephy-prefs.h"
+#include "ephy-saved-page.h"
 #include "ephy-settings.h"
 #include "ephy-string.h"
 #include "ephy-web-app-utils.h"
 #include "ephy-web-dom-utils.h"
+#ifdef HAVE_WEBKIT2
+#include "ephy-web-extension.h"
+#endif
 #include "ephy-zoom.h"
 
 #include <gio/gio.h>
@@ -51,6 +57,7 @@
 #include <glib/gstdio.h>
 #include <gtk/gtk.h>
 #include <libsoup/soup.h>
+#include <string.h>
 
 /**
  * SECTION:ephy-web-view
@@ -77,6 +84,8 @@ struct _EphyWebViewPrivate {
   guint is_setting_zoom : 1;
   guint load_failed : 1;
   guint history_frozen : 1;
+  guint has_modified_forms : 1;
+  guint load_prefetched : 1;
 
   char *address;
   char *typed_address;
@@ -106,6 +115,8 @@ struct _EphyWebViewPrivate {
 
   EphyHistoryPageVisitType visit_type;
 
+  gint64 load_start_time;
+
   gulong do_not_track_handler;
 
   /* TLS information. */
@@ -969,6 +980,8 @@ _ephy_web_view_update_icon (EphyWebView *view)
   }
 
   if (priv->address) {
+    static EphyMetricsCounter *loads_metric = NULL;
+    static EphyMetricsCounter *misses_metric = NULL;
 #ifdef HAVE_WEBKIT2
     cairo_surface_t *icon_surface = webkit_web_view_get_favicon (WEBKIT_WEB_VIEW (view));
     if (icon_surface)
@@ -979,6 +992,12 @@ _ephy_web_view_update_icon (EphyWebView *view)
       priv->icon = webkit_favicon_database_try_get_favicon_pixbuf (webkit_get_favicon_database (), page_uri,
                                                                    FAVICON_SIZE, FAVICON_SIZE);
 #endif
+
+    if (!loads_metric) {
+      loads_metric = ephy_metrics_counter_get ("favicon.loads");
+      misses_metric = ephy_metrics_counter_get ("favicon.misses");
+    }
+    ephy_metrics_counter_add (priv->icon ? loads_metric : misses_metric, 1);
   }
 
   g_object_notify (G_OBJECT (view), "icon");
@@ -1047,6 +1066,18 @@ form_auth_data_save_requested (EphyEmbedShell *shell,
 
   gtk_widget_show (info_bar);
 }
+
+static void
+page_has_modified_forms_changed (EphyEmbedShell *shell,
+                                 guint64 page_id,
+                                 gboolean has_modified_forms,
+                                 WebKitWebView *web_view)
+{
+  if (webkit_web_view_get_page_id (web_view) != page_id)
+    return;
+
+  EPHY_WEB_VIEW (web_view)->priv->has_modified_forms = has_modified_forms;
+}
 #endif
 
 static void
@@ -1062,6 +1093,7 @@ ephy_web_view_dispose (GObject *object)
   g_signal_handlers_disconnect_by_func (object, icon_changed_cb, NULL);
 
   g_signal_handlers_disconnect_by_func (ephy_embed_shell_get_default (), form_auth_data_save_requested, object);
+  g_signal_handlers_disconnect_by_func (ephy_embed_shell_get_default (), page_has_modified_forms_changed, object);
 #endif
 
   g_clear_object (&priv->file_monitor);
@@ -1251,6 +1283,12 @@ uri_changed_cb (WebKitWebView *web_view,
   g_free (uri);
 }
 
+static EphyPredictor *
+get_predictor (void)
+{
+  return EPHY_PREDICTOR (ephy_embed_shell_get_predictor (ephy_embed_shell_get_default ()));
+}
+
 #ifdef HAVE_WEBKIT2
 static void
 mouse_target_changed_cb (EphyWebView *web_view,
@@ -1260,11 +1298,24 @@ mouse_target_changed_cb (EphyWebView *web_view,
 {
   const char *message = NULL;
 
-  if (webkit_hit_test_result_context_is_link (hit_test_result))
+  if (webkit_hit_test_result_context_is_link (hit_test_result)) {
     message = webkit_hit_test_result_get_link_uri (hit_test_result);
+    ephy_predictor_predict (get_predictor (), message);
+  }
 
   ephy_web_view_set_link_message (web_view, message);
 }
+
+static void
+resource_load_started_cb (WebKitWebView *web_view,
+                          WebKitWebResource *resource,
+                          WebKitURIRequest *request,
+                          gpointer user_data)
+{
+  ephy_predictor_learn_subresource (get_predictor (),
+                                    webkit_web_view_get_uri (web_view),
+                                    webkit_uri_request_get_uri (request));
+}
 #else
 static void
 hovering_over_link_cb (EphyWebView *web_view,
@@ -1272,6 +1323,9 @@ hovering_over_link_cb (EphyWebView *web_view,
                        char *location,
                        gpointer data)
 {
+  if (location)
+    ephy_predictor_predict (get_predictor (), location);
+
   ephy_web_view_set_link_message (web_view, location);
 }
 #endif
@@ -1952,6 +2006,21 @@ geolocation_policy_decision_requested_cb (WebKitWebView *web_view,
   return TRUE;
 }
 
+static void
+set_zoom_level_from_history (EphyWebView *view,
+                             double zoom_level)
+{
+  double current_zoom;
+
+  current_zoom = webkit_web_view_get_zoom_level (WEBKIT_WEB_VIEW (view));
+
+  if (zoom_level != current_zoom) {
+    view->priv->is_setting_zoom = TRUE;
+    webkit_web_view_set_zoom_level (WEBKIT_WEB_VIEW (view), zoom_level);
+    view->priv->is_setting_zoom = FALSE;
+  }
+}
+
 static void
 get_host_for_url_cb (gpointer service,
                      gboolean success,
@@ -1959,23 +2028,12 @@ get_host_for_url_cb (gpointer service,
                      gpointer user_data)
 {
   EphyHistoryHost *host;
-  EphyWebView *view;
-  double current_zoom;
 
   if (success == FALSE)
     return;
 
-  view = EPHY_WEB_VIEW (user_data);
   host = (EphyHistoryHost *)result_data;
-
-  current_zoom = webkit_web_view_get_zoom_level (WEBKIT_WEB_VIEW (view));
-
-  if (host->zoom_level != current_zoom) {
-    view->priv->is_setting_zoom = TRUE;
-    webkit_web_view_set_zoom_level (WEBKIT_WEB_VIEW (view), host->zoom_level);
-    view->priv->is_setting_zoom = FALSE;
-  }
-
+  set_zoom_level_from_history (EPHY_WEB_VIEW (user_data), host->zoom_level);
   ephy_history_host_free (host);
 }
 
@@ -1983,10 +2041,21 @@ static void
 restore_zoom_level (EphyWebView *view,
                     const char *address)
 {
-  if (ephy_embed_utils_address_has_web_scheme (address))
-    ephy_history_service_get_host_for_url (view->priv->history_service,
-                                           address, view->priv->history_service_cancellable,
-                                           (EphyHistoryJobCallback)get_host_for_url_cb, view);
+  double zoom_level;
+
+  if (!ephy_embed_utils_address_has_web_scheme (address))
+    return;
+
+  /* Avoid a round-trip to the history thread on every navigation. */
+  if (ephy_history_service_get_cached_zoom_level (view->priv->history_service,
+                                                  address, &zoom_level)) {
+    set_zoom_level_from_history (view, zoom_level);
+    return;
+  }
+
+  ephy_history_service_get_host_for_url (view->priv->history_service,
+                                         address, view->priv->history_service_cancellable,
+                                         (EphyHistoryJobCallback)get_host_for_url_cb, view);
 }
 
 static void
@@ -2116,6 +2185,9 @@ load_changed_cb (WebKitWebView *web_view,
     loading_uri = webkit_web_view_get_uri (web_view);
     g_signal_emit_by_name (view, "new-document-now", loading_uri);
 
+    priv->load_start_time = g_get_monotonic_time ();
+    priv->load_prefetched = ephy_predictor_take_prefetched (get_predictor (), loading_uri);
+
     if (ephy_embed_utils_is_no_show_address (loading_uri))
       ephy_web_view_freeze_history (view);
 
@@ -2138,9 +2210,22 @@ load_changed_cb (WebKitWebView *web_view,
     break;
   case WEBKIT_LOAD_COMMITTED: {
     const char* uri;
+    char *previous_uri;
     EphyWebViewSecurityLevel security_level = EPHY_WEB_VIEW_STATE_IS_UNKNOWN;
 
+    /* The forms of the previous document are gone. */
+    priv->has_modified_forms = FALSE;
+
+    /* Time to the first byte of the document, split by whether the
+     * predictor had resolved its host beforehand. */
+    if (priv->load_start_time != 0) {
+      ephy_predictor_account_first_byte (get_predictor (), priv->load_prefetched,
+                                         g_get_monotonic_time () - priv->load_start_time);
+      priv->load_start_time = 0;
+    }
+
     /* Title and location. */
+    previous_uri = g_strdup (priv->address);
     uri = webkit_web_view_get_uri (web_view);
     ephy_web_view_location_changed (view, uri);
 
@@ -2167,10 +2252,12 @@ load_changed_cb (WebKitWebView *web_view,
       ephy_history_service_visit_url (priv->history_service,
                                       history_uri,
                                       priv->visit_type);
+      ephy_predictor_learn_navigation (get_predictor (), previous_uri, uri);
 
       g_free (history_uri);
     }
 
+    g_free (previous_uri);
     ephy_web_view_thaw_history (view);
 
     break;
@@ -2785,6 +2872,9 @@ ephy_web_view_init (EphyWebView *web_view)
   g_signal_connect (web_view, "mouse-target-changed",
                     G_CALLBACK (mouse_target_changed_cb),
                     NULL);
+  g_signal_connect (web_view, "resource-load-started",
+                    G_CALLBACK (resource_load_started_cb),
+                    NULL);
 #else
   g_signal_connect (web_view, "hovering-over-link",
                     G_CALLBACK (hovering_over_link_cb),
@@ -2813,6 +2903,9 @@ ephy_web_view_init (EphyWebView *web_view)
   g_signal_connect (ephy_embed_shell_get_default (), "form-auth-data-save-requested",
                     G_CALLBACK (form_auth_data_save_requested),
                     web_view);
+  g_signal_connect (ephy_embed_shell_get_default (), "page-has-modified-forms-changed",
+                    G_CALLBACK (page_has_modified_forms_changed),
+                    web_view);
 #endif
 
 #ifndef HAVE_WEBKIT2
@@ -3494,38 +3587,200 @@ gboolean
 ephy_web_view_has_modified_forms (EphyWebView *view)
 {
 #ifdef HAVE_WEBKIT2
-  return FALSE;
-#if 0
-  GDBusProxy *web_extension;
-  GVariant *result;
-  gboolean retval = FALSE;
+  g_return_val_if_fail (EPHY_IS_WEB_VIEW (view), FALSE);
 
-  /* FIXME: This should be async */
-  web_extension = ephy_embed_shell_get_web_extension_proxy (ephy_embed_shell_get_default ());
-  if (!web_extension)
-    return FALSE;
-  result = g_dbus_proxy_call_sync (web_extension,
-                                   "HasModifiedForms",
-                                   g_variant_new ("(t)", webkit_web_view_get_page_id (WEBKIT_WEB_VIEW (view))),
-                                   G_DBUS_CALL_FLAGS_NONE,
-                                   -1,
-                                   NULL,
-                                   NULL);
+  /* Kept up to date by the web extension, which tracks form edits as
+   * they happen. The state may lag behind the last keystroke by a
+   * D-Bus round trip. */
+  return view->priv->has_modified_forms;
+#else
+  g_return_val_if_fail (EPHY_IS_WEB_VIEW (view), FALSE);
 
+  WebKitDOMDocument *document = webkit_web_view_get_dom_document (WEBKIT_WEB_VIEW (view));
+  return ephy_web_dom_utils_has_modified_forms (document);
+#endif
+}
 
-  g_variant_get (result, "(b)", &retval);
-  g_variant_unref (result);
+typedef struct {
+  char *title;
+  char *icon_uri;
+  char *icon_color;
+} WebAppInfo;
 
-  return retval;
+static void
+web_app_info_free (WebAppInfo *info)
+{
+  g_free (info->title);
+  g_free (info->icon_uri);
+  g_free (info->icon_color);
+  g_slice_free (WebAppInfo, info);
+}
+
+#ifdef HAVE_WEBKIT2
+static void
+query_web_app_info_cb (GDBusProxy *web_extension,
+                       GAsyncResult *result,
+                       GTask *task)
+{
+  GVariant *reply;
+  GVariantIter *pages;
+  GVariant *fields;
+  WebAppInfo *info;
+  GError *error = NULL;
+  guint64 page_id;
+
+  reply = g_dbus_proxy_call_finish (web_extension, result, &error);
+  if (!reply) {
+    g_task_return_error (task, error);
+    g_object_unref (task);
+    return;
+  }
+
+  info = g_slice_new0 (WebAppInfo);
+
+  g_variant_get (reply, "(a(ta{sv}))", &pages);
+  if (g_variant_iter_next (pages, "(t@a{sv})", &page_id, &fields)) {
+    gboolean has_icon = FALSE;
+    char *icon_uri = NULL;
+    char *icon_color = NULL;
+
+    g_variant_lookup (fields, EPHY_WEB_EXTENSION_FIELD_WEB_APP_TITLE, "s", &info->title);
+    if (g_variant_lookup (fields, EPHY_WEB_EXTENSION_FIELD_BEST_WEB_APP_ICON, "(bss)",
+                          &has_icon, &icon_uri, &icon_color) && has_icon) {
+      info->icon_uri = icon_uri;
+      info->icon_color = icon_color;
+    } else {
+      g_free (icon_uri);
+      g_free (icon_color);
+    }
+
+    g_variant_unref (fields);
+  }
+  g_variant_iter_free (pages);
+  g_variant_unref (reply);
+
+  g_task_return_pointer (task, info, (GDestroyNotify)web_app_info_free);
+  g_object_unref (task);
+}
+#endif
+
+/**
+ * ephy_web_view_get_web_app_info_async:
+ * @view: an #EphyWebView
+ * @cancellable: (allow-none): a #GCancellable or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the page has been inspected
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronously looks up the title and the best icon to use for a web
+ * application created from the page loaded in @view. Both are fetched
+ * with a single call to the web extension.
+ **/
+void
+ephy_web_view_get_web_app_info_async (EphyWebView *view,
+                                      GCancellable *cancellable,
+                                      GAsyncReadyCallback callback,
+                                      gpointer user_data)
+{
+  GTask *task;
+#ifdef HAVE_WEBKIT2
+  GDBusProxy *web_extension;
+  GVariantBuilder page_ids;
+  const char *fields[] = { EPHY_WEB_EXTENSION_FIELD_WEB_APP_TITLE,
+                           EPHY_WEB_EXTENSION_FIELD_BEST_WEB_APP_ICON,
+                           NULL };
+#else
+  WebKitDOMDocument *document;
+  WebAppInfo *info;
+  const char *base_uri;
 #endif
+
+  g_return_if_fail (EPHY_IS_WEB_VIEW (view));
+
+  task = g_task_new (view, cancellable, callback, user_data);
+
+#ifdef HAVE_WEBKIT2
+  web_extension = ephy_embed_shell_get_web_extension_proxy (ephy_embed_shell_get_default ());
+  if (!web_extension) {
+    g_task_return_pointer (task, g_slice_new0 (WebAppInfo), (GDestroyNotify)web_app_info_free);
+    g_object_unref (task);
+    return;
+  }
+
+  g_variant_builder_init (&page_ids, G_VARIANT_TYPE ("at"));
+  g_variant_builder_add (&page_ids, "t", webkit_web_view_get_page_id (WEBKIT_WEB_VIEW (view)));
+
+  g_dbus_proxy_call (web_extension,
+                     "QueryPages",
+                     g_variant_new ("(at^as)", &page_ids, fields),
+                     G_DBUS_CALL_FLAGS_NONE,
+                     -1,
+                     cancellable,
+                     (GAsyncReadyCallback)query_web_app_info_cb,
+                     task);
 #else
-  g_return_val_if_fail (EPHY_IS_WEB_VIEW (view), FALSE);
+  document = webkit_web_view_get_dom_document (WEBKIT_WEB_VIEW (view));
+  base_uri = webkit_web_view_get_uri (WEBKIT_WEB_VIEW (view));
+
+  info = g_slice_new0 (WebAppInfo);
+  info->title = ephy_web_dom_utils_get_application_title (document);
+  if (!base_uri ||
+      !ephy_web_dom_utils_get_best_icon (document, base_uri, &info->icon_uri, &info->icon_color)) {
+    g_clear_pointer (&info->icon_uri, g_free);
+    g_clear_pointer (&info->icon_color, g_free);
+  }
 
-  WebKitDOMDocument *document = webkit_web_view_get_dom_document (WEBKIT_WEB_VIEW (view));
-  return ephy_web_dom_utils_has_modified_forms (document);
+  g_task_return_pointer (task, info, (GDestroyNotify)web_app_info_free);
+  g_object_unref (task);
 #endif
 }
 
+/**
+ * ephy_web_view_get_web_app_info_finish:
+ * @view: an #EphyWebView
+ * @result: a #GAsyncResult
+ * @title: (out) (allow-none): return location for the application title
+ * @icon_uri: (out) (allow-none): return location for the icon URI
+ * @icon_color: (out) (allow-none): return location for the icon color
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes an operation started with ephy_web_view_get_web_app_info_async().
+ * Each of the out strings is set to %NULL when the page does not provide it.
+ *
+ * Returns: %TRUE if the page could be inspected
+ **/
+gboolean
+ephy_web_view_get_web_app_info_finish (EphyWebView *view,
+                                       GAsyncResult *result,
+                                       char **title,
+                                       char **icon_uri,
+                                       char **icon_color,
+                                       GError **error)
+{
+  WebAppInfo *info;
+
+  g_return_val_if_fail (g_task_is_valid (result, view), FALSE);
+
+  info = g_task_propagate_pointer (G_TASK (result), error);
+  if (!info)
+    return FALSE;
+
+  if (title) {
+    *title = info->title;
+    info->title = NULL;
+  }
+  if (icon_uri) {
+    *icon_uri = info->icon_uri;
+    info->icon_uri = NULL;
+  }
+  if (icon_color) {
+    *icon_color = info->icon_color;
+    info->icon_color = NULL;
+  }
+  web_app_info_free (info);
+
+  return TRUE;
+}
+
 /**
  * ephy_web_view_get_security_level:
  * @view: an #EphyWebView
@@ -3760,225 +4015,198 @@ ephy_web_view_save_main_resource_cb (GFile *file,
                                 output_stream);
 }
 #else
-static void
-ephy_web_view_save_sub_resource_start (GList *subresources, char *destination_uri);
-
-static void
-ephy_web_view_close_cb (GOutputStream *ostream, GAsyncResult *result, GString *data)
-{
-  GList *subresources;
-  char *destination_uri;
-  GError *error = NULL;
-
-  subresources = (GList*)g_object_get_data (G_OBJECT (ostream),
-                                            "ephy-web-view-save-subresources");
+/* How many files of a saved page are written at the same time. */
+#define SAVE_PAGE_MAX_WRITES 4
 
-  destination_uri = (char*)g_object_get_data (G_OBJECT (ostream),
-                                              "ephy-web-view-save-dest-uri");
-
-  g_output_stream_close_finish (ostream, result, &error);
-  g_object_unref (ostream);
-
-  if (error) {
-    g_list_free (subresources);
-    g_free (destination_uri);
-    g_warning ("Unable to write to file: %s", error->message);
-    g_error_free (error);
-    return;
-  }
+typedef struct {
+  char *directory_uri;
+  EphySavedPage *resources;
+  GQueue *pending;
+  gboolean has_directory;
+  guint n_active;
+} SavePageJob;
 
-  if (!subresources || !subresources->next) {
-    g_list_free (subresources);
-    g_free (destination_uri);
-    return;
-  }
+typedef struct {
+  SavePageJob *job;
+  GFile *file;
+  GObject *owner;
+  const char *data;
+  gsize length;
+  char *owned_data;
+} SavePageFile;
 
-  subresources = subresources->next;
-  ephy_web_view_save_sub_resource_start (subresources, destination_uri);
-}
+static void save_page_job_schedule (SavePageJob *job);
 
-static void
-ephy_web_view_save_write_cb (GOutputStream *ostream, GAsyncResult *result, GString *data)
+static SavePageJob *
+save_page_job_new (const char *uri,
+                   const char *document_uri)
 {
-  GError *error = NULL;
-  gssize written;
-
-  written = g_output_stream_write_finish (ostream, result, &error);
-  if (error) {
-    GList *subresources;
-    char *destination_uri;
-
-    subresources = (GList*)g_object_get_data (G_OBJECT (ostream),
-                                             "ephy-web-view-save-subresources");
-    g_list_free (subresources);
-
-    destination_uri = (char*)g_object_get_data (G_OBJECT (ostream),
-                                                "ephy-web-view-save-dest-uri");
-    g_free (destination_uri);
+  SavePageJob *job;
+  char *filename;
+  char *dotpos;
+  char *directory_uri;
+  char *directory_href;
+  char *tmp;
 
-    g_string_free (data, FALSE);
-    g_object_unref (ostream);
+  /* filename of the main resource without extension */
+  filename = g_path_get_basename (uri);
+  dotpos = g_strrstr (filename, ".");
+  if (dotpos)
+    *dotpos = '\0';
 
-    g_warning ("Unable to write to file: %s", error->message);
+  directory_uri = g_path_get_dirname (uri);
 
-    g_error_free (error);
-    return;
-  }
+  /* Translators: this is the directory name to store auxilary files
+   * when saving html files.
+   */
+  tmp = g_strdup_printf (_("%s Files"), filename);
+  g_free (filename);
 
-  if (written == data->len) {
-    g_string_free (data, FALSE);
-    g_output_stream_close_async (ostream, G_PRIORITY_DEFAULT, NULL,
-                                 (GAsyncReadyCallback)ephy_web_view_close_cb,
-                                 NULL);
-    return;
-  }
+  job = g_slice_new0 (SavePageJob);
+  job->directory_uri = g_strdup_printf ("%s/%s", directory_uri, tmp);
+  directory_href = g_uri_escape_string (tmp, NULL, TRUE);
+  job->resources = ephy_saved_page_new (document_uri, directory_href);
+  g_free (directory_href);
+  g_free (directory_uri);
+  g_free (tmp);
 
-  data->len -= written;
-  data->str += written;
+  job->pending = g_queue_new ();
 
-  g_output_stream_write_async (ostream,
-                               data->str, data->len,
-                               G_PRIORITY_DEFAULT, NULL,
-                               (GAsyncReadyCallback)ephy_web_view_save_write_cb,
-                               data);
+  return job;
 }
 
 static void
-ephy_web_view_save_replace_cb (GFile *file, GAsyncResult *result, GString *const_data)
+save_page_job_free (SavePageJob *job)
 {
-  GFileOutputStream *ostream;
-  GList *subresources;
-  char *destination_uri;
-  GString *data;
-  GError *error = NULL;
-
-  subresources = (GList*)g_object_get_data (G_OBJECT (file),
-                                            "ephy-web-view-save-subresources");
-
-  destination_uri = (char*)g_object_get_data (G_OBJECT (file),
-                                              "ephy-web-view-save-dest-uri");
-
-  ostream = g_file_replace_finish (file, result, &error);
-  if (error) {
-    g_warning ("Failed to save page: %s", error->message);
-    g_list_free (subresources);
-    g_free (destination_uri);
-    g_error_free (error);
-    return;
-  }
+  g_free (job->directory_uri);
+  if (job->resources)
+    ephy_saved_page_free (job->resources);
+  g_queue_free (job->pending);
+  g_slice_free (SavePageJob, job);
+}
 
-  if (const_data) {
-    data = g_string_sized_new (const_data->len);
-    data->str = const_data->str;
-    data->len = const_data->len;
-  } else
-    data = g_string_new ("");
+static void
+save_page_file_free (SavePageFile *file)
+{
+  g_object_unref (file->file);
+  if (file->owner)
+    g_object_unref (file->owner);
+  g_free (file->owned_data);
+  g_slice_free (SavePageFile, file);
+}
 
-  /* If we have subresources to handle, pass the information along */
-  if (subresources) {
-    g_object_set_data (G_OBJECT (ostream),
-                       "ephy-web-view-save-subresources",
-                       subresources);
+/* The data is written straight from WebKit's buffer, @owner keeps it
+ * alive until the file has been written. */
+static void
+save_page_job_add_file (SavePageJob *job,
+                        GFile *file,
+                        GObject *owner,
+                        const char *data,
+                        gsize length,
+                        char *owned_data)
+{
+  SavePageFile *save_file = g_slice_new0 (SavePageFile);
 
-    g_object_set_data (G_OBJECT (ostream),
-                       "ephy-web-view-save-dest-uri",
-                       destination_uri);
-  }
+  save_file->job = job;
+  save_file->file = g_object_ref (file);
+  save_file->owner = owner ? g_object_ref (owner) : NULL;
+  save_file->data = data;
+  save_file->length = length;
+  save_file->owned_data = owned_data;
 
-  g_output_stream_write_async (G_OUTPUT_STREAM (ostream),
-                               data->str, data->len,
-                               G_PRIORITY_DEFAULT, NULL,
-                               (GAsyncReadyCallback)ephy_web_view_save_write_cb,
-                               data);
+  g_queue_push_tail (job->pending, save_file);
 }
 
 static void
-ephy_web_view_save_sub_resource_start (GList *subresources, char *destination_uri)
+save_page_job_add_resource (SavePageJob *job,
+                            WebKitWebResource *resource)
 {
-  WebKitWebResource *resource;
-  GFile *file;
-  const char *resource_uri;
-  char *resource_basename;
-  char *resource_name;
-  char *resource_dest_uri;
+  const char *uri;
   const GString *data;
+  char *name;
+  char *file_uri;
+  GFile *file;
 
-  resource = WEBKIT_WEB_RESOURCE (subresources->data);
-
-  resource_uri = webkit_web_resource_get_uri (resource);
-  resource_basename = g_path_get_basename (resource_uri);
-
-  resource_name = g_uri_escape_string (resource_basename, NULL, TRUE);
-  g_free (resource_basename);
-
-  resource_dest_uri = g_strdup_printf ("%s/%s", destination_uri, resource_name);
-  g_free (resource_name);
-
-  file = g_file_new_for_uri (resource_dest_uri);
-  g_free (resource_dest_uri);
+  /* The resources directory could not be created. */
+  if (!job->resources)
+    return;
 
-  g_object_set_data (G_OBJECT (file),
-                     "ephy-web-view-save-dest-uri",
-                     destination_uri);
+  uri = webkit_web_resource_get_uri (resource);
+  data = webkit_web_resource_get_data (resource);
+  if (!uri || !data)
+    return;
 
-  g_object_set_data (G_OBJECT (file),
-                     "ephy-web-view-save-subresources",
-                     subresources);
+  name = ephy_saved_page_add_resource (job->resources, uri, data->str, data->len);
+  if (!name)
+    return;
 
-  data = webkit_web_resource_get_data (resource);
+  /* Only pages with subresources get a directory for them. */
+  if (!job->has_directory) {
+    GFile *directory;
+    GError *error = NULL;
 
-  g_file_replace_async (file, NULL, FALSE,
-                        G_FILE_CREATE_REPLACE_DESTINATION|G_FILE_CREATE_PRIVATE,
-                        G_PRIORITY_DEFAULT, NULL,
-                        (GAsyncReadyCallback)ephy_web_view_save_replace_cb,
-                        (GString*)data);
+    directory = g_file_new_for_uri (job->directory_uri);
+    if (!g_file_make_directory (directory, NULL, &error) &&
+        error->code != G_IO_ERROR_EXISTS) {
+      /* Save the document alone, pointing to the original resources. */
+      g_warning ("Could not create directory: %s", error->message);
+      g_error_free (error);
+      g_object_unref (directory);
+      g_free (name);
+      g_clear_pointer (&job->resources, ephy_saved_page_free);
+      return;
+    }
+    g_clear_error (&error);
+    g_object_unref (directory);
+    job->has_directory = TRUE;
+  }
 
+  file_uri = g_strdup_printf ("%s/%s", job->directory_uri, name);
+  file = g_file_new_for_uri (file_uri);
+  g_free (file_uri);
+  save_page_job_add_file (job, file, G_OBJECT (resource), data->str, data->len, NULL);
   g_object_unref (file);
+  g_free (name);
 }
 
 static void
-ephy_web_view_save_sub_resources (EphyWebView *view, const char *uri, GList *subresources)
+save_page_file_replace_cb (GFile *file,
+                           GAsyncResult *result,
+                           SavePageFile *save_file)
 {
-  GFile *file;
-  char *filename;
-  char *dotpos;
-  char *directory_uri;
-  char *tmp;
-  char *destination_uri;
+  SavePageJob *job = save_file->job;
   GError *error = NULL;
 
-  /* filename of the main resource without extension */
-  filename = g_path_get_basename (uri);
-  dotpos = g_strrstr (filename, ".");
-  if (dotpos)
-    *dotpos = '\0';
-
-  directory_uri = g_path_get_dirname (uri);
-
-  /* Translators: this is the directory name to store auxilary files
-   * when saving html files.
-   */
-  tmp = g_strdup_printf (_("%s Files"), filename);
-  g_free (filename);
+  if (!g_file_replace_contents_finish (file, result, NULL, &error)) {
+    g_warning ("Failed to save page: %s", error->message);
+    g_error_free (error);
+  }
 
-  destination_uri = g_strdup_printf ("%s/%s", directory_uri, tmp);
-  g_free (directory_uri);
-  g_free (tmp);
+  save_page_file_free (save_file);
 
-  file = g_file_new_for_uri (destination_uri);
+  job->n_active--;
+  save_page_job_schedule (job);
+}
 
-  if (!g_file_make_directory (file, NULL, &error)) {
-    if (error->code != G_IO_ERROR_EXISTS) {
-      g_warning ("Could not create directory: %s", error->message);
-      g_error_free (error);
-      g_object_unref (file);
-      return;
-    }
+static void
+save_page_job_schedule (SavePageJob *job)
+{
+  while (job->n_active < SAVE_PAGE_MAX_WRITES && !g_queue_is_empty (job->pending)) {
+    SavePageFile *save_file = g_queue_pop_head (job->pending);
+
+    job->n_active++;
+    g_file_replace_contents_async (save_file->file,
+                                   save_file->owned_data ? save_file->owned_data : save_file->data,
+                                   save_file->length,
+                                   NULL, FALSE,
+                                   G_FILE_CREATE_REPLACE_DESTINATION | G_FILE_CREATE_PRIVATE,
+                                   NULL,
+                                   (GAsyncReadyCallback)save_page_file_replace_cb,
+                                   save_file);
   }
-  g_object_unref (file);
 
-  /* Now, let's start saving sub resources */
-  ephy_web_view_save_sub_resource_start (subresources, destination_uri);
+  if (job->n_active == 0)
+    save_page_job_free (job);
 }
 #endif
 
@@ -3996,8 +4224,11 @@ ephy_web_view_save (EphyWebView *view, const char *uri)
 #ifndef HAVE_WEBKIT2
   WebKitWebFrame *frame;
   WebKitWebDataSource *data_source;
-  GList *subresources;
+  GList *subresources, *l;
   const GString *data;
+  SavePageJob *job;
+  char *rewritten;
+  gsize length;
 #endif
 
   g_return_if_fail (EPHY_IS_WEB_VIEW (view));
@@ -4017,26 +4248,29 @@ ephy_web_view_save (EphyWebView *view, const char *uri)
                           view);
   g_object_unref (file);
 #else
-  /* Save main resource */
   frame = webkit_web_view_get_main_frame (WEBKIT_WEB_VIEW(view));
   data_source = webkit_web_frame_get_data_source (frame);
   data = webkit_web_data_source_get_data (data_source);
 
-  file = g_file_new_for_uri (uri);
-  g_file_replace_async (file, NULL, FALSE,
-                        G_FILE_CREATE_REPLACE_DESTINATION|G_FILE_CREATE_PRIVATE,
-                        G_PRIORITY_DEFAULT, NULL,
-                        (GAsyncReadyCallback)ephy_web_view_save_replace_cb,
-                        (GString*)data);
-
-  g_object_unref (file);
+  job = save_page_job_new (uri, webkit_web_frame_get_uri (frame));
 
-  /* If subresources exist, save them */
   subresources = webkit_web_data_source_get_subresources (data_source);
-  if (!subresources)
-    return;
+  for (l = subresources; l; l = l->next)
+    save_page_job_add_resource (job, WEBKIT_WEB_RESOURCE (l->data));
+  g_list_free (subresources);
+
+  /* The main resource goes first, the page is usable without the rest. */
+  rewritten = NULL;
+  if (job->resources)
+    rewritten = ephy_saved_page_rewrite_document (job->resources, data->str, data->len, &length);
+  if (rewritten)
+    save_page_job_add_file (job, file, NULL, NULL, length, rewritten);
+  else
+    save_page_job_add_file (job, file, G_OBJECT (data_source), data->str, data->len, NULL);
+  g_queue_push_head (job->pending, g_queue_pop_tail (job->pending));
 
-  ephy_web_view_save_sub_resources (view, uri, subresources);
+  save_page_job_schedule (job);
+  g_object_unref (file);
 #endif
 }
 
@@ -154,6 +154,16 @@ void                       ephy_web_view_set_typed_address        (EphyWebView
                                                                    const char                *address);
 gboolean                   ephy_web_view_get_is_blank             (EphyWebView               *view);
 gboolean                   ephy_web_view_has_modified_forms       (EphyWebView               *view);
+void                       ephy_web_view_get_web_app_info_async   (EphyWebView               *view,
+                                                                   GCancellable              *cancellable,
+                                                                   GAsyncReadyCallback        callback,
+                                                                   gpointer                   user_data);
+gboolean                   ephy_web_view_get_web_app_info_finish  (EphyWebView               *view,
+                                                                   GAsyncResult              *result,
+                                                                   char                     **title,
+                                                                   char                     **icon_uri,
+                                                                   char                     **icon_color,
+                                                                   GError                   **error);
 void                       ephy_web_view_get_security_level       (EphyWebView               *view,
                                                                    EphyWebViewSecurityLevel  *level,
                                                                    GTlsCertificate          **certificate,
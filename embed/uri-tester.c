@@ -26,9 +26,11 @@
 #include "uri-tester.h"
 
 #include "ephy-debug.h"
+#include "ephy-metrics.h"
 
 #include <gio/gio.h>
 #include <glib/gstdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define DEFAULT_FILTER_URL "http://adblockplus.mozdev.org/easylist/easylist.txt"
@@ -36,6 +38,42 @@
 #define SIGNATURE_SIZE 8
 #define UPDATE_FREQUENCY 24 * 60 * 60 /* In seconds */
 
+/* The compiled ruleset shared by all the processes using the same
+ * profile, see uri_tester_share_ruleset(). */
+#define RULESET_FILENAME "ruleset.bin"
+#define RULESET_MAGIC "EPHYADB1"
+#define RULESET_NO_STRING G_MAXUINT32
+
+typedef struct
+{
+  char magic[8];
+  char stamp[40];   /* MD5 of the filters it was built from */
+  guint32 n_keys;
+  guint32 n_patterns;
+  guint32 keys_offset;
+  guint32 patterns_offset;
+  guint32 strings_offset;
+  guint32 strings_size;
+} RulesetHeader;
+
+/* Sorted by signature, so that it can be searched with bsearch(). */
+typedef struct
+{
+  char sig[SIGNATURE_SIZE];
+  guint32 regex;    /* Offsets in the strings section */
+  guint32 opts;
+} RulesetKey;
+
+typedef struct
+{
+  guint32 regex;
+  guint32 opts;
+} RulesetPattern;
+
+/* Values of the verdicts cache; 0 is taken by "not cached". */
+#define VERDICT_ALLOW 1
+#define VERDICT_BLOCK 2
+
 #define URI_TESTER_GET_PRIVATE(object) (G_TYPE_INSTANCE_GET_PRIVATE ((object), TYPE_URI_TESTER, UriTesterPrivate))
 
 struct _UriTesterPrivate
@@ -48,8 +86,25 @@ struct _UriTesterPrivate
   GHashTable *optslist;
   GHashTable *urlcache;
 
+  /* Verdicts may be asked for from any thread: rules_lock protects the
+   * parsed rules, cache_lock the cache of verdicts. */
+  GRWLock rules_lock;
+  GMutex cache_lock;
+
+  /* When set, the rules are matched from this file instead of the
+   * hash tables above. The regexps are compiled on first use. */
+  GMappedFile *ruleset;
+  GHashTable *ruleset_regexps;
+  GMutex ruleset_regexps_lock;
+  guint n_pending_filters;
+
   GString *blockcss;
   GString *blockcssprivate;
+
+  /* Verdicts are given in the web process, whose metrics never reach
+     about:performance, so only loading the rules is counted. */
+  EphyMetricsCounter *filters_parsed_metric;
+  EphyMetricsCounter *ruleset_mapped_metric;
 };
 
 enum
@@ -69,6 +124,9 @@ uri_tester_fixup_regexp (const char *prefix, char *src);
 static gboolean
 uri_tester_parse_file_at_uri (UriTester *tester, const char *fileuri);
 
+static void
+uri_tester_share_ruleset (UriTester *tester);
+
 static char *
 uri_tester_ensure_data_dir (const char *base_data_dir)
 {
@@ -121,6 +179,9 @@ uri_tester_retrieve_filter_finished (GFile *src,
   } else
     uri_tester_parse_file_at_uri (data->tester, data->dest_uri);
 
+  if (--data->tester->priv->n_pending_filters == 0)
+    uri_tester_share_ruleset (data->tester);
+
   g_object_unref (data->tester);
   g_free (data->dest_uri);
   g_slice_free (RetrieveFilterAsyncData, data);
@@ -140,6 +201,8 @@ uri_tester_retrieve_filter (UriTester *tester, const char *url, const char *file
   src = g_file_new_for_uri (url);
   dest = g_file_new_for_uri (fileuri);
 
+  tester->priv->n_pending_filters++;
+
   data = g_slice_new (RetrieveFilterAsyncData);
   data->tester = g_object_ref (tester);
   data->dest_uri = g_file_get_uri (dest);
@@ -191,12 +254,315 @@ uri_tester_filter_is_valid (const char *fileuri)
   return result;
 }
 
+/* Identifies the filter files a ruleset is built from. Returns %NULL
+ * if any of them is missing or too old. */
+static char *
+uri_tester_get_ruleset_stamp (UriTester *tester)
+{
+  GChecksum *checksum;
+  GSList *filter;
+  char *stamp = NULL;
+
+  checksum = g_checksum_new (G_CHECKSUM_MD5);
+
+  for (filter = tester->priv->filters; filter; filter = g_slist_next (filter))
+    {
+      GFile *file;
+      GFileInfo *file_info;
+      char *fileuri;
+      guint64 mtime;
+
+      fileuri = uri_tester_get_fileuri_for_url (tester, filter->data);
+      if (!uri_tester_filter_is_valid (fileuri))
+        {
+          g_free (fileuri);
+          goto out;
+        }
+
+      file = g_file_new_for_uri (fileuri);
+      file_info = g_file_query_info (file,
+                                     G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                     G_FILE_QUERY_INFO_NONE,
+                                     NULL,
+                                     NULL);
+      g_object_unref (file);
+      g_free (fileuri);
+      if (!file_info)
+        goto out;
+
+      mtime = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+      g_object_unref (file_info);
+
+      g_checksum_update (checksum, filter->data, -1);
+      g_checksum_update (checksum, (const guchar *)&mtime, sizeof (mtime));
+    }
+
+  stamp = g_strdup (g_checksum_get_string (checksum));
+
+out:
+  g_checksum_free (checksum);
+
+  return stamp;
+}
+
+static void
+uri_tester_unmap_ruleset (UriTester *tester)
+{
+  UriTesterPrivate *priv = tester->priv;
+
+  if (!priv->ruleset)
+    return;
+
+  g_mapped_file_unref (priv->ruleset);
+  priv->ruleset = NULL;
+
+  g_mutex_lock (&priv->ruleset_regexps_lock);
+  g_hash_table_remove_all (priv->ruleset_regexps);
+  g_mutex_unlock (&priv->ruleset_regexps_lock);
+}
+
+static const RulesetHeader *
+uri_tester_ruleset_get_header (GMappedFile *ruleset)
+{
+  return (const RulesetHeader *)g_mapped_file_get_contents (ruleset);
+}
+
+static const char *
+uri_tester_ruleset_get_string (UriTester *tester,
+                               guint32 offset)
+{
+  const RulesetHeader *header = uri_tester_ruleset_get_header (tester->priv->ruleset);
+
+  if (offset == RULESET_NO_STRING || offset >= header->strings_size)
+    return NULL;
+
+  return (const char *)header + header->strings_offset + offset;
+}
+
+static gboolean
+uri_tester_ruleset_is_valid (GMappedFile *ruleset,
+                             const char *stamp)
+{
+  const RulesetHeader *header;
+  const char *contents;
+  gsize size;
+
+  contents = g_mapped_file_get_contents (ruleset);
+  size = g_mapped_file_get_length (ruleset);
+  if (size < sizeof (RulesetHeader))
+    return FALSE;
+
+  header = (const RulesetHeader *)contents;
+  if (memcmp (header->magic, RULESET_MAGIC, sizeof (header->magic)) != 0 ||
+      strncmp (header->stamp, stamp, sizeof (header->stamp)) != 0)
+    return FALSE;
+
+  /* Do not trust the offsets blindly, the file might be truncated. */
+  if (header->keys_offset > size ||
+      header->n_keys > (size - header->keys_offset) / sizeof (RulesetKey) ||
+      header->patterns_offset > size ||
+      header->n_patterns > (size - header->patterns_offset) / sizeof (RulesetPattern) ||
+      header->strings_offset > size ||
+      header->strings_size > size - header->strings_offset ||
+      header->strings_size == 0 ||
+      contents[header->strings_offset + header->strings_size - 1] != '\0')
+    return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+uri_tester_map_ruleset (UriTester *tester,
+                        const char *stamp)
+{
+  UriTesterPrivate *priv = tester->priv;
+  GMappedFile *ruleset;
+  char *path;
+
+  path = g_build_filename (priv->data_dir, RULESET_FILENAME, NULL);
+  ruleset = g_mapped_file_new (path, FALSE, NULL);
+  g_free (path);
+
+  if (!ruleset)
+    return FALSE;
+
+  if (!uri_tester_ruleset_is_valid (ruleset, stamp))
+    {
+      LOG ("Ignoring stale or corrupt compiled ruleset");
+      g_mapped_file_unref (ruleset);
+      return FALSE;
+    }
+
+  g_rw_lock_writer_lock (&priv->rules_lock);
+  uri_tester_unmap_ruleset (tester);
+  priv->ruleset = ruleset;
+
+  /* The rules parsed so far by this process are in the file. */
+  g_hash_table_remove_all (priv->pattern);
+  g_hash_table_remove_all (priv->keys);
+  g_hash_table_remove_all (priv->optslist);
+  g_rw_lock_writer_unlock (&priv->rules_lock);
+
+  g_mutex_lock (&priv->cache_lock);
+  g_hash_table_remove_all (priv->urlcache);
+  g_mutex_unlock (&priv->cache_lock);
+
+  ephy_metrics_counter_add (priv->ruleset_mapped_metric, 1);
+
+  LOG ("Mapped compiled ruleset with %u keys and %u patterns",
+       uri_tester_ruleset_get_header (ruleset)->n_keys,
+       uri_tester_ruleset_get_header (ruleset)->n_patterns);
+
+  return TRUE;
+}
+
+static guint32
+ruleset_add_string (GString *strings,
+                    GHashTable *offsets,
+                    const char *string)
+{
+  gpointer offset;
+
+  if (!string)
+    return RULESET_NO_STRING;
+
+  if (g_hash_table_lookup_extended (offsets, string, NULL, &offset))
+    return GPOINTER_TO_UINT (offset);
+
+  offset = GUINT_TO_POINTER (strings->len);
+  g_string_append_len (strings, string, strlen (string) + 1);
+  g_hash_table_insert (offsets, (gpointer)string, offset);
+
+  return GPOINTER_TO_UINT (offset);
+}
+
+static int
+compare_ruleset_keys (gconstpointer a,
+                      gconstpointer b)
+{
+  return memcmp (((const RulesetKey *)a)->sig, ((const RulesetKey *)b)->sig, SIGNATURE_SIZE);
+}
+
+static gboolean
+uri_tester_save_ruleset (UriTester *tester,
+                         const char *stamp)
+{
+  UriTesterPrivate *priv = tester->priv;
+  RulesetHeader header;
+  GHashTableIter iter;
+  gpointer key, value;
+  GHashTable *offsets;
+  GArray *keys;
+  GArray *patterns;
+  GString *strings;
+  GString *contents;
+  char *path;
+  gboolean retval;
+
+  offsets = g_hash_table_new (g_str_hash, g_str_equal);
+  strings = g_string_new (NULL);
+  keys = g_array_sized_new (FALSE, FALSE, sizeof (RulesetKey), g_hash_table_size (priv->keys));
+  patterns = g_array_sized_new (FALSE, FALSE, sizeof (RulesetPattern), g_hash_table_size (priv->pattern));
+
+  g_rw_lock_reader_lock (&priv->rules_lock);
+
+  g_hash_table_iter_init (&iter, priv->keys);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      RulesetKey rule;
+
+      memcpy (rule.sig, key, SIGNATURE_SIZE);
+      rule.regex = ruleset_add_string (strings, offsets, g_regex_get_pattern (value));
+      rule.opts = ruleset_add_string (strings, offsets, g_hash_table_lookup (priv->optslist, key));
+      g_array_append_val (keys, rule);
+    }
+  g_array_sort (keys, compare_ruleset_keys);
+
+  g_hash_table_iter_init (&iter, priv->pattern);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      RulesetPattern rule;
+
+      rule.regex = ruleset_add_string (strings, offsets, g_regex_get_pattern (value));
+      rule.opts = ruleset_add_string (strings, offsets, g_hash_table_lookup (priv->optslist, key));
+      g_array_append_val (patterns, rule);
+    }
+
+  /* The strings are copied in the ruleset before the lock is released,
+     the offsets table only points to them. */
+  if (strings->len == 0)
+    g_string_append_c (strings, '\0');
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, RULESET_MAGIC, sizeof (header.magic));
+  g_strlcpy (header.stamp, stamp, sizeof (header.stamp));
+  header.n_keys = keys->len;
+  header.n_patterns = patterns->len;
+  header.keys_offset = sizeof (header);
+  header.patterns_offset = header.keys_offset + keys->len * sizeof (RulesetKey);
+  header.strings_offset = header.patterns_offset + patterns->len * sizeof (RulesetPattern);
+  header.strings_size = strings->len;
+
+  contents = g_string_sized_new (header.strings_offset + strings->len);
+  g_string_append_len (contents, (const char *)&header, sizeof (header));
+  g_string_append_len (contents, keys->data, keys->len * sizeof (RulesetKey));
+  g_string_append_len (contents, patterns->data, patterns->len * sizeof (RulesetPattern));
+  g_string_append_len (contents, strings->str, strings->len);
+
+  g_rw_lock_reader_unlock (&priv->rules_lock);
+
+  /* g_file_set_contents() replaces the file atomically, so other
+     processes either see the previous ruleset or this one. */
+  path = g_build_filename (priv->data_dir, RULESET_FILENAME, NULL);
+  retval = g_file_set_contents (path, contents->str, contents->len, NULL);
+  g_free (path);
+
+  g_string_free (contents, TRUE);
+  g_string_free (strings, TRUE);
+  g_array_free (keys, TRUE);
+  g_array_free (patterns, TRUE);
+  g_hash_table_destroy (offsets);
+
+  return retval;
+}
+
+/* Compiles the rules parsed from the filter files into a file that the
+ * other processes using the same profile can map instead of parsing
+ * the filters themselves, then matches from the file too so that
+ * the memory taken by the rules is shared. */
+static void
+uri_tester_share_ruleset (UriTester *tester)
+{
+  char *stamp;
+
+  stamp = uri_tester_get_ruleset_stamp (tester);
+  if (!stamp)
+    return;
+
+  if (uri_tester_save_ruleset (tester, stamp))
+    uri_tester_map_ruleset (tester, stamp);
+  else
+    LOG ("Could not save the compiled ruleset");
+
+  g_free (stamp);
+}
+
 static void
 uri_tester_load_patterns (UriTester *tester)
 {
   GSList *filter = NULL;
   char *url = NULL;
   char *fileuri = NULL;
+  char *stamp;
+
+  /* Another process may have compiled these filters already. */
+  stamp = uri_tester_get_ruleset_stamp (tester);
+  if (stamp && uri_tester_map_ruleset (tester, stamp))
+    {
+      g_free (stamp);
+      return;
+    }
+  g_free (stamp);
 
   /* Load patterns from the list of filters. */
   for (filter = tester->priv->filters; filter; filter = g_slist_next(filter))
@@ -211,6 +577,9 @@ uri_tester_load_patterns (UriTester *tester)
 
       g_free (fileuri);
     }
+
+  if (tester->priv->n_pending_filters == 0)
+    uri_tester_share_ruleset (tester);
 }
 
 static void
@@ -290,19 +659,37 @@ uri_tester_save_filters (UriTester *tester)
   g_free (filepath);
 }
 
+static GRegex *
+uri_tester_ruleset_get_regex (UriTester *tester,
+                              guint32 offset)
+{
+  UriTesterPrivate *priv = tester->priv;
+  GRegex *regex;
+
+  g_mutex_lock (&priv->ruleset_regexps_lock);
+  regex = g_hash_table_lookup (priv->ruleset_regexps, GUINT_TO_POINTER (offset));
+  if (!regex && uri_tester_ruleset_get_string (tester, offset))
+    {
+      regex = g_regex_new (uri_tester_ruleset_get_string (tester, offset),
+                           G_REGEX_OPTIMIZE, G_REGEX_MATCH_NOTEMPTY, NULL);
+      if (regex)
+        g_hash_table_insert (priv->ruleset_regexps, GUINT_TO_POINTER (offset), regex);
+    }
+  g_mutex_unlock (&priv->ruleset_regexps_lock);
+
+  return regex;
+}
+
 static inline int
 uri_tester_check_rule (UriTester  *tester,
                        GRegex     *regex,
-                       const char *patt,
+                       const char *opts,
                        const char *req_uri,
                        const char *page_uri)
 {
-  char *opts;
-
   if (!g_regex_match_full (regex, req_uri, -1, 0, 0, NULL, NULL))
     return FALSE;
 
-  opts = g_hash_table_lookup (tester->priv->optslist, patt);
   if (opts && g_regex_match_simple (",third-party", opts,
                                     G_REGEX_CASELESS, G_REGEX_MATCH_NOTEMPTY))
     {
@@ -322,10 +709,31 @@ uri_tester_is_matched_by_pattern (UriTester  *tester,
   GHashTableIter iter;
   gpointer patt, regex;
 
+  if (tester->priv->ruleset)
+    {
+      const RulesetHeader *header = uri_tester_ruleset_get_header (tester->priv->ruleset);
+      const RulesetPattern *patterns;
+      guint i;
+
+      patterns = (const RulesetPattern *)((const char *)header + header->patterns_offset);
+      for (i = 0; i < header->n_patterns; i++)
+        {
+          regex = uri_tester_ruleset_get_regex (tester, patterns[i].regex);
+          if (regex &&
+              uri_tester_check_rule (tester, regex,
+                                     uri_tester_ruleset_get_string (tester, patterns[i].opts),
+                                     req_uri, page_uri))
+            return TRUE;
+        }
+      return FALSE;
+    }
+
   g_hash_table_iter_init (&iter, tester->priv->pattern);
   while (g_hash_table_iter_next (&iter, &patt, &regex))
     {
-      if (uri_tester_check_rule(tester, regex, patt, req_uri, page_uri))
+      if (uri_tester_check_rule(tester, regex,
+                                g_hash_table_lookup (tester->priv->optslist, patt),
+                                req_uri, page_uri))
         return TRUE;
     }
   return FALSE;
@@ -357,13 +765,32 @@ uri_tester_is_matched_by_key (UriTester  *tester,
   for (pos = len - SIGNATURE_SIZE; pos >= 0; pos--)
     {
       GRegex *regex;
+      const char *key_opts;
       strncpy (sig, uri + pos, SIGNATURE_SIZE);
-      regex = g_hash_table_lookup (priv->keys, sig);
+
+      if (priv->ruleset)
+        {
+          const RulesetHeader *header = uri_tester_ruleset_get_header (priv->ruleset);
+          const RulesetKey *key;
+
+          key = bsearch (sig, (const char *)header + header->keys_offset,
+                         header->n_keys, sizeof (RulesetKey), compare_ruleset_keys);
+          if (!key)
+            continue;
+
+          regex = uri_tester_ruleset_get_regex (tester, key->regex);
+          key_opts = uri_tester_ruleset_get_string (tester, key->opts);
+        }
+      else
+        {
+          regex = g_hash_table_lookup (priv->keys, sig);
+          key_opts = g_hash_table_lookup (priv->optslist, sig);
+        }
 
       /* Dont check if regex is already blacklisted */
       if (!regex || g_list_find (regex_bl, regex))
         continue;
-      ret = uri_tester_check_rule (tester, regex, sig, req_uri, page_uri);
+      ret = uri_tester_check_rule (tester, regex, key_opts, req_uri, page_uri);
       if (ret)
         break;
       regex_bl = g_list_prepend (regex_bl, regex);
@@ -380,30 +807,32 @@ uri_tester_is_matched (UriTester  *tester,
                        const char *page_uri)
 {
   UriTesterPrivate *priv = NULL;
-  char *value;
+  gpointer value;
+  gboolean matched;
 
   priv = tester->priv;
 
-  /* Check cached URLs first. */
-  if ((value = g_hash_table_lookup (priv->urlcache, req_uri)))
-    return (value[0] != '0') ? TRUE : FALSE;
-
-  /* Look for a match either by key or by pattern. */
-  if (uri_tester_is_matched_by_key (tester, opts, req_uri, page_uri))
-    {
-      g_hash_table_insert (priv->urlcache, g_strdup (req_uri), g_strdup("1"));
-      return TRUE;
-    }
-
-  /* Matching by pattern is pretty expensive, so do it if needed only. */
-  if (uri_tester_is_matched_by_pattern (tester, req_uri, page_uri))
-    {
-      g_hash_table_insert (priv->urlcache, g_strdup (req_uri), g_strdup("1"));
-      return TRUE;
-    }
-
-  g_hash_table_insert (priv->urlcache, g_strdup (req_uri), g_strdup("0"));
-  return FALSE;
+  /* Check cached URLs first. This is the common case, so it must not
+     allocate anything. */
+  g_mutex_lock (&priv->cache_lock);
+  value = g_hash_table_lookup (priv->urlcache, req_uri);
+  g_mutex_unlock (&priv->cache_lock);
+  if (value)
+    return GPOINTER_TO_INT (value) == VERDICT_BLOCK;
+
+  /* Look for a match either by key or by pattern. Matching by pattern
+     is pretty expensive, so do it if needed only. */
+  g_rw_lock_reader_lock (&priv->rules_lock);
+  matched = uri_tester_is_matched_by_key (tester, opts, req_uri, page_uri) ||
+            uri_tester_is_matched_by_pattern (tester, req_uri, page_uri);
+  g_rw_lock_reader_unlock (&priv->rules_lock);
+
+  g_mutex_lock (&priv->cache_lock);
+  g_hash_table_replace (priv->urlcache, g_strdup (req_uri),
+                        GINT_TO_POINTER (matched ? VERDICT_BLOCK : VERDICT_ALLOW));
+  g_mutex_unlock (&priv->cache_lock);
+
+  return matched;
 }
 
 static GString *
@@ -720,10 +1149,21 @@ uri_tester_parse_file_at_uri (UriTester *tester, const char *fileuri)
   path = g_filename_from_uri (fileuri, NULL, NULL);
   if ((file = g_fopen (path, "r")))
     {
+      g_rw_lock_writer_lock (&tester->priv->rules_lock);
+      /* These rules are not in the compiled ruleset. */
+      uri_tester_unmap_ruleset (tester);
       while (fgets (line, 2000, file))
         g_free (uri_tester_parse_line (tester, line));
+      g_rw_lock_writer_unlock (&tester->priv->rules_lock);
       fclose (file);
 
+      /* Verdicts given before these rules were known are stale. */
+      g_mutex_lock (&tester->priv->cache_lock);
+      g_hash_table_remove_all (tester->priv->urlcache);
+      g_mutex_unlock (&tester->priv->cache_lock);
+
+      ephy_metrics_counter_add (tester->priv->filters_parsed_metric, 1);
+
       result = TRUE;
     }
   g_free (path);
@@ -753,10 +1193,19 @@ uri_tester_init (UriTester *tester)
                                           (GDestroyNotify)g_free);
   priv->urlcache = g_hash_table_new_full (g_str_hash, g_str_equal,
                                           (GDestroyNotify)g_free,
-                                          (GDestroyNotify)g_free);
+                                          NULL);
+  g_rw_lock_init (&priv->rules_lock);
+  g_mutex_init (&priv->cache_lock);
+  priv->ruleset_regexps = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                 NULL,
+                                                 (GDestroyNotify)g_regex_unref);
+  g_mutex_init (&priv->ruleset_regexps_lock);
 
   priv->blockcss = g_string_new ("z-non-exist");
   priv->blockcssprivate = g_string_new ("");
+
+  priv->filters_parsed_metric = ephy_metrics_counter_get ("adblock.filters-parsed");
+  priv->ruleset_mapped_metric = ephy_metrics_counter_get ("adblock.ruleset-mapped");
 }
 
 static void
@@ -811,6 +1260,13 @@ uri_tester_finalize (GObject *object)
   g_string_free (priv->blockcss, TRUE);
   g_string_free (priv->blockcssprivate, TRUE);
 
+  uri_tester_unmap_ruleset (URI_TESTER (object));
+  g_hash_table_destroy (priv->ruleset_regexps);
+
+  g_rw_lock_clear (&priv->rules_lock);
+  g_mutex_clear (&priv->cache_lock);
+  g_mutex_clear (&priv->ruleset_regexps_lock);
+
   G_OBJECT_CLASS (uri_tester_parent_class)->finalize (object);
 }
 
@@ -850,6 +1306,8 @@ uri_tester_new (const char *base_data_dir)
   return g_object_new (TYPE_URI_TESTER, "base-data-dir", base_data_dir, NULL);
 }
 
+/* Safe to call from any thread. Verdicts are cached per request URI,
+ * and the cache is dropped whenever a filter is (re)loaded. */
 gboolean
 uri_tester_test_uri (UriTester *tester,
                      const char *req_uri,
@@ -0,0 +1,314 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <config.h>
+#include "ephy-embed-form-tracker.h"
+
+#include "ephy-debug.h"
+
+/* Keeps track of the forms the user edited in a document, so that
+ * asking whether there are modified forms does not need to walk all
+ * the forms of the document. The heuristic is the one of
+ * ephy_web_dom_utils_has_modified_forms(): an edited <textarea> is
+ * always worth keeping, an edited <input> only if another input of
+ * the same form was edited too or if it holds more than 50 characters.
+ */
+
+typedef struct {
+  WebKitDOMHTMLInputElement *edited_input;
+  guint n_edited_inputs;
+  gboolean modified;
+} FormState;
+
+struct _EphyEmbedFormTrackerPrivate
+{
+  WebKitDOMDocument *document;
+  GHashTable *forms;
+  guint n_modified_forms;
+  gboolean textarea_edited;
+};
+
+enum
+{
+  PROP_0,
+  PROP_HAS_MODIFIED_FORMS
+};
+
+G_DEFINE_TYPE (EphyEmbedFormTracker, ephy_embed_form_tracker, G_TYPE_OBJECT)
+
+static void
+form_state_free (FormState *state)
+{
+  g_clear_object (&state->edited_input);
+  g_slice_free (FormState, state);
+}
+
+static void
+update_has_modified_forms (EphyEmbedFormTracker *tracker,
+                           gboolean was_modified)
+{
+  if (ephy_embed_form_tracker_has_modified_forms (tracker) != was_modified)
+    g_object_notify (G_OBJECT (tracker), "has-modified-forms");
+}
+
+static void
+input_edited (EphyEmbedFormTracker *tracker,
+              WebKitDOMHTMLInputElement *input)
+{
+  EphyEmbedFormTrackerPrivate *priv = tracker->priv;
+  WebKitDOMHTMLFormElement *form;
+  FormState *state;
+  gboolean modified;
+
+  form = webkit_dom_html_input_element_get_form (input);
+  if (!form)
+    return;
+
+  if (!webkit_dom_html_input_element_is_edited (input))
+    return;
+
+  state = g_hash_table_lookup (priv->forms, form);
+  if (!state) {
+    state = g_slice_new0 (FormState);
+    g_hash_table_insert (priv->forms, g_object_ref (form), state);
+  }
+
+  /* Two edited inputs are enough, no need to count any further. */
+  if (state->n_edited_inputs >= 2)
+    return;
+
+  if (!state->edited_input) {
+    state->edited_input = g_object_ref (input);
+    state->n_edited_inputs = 1;
+  } else if (state->edited_input != input) {
+    state->n_edited_inputs = 2;
+  }
+
+  if (state->n_edited_inputs >= 2) {
+    modified = TRUE;
+  } else {
+    char *text;
+
+    text = webkit_dom_html_input_element_get_value (input);
+    modified = g_utf8_strlen (text, -1) > 50;
+    g_free (text);
+  }
+
+  if (modified == state->modified)
+    return;
+
+  state->modified = modified;
+  if (modified)
+    priv->n_modified_forms++;
+  else
+    priv->n_modified_forms--;
+}
+
+static void
+textarea_edited (EphyEmbedFormTracker *tracker,
+                 WebKitDOMHTMLTextAreaElement *textarea)
+{
+  EphyEmbedFormTrackerPrivate *priv = tracker->priv;
+
+  if (!priv->textarea_edited &&
+      webkit_dom_html_text_area_element_get_form (textarea) &&
+      webkit_dom_html_text_area_element_is_edited (textarea))
+    priv->textarea_edited = TRUE;
+}
+
+/* Accounts for the controls edited before the tracker was listening,
+ * like the ones restored from the page cache or by the session. */
+static void
+scan_document (EphyEmbedFormTracker *tracker)
+{
+  WebKitDOMHTMLCollection *forms;
+  gulong forms_n;
+  gulong i;
+
+  forms = webkit_dom_document_get_forms (tracker->priv->document);
+  forms_n = webkit_dom_html_collection_get_length (forms);
+
+  for (i = 0; i < forms_n; i++) {
+    WebKitDOMHTMLCollection *elements;
+    WebKitDOMNode *form = webkit_dom_html_collection_item (forms, i);
+    gulong elements_n;
+    gulong j;
+
+    elements = webkit_dom_html_form_element_get_elements (WEBKIT_DOM_HTML_FORM_ELEMENT (form));
+    elements_n = webkit_dom_html_collection_get_length (elements);
+
+    for (j = 0; j < elements_n; j++) {
+      WebKitDOMNode *element = webkit_dom_html_collection_item (elements, j);
+
+      if (WEBKIT_DOM_IS_HTML_TEXT_AREA_ELEMENT (element))
+        textarea_edited (tracker, WEBKIT_DOM_HTML_TEXT_AREA_ELEMENT (element));
+      else if (WEBKIT_DOM_IS_HTML_INPUT_ELEMENT (element))
+        input_edited (tracker, WEBKIT_DOM_HTML_INPUT_ELEMENT (element));
+    }
+  }
+}
+
+static gboolean
+form_control_edited_cb (WebKitDOMEventTarget *target,
+                        WebKitDOMEvent *event,
+                        EphyEmbedFormTracker *tracker)
+{
+  WebKitDOMEventTarget *control;
+  gboolean was_modified;
+
+  control = webkit_dom_event_get_target (event);
+  was_modified = ephy_embed_form_tracker_has_modified_forms (tracker);
+
+  if (WEBKIT_DOM_IS_HTML_TEXT_AREA_ELEMENT (control)) {
+    textarea_edited (tracker, WEBKIT_DOM_HTML_TEXT_AREA_ELEMENT (control));
+  } else if (WEBKIT_DOM_IS_HTML_INPUT_ELEMENT (control)) {
+    input_edited (tracker, WEBKIT_DOM_HTML_INPUT_ELEMENT (control));
+  }
+
+  update_has_modified_forms (tracker, was_modified);
+
+  return TRUE;
+}
+
+static void
+ephy_embed_form_tracker_get_property (GObject *object,
+                                      guint prop_id,
+                                      GValue *value,
+                                      GParamSpec *pspec)
+{
+  EphyEmbedFormTracker *tracker = EPHY_EMBED_FORM_TRACKER (object);
+
+  switch (prop_id) {
+  case PROP_HAS_MODIFIED_FORMS:
+    g_value_set_boolean (value, ephy_embed_form_tracker_has_modified_forms (tracker));
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+ephy_embed_form_tracker_finalize (GObject *object)
+{
+  EphyEmbedFormTrackerPrivate *priv = EPHY_EMBED_FORM_TRACKER (object)->priv;
+
+  if (priv->document) {
+    webkit_dom_event_target_remove_event_listener (WEBKIT_DOM_EVENT_TARGET (priv->document), "input",
+                                                   G_CALLBACK (form_control_edited_cb), TRUE);
+    webkit_dom_event_target_remove_event_listener (WEBKIT_DOM_EVENT_TARGET (priv->document), "change",
+                                                   G_CALLBACK (form_control_edited_cb), TRUE);
+    g_object_unref (priv->document);
+  }
+  g_hash_table_destroy (priv->forms);
+
+  G_OBJECT_CLASS (ephy_embed_form_tracker_parent_class)->finalize (object);
+}
+
+static void
+ephy_embed_form_tracker_init (EphyEmbedFormTracker *tracker)
+{
+  tracker->priv = G_TYPE_INSTANCE_GET_PRIVATE (tracker, EPHY_TYPE_EMBED_FORM_TRACKER, EphyEmbedFormTrackerPrivate);
+  tracker->priv->forms = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                (GDestroyNotify)g_object_unref,
+                                                (GDestroyNotify)form_state_free);
+}
+
+static void
+ephy_embed_form_tracker_class_init (EphyEmbedFormTrackerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ephy_embed_form_tracker_finalize;
+  object_class->get_property = ephy_embed_form_tracker_get_property;
+
+  /**
+   * EphyEmbedFormTracker:has-modified-forms:
+   *
+   * Whether the user modified the forms of the document enough for
+   * the changes to be worth a warning before they are thrown away.
+   **/
+  g_object_class_install_property (object_class,
+                                   PROP_HAS_MODIFIED_FORMS,
+                                   g_param_spec_boolean ("has-modified-forms",
+                                                         "Has modified forms",
+                                                         "Whether the document has modified forms",
+                                                         FALSE,
+                                                         G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_type_class_add_private (object_class, sizeof (EphyEmbedFormTrackerPrivate));
+}
+
+/**
+ * ephy_embed_form_tracker_new:
+ * @document: the #WebKitDOMDocument to watch
+ *
+ * Looks for the form controls of @document that were already edited,
+ * and starts listening to its input and change events for the next
+ * ones.
+ *
+ * Returns: a new #EphyEmbedFormTracker
+ **/
+EphyEmbedFormTracker *
+ephy_embed_form_tracker_new (WebKitDOMDocument *document)
+{
+  EphyEmbedFormTracker *tracker;
+
+  g_return_val_if_fail (WEBKIT_DOM_IS_DOCUMENT (document), NULL);
+
+  tracker = EPHY_EMBED_FORM_TRACKER (g_object_new (EPHY_TYPE_EMBED_FORM_TRACKER, NULL));
+  tracker->priv->document = g_object_ref (document);
+
+  scan_document (tracker);
+
+  /* Listen on the capture phase so that pages stopping the propagation
+   * of the events do not hide the edits from us. */
+  webkit_dom_event_target_add_event_listener (WEBKIT_DOM_EVENT_TARGET (document), "input",
+                                              G_CALLBACK (form_control_edited_cb), TRUE,
+                                              tracker);
+  webkit_dom_event_target_add_event_listener (WEBKIT_DOM_EVENT_TARGET (document), "change",
+                                              G_CALLBACK (form_control_edited_cb), TRUE,
+                                              tracker);
+
+  return tracker;
+}
+
+WebKitDOMDocument *
+ephy_embed_form_tracker_get_document (EphyEmbedFormTracker *tracker)
+{
+  g_return_val_if_fail (EPHY_IS_EMBED_FORM_TRACKER (tracker), NULL);
+
+  return tracker->priv->document;
+}
+
+/**
+ * ephy_embed_form_tracker_has_modified_forms:
+ * @tracker: an #EphyEmbedFormTracker
+ *
+ * Returns: %TRUE if the user modified the forms of the tracked document,
+ * see ephy_web_dom_utils_has_modified_forms()
+ **/
+gboolean
+ephy_embed_form_tracker_has_modified_forms (EphyEmbedFormTracker *tracker)
+{
+  g_return_val_if_fail (EPHY_IS_EMBED_FORM_TRACKER (tracker), FALSE);
+
+  return tracker->priv->textarea_edited || tracker->priv->n_modified_forms > 0;
+}
@@ -0,0 +1,56 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef EPHY_EMBED_FORM_TRACKER_H
+#define EPHY_EMBED_FORM_TRACKER_H
+
+#include <glib-object.h>
+#include <webkit2/webkit-web-extension.h>
+
+G_BEGIN_DECLS
+
+#define EPHY_TYPE_EMBED_FORM_TRACKER     (ephy_embed_form_tracker_get_type ())
+#define EPHY_EMBED_FORM_TRACKER(obj)       (G_TYPE_CHECK_INSTANCE_CAST ((obj), EPHY_TYPE_EMBED_FORM_TRACKER, EphyEmbedFormTracker))
+#define EPHY_IS_EMBED_FORM_TRACKER(obj)    (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EPHY_TYPE_EMBED_FORM_TRACKER))
+
+typedef struct _EphyEmbedFormTrackerClass   EphyEmbedFormTrackerClass;
+typedef struct _EphyEmbedFormTracker        EphyEmbedFormTracker;
+typedef struct _EphyEmbedFormTrackerPrivate EphyEmbedFormTrackerPrivate;
+
+struct _EphyEmbedFormTracker
+{
+  GObject parent;
+
+  EphyEmbedFormTrackerPrivate *priv;
+};
+
+struct _EphyEmbedFormTrackerClass
+{
+  GObjectClass parent_class;
+};
+
+GType                 ephy_embed_form_tracker_get_type           (void);
+EphyEmbedFormTracker *ephy_embed_form_tracker_new                (WebKitDOMDocument    *document);
+WebKitDOMDocument    *ephy_embed_form_tracker_get_document       (EphyEmbedFormTracker *tracker);
+gboolean              ephy_embed_form_tracker_has_modified_forms (EphyEmbedFormTracker *tracker);
+
+G_END_DECLS
+
+#endif /* EPHY_EMBED_FORM_TRACKER_H */
@@ -23,6 +23,7 @@
 
 #include "ephy-debug.h"
 #include "ephy-embed-form-auth.h"
+#include "ephy-embed-form-tracker.h"
 #include "ephy-form-auth-data.h"
 #include "ephy-prefs.h"
 #include "ephy-settings.h"
@@ -39,6 +40,11 @@ static UriTester *uri_tester;
 static EphyFormAuthDataCache *form_auth_data_cache;
 static GDBusConnection *dbus_connection;
 
+/* Mirrors of the settings checked for every request, so that
+ * web_page_send_request() does not have to go through GSettings. */
+static volatile gint do_not_track_enabled;
+static volatile gint adblock_enabled;
+
 static const char introspection_xml[] =
   "<node>"
   " <interface name='org.gnome.Epiphany.WebExtension'>"
@@ -57,12 +63,21 @@ static const char introspection_xml[] =
   "   <arg type='s' name='uri' direction='out'/>"
   "   <arg type='s' name='color' direction='out'/>"
   "  </method>"
+  "  <method name='QueryPages'>"
+  "   <arg type='at' name='page_ids' direction='in'/>"
+  "   <arg type='as' name='fields' direction='in'/>"
+  "   <arg type='a(ta{sv})' name='pages' direction='out'/>"
+  "  </method>"
   "  <signal name='FormAuthDataSaveConfirmationRequired'>"
   "   <arg type='u' name='request_id' direction='out'/>"
   "   <arg type='t' name='page_id' direction='out'/>"
   "   <arg type='s' name='hostname' direction='out'/>"
   "   <arg type='s' name='username' direction='out'/>"
   "  </signal>"
+  "  <signal name='HasModifiedFormsChanged'>"
+  "   <arg type='t' name='page_id' direction='out'/>"
+  "   <arg type='b' name='has_modified_forms' direction='out'/>"
+  "  </signal>"
   "  <method name='FormAuthDataSaveConfirmationResponse'>"
   "   <arg type='u' name='request_id' direction='in'/>"
   "   <arg type='b' name='should_store' direction='in'/>"
@@ -80,7 +95,7 @@ web_page_send_request (WebKitWebPage *web_page,
   const char *request_uri;
   const char *page_uri;
 
-  if (g_settings_get_boolean (EPHY_SETTINGS_WEB, EPHY_PREFS_WEB_DO_NOT_TRACK)) {
+  if (g_atomic_int_get (&do_not_track_enabled)) {
     SoupMessageHeaders *headers;
 
     headers = webkit_uri_request_get_http_headers (request);
@@ -91,7 +106,7 @@ web_page_send_request (WebKitWebPage *web_page,
     }
   }
 
-  if (!g_settings_get_boolean (EPHY_SETTINGS_WEB, EPHY_PREFS_WEB_ENABLE_ADBLOCK))
+  if (!g_atomic_int_get (&adblock_enabled))
       return FALSE;
 
   request_uri = webkit_uri_request_get_uri (request);
@@ -104,6 +119,17 @@ web_page_send_request (WebKitWebPage *web_page,
   return uri_tester_test_uri (uri_tester, request_uri, page_uri, AD_URI_CHECK_TYPE_OTHER);
 }
 
+static void
+web_settings_changed_cb (GSettings *settings,
+                         const char *key,
+                         gpointer user_data)
+{
+  g_atomic_int_set (&do_not_track_enabled,
+                    g_settings_get_boolean (settings, EPHY_PREFS_WEB_DO_NOT_TRACK));
+  g_atomic_int_set (&adblock_enabled,
+                    g_settings_get_boolean (settings, EPHY_PREFS_WEB_ENABLE_ADBLOCK));
+}
+
 static GHashTable *
 get_form_auth_data_save_requests (void)
 {
@@ -128,6 +154,46 @@ form_auth_data_save_request_new_id (void)
   return ++form_auth_data_save_request_id;
 }
 
+typedef struct {
+  char *host;
+  char *form_username;
+  char *form_password;
+  char *username;
+} StorePasswordData;
+
+static void
+store_password_data_free (StorePasswordData *data)
+{
+  g_free (data->host);
+  g_free (data->form_username);
+  g_free (data->form_password);
+  g_free (data->username);
+  g_slice_free (StorePasswordData, data);
+}
+
+static void
+password_stored_cb (GObject *source_object,
+                    GAsyncResult *result,
+                    StorePasswordData *data)
+{
+  GError *error = NULL;
+
+  /* Only cache what actually made it to the keyring. */
+  if (ephy_form_auth_data_store_finish (result, &error)) {
+    if (form_auth_data_cache)
+      ephy_form_auth_data_cache_add (form_auth_data_cache,
+                                     data->host,
+                                     data->form_username,
+                                     data->form_password,
+                                     data->username);
+  } else {
+    LOG ("Error storing form password: %s", error ? error->message : "unknown error");
+    g_clear_error (&error);
+  }
+
+  store_password_data_free (data);
+}
+
 static void
 store_password (EphyEmbedFormAuth *form_auth)
 {
@@ -137,6 +203,7 @@ store_password (EphyEmbedFormAuth *form_auth)
   char *username_field_value = NULL;
   char *password_field_name = NULL;
   char *password_field_value = NULL;
+  StorePasswordData *data;
 
   g_object_get (ephy_embed_form_auth_get_username_node (form_auth),
                 "name", &username_field_name,
@@ -149,21 +216,22 @@ store_password (EphyEmbedFormAuth *form_auth)
 
   uri = ephy_embed_form_auth_get_uri (form_auth);
   uri_str = soup_uri_to_string (uri, FALSE);
+
+  data = g_slice_new (StorePasswordData);
+  data->host = g_strdup (uri->host);
+  data->form_username = g_strdup (username_field_name);
+  data->form_password = g_strdup (password_field_name);
+  data->username = g_strdup (username_field_value);
+
   ephy_form_auth_data_store (uri_str,
                              username_field_name,
                              password_field_name,
                              username_field_value,
                              password_field_value,
-                             NULL, NULL);
+                             (GAsyncReadyCallback)password_stored_cb,
+                             data);
   g_free (uri_str);
 
-  /* Update internal caching */
-  ephy_form_auth_data_cache_add (form_auth_data_cache,
-                                 uri->host,
-                                 username_field_name,
-                                 password_field_name,
-                                 username_field_value);
-
   g_free (username_field_name);
   g_free (username_field_value);
   g_free (password_field_name);
@@ -285,74 +353,102 @@ form_submitted_cb (WebKitDOMHTMLFormElement *dom_form,
   return TRUE;
 }
 
-static void
-fill_form_cb (const char *username,
-              const char *password,
-              gpointer user_data)
+static gboolean
+form_auth_has_fields (EphyEmbedFormAuth *form_auth,
+                      const char *form_username,
+                      const char *form_password)
 {
-  EphyEmbedFormAuth *form_auth = EPHY_EMBED_FORM_AUTH (user_data);
+  char *username_field_name;
+  char *password_field_name;
+  gboolean retval;
 
-  if (username == NULL && password == NULL) {
-    LOG ("No result");
-    return;
-  }
+  g_object_get (ephy_embed_form_auth_get_username_node (form_auth),
+                "name", &username_field_name, NULL);
+  g_object_get (ephy_embed_form_auth_get_password_node (form_auth),
+                "name", &password_field_name, NULL);
 
-  LOG ("Found: user %s pass (hidden)", username);
-  g_object_set (ephy_embed_form_auth_get_username_node (form_auth),
-                "value", username, NULL);
-  g_object_set (ephy_embed_form_auth_get_password_node (form_auth),
-                "value", password, NULL);
+  retval = g_strcmp0 (username_field_name, form_username) == 0 &&
+    g_strcmp0 (password_field_name, form_password) == 0;
+
+  g_free (username_field_name);
+  g_free (password_field_name);
+
+  return retval;
 }
 
-static gint
-ephy_form_auth_data_compare (EphyFormAuthData *form_data,
-                             EphyEmbedFormAuth *form_auth)
+static gboolean
+form_auth_is_known (EphyEmbedFormAuth *form_auth)
 {
+  SoupURI *uri;
   char *username_field_name;
   char *password_field_name;
   gboolean retval;
 
+  uri = ephy_embed_form_auth_get_uri (form_auth);
+  if (!uri || !uri->host)
+    return FALSE;
+
   g_object_get (ephy_embed_form_auth_get_username_node (form_auth),
                 "name", &username_field_name, NULL);
   g_object_get (ephy_embed_form_auth_get_password_node (form_auth),
                 "name", &password_field_name, NULL);
 
-  retval = g_strcmp0 (username_field_name, form_data->form_username) == 0 &&
-    g_strcmp0 (password_field_name, form_data->form_password) == 0;
+  retval = ephy_form_auth_data_cache_lookup (form_auth_data_cache, uri->host,
+                                             username_field_name,
+                                             password_field_name) != NULL;
 
   g_free (username_field_name);
   g_free (password_field_name);
 
-  return retval ? 0 : 1;
+  return retval;
 }
 
 static void
-pre_fill_form (EphyEmbedFormAuth *form_auth)
+fill_forms_cb (const char *form_username,
+               const char *form_password,
+               const char *username,
+               const char *password,
+               gpointer user_data)
 {
-  GSList *form_auth_data_list;
-  GSList *l;
-  EphyFormAuthData *form_data;
-  SoupURI *uri;
-  char *uri_str;
+  GPtrArray *form_auths = (GPtrArray *)user_data;
+  guint i;
 
-  uri = ephy_embed_form_auth_get_uri (form_auth);
-  if (!uri)
+  if (username == NULL && password == NULL)
     return;
 
-  form_auth_data_list = ephy_form_auth_data_cache_get_list (form_auth_data_cache, uri->host);
-  l = g_slist_find_custom (form_auth_data_list, form_auth, (GCompareFunc)ephy_form_auth_data_compare);
-  if (!l)
-    return;
+  /* Like ephy_form_auth_data_query(), the first password found for
+   * the fields of a form is the one used to fill it. */
+  for (i = 0; i < form_auths->len; i++) {
+    EphyEmbedFormAuth *form_auth = g_ptr_array_index (form_auths, i);
+
+    if (!form_auth_has_fields (form_auth, form_username, form_password))
+      continue;
+
+    LOG ("Found: user %s pass (hidden)", username);
+    g_object_set (ephy_embed_form_auth_get_username_node (form_auth),
+                  "value", username, NULL);
+    g_object_set (ephy_embed_form_auth_get_password_node (form_auth),
+                  "value", password, NULL);
+
+    g_ptr_array_remove_index_fast (form_auths, i--);
+  }
+}
+
+/* Fills all the known forms of a page with a single secret service
+ * search. */
+static void
+pre_fill_forms (GPtrArray *form_auths)
+{
+  SoupURI *uri;
+  char *uri_str;
 
-  form_data = (EphyFormAuthData *)l->data;
+  uri = ephy_embed_form_auth_get_uri (g_ptr_array_index (form_auths, 0));
   uri_str = soup_uri_to_string (uri, FALSE);
 
-  ephy_form_auth_data_query (uri_str,
-                             form_data->form_username,
-                             form_data->form_password,
-                             fill_form_cb,
-                             g_object_ref (form_auth),
-                             (GDestroyNotify)g_object_unref);
+  ephy_form_auth_data_query_all (uri_str,
+                                 fill_forms_cb,
+                                 g_ptr_array_ref (form_auths),
+                                 (GDestroyNotify)g_ptr_array_unref);
   g_free (uri_str);
 }
 
@@ -362,6 +458,7 @@ web_page_document_loaded (WebKitWebPage *web_page,
 {
   WebKitDOMHTMLCollection *forms = NULL;
   WebKitDOMDocument *document = NULL;
+  GPtrArray *known_form_auths = NULL;
   gulong forms_n;
   int i;
 
@@ -390,20 +487,106 @@ web_page_document_loaded (WebKitWebPage *web_page,
     if (ephy_web_dom_utils_find_form_auth_elements (form, &username_node, &password_node)) {
       EphyEmbedFormAuth *form_auth;
 
-      LOG ("Hooking and pre-filling a form");
+      LOG ("Hooking a form");
 
       /* EphyEmbedFormAuth takes ownership of the nodes */
       form_auth = ephy_embed_form_auth_new (web_page, username_node, password_node);
       webkit_dom_event_target_add_event_listener (WEBKIT_DOM_EVENT_TARGET (form), "submit",
                                                   G_CALLBACK (form_submitted_cb), FALSE,
                                                   web_page);
-      pre_fill_form (form_auth);
-      g_object_unref (form_auth);
+
+      /* Only ask the keyring about forms we know it has passwords for. */
+      if (form_auth_is_known (form_auth)) {
+        LOG ("Pre-filling a form");
+        if (!known_form_auths)
+          known_form_auths = g_ptr_array_new_with_free_func (g_object_unref);
+        g_ptr_array_add (known_form_auths, form_auth);
+      } else
+        g_object_unref (form_auth);
     } else
       LOG ("No pre-fillable/hookable form found");
   }
 
   g_object_unref(forms);
+
+  if (known_form_auths) {
+    pre_fill_forms (known_form_auths);
+    g_ptr_array_unref (known_form_auths);
+  }
+}
+
+static void
+emit_has_modified_forms_changed (WebKitWebPage *web_page,
+                                 gboolean has_modified_forms)
+{
+  GError *error = NULL;
+
+  if (!dbus_connection)
+    return;
+
+  g_dbus_connection_emit_signal (dbus_connection,
+                                 NULL,
+                                 EPHY_WEB_EXTENSION_OBJECT_PATH,
+                                 EPHY_WEB_EXTENSION_INTERFACE,
+                                 "HasModifiedFormsChanged",
+                                 g_variant_new ("(tb)",
+                                                webkit_web_page_get_id (web_page),
+                                                has_modified_forms),
+                                 &error);
+  if (error) {
+    g_warning ("Error emitting signal HasModifiedFormsChanged: %s\n", error->message);
+    g_error_free (error);
+  }
+}
+
+static void
+has_modified_forms_changed_cb (EphyEmbedFormTracker *tracker,
+                               GParamSpec *pspec,
+                               WebKitWebPage *web_page)
+{
+  emit_has_modified_forms_changed (web_page,
+                                   ephy_embed_form_tracker_has_modified_forms (tracker));
+}
+
+static void
+web_page_track_modified_forms (WebKitWebPage *web_page,
+                               gpointer user_data)
+{
+  EphyEmbedFormTracker *tracker;
+  gboolean had_modified_forms = FALSE;
+  gboolean has_modified_forms;
+
+  tracker = g_object_get_data (G_OBJECT (web_page), "ephy-form-tracker");
+  if (tracker)
+    had_modified_forms = ephy_embed_form_tracker_has_modified_forms (tracker);
+
+  tracker = ephy_embed_form_tracker_new (webkit_web_page_get_dom_document (web_page));
+  has_modified_forms = ephy_embed_form_tracker_has_modified_forms (tracker);
+  g_signal_connect (tracker, "notify::has-modified-forms",
+                    G_CALLBACK (has_modified_forms_changed_cb), web_page);
+  /* This drops the tracker of the previous document, if any. */
+  g_object_set_data_full (G_OBJECT (web_page), "ephy-form-tracker",
+                          tracker, (GDestroyNotify)g_object_unref);
+
+  /* The UI process starts every document without modified forms. */
+  if (had_modified_forms || has_modified_forms)
+    emit_has_modified_forms_changed (web_page, has_modified_forms);
+}
+
+static gboolean
+web_page_has_modified_forms (WebKitWebPage *web_page)
+{
+  EphyEmbedFormTracker *tracker;
+  WebKitDOMDocument *document;
+
+  document = webkit_web_page_get_dom_document (web_page);
+  tracker = g_object_get_data (G_OBJECT (web_page), "ephy-form-tracker");
+
+  /* The document has not finished loading yet, scan it. */
+  if (!tracker || ephy_embed_form_tracker_get_document (tracker) != document)
+    return ephy_web_dom_utils_has_modified_forms (document);
+
+  return ephy_embed_form_tracker_has_modified_forms (tracker);
 }
 
 static void
@@ -414,6 +597,9 @@ web_page_created_callback (WebKitWebExtension *extension,
   g_signal_connect_object (web_page, "send-request",
                            G_CALLBACK (web_page_send_request),
                            NULL, 0);
+  g_signal_connect_object (web_page, "document-loaded",
+                           G_CALLBACK (web_page_track_modified_forms),
+                           NULL, 0);
   g_signal_connect_object (web_page, "document-loaded",
                            G_CALLBACK (web_page_document_loaded),
                            NULL, 0);
@@ -432,6 +618,54 @@ get_webkit_web_page_or_return_dbus_error (GDBusMethodInvocation *invocation,
   return web_page;
 }
 
+/* Answers the @fields of a single page for QueryPages. Unknown fields
+ * are left out of the reply, and so are pages that were closed while
+ * the call was in flight. */
+static GVariant *
+query_page (WebKitWebPage *web_page,
+            guint64 page_id,
+            const char * const *fields)
+{
+  WebKitDOMDocument *document;
+  GVariantBuilder builder;
+  guint i;
+
+  document = webkit_web_page_get_dom_document (web_page);
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+  for (i = 0; fields[i]; i++) {
+    const char *field = fields[i];
+
+    if (g_strcmp0 (field, EPHY_WEB_EXTENSION_FIELD_HAS_MODIFIED_FORMS) == 0) {
+      g_variant_builder_add (&builder, "{sv}", field,
+                             g_variant_new_boolean (web_page_has_modified_forms (web_page)));
+    } else if (g_strcmp0 (field, EPHY_WEB_EXTENSION_FIELD_WEB_APP_TITLE) == 0) {
+      char *title;
+
+      title = ephy_web_dom_utils_get_application_title (document);
+      g_variant_builder_add (&builder, "{sv}", field,
+                             g_variant_new_string (title ? title : ""));
+      g_free (title);
+    } else if (g_strcmp0 (field, EPHY_WEB_EXTENSION_FIELD_BEST_WEB_APP_ICON) == 0) {
+      const char *base_uri;
+      char *uri = NULL;
+      char *color = NULL;
+      gboolean result = FALSE;
+
+      base_uri = webkit_web_page_get_uri (web_page);
+      if (base_uri && base_uri[0] != '\0')
+        result = ephy_web_dom_utils_get_best_icon (document, base_uri, &uri, &color);
+
+      g_variant_builder_add (&builder, "{sv}", field,
+                             g_variant_new ("(bss)", result, uri ? uri : "", color ? color : ""));
+      g_free (uri);
+      g_free (color);
+    }
+  }
+
+  return g_variant_new ("(ta{sv})", page_id, &builder);
+}
+
 static void
 handle_method_call (GDBusConnection *connection,
                     const char *sender,
@@ -449,7 +683,6 @@ handle_method_call (GDBusConnection *connection,
 
   if (g_strcmp0 (method_name, "HasModifiedForms") == 0) {
     WebKitWebPage *web_page;
-    WebKitDOMDocument *document;
     guint64 page_id;
     gboolean has_modifed_forms;
 
@@ -458,8 +691,7 @@ handle_method_call (GDBusConnection *connection,
     if (!web_page)
       return;
 
-    document = webkit_web_page_get_dom_document (web_page);
-    has_modifed_forms = ephy_web_dom_utils_has_modified_forms (document);
+    has_modifed_forms = web_page_has_modified_forms (web_page);
 
     g_dbus_method_invocation_return_value (invocation, g_variant_new ("(b)", has_modifed_forms));
   } else if (g_strcmp0 (method_name, "GetWebAppTitle") == 0) {
@@ -502,6 +734,28 @@ handle_method_call (GDBusConnection *connection,
 
     g_dbus_method_invocation_return_value (invocation,
                                            g_variant_new ("(bss)", result, uri ? uri : "", color ? color : ""));
+  } else if (g_strcmp0 (method_name, "QueryPages") == 0) {
+    GVariantIter *page_ids;
+    const char **fields;
+    GVariantBuilder builder;
+    guint64 page_id;
+
+    g_variant_get (parameters, "(at^a&s)", &page_ids, &fields);
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ta{sv})"));
+    while (g_variant_iter_next (page_ids, "t", &page_id)) {
+      WebKitWebPage *web_page;
+
+      web_page = webkit_web_extension_get_page (web_extension, page_id);
+      if (!web_page)
+        continue;
+
+      g_variant_builder_add_value (&builder, query_page (web_page, page_id, fields));
+    }
+    g_variant_iter_free (page_ids);
+    g_free (fields);
+
+    g_dbus_method_invocation_return_value (invocation, g_variant_new ("(a(ta{sv}))", &builder));
   } else if (g_strcmp0 (method_name, "FormAuthDataSaveConfirmationResponse") == 0) {
     EphyEmbedFormAuth *form_auth;
     guint request_id;
@@ -565,6 +819,12 @@ webkit_web_extension_initialize (WebKitWebExtension *extension)
   if (!g_getenv ("EPHY_PRIVATE_PROFILE"))
     form_auth_data_cache = ephy_form_auth_data_cache_new ();
 
+  g_signal_connect (EPHY_SETTINGS_WEB, "changed::" EPHY_PREFS_WEB_DO_NOT_TRACK,
+                    G_CALLBACK (web_settings_changed_cb), NULL);
+  g_signal_connect (EPHY_SETTINGS_WEB, "changed::" EPHY_PREFS_WEB_ENABLE_ADBLOCK,
+                    G_CALLBACK (web_settings_changed_cb), NULL);
+  web_settings_changed_cb (EPHY_SETTINGS_WEB, NULL, NULL);
+
   g_signal_connect (extension, "page-created",
                     G_CALLBACK (web_page_created_callback),
                     NULL);
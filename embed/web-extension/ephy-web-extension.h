@@ -23,4 +23,9 @@
 #define EPHY_WEB_EXTENSION_OBJECT_PATH  "/org/gnome/Epiphany/WebExtension"
 #define EPHY_WEB_EXTENSION_INTERFACE    "org.gnome.Epiphany.WebExtension"
 
+/* Fields that can be asked for with the QueryPages method. */
+#define EPHY_WEB_EXTENSION_FIELD_HAS_MODIFIED_FORMS "has-modified-forms"
+#define EPHY_WEB_EXTENSION_FIELD_WEB_APP_TITLE      "web-app-title"
+#define EPHY_WEB_EXTENSION_FIELD_BEST_WEB_APP_ICON  "best-web-app-icon"
+
 #endif /* EPHY_WEB_EXTENSION_H */
@@ -28,6 +28,7 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <glib.h>
 
 /**
@@ -46,6 +47,40 @@ static char **ephy_profile_modules;
 static gboolean ephy_profile_all_modules;
 #endif /* !DISABLE_PROFILING */
 
+static GMutex ephy_trace_lock;
+static char *ephy_trace_file = NULL;
+static gint64 ephy_trace_origin = 0;
+static GHashTable *ephy_trace_active = NULL;
+static GPtrArray *ephy_trace_events = NULL;
+
+static EphyProfiler *
+ephy_profiler_new (const char *name, const char *module)
+{
+	EphyProfiler *profiler;
+
+	profiler = g_new0 (EphyProfiler, 1);
+	profiler->timer = g_timer_new ();
+	profiler->name  = g_strdup (name);
+	profiler->module  = g_strdup (module);
+	profiler->start_time = g_get_monotonic_time ();
+
+	g_timer_start (profiler->timer);
+
+	return profiler;
+}
+
+static void
+ephy_profiler_free (EphyProfiler *profiler)
+{
+	g_return_if_fail (profiler != NULL);
+
+	if (profiler->timer)
+		g_timer_destroy (profiler->timer);
+	g_free (profiler->name);
+	g_free (profiler->module);
+	g_free (profiler);
+}
+
 #ifdef GNOME_ENABLE_DEBUG
 
 static char **
@@ -184,6 +219,9 @@ ephy_debug_init (void)
 	ephy_debug_break = g_getenv ("EPHY_DEBUG_BREAK");
 	g_log_set_default_handler (trap_handler, NULL);
 
+	ephy_trace_origin = g_get_monotonic_time ();
+	ephy_trace_file = g_strdup (g_getenv ("EPHY_TRACE_FILE"));
+
 #ifndef DISABLE_PROFILING
 	ephy_profile_modules = build_modules ("EPHY_PROFILE_MODULES", &ephy_profile_all_modules);
 #endif
@@ -191,21 +229,6 @@ ephy_debug_init (void)
 
 #ifndef DISABLE_PROFILING
 
-static EphyProfiler *
-ephy_profiler_new (const char *name, const char *module)
-{
-	EphyProfiler *profiler;
-
-	profiler = g_new0 (EphyProfiler, 1);
-	profiler->timer = g_timer_new ();
-	profiler->name  = g_strdup (name);
-	profiler->module  = g_strdup (module);
-
-	g_timer_start (profiler->timer);
-
-	return profiler;
-}
-
 static gboolean
 ephy_should_profile (const char *module)
 {
@@ -244,17 +267,6 @@ ephy_profiler_dump (EphyProfiler *profiler)
 		 seconds);
 }
 
-static void
-ephy_profiler_free (EphyProfiler *profiler)
-{
-	g_return_if_fail (profiler != NULL);
-
-	g_timer_destroy (profiler->timer);
-	g_free (profiler->name);
-	g_free (profiler->module);
-	g_free (profiler);
-}
-
 /**
  * ephy_profiler_start:
  * @name: name of this new profiler
@@ -302,3 +314,197 @@ ephy_profiler_stop (const char *name)
 }
 
 #endif
+
+/**
+ * ephy_trace_is_enabled:
+ *
+ * Tracing is turned on by pointing the EPHY_TRACE_FILE variable to the
+ * file the trace should be written to. Unlike the profiler it is also
+ * available in non-debug builds.
+ *
+ * Returns: %TRUE if spans are being recorded
+ **/
+gboolean
+ephy_trace_is_enabled (void)
+{
+	return ephy_trace_file != NULL;
+}
+
+static const char *
+trace_module_name (const char *module)
+{
+	const char *slash;
+
+	slash = strrchr (module, '/');
+
+	return slash ? slash + 1 : module;
+}
+
+/**
+ * ephy_trace_start:
+ * @name: name of the span
+ * @module: the file the span belongs to, usually __FILE__
+ *
+ * Starts a span named @name. Use the START_TRACE() macro rather than
+ * calling this directly.
+ **/
+void
+ephy_trace_start (const char *name, const char *module)
+{
+	if (ephy_trace_file == NULL) return;
+
+	g_mutex_lock (&ephy_trace_lock);
+
+	if (ephy_trace_active == NULL)
+	{
+		ephy_trace_active =
+			g_hash_table_new_full (g_str_hash, g_str_equal,
+					       g_free, (GDestroyNotify) ephy_profiler_free);
+	}
+
+	g_hash_table_insert (ephy_trace_active, g_strdup (name),
+			     ephy_profiler_new (name, trace_module_name (module)));
+
+	g_mutex_unlock (&ephy_trace_lock);
+}
+
+static void
+trace_add_event (EphyProfiler *profiler)
+{
+	if (ephy_trace_events == NULL)
+	{
+		ephy_trace_events =
+			g_ptr_array_new_with_free_func ((GDestroyNotify) ephy_profiler_free);
+	}
+
+	g_ptr_array_add (ephy_trace_events, profiler);
+}
+
+/**
+ * ephy_trace_stop:
+ * @name: name of the span to stop
+ *
+ * Ends the span named @name and keeps it for ephy_trace_write().
+ **/
+void
+ephy_trace_stop (const char *name)
+{
+	EphyProfiler *profiler;
+	char *key;
+
+	if (ephy_trace_file == NULL) return;
+
+	g_mutex_lock (&ephy_trace_lock);
+
+	if (ephy_trace_active != NULL &&
+	    g_hash_table_lookup_extended (ephy_trace_active, name,
+					  (gpointer *) &key, (gpointer *) &profiler))
+	{
+		g_hash_table_steal (ephy_trace_active, name);
+		g_free (key);
+		g_timer_stop (profiler->timer);
+		trace_add_event (profiler);
+	}
+
+	g_mutex_unlock (&ephy_trace_lock);
+}
+
+/**
+ * ephy_trace_mark:
+ * @name: name of the event
+ * @module: the file the event belongs to, usually __FILE__
+ *
+ * Records an instant event, like the first window being drawn.
+ **/
+void
+ephy_trace_mark (const char *name, const char *module)
+{
+	EphyProfiler *profiler;
+
+	if (ephy_trace_file == NULL) return;
+
+	profiler = ephy_profiler_new (name, trace_module_name (module));
+	g_timer_destroy (profiler->timer);
+	profiler->timer = NULL;
+
+	g_mutex_lock (&ephy_trace_lock);
+	trace_add_event (profiler);
+	g_mutex_unlock (&ephy_trace_lock);
+}
+
+/**
+ * ephy_trace_get_elapsed:
+ *
+ * Returns: the time in microseconds since ephy_debug_init() was called,
+ * whether tracing is enabled or not
+ **/
+gint64
+ephy_trace_get_elapsed (void)
+{
+	if (ephy_trace_origin == 0) return 0;
+
+	return g_get_monotonic_time () - ephy_trace_origin;
+}
+
+/**
+ * ephy_trace_write:
+ *
+ * Writes every finished span to the file named by EPHY_TRACE_FILE, in
+ * the Chrome trace event format, so it can be loaded in about:tracing.
+ * Spans that are still running are left out.
+ *
+ * Returns: %TRUE if the file was written
+ **/
+gboolean
+ephy_trace_write (void)
+{
+	GString *json;
+	GError *error = NULL;
+	gboolean ret;
+	guint i;
+	int pid;
+
+	if (ephy_trace_file == NULL) return FALSE;
+
+	pid = getpid ();
+	json = g_string_new ("{\"traceEvents\":[");
+
+	g_mutex_lock (&ephy_trace_lock);
+
+	for (i = 0; ephy_trace_events != NULL && i < ephy_trace_events->len; i++)
+	{
+		EphyProfiler *profiler = g_ptr_array_index (ephy_trace_events, i);
+
+		g_string_append_printf (json,
+					"%s{\"name\":\"%s\",\"cat\":\"%s\",\"pid\":%d,\"tid\":%d,"
+					"\"ts\":%" G_GINT64_FORMAT,
+					i ? "," : "",
+					profiler->name, profiler->module, pid, pid,
+					profiler->start_time - ephy_trace_origin);
+
+		if (profiler->timer)
+		{
+			g_string_append_printf (json, ",\"ph\":\"X\",\"dur\":%" G_GINT64_FORMAT "}",
+						(gint64) (g_timer_elapsed (profiler->timer, NULL) * G_USEC_PER_SEC));
+		}
+		else
+		{
+			g_string_append (json, ",\"ph\":\"i\",\"s\":\"p\"}");
+		}
+	}
+
+	g_mutex_unlock (&ephy_trace_lock);
+
+	g_string_append (json, "]}\n");
+
+	ret = g_file_set_contents (ephy_trace_file, json->str, json->len, &error);
+	if (!ret)
+	{
+		g_warning ("Could not write trace to %s: %s", ephy_trace_file, error->message);
+		g_error_free (error);
+	}
+
+	g_string_free (json, TRUE);
+
+	return ret;
+}
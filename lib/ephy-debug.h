@@ -64,15 +64,35 @@ ephy_profiler_start (name, __FILE__);
 ephy_profiler_stop (name);
 #endif
 
+#define START_TRACE(name)	\
+ephy_trace_start (name, __FILE__);
+#define STOP_TRACE(name)	\
+ephy_trace_stop (name);
+
 typedef struct
 {
 	GTimer *timer;
 	char *name;
 	char *module;
+	gint64 start_time;
 } EphyProfiler;
 
 void		ephy_debug_init		(void);
 
+gboolean	ephy_trace_is_enabled	(void);
+
+void		ephy_trace_start	(const char *name,
+					 const char *module);
+
+void		ephy_trace_stop		(const char *name);
+
+void		ephy_trace_mark		(const char *name,
+					 const char *module);
+
+gint64		ephy_trace_get_elapsed	(void);
+
+gboolean	ephy_trace_write	(void);
+
 #ifndef DISABLE_PROFILING
 
 void		ephy_profiler_start	(const char *name,
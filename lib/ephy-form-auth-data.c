@@ -252,6 +252,103 @@ ephy_form_auth_data_query (const char *uri,
   g_free (key_str);
 }
 
+typedef struct
+{
+  EphyFormAuthDataQueryAllCallback callback;
+  gpointer data;
+  GDestroyNotify destroy_data;
+} EphyFormAuthDataQueryAllClosure;
+
+static void
+search_all_form_data_cb (SecretService *service,
+                         GAsyncResult *res,
+                         EphyFormAuthDataQueryAllClosure *closure)
+{
+  GList *results, *p;
+  GError *error = NULL;
+
+  results = secret_service_search_finish (service, res, &error);
+  if (error) {
+    g_warning ("Couldn't retrieve form data: %s", error->message);
+    g_error_free (error);
+  }
+
+  for (p = results; p && closure->callback; p = p->next) {
+    SecretItem *item = (SecretItem *)p->data;
+    GHashTable *attributes;
+    SecretValue *value;
+
+    attributes = secret_item_get_attributes (item);
+    value = secret_item_get_secret (item);
+    closure->callback (g_hash_table_lookup (attributes, FORM_USERNAME_KEY),
+                       g_hash_table_lookup (attributes, FORM_PASSWORD_KEY),
+                       g_hash_table_lookup (attributes, USERNAME_KEY),
+                       value ? secret_value_get (value, NULL) : NULL,
+                       closure->data);
+    if (value)
+      secret_value_unref (value);
+    g_hash_table_unref (attributes);
+  }
+  g_list_free_full (results, (GDestroyNotify)g_object_unref);
+
+  if (closure->destroy_data)
+    closure->destroy_data (closure->data);
+  g_slice_free (EphyFormAuthDataQueryAllClosure, closure);
+}
+
+/**
+ * ephy_form_auth_data_query_all:
+ * @uri: the URI of the page
+ * @callback: called once for every form password stored for @uri
+ * @user_data: data for @callback
+ * @destroy_data: (allow-none): called on @user_data once all the results
+ *   have been passed to @callback
+ *
+ * Like ephy_form_auth_data_query(), but retrieves the passwords of all
+ * the forms of @uri with a single secret service search, so that a page
+ * with several known forms can be filled in one go.
+ **/
+void
+ephy_form_auth_data_query_all (const char *uri,
+                               EphyFormAuthDataQueryAllCallback callback,
+                               gpointer user_data,
+                               GDestroyNotify destroy_data)
+{
+  SoupURI *key;
+  char *key_str;
+  EphyFormAuthDataQueryAllClosure *closure;
+  GHashTable *attributes;
+
+  g_return_if_fail (uri);
+
+  key = soup_uri_new (uri);
+  g_return_if_fail (key);
+
+  normalize_and_prepare_uri (key);
+
+  key_str = soup_uri_to_string (key, FALSE);
+
+  attributes = secret_attributes_build (EPHY_FORM_PASSWORD_SCHEMA,
+                                        URI_KEY, key_str,
+                                        NULL);
+
+  closure = g_slice_new0 (EphyFormAuthDataQueryAllClosure);
+  closure->callback = callback;
+  closure->data = user_data;
+  closure->destroy_data = destroy_data;
+
+  secret_service_search (NULL,
+                         EPHY_FORM_PASSWORD_SCHEMA,
+                         attributes,
+                         SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK | SECRET_SEARCH_LOAD_SECRETS,
+                         NULL, (GAsyncReadyCallback)search_all_form_data_cb,
+                         closure);
+
+  g_hash_table_unref (attributes);
+  soup_uri_free (key);
+  g_free (key_str);
+}
+
 static EphyFormAuthData *
 ephy_form_auth_data_new (const char *form_username,
                          const char *form_password,
@@ -327,30 +424,96 @@ ephy_form_auth_data_cache_init (EphyFormAuthDataCache *cache)
   g_hash_table_unref (attributes);
 }
 
+/* The form auth data known for a host: all of it in the order it was
+ * added, plus an index on the names of the form fields. The index maps
+ * the first entry added for some fields to all the entries for them,
+ * in the order they were added. */
+typedef struct {
+  GSList *data;
+  GSList *last;
+  GHashTable *by_fields;
+} EphyFormAuthDataHost;
+
 struct _EphyFormAuthDataCache {
   GHashTable  *form_auth_data_map;
 };
 
+static guint
+form_fields_hash (gconstpointer key)
+{
+  const EphyFormAuthData *data = key;
+
+  return g_str_hash (data->form_username) * 31 + g_str_hash (data->form_password);
+}
+
+static gboolean
+form_fields_equal (gconstpointer a,
+                   gconstpointer b)
+{
+  const EphyFormAuthData *data_a = a;
+  const EphyFormAuthData *data_b = b;
+
+  return g_str_equal (data_a->form_username, data_b->form_username) &&
+    g_str_equal (data_a->form_password, data_b->form_password);
+}
+
+static EphyFormAuthDataHost *
+ephy_form_auth_data_host_new (void)
+{
+  EphyFormAuthDataHost *host = g_slice_new0 (EphyFormAuthDataHost);
+
+  host->by_fields = g_hash_table_new_full (form_fields_hash, form_fields_equal,
+                                           NULL, (GDestroyNotify)g_ptr_array_unref);
+
+  return host;
+}
+
+static void
+ephy_form_auth_data_host_free (EphyFormAuthDataHost *host)
+{
+  g_hash_table_destroy (host->by_fields);
+  g_slist_free_full (host->data, (GDestroyNotify)ephy_form_auth_data_free);
+
+  g_slice_free (EphyFormAuthDataHost, host);
+}
+
+/**
+ * ephy_form_auth_data_cache_new_empty:
+ *
+ * Creates a cache without loading the form passwords stored in the
+ * keyring, to be filled with ephy_form_auth_data_cache_add().
+ *
+ * Returns: a new, empty #EphyFormAuthDataCache
+ **/
 EphyFormAuthDataCache *
-ephy_form_auth_data_cache_new (void)
+ephy_form_auth_data_cache_new_empty (void)
 {
   EphyFormAuthDataCache *cache = g_slice_new (EphyFormAuthDataCache);
 
   cache->form_auth_data_map = g_hash_table_new_full (g_str_hash,
                                                      g_str_equal,
                                                      g_free,
-                                                     NULL);
-  ephy_form_auth_data_cache_init (cache);
+                                                     (GDestroyNotify)ephy_form_auth_data_host_free);
 
   return cache;
 }
 
-static void
-form_auth_data_map_free_value (gpointer key,
-                               gpointer value,
-                               gpointer user_data)
+/**
+ * ephy_form_auth_data_cache_new:
+ *
+ * Creates a cache and starts loading the form passwords stored in the
+ * keyring into it.
+ *
+ * Returns: a new #EphyFormAuthDataCache
+ **/
+EphyFormAuthDataCache *
+ephy_form_auth_data_cache_new (void)
 {
-  g_slist_free_full ((GSList *)value, (GDestroyNotify)ephy_form_auth_data_free);
+  EphyFormAuthDataCache *cache = ephy_form_auth_data_cache_new_empty ();
+
+  ephy_form_auth_data_cache_init (cache);
+
+  return cache;
 }
 
 void
@@ -358,9 +521,6 @@ ephy_form_auth_data_cache_free (EphyFormAuthDataCache *cache)
 {
   g_return_if_fail (cache);
 
-  g_hash_table_foreach (cache->form_auth_data_map,
-                        (GHFunc)form_auth_data_map_free_value,
-                        NULL);
   g_hash_table_destroy (cache->form_auth_data_map);
 
   g_slice_free (EphyFormAuthDataCache, cache);
@@ -373,8 +533,11 @@ ephy_form_auth_data_cache_add (EphyFormAuthDataCache *cache,
                                const char *form_password,
                                const char *username)
 {
+  EphyFormAuthDataHost *host;
   EphyFormAuthData *data;
-  GSList *l;
+  EphyFormAuthData key;
+  GPtrArray *logins;
+  guint i;
 
   g_return_if_fail (cache);
   g_return_if_fail (uri);
@@ -382,19 +545,159 @@ ephy_form_auth_data_cache_add (EphyFormAuthDataCache *cache,
   g_return_if_fail (form_password);
   g_return_if_fail (username);
 
+  host = g_hash_table_lookup (cache->form_auth_data_map, uri);
+  if (!host) {
+    host = ephy_form_auth_data_host_new ();
+    g_hash_table_insert (cache->form_auth_data_map, g_strdup (uri), host);
+  }
+
+  key.form_username = (char *)form_username;
+  key.form_password = (char *)form_password;
+  key.username = NULL;
+
+  /* Storing the same login again replaces the secret, not the entry.
+   * Only the logins for the same fields can be the same. */
+  logins = g_hash_table_lookup (host->by_fields, &key);
+  for (i = 0; logins && i < logins->len; i++) {
+    data = g_ptr_array_index (logins, i);
+    if (g_str_equal (data->username, username))
+      return;
+  }
+
+  /* Append in constant time, the callers expect the insertion order. */
   data = ephy_form_auth_data_new (form_username, form_password, username);
-  l = g_hash_table_lookup (cache->form_auth_data_map, uri);
-  l = g_slist_append (l, data);
-  g_hash_table_replace (cache->form_auth_data_map,
-                        g_strdup (uri), l);
+  if (!host->data)
+    host->data = host->last = g_slist_prepend (NULL, data);
+  else
+    host->last = g_slist_append (host->last, data)->next;
+
+  if (!logins) {
+    logins = g_ptr_array_new ();
+    g_hash_table_insert (host->by_fields, data, logins);
+  }
+  g_ptr_array_add (logins, data);
+}
+
+/**
+ * ephy_form_auth_data_cache_remove:
+ * @cache: an #EphyFormAuthDataCache
+ * @uri: the host the data was stored for
+ * @form_username: the name of the username field
+ * @form_password: the name of the password field
+ * @username: the username
+ *
+ * Forgets an entry added with ephy_form_auth_data_cache_add(), for
+ * instance after its password was deleted from the keyring.
+ **/
+void
+ephy_form_auth_data_cache_remove (EphyFormAuthDataCache *cache,
+                                  const char *uri,
+                                  const char *form_username,
+                                  const char *form_password,
+                                  const char *username)
+{
+  EphyFormAuthDataHost *host;
+  EphyFormAuthData *data = NULL;
+  EphyFormAuthData key;
+  GPtrArray *logins;
+  guint i;
+
+  g_return_if_fail (cache);
+  g_return_if_fail (uri);
+  g_return_if_fail (form_username);
+  g_return_if_fail (form_password);
+  g_return_if_fail (username);
+
+  host = g_hash_table_lookup (cache->form_auth_data_map, uri);
+  if (!host)
+    return;
+
+  key.form_username = (char *)form_username;
+  key.form_password = (char *)form_password;
+  key.username = NULL;
+
+  logins = g_hash_table_lookup (host->by_fields, &key);
+  if (!logins)
+    return;
+
+  for (i = 0; i < logins->len; i++) {
+    data = g_ptr_array_index (logins, i);
+    if (g_str_equal (data->username, username))
+      break;
+  }
+  if (i == logins->len)
+    return;
+
+  host->data = g_slist_remove (host->data, data);
+  host->last = g_slist_last (host->data);
+
+  /* The first entry is the key of the index, so the next entry for the
+   * same fields, if any, takes its place. */
+  if (i == 0) {
+    g_hash_table_steal (host->by_fields, data);
+    g_ptr_array_remove_index (logins, 0);
+    if (logins->len)
+      g_hash_table_insert (host->by_fields, g_ptr_array_index (logins, 0), logins);
+    else
+      g_ptr_array_unref (logins);
+  } else {
+    g_ptr_array_remove_index (logins, i);
+  }
+  ephy_form_auth_data_free (data);
+
+  if (!host->data)
+    g_hash_table_remove (cache->form_auth_data_map, uri);
+}
+
+/**
+ * ephy_form_auth_data_cache_lookup:
+ * @cache: an #EphyFormAuthDataCache
+ * @uri: the host of the page
+ * @form_username: the name of the username field of the form
+ * @form_password: the name of the password field of the form
+ *
+ * Returns: (transfer none): the first #EphyFormAuthData added for a
+ * form with these fields in @uri, or %NULL
+ **/
+EphyFormAuthData *
+ephy_form_auth_data_cache_lookup (EphyFormAuthDataCache *cache,
+                                  const char *uri,
+                                  const char *form_username,
+                                  const char *form_password)
+{
+  EphyFormAuthDataHost *host;
+  EphyFormAuthData key;
+  GPtrArray *logins;
+
+  g_return_val_if_fail (cache, NULL);
+  g_return_val_if_fail (uri, NULL);
+
+  if (!form_username || !form_password)
+    return NULL;
+
+  host = g_hash_table_lookup (cache->form_auth_data_map, uri);
+  if (!host)
+    return NULL;
+
+  key.form_username = (char *)form_username;
+  key.form_password = (char *)form_password;
+  key.username = NULL;
+
+  logins = g_hash_table_lookup (host->by_fields, &key);
+
+  return logins ? g_ptr_array_index (logins, 0) : NULL;
 }
 
 GSList *
 ephy_form_auth_data_cache_get_list (EphyFormAuthDataCache *cache,
                                     const char *uri)
 {
+  EphyFormAuthDataHost *host;
+
   g_return_val_if_fail (cache, NULL);
   g_return_val_if_fail (uri, NULL);
 
-  return g_hash_table_lookup (cache->form_auth_data_map, uri);
+  host = g_hash_table_lookup (cache->form_auth_data_map, uri);
+
+  return host ? host->data : NULL;
 }
@@ -52,6 +52,17 @@ void ephy_form_auth_data_query                (const char *uri,
                                                gpointer user_data,
                                                GDestroyNotify destroy_data);
 
+typedef void (*EphyFormAuthDataQueryAllCallback) (const char *form_username,
+                                                  const char *form_password,
+                                                  const char *username,
+                                                  const char *password,
+                                                  gpointer user_data);
+
+void ephy_form_auth_data_query_all            (const char *uri,
+                                               EphyFormAuthDataQueryAllCallback callback,
+                                               gpointer user_data,
+                                               GDestroyNotify destroy_data);
+
 const SecretSchema *ephy_form_auth_data_get_password_schema (void) G_GNUC_CONST;
 
 #define EPHY_FORM_PASSWORD_SCHEMA ephy_form_auth_data_get_password_schema ()
@@ -64,14 +75,24 @@ typedef struct {
 
 typedef struct _EphyFormAuthDataCache EphyFormAuthDataCache;
 
-EphyFormAuthDataCache *ephy_form_auth_data_cache_new      (void);
-void                   ephy_form_auth_data_cache_free     (EphyFormAuthDataCache *cache);
-void                   ephy_form_auth_data_cache_add      (EphyFormAuthDataCache *cache,
-                                                           const char            *uri,
-                                                           const char            *form_username,
-                                                           const char            *form_password,
-                                                           const char            *username);
-GSList                *ephy_form_auth_data_cache_get_list (EphyFormAuthDataCache *cache,
-                                                           const char            *uri);
+EphyFormAuthDataCache *ephy_form_auth_data_cache_new       (void);
+EphyFormAuthDataCache *ephy_form_auth_data_cache_new_empty (void);
+void                   ephy_form_auth_data_cache_free      (EphyFormAuthDataCache *cache);
+void                   ephy_form_auth_data_cache_add       (EphyFormAuthDataCache *cache,
+                                                            const char            *uri,
+                                                            const char            *form_username,
+                                                            const char            *form_password,
+                                                            const char            *username);
+void                   ephy_form_auth_data_cache_remove    (EphyFormAuthDataCache *cache,
+                                                            const char            *uri,
+                                                            const char            *form_username,
+                                                            const char            *form_password,
+                                                            const char            *username);
+EphyFormAuthData      *ephy_form_auth_data_cache_lookup    (EphyFormAuthDataCache *cache,
+                                                            const char            *uri,
+                                                            const char            *form_username,
+                                                            const char            *form_password);
+GSList                *ephy_form_auth_data_cache_get_list  (EphyFormAuthDataCache *cache,
+                                                            const char            *uri);
 
 #endif
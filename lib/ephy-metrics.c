@@ -0,0 +1,344 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+#include "ephy-metrics.h"
+
+#include <string.h>
+
+/**
+ * SECTION:ephy-metrics
+ * @short_description: Always-on performance counters and histograms
+ *
+ * Counters and latency histograms are registered by name the first
+ * time they are requested and live until the process exits, so callers
+ * should look them up once and keep the pointer around. Updating them
+ * can be done from any thread; only the running total of a histogram
+ * takes a lock, since it does not fit in an atomic integer.
+ */
+
+/* Upper bounds of the histogram buckets, in microseconds. The last
+   bucket holds everything slower. */
+static const gint64 bucket_limits[] = {
+  100, 250, 500,
+  1000, 2500, 5000,
+  10000, 25000, 50000,
+  100000, 250000, 500000,
+  1000000
+};
+
+#define N_BUCKETS (G_N_ELEMENTS (bucket_limits) + 1)
+
+struct _EphyMetricsCounter {
+  char *name;
+  volatile gint value;
+};
+
+struct _EphyMetricsHistogram {
+  char *name;
+  volatile gint buckets[N_BUCKETS];
+  volatile gint count;
+  volatile gint max;
+
+  GMutex total_lock;
+  gint64 total;
+};
+
+static GMutex metrics_lock;
+static GHashTable *counters;
+static GHashTable *histograms;
+
+/**
+ * ephy_metrics_counter_get:
+ * @name: the name of the counter, like "history.queue-depth"
+ *
+ * Returns: (transfer none): the counter called @name, created on the
+ * first call.
+ **/
+EphyMetricsCounter *
+ephy_metrics_counter_get (const char *name)
+{
+  EphyMetricsCounter *counter;
+
+  g_return_val_if_fail (name != NULL, NULL);
+
+  g_mutex_lock (&metrics_lock);
+
+  if (!counters)
+    counters = g_hash_table_new (g_str_hash, g_str_equal);
+
+  counter = g_hash_table_lookup (counters, name);
+  if (!counter) {
+    counter = g_new0 (EphyMetricsCounter, 1);
+    counter->name = g_strdup (name);
+    g_hash_table_insert (counters, counter->name, counter);
+  }
+
+  g_mutex_unlock (&metrics_lock);
+
+  return counter;
+}
+
+void
+ephy_metrics_counter_add (EphyMetricsCounter *counter,
+                          gint value)
+{
+  g_atomic_int_add (&counter->value, value);
+}
+
+/* For gauges, like the length of a queue. */
+void
+ephy_metrics_counter_set (EphyMetricsCounter *counter,
+                          gint value)
+{
+  g_atomic_int_set (&counter->value, value);
+}
+
+gint
+ephy_metrics_counter_get_value (EphyMetricsCounter *counter)
+{
+  return g_atomic_int_get (&counter->value);
+}
+
+/**
+ * ephy_metrics_histogram_get:
+ * @name: the name of the histogram, like "history.query"
+ *
+ * Returns: (transfer none): the latency histogram called @name,
+ * created on the first call.
+ **/
+EphyMetricsHistogram *
+ephy_metrics_histogram_get (const char *name)
+{
+  EphyMetricsHistogram *histogram;
+
+  g_return_val_if_fail (name != NULL, NULL);
+
+  g_mutex_lock (&metrics_lock);
+
+  if (!histograms)
+    histograms = g_hash_table_new (g_str_hash, g_str_equal);
+
+  histogram = g_hash_table_lookup (histograms, name);
+  if (!histogram) {
+    histogram = g_new0 (EphyMetricsHistogram, 1);
+    histogram->name = g_strdup (name);
+    g_mutex_init (&histogram->total_lock);
+    g_hash_table_insert (histograms, histogram->name, histogram);
+  }
+
+  g_mutex_unlock (&metrics_lock);
+
+  return histogram;
+}
+
+void
+ephy_metrics_histogram_add (EphyMetricsHistogram *histogram,
+                            gint64 usecs)
+{
+  guint i;
+  gint max;
+
+  for (i = 0; i < G_N_ELEMENTS (bucket_limits); i++) {
+    if (usecs < bucket_limits[i])
+      break;
+  }
+
+  g_atomic_int_inc (&histogram->buckets[i]);
+  g_atomic_int_inc (&histogram->count);
+
+  g_mutex_lock (&histogram->total_lock);
+  histogram->total += usecs;
+  g_mutex_unlock (&histogram->total_lock);
+
+  do {
+    max = g_atomic_int_get (&histogram->max);
+  } while (usecs > max &&
+           !g_atomic_int_compare_and_exchange (&histogram->max, max, MIN (usecs, G_MAXINT)));
+}
+
+guint
+ephy_metrics_histogram_get_count (EphyMetricsHistogram *histogram)
+{
+  return g_atomic_int_get (&histogram->count);
+}
+
+static gint64
+ephy_metrics_histogram_get_total (EphyMetricsHistogram *histogram)
+{
+  gint64 total;
+
+  g_mutex_lock (&histogram->total_lock);
+  total = histogram->total;
+  g_mutex_unlock (&histogram->total_lock);
+
+  return total;
+}
+
+/* Both counters and histograms start with their name. */
+static int
+compare_names (gconstpointer a,
+               gconstpointer b)
+{
+  return strcmp (*(const char **)a, *(const char **)b);
+}
+
+static GList *
+get_sorted_values (GHashTable *table)
+{
+  if (!table)
+    return NULL;
+
+  return g_list_sort (g_hash_table_get_values (table), compare_names);
+}
+
+static void
+format_usecs (GString *str,
+              gint64 usecs)
+{
+  if (usecs < 1000)
+    g_string_append_printf (str, "%" G_GINT64_FORMAT " µs", usecs);
+  else if (usecs < 1000000)
+    g_string_append_printf (str, "%.1f ms", usecs / 1000.);
+  else
+    g_string_append_printf (str, "%.2f s", usecs / 1000000.);
+}
+
+/**
+ * ephy_metrics_to_html:
+ *
+ * Returns: an HTML fragment with tables for all the counters and
+ * histograms.
+ **/
+char *
+ephy_metrics_to_html (void)
+{
+  GString *str;
+  GList *values, *l;
+  guint i;
+
+  str = g_string_new (NULL);
+
+  g_mutex_lock (&metrics_lock);
+
+  g_string_append (str, "<table class=\"performance-table\"><caption>Counters</caption><tbody>");
+  values = get_sorted_values (counters);
+  for (l = values; l; l = l->next) {
+    EphyMetricsCounter *counter = l->data;
+
+    g_string_append_printf (str, "<tr><td>%s</td><td>%d</td></tr>",
+                            counter->name, ephy_metrics_counter_get_value (counter));
+  }
+  g_list_free (values);
+  g_string_append (str, "</tbody></table>");
+
+  g_string_append (str, "<table class=\"performance-table\"><caption>Latency</caption><thead><tr><th></th><th>Count</th><th>Mean</th><th>Max</th>");
+  for (i = 0; i < N_BUCKETS; i++) {
+    g_string_append (str, "<th>");
+    if (i < G_N_ELEMENTS (bucket_limits)) {
+      g_string_append (str, "&lt; ");
+      format_usecs (str, bucket_limits[i]);
+    } else
+      g_string_append (str, "More");
+    g_string_append (str, "</th>");
+  }
+  g_string_append (str, "</tr></thead><tbody>");
+
+  values = get_sorted_values (histograms);
+  for (l = values; l; l = l->next) {
+    EphyMetricsHistogram *histogram = l->data;
+    guint count = g_atomic_int_get (&histogram->count);
+    gint64 total = ephy_metrics_histogram_get_total (histogram);
+
+    g_string_append_printf (str, "<tr><td>%s</td><td>%u</td><td>", histogram->name, count);
+    format_usecs (str, count ? total / count : 0);
+    g_string_append (str, "</td><td>");
+    format_usecs (str, g_atomic_int_get (&histogram->max));
+    g_string_append (str, "</td>");
+    for (i = 0; i < N_BUCKETS; i++)
+      g_string_append_printf (str, "<td>%d</td>", g_atomic_int_get (&histogram->buckets[i]));
+    g_string_append (str, "</tr>");
+  }
+  g_list_free (values);
+  g_string_append (str, "</tbody></table>");
+
+  g_mutex_unlock (&metrics_lock);
+
+  return g_string_free (str, FALSE);
+}
+
+/**
+ * ephy_metrics_to_json:
+ *
+ * Returns: all the counters and histograms as a JSON object, with
+ * latencies in microseconds.
+ **/
+char *
+ephy_metrics_to_json (void)
+{
+  GString *str;
+  GList *values, *l;
+  guint i;
+
+  str = g_string_new ("{\"counters\":{");
+
+  g_mutex_lock (&metrics_lock);
+
+  values = get_sorted_values (counters);
+  for (l = values; l; l = l->next) {
+    EphyMetricsCounter *counter = l->data;
+
+    g_string_append_printf (str, "%s\"%s\":%d",
+                            l == values ? "" : ",",
+                            counter->name, ephy_metrics_counter_get_value (counter));
+  }
+  g_list_free (values);
+
+  g_string_append (str, "},\"histograms\":{");
+
+  values = get_sorted_values (histograms);
+  for (l = values; l; l = l->next) {
+    EphyMetricsHistogram *histogram = l->data;
+
+    g_string_append_printf (str, "%s\"%s\":{\"count\":%d,\"total\":%" G_GINT64_FORMAT ",\"max\":%d,\"buckets\":[",
+                            l == values ? "" : ",",
+                            histogram->name,
+                            g_atomic_int_get (&histogram->count),
+                            ephy_metrics_histogram_get_total (histogram),
+                            g_atomic_int_get (&histogram->max));
+    for (i = 0; i < N_BUCKETS; i++) {
+      if (i < G_N_ELEMENTS (bucket_limits))
+        g_string_append_printf (str, "%s{\"le\":%" G_GINT64_FORMAT ",\"count\":%d}",
+                                i ? "," : "", bucket_limits[i],
+                                g_atomic_int_get (&histogram->buckets[i]));
+      else
+        g_string_append_printf (str, ",{\"le\":null,\"count\":%d}",
+                                g_atomic_int_get (&histogram->buckets[i]));
+    }
+    g_string_append (str, "]}");
+  }
+  g_list_free (values);
+
+  g_mutex_unlock (&metrics_lock);
+
+  g_string_append (str, "}}");
+
+  return g_string_free (str, FALSE);
+}
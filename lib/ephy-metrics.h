@@ -0,0 +1,58 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#if !defined (__EPHY_EPIPHANY_H_INSIDE__) && !defined (EPIPHANY_COMPILATION)
+#error "Only <epiphany/epiphany.h> can be included directly."
+#endif
+
+#ifndef EPHY_METRICS_H
+#define EPHY_METRICS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EphyMetricsCounter EphyMetricsCounter;
+typedef struct _EphyMetricsHistogram EphyMetricsHistogram;
+
+EphyMetricsCounter   *ephy_metrics_counter_get      (const char *name);
+
+void                  ephy_metrics_counter_add      (EphyMetricsCounter *counter,
+                                                     gint value);
+
+void                  ephy_metrics_counter_set      (EphyMetricsCounter *counter,
+                                                     gint value);
+
+gint                  ephy_metrics_counter_get_value (EphyMetricsCounter *counter);
+
+EphyMetricsHistogram *ephy_metrics_histogram_get    (const char *name);
+
+void                  ephy_metrics_histogram_add    (EphyMetricsHistogram *histogram,
+                                                     gint64 usecs);
+
+guint                 ephy_metrics_histogram_get_count (EphyMetricsHistogram *histogram);
+
+char                 *ephy_metrics_to_html          (void);
+
+char                 *ephy_metrics_to_json          (void);
+
+G_END_DECLS
+
+#endif
@@ -356,26 +356,20 @@ ephy_node_db_load_from_file (EphyNodeDb *db,
 	return (success && ret == 0);
 }
 
-static int
-ephy_node_db_write_to_xml_valist (EphyNodeDb *db,
-				  xmlBuffer *buffer,
-				  const xmlChar *root,
-				  const xmlChar *version,
-				  const xmlChar *comment,
-				  EphyNode *first_node,
-				  va_list argptr)
+static xmlTextWriterPtr
+start_document (xmlBuffer *buffer,
+		const xmlChar *root,
+		const xmlChar *version,
+		const xmlChar *comment)
 {
 	xmlTextWriterPtr writer;
-	EphyNode *node;
 	int ret;
 
-	START_PROFILER ("Saving node db")
-
 	/* FIXME: do we want to turn compression on ? */
 	writer = xmlNewTextWriterMemory (buffer, 0);
 	if (writer == NULL)
 	{
-		return -1;
+		return NULL;
 	}
 
 	ret = xmlTextWriterSetIndent (writer, 1);
@@ -399,6 +393,67 @@ ephy_node_db_write_to_xml_valist (EphyNodeDb *db,
 		if (ret < 0) goto out;
 	}
 
+out:
+	if (ret < 0)
+	{
+		xmlFreeTextWriter (writer);
+		return NULL;
+	}
+
+	return writer;
+}
+
+static int
+end_document (xmlTextWriterPtr writer)
+{
+	int ret;
+
+	ret = xmlTextWriterEndElement (writer); /* root */
+	if (ret < 0) return ret;
+
+	return xmlTextWriterEndDocument (writer);
+}
+
+static int
+save_buffer (const xmlChar *filename,
+	     xmlBuffer *buffer)
+{
+	GError *error = NULL;
+
+	/* g_file_set_contents() writes to a temporary file and renames it
+	 * over @filename, so readers never see a partially written file. */
+	if (g_file_set_contents ((const char *)filename, (const char *)buffer->content, buffer->use, &error) == FALSE)
+	{
+		g_warning ("Error saving EphyNodeDB as XML: %s", error->message);
+		g_error_free (error);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+ephy_node_db_write_to_xml_valist (EphyNodeDb *db,
+				  xmlBuffer *buffer,
+				  const xmlChar *root,
+				  const xmlChar *version,
+				  const xmlChar *comment,
+				  EphyNode *first_node,
+				  va_list argptr)
+{
+	xmlTextWriterPtr writer;
+	EphyNode *node;
+	int ret = 0;
+
+	START_PROFILER ("Saving node db")
+
+	writer = start_document (buffer, root, version, comment);
+	if (writer == NULL)
+	{
+		STOP_PROFILER ("Saving node db")
+		return -1;
+	}
+
 	node = first_node;
 	while (node != NULL)
 	{
@@ -429,11 +484,7 @@ ephy_node_db_write_to_xml_valist (EphyNodeDb *db,
 	}
 	if (ret < 0) goto out;
 
-	ret = xmlTextWriterEndElement (writer); /* root */
-	if (ret < 0) goto out;
-
-	ret = xmlTextWriterEndDocument (writer);
-	if (ret < 0) goto out;
+	ret = end_document (writer);
 
 out:
 	xmlFreeTextWriter (writer);
@@ -486,7 +537,6 @@ ephy_node_db_write_to_xml_safe (EphyNodeDb *db,
 {
 	va_list argptr;
 	xmlBuffer *buffer;
-	GError *error = NULL;
 	int ret = 0;
 
 	LOG ("Saving node db to %s", filename);
@@ -505,17 +555,81 @@ ephy_node_db_write_to_xml_safe (EphyNodeDb *db,
 		goto failed;
 	}
 
-	if (g_file_set_contents ((const char *)filename, (const char *)buffer->content, buffer->use, &error) == FALSE)
+	ret = save_buffer (filename, buffer);
+
+failed:
+	xmlBufferFree (buffer);
+
+	return ret;
+}
+
+/**
+ * ephy_node_db_write_snapshots_to_xml_safe:
+ * @filename: the XML file in which the data will be stored
+ * @root: the desired root element in @filename
+ * @version: the version attribute to the @root element
+ * @comment: a comment to place directly inside the @root element of @filename
+ * @snapshots: a #GPtrArray of #EphyNodeSnapshot
+ *
+ * Like ephy_node_db_write_to_xml_safe(), but writes nodes that were
+ * previously copied with ephy_node_snapshot_new(). Since no #EphyNode is
+ * accessed this can be used from a worker thread. The file is replaced
+ * atomically.
+ *
+ * Return value: %0 on success or a negative number on failure
+ **/
+int
+ephy_node_db_write_snapshots_to_xml_safe (const xmlChar *filename,
+					  const xmlChar *root,
+					  const xmlChar *version,
+					  const xmlChar *comment,
+					  GPtrArray *snapshots)
+{
+	xmlTextWriterPtr writer;
+	xmlBuffer *buffer;
+	guint i;
+	int ret = 0;
+
+	LOG ("Saving node db snapshot to %s", filename);
+
+	START_PROFILER ("Saving node db snapshot")
+
+	buffer = xmlBufferCreate ();
+	writer = start_document (buffer, root, version, comment);
+	if (writer == NULL)
 	{
-		g_warning ("Error saving EphyNodeDB as XML: %s", error->message);
-		g_error_free (error);
 		ret = -1;
+		goto failed;
+	}
+
+	for (i = 0; i < snapshots->len; i++)
+	{
+		ret = ephy_node_snapshot_write_to_xml
+			(g_ptr_array_index (snapshots, i), writer);
+		if (ret < 0) break;
 	}
 
+	if (ret >= 0)
+	{
+		ret = end_document (writer);
+	}
+
+	xmlFreeTextWriter (writer);
+
+	if (ret < 0)
+	{
+		g_warning ("Failed to write XML data");
+		goto failed;
+	}
+
+	ret = save_buffer (filename, buffer);
+
 failed:
 	xmlBufferFree (buffer);
 
-	return ret;
+	STOP_PROFILER ("Saving node db snapshot")
+
+	return ret < 0 ? -1 : 0;
 }
 
 static void
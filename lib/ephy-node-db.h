@@ -72,6 +72,13 @@ int           ephy_node_db_write_to_xml_safe	(EphyNodeDb *db,
 						 const xmlChar *comment,
 						 EphyNode *node, ...);
 
+int           ephy_node_db_write_snapshots_to_xml_safe
+						(const xmlChar *filename,
+						 const xmlChar *root,
+						 const xmlChar *version,
+						 const xmlChar *comment,
+						 GPtrArray *snapshots);
+
 const char   *ephy_node_db_get_name		(EphyNodeDb *db);
 
 gboolean      ephy_node_db_is_immutable		(EphyNodeDb *db);
@@ -43,8 +43,15 @@ enum
 struct _EphyNodeFilterPrivate
 {
 	GPtrArray *levels;
+
+	/* copy of the levels as of the last "changed" emission */
+	GPtrArray *applied_levels;
+	EphyNodeFilterChange last_change;
 };
 
+#define CHANGE_REFINES (1 << 0)
+#define CHANGE_RELAXES (1 << 1)
+
 struct _EphyNodeFilterExpression
 {
 	EphyNodeFilterExpressionType type;
@@ -75,6 +82,32 @@ static GObjectClass *parent_class = NULL;
 
 static guint ephy_node_filter_signals[LAST_SIGNAL] = { 0 };
 
+static void
+free_levels (GPtrArray *levels)
+{
+	int i;
+	
+	for (i = levels->len - 1; i >= 0; i--)
+	{
+		GList *list, *l;
+
+		list = g_ptr_array_index (levels, i);
+
+		for (l = list; l != NULL; l = g_list_next (l))
+		{
+			EphyNodeFilterExpression *exp;
+
+			exp = (EphyNodeFilterExpression *) l->data;
+
+			ephy_node_filter_expression_free (exp);
+		}
+
+		g_list_free (list);
+
+		g_ptr_array_remove_index (levels, i);
+	}
+}
+
 GType
 ephy_node_filter_get_type (void)
 {
@@ -131,6 +164,8 @@ ephy_node_filter_init (EphyNodeFilter *filter)
 	filter->priv = EPHY_NODE_FILTER_GET_PRIVATE (filter);
 
 	filter->priv->levels = g_ptr_array_new ();
+	filter->priv->applied_levels = g_ptr_array_new ();
+	filter->priv->last_change = EPHY_NODE_FILTER_CHANGE_ANY;
 }
 
 static void
@@ -139,8 +174,10 @@ ephy_node_filter_finalize (GObject *object)
 	EphyNodeFilter *filter = EPHY_NODE_FILTER (object);
 
 	ephy_node_filter_empty (filter);
+	free_levels (filter->priv->applied_levels);
 
 	g_ptr_array_free (filter->priv->levels, TRUE);
+	g_ptr_array_free (filter->priv->applied_levels, TRUE);
 
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -167,32 +204,192 @@ ephy_node_filter_add_expression (EphyNodeFilter *filter,
 void
 ephy_node_filter_empty (EphyNodeFilter *filter)
 {
-	int i;
-	
-	for (i = filter->priv->levels->len - 1; i >= 0; i--)
+	free_levels (filter->priv->levels);
+}
+
+static EphyNodeFilterExpression *
+ephy_node_filter_expression_copy (EphyNodeFilterExpression *exp)
+{
+	EphyNodeFilterExpression *copy;
+
+	copy = g_memdup (exp, sizeof (EphyNodeFilterExpression));
+
+	switch (exp->type)
 	{
-		GList *list, *l;
+	case EPHY_NODE_FILTER_EXPRESSION_STRING_PROP_CONTAINS:
+	case EPHY_NODE_FILTER_EXPRESSION_STRING_PROP_EQUALS:
+	case EPHY_NODE_FILTER_EXPRESSION_KEY_PROP_CONTAINS:
+	case EPHY_NODE_FILTER_EXPRESSION_KEY_PROP_EQUALS:
+		copy->args.prop_args.second_arg.string =
+			g_strdup (exp->args.prop_args.second_arg.string);
+		break;
+	default:
+		break;
+	}
 
-		list = g_ptr_array_index (filter->priv->levels, i);
+	return copy;
+}
 
-		for (l = list; l != NULL; l = g_list_next (l))
-		{
-			EphyNodeFilterExpression *exp;
+/*
+ * Returns CHANGE_REFINES if every node matching @new also matches @old,
+ * and CHANGE_RELAXES if every node matching @old also matches @new.
+ */
+static guint
+compare_expressions (EphyNodeFilterExpression *old,
+		     EphyNodeFilterExpression *new)
+{
+	guint ret = 0;
 
-			exp = (EphyNodeFilterExpression *) l->data;
+	if (old->type != new->type)
+		return 0;
 
-			ephy_node_filter_expression_free (exp);
+	switch (old->type)
+	{
+	case EPHY_NODE_FILTER_EXPRESSION_ALWAYS_TRUE:
+		return CHANGE_REFINES | CHANGE_RELAXES;
+	case EPHY_NODE_FILTER_EXPRESSION_NODE_EQUALS:
+	case EPHY_NODE_FILTER_EXPRESSION_EQUALS:
+	case EPHY_NODE_FILTER_EXPRESSION_HAS_PARENT:
+	case EPHY_NODE_FILTER_EXPRESSION_HAS_CHILD:
+		if (old->args.node_args.a == new->args.node_args.a &&
+		    old->args.node_args.b == new->args.node_args.b)
+			return CHANGE_REFINES | CHANGE_RELAXES;
+		return 0;
+	default:
+		break;
+	}
+
+	if (old->args.prop_args.prop_id != new->args.prop_args.prop_id)
+		return 0;
+
+	switch (old->type)
+	{
+	case EPHY_NODE_FILTER_EXPRESSION_NODE_PROP_EQUALS:
+	case EPHY_NODE_FILTER_EXPRESSION_CHILD_PROP_EQUALS:
+		if (old->args.prop_args.second_arg.node == new->args.prop_args.second_arg.node)
+			ret = CHANGE_REFINES | CHANGE_RELAXES;
+		break;
+	case EPHY_NODE_FILTER_EXPRESSION_STRING_PROP_CONTAINS:
+	case EPHY_NODE_FILTER_EXPRESSION_KEY_PROP_CONTAINS:
+		/* a longer search string only matches a subset */
+		if (strstr (new->args.prop_args.second_arg.string,
+			    old->args.prop_args.second_arg.string) != NULL)
+			ret |= CHANGE_REFINES;
+		if (strstr (old->args.prop_args.second_arg.string,
+			    new->args.prop_args.second_arg.string) != NULL)
+			ret |= CHANGE_RELAXES;
+		break;
+	case EPHY_NODE_FILTER_EXPRESSION_STRING_PROP_EQUALS:
+	case EPHY_NODE_FILTER_EXPRESSION_KEY_PROP_EQUALS:
+		if (strcmp (old->args.prop_args.second_arg.string,
+			    new->args.prop_args.second_arg.string) == 0)
+			ret = CHANGE_REFINES | CHANGE_RELAXES;
+		break;
+	case EPHY_NODE_FILTER_EXPRESSION_INT_PROP_EQUALS:
+		if (old->args.prop_args.second_arg.number == new->args.prop_args.second_arg.number)
+			ret = CHANGE_REFINES | CHANGE_RELAXES;
+		break;
+	case EPHY_NODE_FILTER_EXPRESSION_INT_PROP_BIGGER_THAN:
+		if (new->args.prop_args.second_arg.number >= old->args.prop_args.second_arg.number)
+			ret |= CHANGE_REFINES;
+		if (new->args.prop_args.second_arg.number <= old->args.prop_args.second_arg.number)
+			ret |= CHANGE_RELAXES;
+		break;
+	case EPHY_NODE_FILTER_EXPRESSION_INT_PROP_LESS_THAN:
+		if (new->args.prop_args.second_arg.number <= old->args.prop_args.second_arg.number)
+			ret |= CHANGE_REFINES;
+		if (new->args.prop_args.second_arg.number >= old->args.prop_args.second_arg.number)
+			ret |= CHANGE_RELAXES;
+		break;
+	default:
+		break;
+	}
+
+	return ret;
+}
+
+/*
+ * Levels are ANDed and the expressions of a level are ORed, so the
+ * whole filter is refined (relaxed) if each expression is refined
+ * (relaxed) relative to the one at the same place in the old filter.
+ * An empty level matches everything.
+ */
+static EphyNodeFilterChange
+compare_levels (GPtrArray *old_levels,
+		GPtrArray *new_levels)
+{
+	guint i, n_levels;
+	guint ret = CHANGE_REFINES | CHANGE_RELAXES;
+
+	n_levels = MAX (old_levels->len, new_levels->len);
+
+	for (i = 0; i < n_levels && ret != 0; i++)
+	{
+		GList *old_list = NULL, *new_list = NULL;
+		GList *o, *n;
+
+		if (i < old_levels->len)
+			old_list = g_ptr_array_index (old_levels, i);
+		if (i < new_levels->len)
+			new_list = g_ptr_array_index (new_levels, i);
+
+		if (old_list == NULL && new_list == NULL)
+			continue;
+
+		if (old_list == NULL)
+		{
+			ret &= CHANGE_REFINES;
+			continue;
 		}
 
-		g_list_free (list);
+		if (new_list == NULL)
+		{
+			ret &= CHANGE_RELAXES;
+			continue;
+		}
 
-		g_ptr_array_remove_index (filter->priv->levels, i);
+		for (o = old_list, n = new_list;
+		     o != NULL && n != NULL && ret != 0;
+		     o = o->next, n = n->next)
+		{
+			ret &= compare_expressions (o->data, n->data);
+		}
+
+		if (o != NULL || n != NULL)
+			ret = 0;
 	}
+
+	if (ret & CHANGE_REFINES)
+		return EPHY_NODE_FILTER_CHANGE_REFINED;
+	if (ret & CHANGE_RELAXES)
+		return EPHY_NODE_FILTER_CHANGE_RELAXED;
+
+	return EPHY_NODE_FILTER_CHANGE_ANY;
 }
 
 void
 ephy_node_filter_done_changing (EphyNodeFilter *filter)
 {
+	EphyNodeFilterPrivate *priv = filter->priv;
+	guint i;
+
+	priv->last_change = compare_levels (priv->applied_levels, priv->levels);
+
+	free_levels (priv->applied_levels);
+	for (i = 0; i < priv->levels->len; i++)
+	{
+		GList *list, *l, *copy = NULL;
+
+		list = g_ptr_array_index (priv->levels, i);
+
+		for (l = list; l != NULL; l = g_list_next (l))
+		{
+			copy = g_list_prepend (copy, ephy_node_filter_expression_copy (l->data));
+		}
+
+		g_ptr_array_add (priv->applied_levels, g_list_reverse (copy));
+	}
+
 	g_signal_emit (G_OBJECT (filter), ephy_node_filter_signals[CHANGED], 0);
 }
 
@@ -230,6 +427,25 @@ ephy_node_filter_evaluate (EphyNodeFilter *filter,
 	return TRUE;
 }
 
+/**
+ * ephy_node_filter_get_last_change:
+ * @filter: an #EphyNodeFilter
+ *
+ * Tells how the set of nodes matched by @filter changed the last time
+ * ephy_node_filter_done_changing() was called. Views can use this to
+ * re-evaluate only the nodes whose state may have changed, e.g. only
+ * the matching ones when a search string gets longer.
+ *
+ * Returns: the #EphyNodeFilterChange of the last change
+ **/
+EphyNodeFilterChange
+ephy_node_filter_get_last_change (EphyNodeFilter *filter)
+{
+	g_return_val_if_fail (EPHY_IS_NODE_FILTER (filter), EPHY_NODE_FILTER_CHANGE_ANY);
+
+	return filter->priv->last_change;
+}
+
 EphyNodeFilterExpression *
 ephy_node_filter_expression_new (EphyNodeFilterExpressionType type,
 			         ...)
@@ -359,38 +575,25 @@ ephy_node_filter_expression_evaluate (EphyNodeFilterExpression *exp,
 	}
 	case EPHY_NODE_FILTER_EXPRESSION_STRING_PROP_CONTAINS:
 	{
-		const char *prop;
-		char *folded_case;
-		gboolean ret;
+		const char *folded_case;
 
-		prop = ephy_node_get_property_string (node,
-						    exp->args.prop_args.prop_id);
-		if (prop == NULL)
+		folded_case = ephy_node_get_property_casefold
+			(node, exp->args.prop_args.prop_id);
+		if (folded_case == NULL)
 			return FALSE;
 
-		folded_case = g_utf8_casefold (prop, -1);
-		ret = (strstr (folded_case, exp->args.prop_args.second_arg.string) != NULL);
-		g_free (folded_case);
-
-		return ret;
+		return (strstr (folded_case, exp->args.prop_args.second_arg.string) != NULL);
 	}
 	case EPHY_NODE_FILTER_EXPRESSION_STRING_PROP_EQUALS:
 	{
-		const char *prop;
-		char *folded_case;
-		gboolean ret;
-
-		prop = ephy_node_get_property_string (node,
-						    exp->args.prop_args.prop_id);
+		const char *folded_case;
 
-		if (prop == NULL)
+		folded_case = ephy_node_get_property_casefold
+			(node, exp->args.prop_args.prop_id);
+		if (folded_case == NULL)
 			return FALSE;
 
-		folded_case = g_utf8_casefold (prop, -1);
-		ret = (strcmp (folded_case, exp->args.prop_args.second_arg.string) == 0);
-		g_free (folded_case);
-
-		return ret;
+		return (strcmp (folded_case, exp->args.prop_args.second_arg.string) == 0);
 	}
 	case EPHY_NODE_FILTER_EXPRESSION_KEY_PROP_CONTAINS:
 	{
@@ -75,6 +75,13 @@ typedef enum
 
 typedef struct _EphyNodeFilterExpression EphyNodeFilterExpression;
 
+typedef enum
+{
+	EPHY_NODE_FILTER_CHANGE_ANY,     /* any node may have changed */
+	EPHY_NODE_FILTER_CHANGE_REFINED, /* only matching nodes may stop matching */
+	EPHY_NODE_FILTER_CHANGE_RELAXED  /* only non-matching nodes may start matching */
+} EphyNodeFilterChange;
+
 /* The filter starts iterating over all expressions at level 0,
  * if one of them is TRUE it continues to level 1, etc.
  * If it still has TRUE when there are no more expressions at the
@@ -96,6 +103,8 @@ void            ephy_node_filter_done_changing  (EphyNodeFilter *filter);
 gboolean        ephy_node_filter_evaluate       (EphyNodeFilter *filter,
 					         EphyNode *node);
 
+EphyNodeFilterChange ephy_node_filter_get_last_change (EphyNodeFilter *filter);
+
 EphyNodeFilterExpression *ephy_node_filter_expression_new  (EphyNodeFilterExpressionType,
 						            ...);
 /* no need to free unless you didn't add the expression to a filter */
@@ -60,6 +60,7 @@ struct _EphyNode
 	guint id;
 
 	GPtrArray *properties;
+	GPtrArray *string_keys;
 
 	GHashTable *parents;
 	GPtrArray *children;
@@ -80,6 +81,15 @@ typedef struct
 	va_list valist;
 } ENESCData;
 
+/* Forms of a string property used to sort and filter nodes, computed
+ * the first time they are asked for and dropped when the property
+ * changes. */
+typedef struct
+{
+	char *casefold;
+	char *collate_key;
+} EphyNodeStringKeys;
+
 static gboolean
 int_equal (gconstpointer a,
 	   gconstpointer b)
@@ -282,6 +292,16 @@ node_parent_free (EphyNodeParent *parent)
 	g_slice_free (EphyNodeParent, parent);
 }
 
+static void
+free_string_keys (EphyNodeStringKeys *keys)
+{
+	if (keys == NULL) return;
+
+	g_free (keys->casefold);
+	g_free (keys->collate_key);
+	g_slice_free (EphyNodeStringKeys, keys);
+}
+
 static void
 ephy_node_destroy (EphyNode *node)
 {
@@ -312,6 +332,13 @@ ephy_node_destroy (EphyNode *node)
 	_ephy_node_db_remove_id (node->db, node->id);
 
         /* Remove properties. */
+	if (node->string_keys != NULL) {
+		for (i = 0; i < node->string_keys->len; i++) {
+			free_string_keys (g_ptr_array_index (node->string_keys, i));
+		}
+		g_ptr_array_free (node->string_keys, TRUE);
+	}
+
 	for (i = 0; i < node->properties->len; i++) {
 		GValue *val;
 
@@ -452,6 +479,11 @@ real_set_property (EphyNode *node,
 	}
 
 	g_ptr_array_index (node->properties, property_id) = value;
+
+	if (node->string_keys != NULL && property_id < node->string_keys->len) {
+		free_string_keys (g_ptr_array_index (node->string_keys, property_id));
+		g_ptr_array_index (node->string_keys, property_id) = NULL;
+	}
 }
 
 static inline void
@@ -522,6 +554,87 @@ ephy_node_get_property (EphyNode *node,
 	return TRUE;
 }
 
+static EphyNodeStringKeys *
+get_string_keys (EphyNode *node,
+		 guint property_id)
+{
+	EphyNodeStringKeys *keys;
+	const char *string;
+
+	string = ephy_node_get_property_string (node, property_id);
+	if (string == NULL) return NULL;
+
+	if (node->string_keys == NULL) {
+		node->string_keys = g_ptr_array_new ();
+	}
+	if (property_id >= node->string_keys->len) {
+		g_ptr_array_set_size (node->string_keys, property_id + 1);
+	}
+
+	keys = g_ptr_array_index (node->string_keys, property_id);
+	if (keys == NULL) {
+		keys = g_slice_new0 (EphyNodeStringKeys);
+		keys->casefold = g_utf8_casefold (string, -1);
+		g_ptr_array_index (node->string_keys, property_id) = keys;
+	}
+
+	return keys;
+}
+
+/**
+ * ephy_node_get_property_casefold:
+ * @node: an #EphyNode
+ * @property_id: the identifier of a string property
+ *
+ * Returns the string property @property_id of @node, casefolded with
+ * g_utf8_casefold(). The result is cached until the property changes,
+ * so this is cheap to call repeatedly when filtering nodes.
+ *
+ * Returns: the casefolded property, or %NULL if it is not set
+ **/
+const char *
+ephy_node_get_property_casefold (EphyNode *node,
+				 guint property_id)
+{
+	EphyNodeStringKeys *keys;
+
+	g_return_val_if_fail (EPHY_IS_NODE (node), NULL);
+
+	keys = get_string_keys (node, property_id);
+
+	return keys ? keys->casefold : NULL;
+}
+
+/**
+ * ephy_node_get_property_collate_key:
+ * @node: an #EphyNode
+ * @property_id: the identifier of a string property
+ *
+ * Returns the g_utf8_collate_key() of the casefolded string property
+ * @property_id of @node. Comparing two of these keys with strcmp()
+ * orders the properties like g_utf8_collate() would order their
+ * casefolded values. The result is cached until the property changes.
+ *
+ * Returns: the collation key, or %NULL if the property is not set
+ **/
+const char *
+ephy_node_get_property_collate_key (EphyNode *node,
+				    guint property_id)
+{
+	EphyNodeStringKeys *keys;
+
+	g_return_val_if_fail (EPHY_IS_NODE (node), NULL);
+
+	keys = get_string_keys (node, property_id);
+	if (keys == NULL) return NULL;
+
+	if (keys->collate_key == NULL) {
+		keys->collate_key = g_utf8_collate_key (keys->casefold, -1);
+	}
+
+	return keys->collate_key;
+}
+
 void
 ephy_node_set_property_string (EphyNode *node,
 			       guint property_id,
@@ -802,27 +915,33 @@ typedef struct
 	int ret;
 } ForEachData;
 
+static int
+write_parent_id (xmlTextWriterPtr writer,
+		 guint id)
+{
+	int ret;
+
+	ret = xmlTextWriterStartElement (writer, (const xmlChar *)"parent");
+	if (ret < 0) return ret;
+
+	ret = xmlTextWriterWriteFormatAttribute
+			(writer, (const xmlChar *)"id", "%d", id);
+	if (ret < 0) return ret;
+
+	return xmlTextWriterEndElement (writer); /* parent */
+}
+
 static void
 write_parent (guint id,
 	      EphyNodeParent *node_info,
 	      ForEachData* data)
 {
-	xmlTextWriterPtr writer = data->writer;
-
 	/* there already was an error, do nothing. this works around
 	 * the fact that g_hash_table_foreach cannot be cancelled.
 	 */
 	if (data->ret < 0) return;
 
-	data->ret = xmlTextWriterStartElement (writer, (const xmlChar *)"parent");
-	if (data->ret < 0) return;
-
-	data->ret = xmlTextWriterWriteFormatAttribute
-			(writer, (const xmlChar *)"id", "%d", node_info->node->id);
-	if (data->ret < 0) return;
-
-	data->ret = xmlTextWriterEndElement (writer); /* parent */
-	if (data->ret < 0) return;
+	data->ret = write_parent_id (data->writer, node_info->node->id);
 }
 
 static inline int
@@ -857,32 +976,19 @@ safe_write_string (xmlTextWriterPtr writer,
 	return ret;
 }
 
-int
-ephy_node_write_to_xml(EphyNode *node,
-		       xmlTextWriterPtr writer)
+static int
+write_properties (GPtrArray *properties,
+		  xmlTextWriterPtr writer)
 {
 	xmlChar xml_buf[G_ASCII_DTOSTR_BUF_SIZE];
 	guint i;
-	int ret;
-	ForEachData data;
+	int ret = 0;
 
-	g_return_val_if_fail (EPHY_IS_NODE (node), -1);
-	g_return_val_if_fail (writer != NULL, -1);
-
-	/* start writing the node */
-	ret = xmlTextWriterStartElement (writer, (const xmlChar *)"node");
-	if (ret < 0) goto out;
-
-	/* write node id */
-	ret = xmlTextWriterWriteFormatAttribute (writer, (const xmlChar *)"id", "%d", node->id);
-	if (ret < 0) goto out;
-
-	/* write node properties */
-	for (i = 0; i < node->properties->len; i++)
+	for (i = 0; i < properties->len; i++)
 	{
 		GValue *value;
 
-		value = g_ptr_array_index (node->properties, i);
+		value = g_ptr_array_index (properties, i);
 
 		if (value == NULL) continue;
 		if (G_VALUE_TYPE (value) == G_TYPE_STRING &&
@@ -895,7 +1001,7 @@ ephy_node_write_to_xml(EphyNode *node,
 		if (ret < 0) break;
 
 		ret = xmlTextWriterWriteAttribute
-			(writer, (const xmlChar *)"value_type", 
+			(writer, (const xmlChar *)"value_type",
 			 (const xmlChar *)g_type_name (G_VALUE_TYPE (value)));
 		if (ret < 0) break;
 
@@ -918,7 +1024,7 @@ ephy_node_write_to_xml(EphyNode *node,
 				(writer, "%ld", g_value_get_long (value));
 			break;
 		case G_TYPE_FLOAT:
-			g_ascii_dtostr ((gchar *)xml_buf, sizeof (xml_buf), 
+			g_ascii_dtostr ((gchar *)xml_buf, sizeof (xml_buf),
 					g_value_get_float (value));
 			ret = xmlTextWriterWriteString (writer, xml_buf);
 			break;
@@ -932,10 +1038,34 @@ ephy_node_write_to_xml(EphyNode *node,
 			break;
 		}
 		if (ret < 0) break;
-	
+
 		ret = xmlTextWriterEndElement (writer); /* property */
 		if (ret < 0) break;
 	}
+
+	return ret;
+}
+
+int
+ephy_node_write_to_xml(EphyNode *node,
+		       xmlTextWriterPtr writer)
+{
+	int ret;
+	ForEachData data;
+
+	g_return_val_if_fail (EPHY_IS_NODE (node), -1);
+	g_return_val_if_fail (writer != NULL, -1);
+
+	/* start writing the node */
+	ret = xmlTextWriterStartElement (writer, (const xmlChar *)"node");
+	if (ret < 0) goto out;
+
+	/* write node id */
+	ret = xmlTextWriterWriteFormatAttribute (writer, (const xmlChar *)"id", "%d", node->id);
+	if (ret < 0) goto out;
+
+	/* write node properties */
+	ret = write_properties (node->properties, writer);
 	if (ret < 0) goto out;
 
 	/* now write parent node ids */
@@ -955,6 +1085,225 @@ out:
 	return ret >= 0 ? 0 : -1;
 }
 
+struct _EphyNodeSnapshot
+{
+	guint id;
+	GPtrArray *properties;
+	guint *parents;
+	guint n_parents;
+};
+
+static void
+free_snapshot_value (GValue *value)
+{
+	if (value == NULL) return;
+
+	g_value_unset (value);
+	g_slice_free (GValue, value);
+}
+
+static int
+compare_ids (gconstpointer a,
+	     gconstpointer b)
+{
+	guint id_a = *(const guint *) a;
+	guint id_b = *(const guint *) b;
+
+	return id_a < id_b ? -1 : id_a > id_b;
+}
+
+/**
+ * ephy_node_snapshot_new:
+ * @node: an #EphyNode
+ *
+ * Copies the id, the properties and the parent ids of @node into a
+ * structure that no longer references the node or its #EphyNodeDb.
+ * The snapshot can be handed to another thread and written out with
+ * ephy_node_snapshot_write_to_xml() while @node keeps changing.
+ *
+ * Returns: a new #EphyNodeSnapshot, free it with ephy_node_snapshot_free()
+ **/
+EphyNodeSnapshot *
+ephy_node_snapshot_new (EphyNode *node)
+{
+	EphyNodeSnapshot *snapshot;
+	GHashTableIter iter;
+	gpointer key;
+	guint i;
+
+	g_return_val_if_fail (EPHY_IS_NODE (node), NULL);
+
+	snapshot = g_slice_new0 (EphyNodeSnapshot);
+	snapshot->id = node->id;
+
+	snapshot->properties = g_ptr_array_new_full (node->properties->len,
+						     (GDestroyNotify) free_snapshot_value);
+	for (i = 0; i < node->properties->len; i++)
+	{
+		GValue *value, *copy = NULL;
+
+		value = g_ptr_array_index (node->properties, i);
+		if (value != NULL)
+		{
+			copy = g_slice_new0 (GValue);
+			g_value_init (copy, G_VALUE_TYPE (value));
+			g_value_copy (value, copy);
+		}
+
+		g_ptr_array_add (snapshot->properties, copy);
+	}
+
+	snapshot->n_parents = g_hash_table_size (node->parents);
+	snapshot->parents = g_new (guint, snapshot->n_parents);
+
+	i = 0;
+	g_hash_table_iter_init (&iter, node->parents);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+	{
+		snapshot->parents[i++] = GPOINTER_TO_UINT (key);
+	}
+	qsort (snapshot->parents, snapshot->n_parents, sizeof (guint), compare_ids);
+
+	return snapshot;
+}
+
+/**
+ * ephy_node_snapshot_free:
+ * @snapshot: an #EphyNodeSnapshot
+ *
+ * Frees @snapshot and the property values it holds.
+ **/
+void
+ephy_node_snapshot_free (EphyNodeSnapshot *snapshot)
+{
+	if (snapshot == NULL) return;
+
+	g_ptr_array_free (snapshot->properties, TRUE);
+	g_free (snapshot->parents);
+	g_slice_free (EphyNodeSnapshot, snapshot);
+}
+
+guint
+ephy_node_snapshot_get_id (EphyNodeSnapshot *snapshot)
+{
+	g_return_val_if_fail (snapshot != NULL, 0);
+
+	return snapshot->id;
+}
+
+static GValue *
+snapshot_get_value (EphyNodeSnapshot *snapshot,
+		    guint property_id,
+		    GType type)
+{
+	GValue *value;
+
+	if (property_id >= snapshot->properties->len) return NULL;
+
+	value = g_ptr_array_index (snapshot->properties, property_id);
+	if (value == NULL || G_VALUE_TYPE (value) != type) return NULL;
+
+	return value;
+}
+
+const char *
+ephy_node_snapshot_get_property_string (EphyNodeSnapshot *snapshot,
+					guint property_id)
+{
+	GValue *value;
+
+	g_return_val_if_fail (snapshot != NULL, NULL);
+
+	value = snapshot_get_value (snapshot, property_id, G_TYPE_STRING);
+
+	return value ? g_value_get_string (value) : NULL;
+}
+
+int
+ephy_node_snapshot_get_property_int (EphyNodeSnapshot *snapshot,
+				     guint property_id)
+{
+	GValue *value;
+
+	g_return_val_if_fail (snapshot != NULL, -1);
+
+	value = snapshot_get_value (snapshot, property_id, G_TYPE_INT);
+
+	return value ? g_value_get_int (value) : -1;
+}
+
+/**
+ * ephy_node_snapshot_has_parent:
+ * @snapshot: an #EphyNodeSnapshot
+ * @parent_id: the id of a node
+ *
+ * Returns: %TRUE if the node with id @parent_id was a parent of the
+ * snapshotted node when the snapshot was taken
+ **/
+gboolean
+ephy_node_snapshot_has_parent (EphyNodeSnapshot *snapshot,
+			       guint parent_id)
+{
+	g_return_val_if_fail (snapshot != NULL, FALSE);
+
+	return bsearch (&parent_id, snapshot->parents, snapshot->n_parents,
+			sizeof (guint), compare_ids) != NULL;
+}
+
+const guint *
+ephy_node_snapshot_get_parents (EphyNodeSnapshot *snapshot,
+				guint *n_parents)
+{
+	g_return_val_if_fail (snapshot != NULL, NULL);
+	g_return_val_if_fail (n_parents != NULL, NULL);
+
+	*n_parents = snapshot->n_parents;
+
+	return snapshot->parents;
+}
+
+/**
+ * ephy_node_snapshot_write_to_xml:
+ * @snapshot: an #EphyNodeSnapshot
+ * @writer: the #xmlTextWriterPtr to write to
+ *
+ * Writes @snapshot in the same format as ephy_node_write_to_xml(). Unlike
+ * the latter this does not touch any #EphyNode, so it may be called from
+ * any thread.
+ *
+ * Returns: 0 on success, -1 on failure
+ **/
+int
+ephy_node_snapshot_write_to_xml (EphyNodeSnapshot *snapshot,
+				 xmlTextWriterPtr writer)
+{
+	guint i;
+	int ret;
+
+	g_return_val_if_fail (snapshot != NULL, -1);
+	g_return_val_if_fail (writer != NULL, -1);
+
+	ret = xmlTextWriterStartElement (writer, (const xmlChar *)"node");
+	if (ret < 0) goto out;
+
+	ret = xmlTextWriterWriteFormatAttribute (writer, (const xmlChar *)"id", "%d", snapshot->id);
+	if (ret < 0) goto out;
+
+	ret = write_properties (snapshot->properties, writer);
+	if (ret < 0) goto out;
+
+	for (i = 0; i < snapshot->n_parents; i++)
+	{
+		ret = write_parent_id (writer, snapshot->parents[i]);
+		if (ret < 0) goto out;
+	}
+
+	ret = xmlTextWriterEndElement (writer); /* node */
+
+out:
+	return ret >= 0 ? 0 : -1;
+}
+
 static inline void
 real_add_child (EphyNode *node,
 		EphyNode *child)
@@ -35,6 +35,7 @@ G_BEGIN_DECLS
 #define EPHY_IS_NODE(o)	(o != NULL)
 
 typedef struct _EphyNode EphyNode;
+typedef struct _EphyNodeSnapshot EphyNodeSnapshot;
 
 typedef enum
 {
@@ -95,6 +96,11 @@ const char *ephy_node_get_property_string   (EphyNode *node,
 void        ephy_node_set_property_string   (EphyNode *node,
 					     guint property_id,
 					     const char *value);
+const char *ephy_node_get_property_casefold (EphyNode *node,
+					     guint property_id);
+const char *ephy_node_get_property_collate_key
+					    (EphyNode *node,
+					     guint property_id);
 gboolean    ephy_node_get_property_boolean  (EphyNode *node,
 					     guint property_id);
 void        ephy_node_set_property_boolean  (EphyNode *node,
@@ -129,6 +135,25 @@ int           ephy_node_write_to_xml	    (EphyNode *node,
 EphyNode     *ephy_node_new_from_xml        (EphyNodeDb *db,
 					     xmlNodePtr xml_node);
 
+/* immutable copies, safe to serialize off the main thread */
+EphyNodeSnapshot *ephy_node_snapshot_new   (EphyNode *node);
+void          ephy_node_snapshot_free       (EphyNodeSnapshot *snapshot);
+guint         ephy_node_snapshot_get_id     (EphyNodeSnapshot *snapshot);
+const char   *ephy_node_snapshot_get_property_string
+					    (EphyNodeSnapshot *snapshot,
+					     guint property_id);
+int           ephy_node_snapshot_get_property_int
+					    (EphyNodeSnapshot *snapshot,
+					     guint property_id);
+gboolean      ephy_node_snapshot_has_parent (EphyNodeSnapshot *snapshot,
+					     guint parent_id);
+const guint  *ephy_node_snapshot_get_parents
+					    (EphyNodeSnapshot *snapshot,
+					     guint *n_parents);
+int           ephy_node_snapshot_write_to_xml
+					    (EphyNodeSnapshot *snapshot,
+					     xmlTextWriterPtr writer);
+
 /* DAG structure */
 void          ephy_node_add_child           (EphyNode *node,
 					     EphyNode *child);
@@ -124,6 +124,9 @@ typedef enum
 #define EPHY_PREFS_INTERNAL_VIEW_SOURCE           "internal-view-source"
 #define EPHY_PREFS_RESTORE_SESSION_POLICY         "restore-session-policy"
 #define EPHY_PREFS_RESTORE_SESSION_DELAYING_LOADS "restore-session-delaying-loads"
+#define EPHY_PREFS_MAX_CONCURRENT_TAB_LOADS       "max-concurrent-tab-loads"
+#define EPHY_PREFS_HISTORY_MAX_AGE_DAYS           "history-max-age-days"
+#define EPHY_PREFS_HISTORY_MAX_VISITS             "history-max-visits"
 
 #define EPHY_PREFS_LOCKDOWN_SCHEMA            "org.gnome.Epiphany.lockdown"
 #define EPHY_PREFS_LOCKDOWN_FULLSCREEN        "disable-fullscreen"
@@ -35,6 +35,7 @@
 #include "ephy-debug.h"
 #include "ephy-file-helpers.h"
 #include "ephy-form-auth-data.h"
+#include "ephy-history-import.h"
 #include "ephy-history-service.h"
 #include "ephy-profile-utils.h"
 #include "ephy-settings.h"
@@ -416,150 +417,21 @@ migrate_passwords2 (void)
 
 /* History migration */
 
-static EphyHistoryService *history_service = NULL;
-static gboolean all_done = FALSE;
-
-typedef struct {
-  char *title;
-  char *location;
-  char *current;
-  long long int visit_count;
-  long long int last_visit;
-  long long int first_visit;
-  double zoom_level;
-  GList *visits;
-} HistoryParseData;
-
-static void
-history_parse_start_element (GMarkupParseContext *context,
-                             const char          *element_name,
-                             const char         **attribute_names,
-                             const char         **attribute_values,
-                             gpointer             user_data,
-                             GError             **error)
-{
-  HistoryParseData *parse_data = user_data;
-
-  if (g_str_equal (element_name, "node") && parse_data) {
-    /* Starting a new node, reset all values */
-    g_free (parse_data->title);
-    parse_data->title = NULL;
-
-    g_free (parse_data->location);
-    parse_data->location = NULL;
-
-    parse_data->visit_count = 0;
-    parse_data->last_visit = 0;
-    parse_data->first_visit = 0;
-    parse_data->zoom_level = 1.0;
-  } else if (g_str_equal (element_name, "property")) {
-    const char **name, **value;
-
-    for (name = attribute_names, value = attribute_values; *name; name++, value++) {
-      if (g_str_equal (*name, "id")) {
-        parse_data->current = g_strdup (*value);
-        break;
-      }
-    }
-  }
-}
-
-static void
-history_parse_text (GMarkupParseContext *context,
-                    const char          *text,
-                    gsize                text_len,
-                    gpointer             user_data,
-                    GError             **error)
-{
-  HistoryParseData *parse_data = user_data;
-
-  if (!parse_data || ! parse_data->current)
-    return;
-
-  if (g_str_equal (parse_data->current, "2")) {
-    /* Title */
-    parse_data->title = g_strndup (text, text_len);
-  } else if (g_str_equal (parse_data->current, "3")) {
-    /* Location */
-    parse_data->location = g_strndup (text, text_len);
-  } else if (g_str_equal (parse_data->current, "4")) {
-    /* Visit count */
-    GString *data = g_string_new_len (text, text_len);
-    sscanf (data->str, "%lld", &parse_data->visit_count);
-    g_string_free (data, TRUE);
-  } else if (g_str_equal (parse_data->current, "5")) {
-    /* Last visit */
-    GString *data = g_string_new_len (text, text_len);
-    sscanf (data->str, "%lld", &parse_data->last_visit);
-    g_string_free (data, TRUE);
-  } else if (g_str_equal (parse_data->current, "6")) {
-    /* First visit */
-    GString *data = g_string_new_len (text, text_len);
-    sscanf (data->str, "%lld", &parse_data->first_visit);
-    g_string_free (data, TRUE);
-  } else if (g_str_equal (parse_data->current, "10")) {
-    /* Zoom level. */
-    GString *data = g_string_new_len (text, text_len);
-    sscanf (data->str, "%lf", &parse_data->zoom_level);
-    g_string_free (data, TRUE);
-  }
-
-  g_free (parse_data->current);
-  parse_data->current = NULL;
-}
-
 static void
-visit_cb (EphyHistoryService *service, gboolean success, gpointer result, gpointer user_data)
+history_import_progress_cb (goffset current_num_bytes,
+                            goffset total_num_bytes,
+                            gpointer user_data)
 {
-  all_done = TRUE;
+  LOG ("Migrated %" G_GOFFSET_FORMAT " of %" G_GOFFSET_FORMAT " bytes of history",
+       current_num_bytes, total_num_bytes);
 }
 
-static void
-history_parse_end_element (GMarkupParseContext *context,
-                           const char          *element_name,
-                           gpointer             user_data,
-                           GError             **error)
-{
-  HistoryParseData *parse_data = user_data;
-
-  if (g_str_equal (element_name, "node") && parse_data) {
-    /* Add one item to History */
-    EphyHistoryPageVisit *visit = ephy_history_page_visit_new (parse_data->location ? parse_data->location : "",
-                                                               parse_data->last_visit, EPHY_PAGE_VISIT_TYPED);
-    g_free (visit->url->title);
-    visit->url->title = g_strdup (parse_data->title);
-
-    if (parse_data->zoom_level != 1.0) {
-      /* Zoom levels are only stored per host in the old history, so
-       * creating a new host here is OK. */
-      g_assert (!visit->url->host);
-      visit->url->host = ephy_history_host_new (parse_data->location, parse_data->title,
-                                                parse_data->visit_count, parse_data->zoom_level);
-    }
-
-    parse_data->visits = g_list_append (parse_data->visits, visit);
-  }
-}
-
-static GMarkupParser history_parse_funcs =
-{
-  history_parse_start_element,
-  history_parse_end_element,
-  history_parse_text,
-  NULL,
-  NULL,
-};
-
 static void
 migrate_history (void)
 {
-  GFileInputStream *input;
-  GMarkupParseContext *context;
+  EphyHistoryService *history_service;
   GError *error = NULL;
-  GFile *file;
   char *filename;
-  char buffer[1024];
-  HistoryParseData parse_data;
 
   gchar *temporary_file = g_build_filename (ephy_dot_dir (), EPHY_HISTORY_FILE, NULL);
   /* Do nothing if the history file already exists. Safer than wiping
@@ -573,51 +445,20 @@ migrate_history (void)
   history_service = ephy_history_service_new (temporary_file);
   g_free (temporary_file);
 
-  memset (&parse_data, 0, sizeof (HistoryParseData));
-  parse_data.location = NULL;
-  parse_data.title = NULL;
-  parse_data.visits = NULL;
-
   filename = g_build_filename (ephy_dot_dir (),
                                "ephy-history.xml",
                                NULL);
 
-  file = g_file_new_for_path (filename);
-  g_free (filename);
-
-  input = g_file_read (file, NULL, &error);
-  g_object_unref (file);
-
-  if (error) {
-    if (error->code != G_IO_ERROR_NOT_FOUND)
+  if (!ephy_history_import_legacy_file (history_service, filename,
+                                        history_import_progress_cb, NULL,
+                                        &error)) {
+    if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
       g_warning ("Could not load Epiphany history data, migration aborted: %s", error->message);
 
     g_error_free (error);
-    return;
-  }
-
-  context = g_markup_parse_context_new (&history_parse_funcs, 0, &parse_data, NULL);
-  while (TRUE) {
-    gssize count = g_input_stream_read (G_INPUT_STREAM (input), buffer, sizeof (buffer), NULL, &error);
-    if (count <= 0)
-      break;
-
-    if (!g_markup_parse_context_parse (context, buffer, count, &error))
-      break;
-  }
-
-  g_markup_parse_context_free (context);
-  g_input_stream_close (G_INPUT_STREAM (input), NULL, NULL);
-  g_object_unref (input);
-
-  if (parse_data.visits) {
-    ephy_history_service_add_visits (history_service, parse_data.visits, NULL, (EphyHistoryJobCallback)visit_cb, NULL);
-    ephy_history_page_visit_list_free (parse_data.visits);
-
-    while (!all_done)
-      g_main_context_iteration (NULL, FALSE);
   }
 
+  g_free (filename);
   g_object_unref (history_service);
 }
 
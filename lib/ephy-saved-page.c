@@ -0,0 +1,384 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+#include "ephy-saved-page.h"
+
+#include <libsoup/soup.h>
+#include <string.h>
+
+/**
+ * SECTION:ephy-saved-page
+ * @short_description: Local copies of the resources of a saved page
+ *
+ * Keeps track of the files the resources of a page are saved to, and
+ * points the references in the saved document to them. Resources are
+ * saved once per URI, and resources with identical data share a file.
+ * URIs are compared in the form libsoup writes them, so references
+ * spelled differently but resolving to the same resource match.
+ */
+
+/* Whitespace allowed around a reference, e.g. url( foo.png ). */
+#define MAX_PADDING 16
+
+struct _EphySavedPage {
+  SoupURI *base_uri;
+  char *directory_href;
+  GHashTable *uri_to_href;
+  GHashTable *checksum_to_href;
+  GHashTable *names;
+  gsize max_uri_length;
+};
+
+/* Returns @uri resolved against @base, as libsoup writes it, or %NULL
+ * if it is not a valid URI. */
+static char *
+resolve_uri (SoupURI *base,
+             const char *uri)
+{
+  SoupURI *soup_uri;
+  char *resolved = NULL;
+
+  soup_uri = soup_uri_new_with_base (base, uri);
+  if (!soup_uri)
+    return NULL;
+
+  if (soup_uri->scheme)
+    resolved = soup_uri_to_string (soup_uri, FALSE);
+  soup_uri_free (soup_uri);
+
+  return resolved;
+}
+
+/**
+ * ephy_saved_page_new:
+ * @document_uri: the URI of the document being saved, which relative
+ * references are resolved against
+ * @directory_href: the escaped, relative reference to the directory the
+ * resources are saved to
+ *
+ * Returns: a new #EphySavedPage
+ **/
+EphySavedPage *
+ephy_saved_page_new (const char *document_uri,
+                     const char *directory_href)
+{
+  EphySavedPage *page;
+
+  g_return_val_if_fail (document_uri, NULL);
+  g_return_val_if_fail (directory_href, NULL);
+
+  page = g_slice_new0 (EphySavedPage);
+  page->base_uri = soup_uri_new (document_uri);
+  page->directory_href = g_strdup (directory_href);
+  page->uri_to_href = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  page->checksum_to_href = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  page->names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  return page;
+}
+
+void
+ephy_saved_page_free (EphySavedPage *page)
+{
+  if (page->base_uri)
+    soup_uri_free (page->base_uri);
+  g_free (page->directory_href);
+  g_hash_table_destroy (page->uri_to_href);
+  g_hash_table_destroy (page->checksum_to_href);
+  g_hash_table_destroy (page->names);
+  g_slice_free (EphySavedPage, page);
+}
+
+/* Returns an escaped file name for @uri that no other resource of the
+ * page uses yet. */
+static char *
+get_unique_name (EphySavedPage *page,
+                 const char *uri)
+{
+  char *basename;
+  char *name;
+  guint i = 1;
+
+  basename = g_path_get_basename (uri);
+  name = g_uri_escape_string (basename, NULL, TRUE);
+
+  while (g_hash_table_contains (page->names, name)) {
+    char *unique;
+
+    g_free (name);
+    unique = g_strdup_printf ("%u-%s", i++, basename);
+    name = g_uri_escape_string (unique, NULL, TRUE);
+    g_free (unique);
+  }
+  g_free (basename);
+
+  g_hash_table_add (page->names, g_strdup (name));
+
+  return name;
+}
+
+/**
+ * ephy_saved_page_add_resource:
+ * @page: an #EphySavedPage
+ * @uri: the URI of the resource
+ * @data: the contents of the resource
+ * @length: the length of @data
+ *
+ * Registers a resource of the page, so that references to @uri are
+ * rewritten by ephy_saved_page_rewrite_document().
+ *
+ * Returns: the escaped name of the file in the resources directory that
+ * @data has to be written to, or %NULL if nothing needs to be written
+ * because @uri was added already or the same data is saved under
+ * another name.
+ **/
+char *
+ephy_saved_page_add_resource (EphySavedPage *page,
+                              const char *uri,
+                              const char *data,
+                              gsize length)
+{
+  char *key;
+  char *checksum;
+  const char *href;
+  char *name;
+
+  g_return_val_if_fail (page, NULL);
+  g_return_val_if_fail (uri, NULL);
+
+  key = resolve_uri (NULL, uri);
+  if (!key)
+    key = g_strdup (uri);
+
+  if (g_hash_table_contains (page->uri_to_href, key)) {
+    g_free (key);
+    return NULL;
+  }
+
+  page->max_uri_length = MAX (page->max_uri_length, strlen (key));
+
+  checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA1, (const guchar *)data, length);
+  href = g_hash_table_lookup (page->checksum_to_href, checksum);
+  if (href) {
+    g_hash_table_insert (page->uri_to_href, key, g_strdup (href));
+    g_free (checksum);
+    return NULL;
+  }
+
+  name = get_unique_name (page, uri);
+  g_hash_table_insert (page->uri_to_href, key,
+                       g_strdup_printf ("%s/%s", page->directory_href, name));
+  g_hash_table_insert (page->checksum_to_href, checksum,
+                       g_strdup_printf ("%s/%s", page->directory_href, name));
+
+  return name;
+}
+
+/**
+ * ephy_saved_page_lookup:
+ * @page: an #EphySavedPage
+ * @uri: the URI of a resource
+ *
+ * Returns: the reference to the local copy of @uri, or %NULL if it
+ * was not added to @page
+ **/
+const char *
+ephy_saved_page_lookup (EphySavedPage *page,
+                        const char *uri)
+{
+  const char *href;
+  char *key;
+
+  g_return_val_if_fail (page, NULL);
+  g_return_val_if_fail (uri, NULL);
+
+  href = g_hash_table_lookup (page->uri_to_href, uri);
+  if (href)
+    return href;
+
+  key = resolve_uri (NULL, uri);
+  if (key)
+    href = g_hash_table_lookup (page->uri_to_href, key);
+  g_free (key);
+
+  return href;
+}
+
+static gboolean
+is_space (char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+/* Looks up the value between @start and @end, without the whitespace
+ * around it, resolved against the document URI. On a hit, appends the
+ * text up to the value and its local reference to @result, and returns
+ * where the value ended. */
+static const char *
+rewrite_value (EphySavedPage *page,
+               GString *result,
+               GString *scratch,
+               const char *start,
+               const char *end)
+{
+  const char *value = start;
+  const char *href;
+
+  while (value < end && is_space (*value))
+    value++;
+  while (end > value && is_space (end[-1]))
+    end--;
+
+  if (value == end || (gsize)(end - value) > page->max_uri_length)
+    return NULL;
+
+  g_string_truncate (scratch, 0);
+  g_string_append_len (scratch, value, end - value);
+
+  /* Absolute references are usually spelled like the saved URIs. */
+  href = g_hash_table_lookup (page->uri_to_href, scratch->str);
+  if (!href) {
+    char *resolved;
+
+    /* Text, not a reference. */
+    if (strpbrk (scratch->str, " \t\n\r\f<>\"'") || strlen (scratch->str) != scratch->len)
+      return NULL;
+
+    resolved = resolve_uri (page->base_uri, scratch->str);
+    if (resolved)
+      href = g_hash_table_lookup (page->uri_to_href, resolved);
+    g_free (resolved);
+    if (!href)
+      return NULL;
+  }
+
+  g_string_append_len (result, start, value - start);
+  g_string_append (result, href);
+
+  return end;
+}
+
+/* Finds where an unquoted value starting at @start ends, looking at
+ * most @limit bytes ahead. Returns %NULL if it is quoted, or too long
+ * to be a saved URI. */
+static const char *
+find_unquoted_value_end (const char *start,
+                         const char *end,
+                         gsize limit,
+                         gboolean in_url)
+{
+  const char *p = start;
+
+  while (p < end && is_space (*p))
+    p++;
+  if (p == end || *p == '"' || *p == '\'')
+    return NULL;
+
+  for (end = MIN (end, p + limit); p < end; p++) {
+    if (in_url ? *p == ')' : (is_space (*p) || *p == '>'))
+      return p;
+  }
+
+  return NULL;
+}
+
+/**
+ * ephy_saved_page_rewrite_document:
+ * @page: an #EphySavedPage
+ * @data: the contents of the document
+ * @length: the length of @data, which may contain NUL bytes
+ * @new_length: (out): return location for the length of the result
+ *
+ * Points the references to the resources of @page in @data to their
+ * local copies, in a single pass over the document. A reference is
+ * only rewritten when it is a whole quoted string, unquoted attribute
+ * value or url() value, so a URI is never mistaken for the start of a
+ * longer one. Relative references are resolved against the document
+ * URI, since they would not resolve next to the saved file otherwise.
+ *
+ * Returns: the rewritten document, or %NULL if there was nothing to
+ * rewrite
+ **/
+char *
+ephy_saved_page_rewrite_document (EphySavedPage *page,
+                                  const char *data,
+                                  gsize length,
+                                  gsize *new_length)
+{
+  GString *result;
+  GString *scratch;
+  const char *p, *end, *copied;
+  gsize limit;
+  gboolean rewritten = FALSE;
+
+  g_return_val_if_fail (page, NULL);
+  g_return_val_if_fail (data || length == 0, NULL);
+  g_return_val_if_fail (new_length, NULL);
+
+  if (g_hash_table_size (page->uri_to_href) == 0)
+    return NULL;
+
+  /* Room for the value, the whitespace around it and its delimiter. */
+  limit = page->max_uri_length + 2 * MAX_PADDING + 1;
+
+  result = g_string_sized_new (length);
+  scratch = g_string_sized_new (page->max_uri_length + 1);
+  end = data + length;
+  copied = data;
+
+  for (p = data; p < end; p++) {
+    const char *value_end = NULL;
+    const char *done;
+
+    if (*p == '"' || *p == '\'') {
+      value_end = memchr (p + 1, *p, MIN ((gsize)(end - p - 1), limit));
+    } else if (*p == '(' || *p == '=') {
+      value_end = find_unquoted_value_end (p + 1, end, limit, *p == '(');
+    }
+
+    if (!value_end)
+      continue;
+
+    g_string_append_len (result, copied, p + 1 - copied);
+    done = rewrite_value (page, result, scratch, p + 1, value_end);
+    if (!done) {
+      copied = p + 1;
+      continue;
+    }
+
+    rewritten = TRUE;
+    copied = done;
+    /* Skip the closing quote, so it does not open another string. */
+    p = (*p == '"' || *p == '\'') ? value_end : done - 1;
+  }
+
+  g_string_free (scratch, TRUE);
+
+  if (!rewritten) {
+    g_string_free (result, TRUE);
+    return NULL;
+  }
+
+  g_string_append_len (result, copied, end - copied);
+  *new_length = result->len;
+
+  return g_string_free (result, FALSE);
+}
@@ -0,0 +1,54 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#if !defined (__EPHY_EPIPHANY_H_INSIDE__) && !defined (EPIPHANY_COMPILATION)
+#error "Only <epiphany/epiphany.h> can be included directly."
+#endif
+
+#ifndef EPHY_SAVED_PAGE_H
+#define EPHY_SAVED_PAGE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EphySavedPage EphySavedPage;
+
+EphySavedPage *ephy_saved_page_new              (const char    *document_uri,
+                                                 const char    *directory_href);
+
+void           ephy_saved_page_free             (EphySavedPage *page);
+
+char          *ephy_saved_page_add_resource     (EphySavedPage *page,
+                                                 const char    *uri,
+                                                 const char    *data,
+                                                 gsize          length);
+
+const char    *ephy_saved_page_lookup           (EphySavedPage *page,
+                                                 const char    *uri);
+
+char          *ephy_saved_page_rewrite_document (EphySavedPage *page,
+                                                 const char    *data,
+                                                 gsize          length,
+                                                 gsize         *new_length);
+
+G_END_DECLS
+
+#endif
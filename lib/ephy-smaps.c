@@ -22,61 +22,46 @@
 #include "ephy-smaps.h"
 
 #include <errno.h>
-#include <gio/gio.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
-G_DEFINE_TYPE (EphySMaps, ephy_smaps, G_TYPE_OBJECT)
+/* Big enough for any smaps line, file names included. */
+#define SMAPS_BUFFER_SIZE 8192
 
-struct _EphySMapsPrivate {
-  GRegex *header;
-  GRegex *detail;
+enum {
+  SAMPLED,
+  LAST_SIGNAL
 };
 
-typedef struct {
-  char *start;
-  char *end;
-  char *perms;
-  char *offset;
-  char *major;
-  char *minor;
-  char *inode;
-  char *filename;
-  char *size;
-  char *rss;
-  char *pss;
-  char *shared_clean;
-  char *shared_dirty;
-  char *private_clean;
-  char *private_dirty;
-} VMA_t;
+static guint signals[LAST_SIGNAL];
 
-typedef struct {
-  guint shared_clean;
-  guint shared_dirty;
-  guint private_clean;
-  guint private_dirty;
-} PermEntry;
+G_DEFINE_TYPE (EphySMaps, ephy_smaps, G_TYPE_OBJECT)
 
-typedef enum {
-  EPHY_PROCESS_EPIPHANY,
-  EPHY_PROCESS_WEB,
-  EPHY_PROCESS_PLUGIN,
+struct _EphySMapsPrivate {
+  guint sampling_id;
 
-  EPHY_PROCESS_OTHER
-} EphyProcess;
+  /* Ring buffer of the last n_samples samples. */
+  EphySMapsSample *samples;
+  guint n_samples;
+  guint first;
+  guint length;
+};
 
 #ifdef HAVE_WEBKIT2
-static const char *get_ephy_process_name (EphyProcess process)
+static const char *get_ephy_process_name (EphySMapsProcess process)
 {
   switch (process) {
-  case EPHY_PROCESS_EPIPHANY:
+  case EPHY_SMAPS_PROCESS_UI:
     return "Browser";
-  case EPHY_PROCESS_WEB:
+  case EPHY_SMAPS_PROCESS_WEB:
     return "Web Process";
-  case EPHY_PROCESS_PLUGIN:
+  case EPHY_SMAPS_PROCESS_PLUGIN:
     return "Plugin Process";
-  case EPHY_PROCESS_OTHER:
+  case EPHY_SMAPS_PROCESS_NETWORK:
+    return "Network Process";
+  case EPHY_SMAPS_N_PROCESSES:
     g_assert_not_reached ();
   }
 
@@ -84,241 +69,233 @@ static const char *get_ephy_process_name (EphyProcess process)
 }
 #endif
 
-static void vma_free (VMA_t* vma)
+/* Reads a file line by line into a fixed buffer, so that parsing
+   smaps does not allocate. */
+typedef struct {
+  int fd;
+  gsize start;
+  gsize end;
+  gboolean eof;
+  gboolean skip_line;
+  char buffer[SMAPS_BUFFER_SIZE];
+} SMapsReader;
+
+static char *smaps_reader_next_line (SMapsReader *reader)
 {
-  g_free (vma->start);
-  g_free (vma->end);
-  g_free (vma->perms);
-  g_free (vma->offset);
-  g_free (vma->major);
-  g_free (vma->minor);
-  g_free (vma->inode);
-  g_free (vma->filename);
-  g_free (vma->size);
-  g_free (vma->rss);
-  g_free (vma->pss);
-  g_free (vma->shared_clean);
-  g_free (vma->shared_dirty);
-  g_free (vma->private_clean);
-  g_free (vma->private_dirty);
-
-  g_slice_free (VMA_t, vma);
-}
+  char *line, *newline;
+  gssize n;
+
+  while (TRUE) {
+    line = reader->buffer + reader->start;
+    newline = memchr (line, '\n', reader->end - reader->start);
+    if (newline) {
+      *newline = '\0';
+      reader->start = newline - reader->buffer + 1;
+
+      if (reader->skip_line) {
+        /* Rest of a line that was too long, drop it. */
+        reader->skip_line = FALSE;
+        continue;
+      }
+
+      return line;
+    }
 
-static void perm_entry_free (PermEntry *entry)
-{
-  if (entry)
-    g_slice_free (PermEntry, entry);
-}
+    if (reader->eof) {
+      if (reader->start == reader->end)
+        return NULL;
 
-static void add_to_perm_entry (GHashTable *hash, VMA_t *entry)
-{
-  const char *perms = entry->perms;
-  PermEntry *value;
-  guint number;
-  gboolean insert = FALSE;
+      reader->buffer[reader->end] = '\0';
+      reader->start = reader->end;
 
-  value = g_hash_table_lookup (hash, perms);
+      return line;
+    }
 
-  if (!value) {
-    value = g_slice_new0 (PermEntry);
-    insert = TRUE;
-  }
+    if (reader->start > 0) {
+      memmove (reader->buffer, line, reader->end - reader->start);
+      reader->end -= reader->start;
+      reader->start = 0;
+    } else if (reader->end == SMAPS_BUFFER_SIZE - 1) {
+      /* Return what fits and skip the rest of the line. */
+      reader->buffer[reader->end] = '\0';
+      reader->start = reader->end = 0;
+      reader->skip_line = TRUE;
+
+      return reader->buffer;
+    }
 
-  sscanf (entry->shared_clean, "%u", &number);
-  value->shared_clean += number;
-  sscanf (entry->shared_dirty, "%u", &number);
-  value->shared_dirty += number;
-  sscanf (entry->private_clean, "%u", &number);
-  value->private_clean += number;
-  sscanf (entry->private_dirty, "%u", &number);
-  value->private_dirty += number;
-
-  if (insert)
-    g_hash_table_insert (hash, g_strdup (perms), value);
+    n = read (reader->fd, reader->buffer + reader->end, SMAPS_BUFFER_SIZE - 1 - reader->end);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      reader->eof = TRUE;
+    else
+      reader->end += n;
+  }
 }
 
-static void add_to_totals (PermEntry *entry, PermEntry *totals)
+/* Parses a mapping header like
+   "7f0e1c000000-7f0e1c021000 rw-p 00000000 00:00 0    [heap]". */
+static gboolean parse_header (const char *line, EphySMapsMapping *mapping, gboolean *anonymous)
 {
-  totals->shared_clean += entry->shared_clean;
-  totals->shared_dirty += entry->shared_dirty;
-  totals->private_dirty += entry->private_dirty;
-  totals->private_dirty += entry->private_dirty;
+  const char *p = line;
+  const char *perms;
+
+  while ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f'))
+    p++;
+  if (p == line || *p != '-')
+    return FALSE;
+
+  p = strchr (p, ' ');
+  if (!p || strlen (++p) < 4)
+    return FALSE;
+  perms = p;
+
+  /* Skip the permissions and the offset. */
+  p = strchr (p, ' ');
+  if (!p || !(p = strchr (p + 1, ' ')))
+    return FALSE;
+
+  *anonymous = strncmp (p + 1, "00:00 ", 6) == 0;
+
+  if (strncmp (perms, "r-xp", 4) == 0)
+    *mapping = EPHY_SMAPS_MAPPING_CODE;
+  else if (strncmp (perms, "rw-p", 4) == 0)
+    *mapping = EPHY_SMAPS_MAPPING_DATA;
+  else if (strncmp (perms, "r--p", 4) == 0)
+    *mapping = EPHY_SMAPS_MAPPING_READ_ONLY_DATA;
+  else if (strncmp (perms, "---p", 4) == 0)
+    *mapping = EPHY_SMAPS_MAPPING_GUARD;
+  else if (strncmp (perms, "r--s", 4) == 0)
+    *mapping = EPHY_SMAPS_MAPPING_SHARED;
+  else
+    *mapping = EPHY_SMAPS_MAPPING_OTHER;
+
+  return TRUE;
 }
 
-static void print_vma_table (GString *str, GHashTable *hash, const char *caption)
-{
-  PermEntry *pentry, totals;
-
-  memset (&totals, 0, sizeof (PermEntry));
-
-  g_string_append_printf (str, "<table class=\"memory-table\"><caption>%s</caption><colgroup><colgroup span=\"2\" align=\"center\"><colgroup span=\"2\" align=\"center\"><colgroup><thead><tr><th><th colspan=\"2\">Shared</th><th colspan=\"2\">Private</th><th></tr></thead>", caption);
-  g_string_append (str, "<tbody><tr><td></td><td>Clean</td><td>Dirty</td><td>Clean</td><td>Dirty</td><td></td></tr>");
-  pentry = g_hash_table_lookup (hash, "r-xp");
-  if (pentry) {
-    g_string_append_printf (str, "<tbody><tr><td>r-xp</td><td>%d</td><td>%d</td><td>%d</td><td>%d</td><td>Code</td></tr>",
-                            pentry->shared_clean, pentry->shared_dirty, pentry->private_clean, pentry->private_dirty);
-    add_to_totals (pentry, &totals);
-  }
-  pentry = g_hash_table_lookup (hash, "rw-p");
-  if (pentry) {
-    g_string_append_printf (str, "<tbody><tr><td>rw-p</td><td>%d</td><td>%d</td><td>%d</td><td>%d</td><td>Data</td></tr>",
-                            pentry->shared_clean, pentry->shared_dirty, pentry->private_clean, pentry->private_dirty);
-    add_to_totals (pentry, &totals);
-  }
-  pentry = g_hash_table_lookup (hash, "r--p");
-  if (pentry) {
-    g_string_append_printf (str, "<tbody><tr><td>r--p</td><td>%d</td><td>%d</td><td>%d</td><td>%d</td><td>Read-only Data</td></tr>",
-                            pentry->shared_clean, pentry->shared_dirty, pentry->private_clean, pentry->private_dirty);
-    add_to_totals (pentry, &totals);
-  }
-  pentry = g_hash_table_lookup (hash, "---p");
-  if (pentry) {
-    g_string_append_printf (str, "<tbody><tr><td>---p</td><td>%d</td><td>%d</td><td>%d</td><td>%d</td><td></td></tr>",
-                            pentry->shared_clean, pentry->shared_dirty, pentry->private_clean, pentry->private_dirty);
-    add_to_totals (pentry, &totals);
-  }
-  pentry = g_hash_table_lookup (hash, "r--s");
-  if (pentry) {
-    g_string_append_printf (str, "<tbody><tr><td>r--s</td><td>%d</td><td>%d</td><td>%d</td><td>%d</td><td></td></tr>",
-                            pentry->shared_clean, pentry->shared_dirty, pentry->private_clean, pentry->private_dirty);
-    add_to_totals (pentry, &totals);
-  }
-  g_string_append_printf (str, "<tbody><tr><td>Total:</td><td>%d kB</td><td>%d kB</td><td>%d kB</td><td>%d kB</td><td></td></tr>",
-                          totals.shared_clean, totals.shared_dirty, totals.private_clean, totals.private_dirty);
-  g_string_append (str, "</table>");
-}
+static const struct {
+  const char *name;
+  gsize length;
+  glong offset;
+} smaps_fields[] = {
+  { "Rss", 3, G_STRUCT_OFFSET (EphySMapsCounters, rss) },
+  { "Pss", 3, G_STRUCT_OFFSET (EphySMapsCounters, pss) },
+  { "Swap", 4, G_STRUCT_OFFSET (EphySMapsCounters, swap) },
+  { "Shared_Clean", 12, G_STRUCT_OFFSET (EphySMapsCounters, shared_clean) },
+  { "Shared_Dirty", 12, G_STRUCT_OFFSET (EphySMapsCounters, shared_dirty) },
+  { "Private_Clean", 13, G_STRUCT_OFFSET (EphySMapsCounters, private_clean) },
+  { "Private_Dirty", 13, G_STRUCT_OFFSET (EphySMapsCounters, private_dirty) }
+};
 
-static void ephy_smaps_pid_to_html (EphySMaps *smaps, GString *str, pid_t pid, EphyProcess process)
+/* Parses a line like "Private_Dirty:        12 kB", returns the offset
+   of the field in EphySMapsCounters or -1 if it's not one we track. */
+static glong parse_field (const char *line, guint64 *value)
 {
-  GFileInputStream *stream;
-  GDataInputStream *data_stream;
-  char *path;
-  GFile *file;
-  char *line;
-  GError *error = NULL;
-  VMA_t *vma = NULL;
-  GHashTable *anon_hash, *mapped_hash;
-  GSList *vma_entries = NULL, *p;
-  EphySMapsPrivate *priv = smaps->priv;
-
-  path = g_strdup_printf ("/proc/%u/smaps", pid);
-  file = g_file_new_for_path (path);
-  g_free (path);
+  const char *colon;
+  const char *p;
+  gsize length;
+  guint i;
 
-  stream = g_file_read (file, NULL, &error);
-  g_object_unref (file);
+  colon = strchr (line, ':');
+  if (!colon)
+    return -1;
+  length = colon - line;
 
-  if (error && error->code == G_IO_ERROR_NOT_FOUND ) {
-    /* This is not GNU/Linux, do nothing. */
-    g_error_free (error);
-    return;
+  for (i = 0; i < G_N_ELEMENTS (smaps_fields); i++) {
+    if (smaps_fields[i].length == length &&
+        strncmp (line, smaps_fields[i].name, length) == 0)
+      break;
   }
+  if (i == G_N_ELEMENTS (smaps_fields))
+    return -1;
 
-  data_stream = g_data_input_stream_new (G_INPUT_STREAM (stream));
-  g_object_unref (stream);
+  p = colon + 1;
+  while (*p == ' ')
+    p++;
+  if (*p < '0' || *p > '9')
+    return -1;
 
-  while ((line = g_data_input_stream_read_line (data_stream, NULL, NULL, NULL))) {
-    GMatchInfo *match_info = NULL;
-    gboolean matched = FALSE;
+  *value = 0;
+  for (; *p >= '0' && *p <= '9'; p++)
+    *value = *value * 10 + (*p - '0');
 
-    g_regex_match (priv->header, line, 0, &match_info);
-    if (g_match_info_matches (match_info)) {
-      matched = TRUE;
+  return smaps_fields[i].offset;
+}
 
-      if (vma)
-        vma_entries = g_slist_append (vma_entries, vma);
+static void counters_add (EphySMapsCounters *counters, const EphySMapsCounters *other)
+{
+  counters->rss += other->rss;
+  counters->pss += other->pss;
+  counters->swap += other->swap;
+  counters->shared_clean += other->shared_clean;
+  counters->shared_dirty += other->shared_dirty;
+  counters->private_clean += other->private_clean;
+  counters->private_dirty += other->private_dirty;
+}
 
-      vma = g_slice_new0 (VMA_t);
+/**
+ * ephy_smaps_sample_pid:
+ * @pid: the process to sample
+ * @process: the kind of process @pid is
+ * @rollup: whether only the totals are needed
+ * @sample: (out): return location for the sample
+ *
+ * Reads the memory usage of @pid from /proc. When @rollup is %TRUE
+ * and the kernel provides smaps_rollup only the totals are read,
+ * which is much cheaper than walking every mapping.
+ *
+ * Returns: %TRUE if @sample was filled
+ **/
+gboolean ephy_smaps_sample_pid (pid_t pid, EphySMapsProcess process, gboolean rollup, EphySMapsProcessSample *sample)
+{
+  SMapsReader reader;
+  char path[64];
+  char *line;
+  EphySMapsCounters *counters = NULL;
 
-      vma->start = g_match_info_fetch (match_info, 1);
-      vma->end = g_match_info_fetch (match_info, 2);
-      vma->perms = g_match_info_fetch (match_info, 3);
-      vma->offset = g_match_info_fetch (match_info, 4);
-      vma->major = g_match_info_fetch (match_info, 5);
-      vma->minor = g_match_info_fetch (match_info, 6);
-      vma->inode = g_match_info_fetch (match_info, 7);
-      vma->filename = g_match_info_fetch (match_info, 8);
-    }
-    
-    g_match_info_free (match_info);
-
-    if (matched)
-      goto out;
-
-    g_regex_match (priv->detail, line, 0, &match_info);
-    if (g_match_info_matches (match_info)) {
-      char *name = g_match_info_fetch (match_info, 1);
-      char **size = NULL;
-
-      if (g_str_equal (name, "Size"))
-        size = &vma->size;
-      else if (g_str_equal (name, "Rss"))
-        size = &vma->rss;
-      else if (g_str_equal (name, "Pss"))
-        size = &vma->pss;
-      else if (g_str_equal (name, "Shared_Clean"))
-        size = &vma->shared_clean;
-      else if (g_str_equal (name, "Shared_Dirty"))
-        size = &vma->shared_dirty;
-      else if (g_str_equal (name, "Private_Clean"))
-        size = &vma->private_clean;
-      else if (g_str_equal (name, "Private_Dirty"))
-        size = &vma->private_dirty;
-
-      if (size)
-        *size = g_match_info_fetch (match_info, 2);
-
-      g_free (name);
-    }
+  memset (sample, 0, sizeof (EphySMapsProcessSample));
+  sample->pid = pid;
+  sample->process = process;
 
-    g_match_info_free (match_info);
-  out:
-    g_free (line);
+  reader.fd = -1;
+  if (rollup) {
+    g_snprintf (path, sizeof (path), "/proc/%u/smaps_rollup", pid);
+    reader.fd = open (path, O_RDONLY);
   }
 
-  if (vma)
-    vma_entries = g_slist_append (vma_entries, vma);
-
-  g_object_unref (data_stream);
-
-  /* All the file is parsed now. We have parsed more stuff than what
-   * we are going to use, but it might be useful in the future. */
-  anon_hash = g_hash_table_new_full (g_str_hash,
-                                     g_str_equal,
-                                     (GDestroyNotify)g_free,
-                                     (GDestroyNotify)perm_entry_free);
-  mapped_hash = g_hash_table_new_full (g_str_hash,
-                                       g_str_equal,
-                                       (GDestroyNotify)g_free,
-                                       (GDestroyNotify)perm_entry_free);
-
-  for (p = vma_entries; p; p = p->next) {
-    VMA_t *entry = (VMA_t*)p->data;
-
-    if (g_strcmp0 (entry->major, "00") && g_strcmp0 (entry->minor, "00"))
-      add_to_perm_entry (anon_hash, entry);
-    else
-      add_to_perm_entry (mapped_hash, entry);
-
-    vma_free (entry);
+  sample->has_mappings = reader.fd == -1;
+  if (sample->has_mappings) {
+    g_snprintf (path, sizeof (path), "/proc/%u/smaps", pid);
+    reader.fd = open (path, O_RDONLY);
   }
 
-  g_slist_free (vma_entries);
-
-#ifdef HAVE_WEBKIT2
-  g_string_append_printf (str, "<h2>%s</h2>", get_ephy_process_name (process));
-#endif
-
-  /* Anon table. */
-  print_vma_table (str, anon_hash, "Anonymous memory");
+  /* Not GNU/Linux, or the process is gone. */
+  if (reader.fd == -1)
+    return FALSE;
+
+  reader.start = reader.end = 0;
+  reader.eof = reader.skip_line = FALSE;
+
+  while ((line = smaps_reader_next_line (&reader))) {
+    EphySMapsMapping mapping;
+    gboolean anonymous;
+    guint64 value;
+    glong offset;
+
+    offset = parse_field (line, &value);
+    if (offset != -1) {
+      G_STRUCT_MEMBER (guint64, &sample->total, offset) += value;
+      if (counters)
+        G_STRUCT_MEMBER (guint64, counters, offset) += value;
+    } else if (sample->has_mappings && parse_header (line, &mapping, &anonymous)) {
+      counters = anonymous ? &sample->anonymous[mapping] : &sample->mapped[mapping];
+    }
+  }
 
-  /* Mapped table. */
-  print_vma_table (str, mapped_hash, "Mapped memory");
+  close (reader.fd);
 
-  /* Done. */
-  g_hash_table_unref (anon_hash);
-  g_hash_table_unref (mapped_hash);
+  return TRUE;
 }
 
 #ifdef HAVE_WEBKIT2
@@ -379,14 +356,14 @@ static pid_t get_parent_pid (pid_t pid)
   return ppid;
 }
 
-static EphyProcess get_ephy_process (pid_t pid)
+static EphySMapsProcess get_ephy_process (pid_t pid)
 {
   char *path;
   char *data;
   gsize data_length = 0;
   char *p;
   char *name;
-  EphyProcess process = EPHY_PROCESS_OTHER;
+  EphySMapsProcess process = EPHY_SMAPS_N_PROCESSES;
 
   path = g_strdup_printf ("/proc/%u/cmdline", pid);
   if (!g_file_get_contents (path, &data, &data_length, NULL)) {
@@ -402,9 +379,11 @@ static EphyProcess get_ephy_process (pid_t pid)
 
   name = g_path_get_basename (data);
   if (g_strcmp0 (name, "WebKitWebProcess") == 0)
-    process = EPHY_PROCESS_WEB;
+    process = EPHY_SMAPS_PROCESS_WEB;
   else if (g_strcmp0 (name, "WebKitPluginProcess") == 0)
-    process = EPHY_PROCESS_PLUGIN;
+    process = EPHY_SMAPS_PROCESS_PLUGIN;
+  else if (g_strcmp0 (name, "WebKitNetworkProcess") == 0)
+    process = EPHY_SMAPS_PROCESS_NETWORK;
 
   g_free (data);
   g_free (name);
@@ -412,7 +391,9 @@ static EphyProcess get_ephy_process (pid_t pid)
   return process;
 }
 
-static void ephy_smaps_pid_children_to_html (EphySMaps *smaps, GString *str, pid_t parent_pid)
+typedef void (*ChildProcessFunc) (pid_t pid, EphySMapsProcess process, gpointer user_data);
+
+static void foreach_child_process (pid_t parent_pid, ChildProcessFunc func, gpointer user_data)
 {
   GDir *proc;
   const char *name;
@@ -423,7 +404,7 @@ static void ephy_smaps_pid_children_to_html (EphySMaps *smaps, GString *str, pid
 
   while ((name = g_dir_read_name (proc))) {
     pid_t pid, ppid;
-    EphyProcess process;
+    EphySMapsProcess process;
 
     if (g_str_equal (name, "self"))
       continue;
@@ -437,13 +418,104 @@ static void ephy_smaps_pid_children_to_html (EphySMaps *smaps, GString *str, pid
       continue;
 
     process = get_ephy_process (pid);
-    if (process != EPHY_PROCESS_OTHER)
-      ephy_smaps_pid_to_html (smaps, str, pid, process);
+    if (process != EPHY_SMAPS_N_PROCESSES)
+      func (pid, process, user_data);
   }
   g_dir_close (proc);
 }
+
+static void sample_child_process (pid_t pid, EphySMapsProcess process, EphySMapsSample *sample)
+{
+  EphySMapsProcessSample process_sample;
+
+  if (ephy_smaps_sample_pid (pid, process, TRUE, &process_sample)) {
+    counters_add (&sample->processes[process], &process_sample.total);
+    sample->n_processes[process]++;
+  }
+}
 #endif
 
+/**
+ * ephy_smaps_sample:
+ * @sample: (out): return location for the sample
+ *
+ * Samples the memory usage totals of the browser and its web, plugin
+ * and network processes.
+ **/
+void ephy_smaps_sample (EphySMapsSample *sample)
+{
+  EphySMapsProcessSample process_sample;
+
+  memset (sample, 0, sizeof (EphySMapsSample));
+  sample->time = g_get_real_time ();
+
+  if (ephy_smaps_sample_pid (getpid (), EPHY_SMAPS_PROCESS_UI, TRUE, &process_sample)) {
+    sample->processes[EPHY_SMAPS_PROCESS_UI] = process_sample.total;
+    sample->n_processes[EPHY_SMAPS_PROCESS_UI] = 1;
+  }
+
+#ifdef HAVE_WEBKIT2
+  foreach_child_process (getpid (), (ChildProcessFunc)sample_child_process, sample);
+#endif
+}
+
+static const struct {
+  EphySMapsMapping mapping;
+  const char *perms;
+  const char *description;
+} html_rows[] = {
+  { EPHY_SMAPS_MAPPING_CODE, "r-xp", "Code" },
+  { EPHY_SMAPS_MAPPING_DATA, "rw-p", "Data" },
+  { EPHY_SMAPS_MAPPING_READ_ONLY_DATA, "r--p", "Read-only Data" },
+  { EPHY_SMAPS_MAPPING_GUARD, "---p", "" },
+  { EPHY_SMAPS_MAPPING_SHARED, "r--s", "" }
+};
+
+static void print_vma_table (GString *str, EphySMapsCounters *mappings, const char *caption)
+{
+  EphySMapsCounters totals;
+  guint i;
+
+  memset (&totals, 0, sizeof (EphySMapsCounters));
+
+  g_string_append_printf (str, "<table class=\"memory-table\"><caption>%s</caption><colgroup><colgroup span=\"2\" align=\"center\"><colgroup span=\"2\" align=\"center\"><colgroup><thead><tr><th><th colspan=\"2\">Shared</th><th colspan=\"2\">Private</th><th></tr></thead>", caption);
+  g_string_append (str, "<tbody><tr><td></td><td>Clean</td><td>Dirty</td><td>Clean</td><td>Dirty</td><td></td></tr>");
+  for (i = 0; i < G_N_ELEMENTS (html_rows); i++) {
+    EphySMapsCounters *entry = &mappings[html_rows[i].mapping];
+
+    if (entry->rss == 0 && entry->swap == 0)
+      continue;
+
+    g_string_append_printf (str, "<tbody><tr><td>%s</td><td>%" G_GUINT64_FORMAT "</td><td>%" G_GUINT64_FORMAT "</td><td>%" G_GUINT64_FORMAT "</td><td>%" G_GUINT64_FORMAT "</td><td>%s</td></tr>",
+                            html_rows[i].perms,
+                            entry->shared_clean, entry->shared_dirty, entry->private_clean, entry->private_dirty,
+                            html_rows[i].description);
+    counters_add (&totals, entry);
+  }
+  g_string_append_printf (str, "<tbody><tr><td>Total:</td><td>%" G_GUINT64_FORMAT " kB</td><td>%" G_GUINT64_FORMAT " kB</td><td>%" G_GUINT64_FORMAT " kB</td><td>%" G_GUINT64_FORMAT " kB</td><td></td></tr>",
+                          totals.shared_clean, totals.shared_dirty, totals.private_clean, totals.private_dirty);
+  g_string_append (str, "</table>");
+}
+
+static void ephy_smaps_pid_to_html (pid_t pid, EphySMapsProcess process, GString *str)
+{
+  EphySMapsProcessSample sample;
+
+  /* This is not GNU/Linux, do nothing. */
+  if (!ephy_smaps_sample_pid (pid, process, FALSE, &sample))
+    return;
+
+#ifdef HAVE_WEBKIT2
+  g_string_append_printf (str, "<h2>%s</h2>", get_ephy_process_name (process));
+#endif
+
+  /* Anon table. */
+  print_vma_table (str, sample.anonymous, "Anonymous memory");
+
+  /* Mapped table. */
+  print_vma_table (str, sample.mapped, "Mapped memory");
+}
+
 char* ephy_smaps_to_html (EphySMaps *smaps)
 {
   GString *str = g_string_new ("");
@@ -451,10 +523,10 @@ char* ephy_smaps_to_html (EphySMaps *smaps)
 
   g_string_append (str, "<body>");
 
-  ephy_smaps_pid_to_html (smaps, str, pid, EPHY_PROCESS_EPIPHANY);
+  ephy_smaps_pid_to_html (pid, EPHY_SMAPS_PROCESS_UI, str);
 
 #ifdef HAVE_WEBKIT2
-  ephy_smaps_pid_children_to_html (smaps, str, pid);
+  foreach_child_process (pid, (ChildProcessFunc)ephy_smaps_pid_to_html, str);
 #endif
 
   g_string_append (str, "</body>");
@@ -462,26 +534,103 @@ char* ephy_smaps_to_html (EphySMaps *smaps)
   return g_string_free (str, FALSE);
 }
 
+static gboolean ephy_smaps_sample_cb (EphySMaps *smaps)
+{
+  EphySMapsPrivate *priv = smaps->priv;
+  EphySMapsSample *sample;
+
+  if (priv->length < priv->n_samples)
+    sample = &priv->samples[(priv->first + priv->length++) % priv->n_samples];
+  else {
+    /* Full, overwrite the oldest one. */
+    sample = &priv->samples[priv->first];
+    priv->first = (priv->first + 1) % priv->n_samples;
+  }
+
+  ephy_smaps_sample (sample);
+  g_signal_emit (smaps, signals[SAMPLED], 0, sample);
+
+  return TRUE;
+}
+
+/**
+ * ephy_smaps_start_sampling:
+ * @smaps: a #EphySMaps
+ * @interval: the time between samples, in seconds
+ * @n_samples: how many samples to keep
+ *
+ * Starts sampling the memory usage of the browser processes every
+ * @interval seconds. The last @n_samples samples are kept and can be
+ * retrieved with ephy_smaps_get_samples(); EphySMaps::sampled is
+ * emitted for every new one. Any previous samples are dropped.
+ **/
+void ephy_smaps_start_sampling (EphySMaps *smaps, guint interval, guint n_samples)
+{
+  EphySMapsPrivate *priv;
+
+  g_return_if_fail (EPHY_IS_SMAPS (smaps));
+  g_return_if_fail (interval > 0);
+  g_return_if_fail (n_samples > 0);
+
+  priv = smaps->priv;
+
+  ephy_smaps_stop_sampling (smaps);
+
+  g_free (priv->samples);
+  priv->samples = g_new0 (EphySMapsSample, n_samples);
+  priv->n_samples = n_samples;
+  priv->first = priv->length = 0;
+
+  ephy_smaps_sample_cb (smaps);
+  priv->sampling_id = g_timeout_add_seconds (interval, (GSourceFunc)ephy_smaps_sample_cb, smaps);
+}
+
+void ephy_smaps_stop_sampling (EphySMaps *smaps)
+{
+  g_return_if_fail (EPHY_IS_SMAPS (smaps));
+
+  if (smaps->priv->sampling_id) {
+    g_source_remove (smaps->priv->sampling_id);
+    smaps->priv->sampling_id = 0;
+  }
+}
+
+/**
+ * ephy_smaps_get_samples:
+ * @smaps: a #EphySMaps
+ *
+ * Returns: (transfer full): a #GArray of #EphySMapsSample, from the
+ * oldest to the newest.
+ **/
+GArray *ephy_smaps_get_samples (EphySMaps *smaps)
+{
+  EphySMapsPrivate *priv;
+  GArray *samples;
+  guint i;
+
+  g_return_val_if_fail (EPHY_IS_SMAPS (smaps), NULL);
+
+  priv = smaps->priv;
+  samples = g_array_sized_new (FALSE, FALSE, sizeof (EphySMapsSample), priv->length);
+  for (i = 0; i < priv->length; i++)
+    g_array_append_val (samples, priv->samples[(priv->first + i) % priv->n_samples]);
+
+  return samples;
+}
+
 static void
 ephy_smaps_init (EphySMaps *smaps)
 {
   smaps->priv = G_TYPE_INSTANCE_GET_PRIVATE (smaps, EPHY_TYPE_SMAPS, EphySMapsPrivate);
-
-  /* Prepare the regexps for the smaps file. */
-  smaps->priv->header = g_regex_new ("^([0-9a-f]+)-([0-9a-f]+) (....) ([0-9a-f]+) (..):(..) (\\d+) *(.*)$",
-                                     G_REGEX_OPTIMIZE,
-                                     0,
-                                     NULL);
-  smaps->priv->detail = g_regex_new ("^(.*): +(\\d+) kB", G_REGEX_OPTIMIZE, 0, NULL);
 }
 
 static void
 ephy_smaps_finalize (GObject *obj)
 {
-  EphySMapsPrivate *priv = EPHY_SMAPS (obj)->priv;
+  EphySMaps *smaps = EPHY_SMAPS (obj);
 
-  g_regex_unref (priv->header);
-  g_regex_unref (priv->detail);
+  ephy_smaps_stop_sampling (smaps);
+  g_free (smaps->priv->samples);
 
   G_OBJECT_CLASS (ephy_smaps_parent_class)->finalize (obj);
 }
@@ -493,6 +642,23 @@ ephy_smaps_class_init (EphySMapsClass *smaps_class)
 
   gobject_class->finalize = ephy_smaps_finalize;
 
+  /**
+   * EphySMaps::sampled:
+   * @smaps: the #EphySMaps
+   * @sample: the new #EphySMapsSample
+   *
+   * Emitted when a new sample has been taken while sampling.
+   **/
+  signals[SAMPLED] =
+    g_signal_new ("sampled",
+                  G_OBJECT_CLASS_TYPE (gobject_class),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__POINTER,
+                  G_TYPE_NONE,
+                  1,
+                  G_TYPE_POINTER);
+
   g_type_class_add_private (smaps_class, sizeof (EphySMapsPrivate));
 }
 
@@ -500,5 +666,3 @@ EphySMaps *ephy_smaps_new ()
 {
   return EPHY_SMAPS (g_object_new (EPHY_TYPE_SMAPS, NULL));
 }
-
-
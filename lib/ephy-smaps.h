@@ -22,6 +22,7 @@
 #define EPHY_SMAPS_H
 
 #include <glib-object.h>
+#include <sys/types.h>
 
 #define EPHY_TYPE_SMAPS            (ephy_smaps_get_type ())
 #define EPHY_SMAPS(object)         (G_TYPE_CHECK_INSTANCE_CAST ((object), EPHY_TYPE_SMAPS, EphySMaps))
@@ -32,6 +33,59 @@
 
 typedef struct _EphySMapsPrivate EphySMapsPrivate;
 
+typedef enum {
+  EPHY_SMAPS_PROCESS_UI,
+  EPHY_SMAPS_PROCESS_WEB,
+  EPHY_SMAPS_PROCESS_PLUGIN,
+  EPHY_SMAPS_PROCESS_NETWORK,
+
+  EPHY_SMAPS_N_PROCESSES
+} EphySMapsProcess;
+
+/* Mappings are classified by their permissions. */
+typedef enum {
+  EPHY_SMAPS_MAPPING_CODE,           /* r-xp */
+  EPHY_SMAPS_MAPPING_DATA,           /* rw-p */
+  EPHY_SMAPS_MAPPING_READ_ONLY_DATA, /* r--p */
+  EPHY_SMAPS_MAPPING_GUARD,          /* ---p */
+  EPHY_SMAPS_MAPPING_SHARED,         /* r--s */
+  EPHY_SMAPS_MAPPING_OTHER,
+
+  EPHY_SMAPS_N_MAPPINGS
+} EphySMapsMapping;
+
+/* All sizes are in kB. */
+typedef struct {
+  guint64 rss;
+  guint64 pss;
+  guint64 swap;
+  guint64 shared_clean;
+  guint64 shared_dirty;
+  guint64 private_clean;
+  guint64 private_dirty;
+} EphySMapsCounters;
+
+typedef struct {
+  pid_t pid;
+  EphySMapsProcess process;
+
+  EphySMapsCounters total;
+
+  /* Only filled when the full smaps file was read, smaps_rollup
+     only has the totals. */
+  gboolean has_mappings;
+  EphySMapsCounters anonymous[EPHY_SMAPS_N_MAPPINGS];
+  EphySMapsCounters mapped[EPHY_SMAPS_N_MAPPINGS];
+} EphySMapsProcessSample;
+
+/* A sample of the whole browser, processes of the same kind are added
+   together. */
+typedef struct {
+  gint64 time;
+  guint n_processes[EPHY_SMAPS_N_PROCESSES];
+  EphySMapsCounters processes[EPHY_SMAPS_N_PROCESSES];
+} EphySMapsSample;
+
 typedef struct {
   GObject parent;
 
@@ -43,8 +97,20 @@ typedef struct {
 
 } EphySMapsClass;
 
-GType       ephy_smaps_get_type (void);
-EphySMaps * ephy_smaps_new      (void);
-char      * ephy_smaps_to_html  (EphySMaps *smaps);
+GType       ephy_smaps_get_type       (void);
+EphySMaps * ephy_smaps_new            (void);
+char      * ephy_smaps_to_html        (EphySMaps *smaps);
+
+gboolean    ephy_smaps_sample_pid     (pid_t pid,
+                                       EphySMapsProcess process,
+                                       gboolean rollup,
+                                       EphySMapsProcessSample *sample);
+void        ephy_smaps_sample         (EphySMapsSample *sample);
+
+void        ephy_smaps_start_sampling (EphySMaps *smaps,
+                                       guint interval,
+                                       guint n_samples);
+void        ephy_smaps_stop_sampling  (EphySMaps *smaps);
+GArray    * ephy_smaps_get_samples    (EphySMaps *smaps);
 
 #endif /* EPHY_SMAPS_H */
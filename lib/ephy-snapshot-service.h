@@ -64,6 +64,18 @@ typedef enum {
   EPHY_SNAPSHOT_SERVICE_ERROR_INVALID
 } EphySnapshotServiceError;
 
+typedef struct {
+  guint queue_depth;
+  guint running;
+  guint64 completed;
+  guint64 coalesced;
+  gint64 mean_latency;
+  gint64 max_latency;
+  guint64 cache_hits;
+  guint64 cache_misses;
+  gsize cache_size;
+} EphySnapshotServiceStats;
+
 /* Values taken from the Web mockups. */
 #define EPHY_THUMBNAIL_WIDTH 180
 #define EPHY_THUMBNAIL_HEIGHT 135
@@ -80,6 +92,14 @@ void                 ephy_snapshot_service_get_snapshot_for_url_async  (EphySnap
                                                                         GAsyncReadyCallback callback,
                                                                         gpointer user_data);
 
+void                 ephy_snapshot_service_get_snapshot_for_url_full   (EphySnapshotService *service,
+                                                                        const char *url,
+                                                                        const time_t mtime,
+                                                                        int priority,
+                                                                        GCancellable *cancellable,
+                                                                        GAsyncReadyCallback callback,
+                                                                        gpointer user_data);
+
 GdkPixbuf           *ephy_snapshot_service_get_snapshot_for_url_finish (EphySnapshotService *service,
                                                                         GAsyncResult *result,
                                                                         GError **error);
@@ -107,8 +127,27 @@ gboolean             ephy_snapshot_service_save_snapshot_finish        (EphySnap
                                                                         GAsyncResult *result,
                                                                         GError **error);
 
+void                 ephy_snapshot_service_save_surface_async          (EphySnapshotService *service,
+                                                                        cairo_surface_t *surface,
+                                                                        const char *url,
+                                                                        time_t mtime,
+                                                                        GCancellable *cancellable,
+                                                                        GAsyncReadyCallback callback,
+                                                                        gpointer user_data);
+
+GdkPixbuf           *ephy_snapshot_service_save_surface_finish         (EphySnapshotService *service,
+                                                                        GAsyncResult *result,
+                                                                        GError **error);
+
 GdkPixbuf           *ephy_snapshot_service_crop_snapshot               (cairo_surface_t *surface);
 
+void                 ephy_snapshot_service_get_stats                   (EphySnapshotService *service,
+                                                                        EphySnapshotServiceStats *stats);
+
+void                 ephy_snapshot_service_freeze_lookups              (EphySnapshotService *service);
+
+void                 ephy_snapshot_service_thaw_lookups                (EphySnapshotService *service);
+
 G_END_DECLS
 
 #endif /* _EPHY_SNAPSHOT_SERVICE_H */
@@ -146,6 +146,12 @@ ephy_sqlite_connection_get_last_insert_id (EphySQLiteConnection *self)
   return sqlite3_last_insert_rowid (self->priv->database);
 }
 
+int
+ephy_sqlite_connection_get_changes (EphySQLiteConnection *self)
+{
+  return sqlite3_changes (self->priv->database);
+}
+
 gboolean
 ephy_sqlite_connection_begin_transaction (EphySQLiteConnection *self, GError **error)
 {
@@ -139,6 +139,17 @@ ephy_sqlite_statement_bind_int (EphySQLiteStatement *self, int column, int value
   return TRUE;
 }
 
+gboolean
+ephy_sqlite_statement_bind_int64 (EphySQLiteStatement *self, int column, gint64 value, GError **error)
+{
+  if (sqlite3_bind_int64 (self->priv->prepared_statement, column + 1, value) != SQLITE_OK) {
+    ephy_sqlite_connection_get_error (self->priv->connection, error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 gboolean
 ephy_sqlite_statement_bind_double (EphySQLiteStatement *self, int column, double value, GError **error)
 {
@@ -0,0 +1,323 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2; -*- */
+/* vim: set sw=2 ts=2 sts=2 et: */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+#include "ephy-history-import.h"
+
+#include "ephy-debug.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Number of visits sent to the history thread in one ADD_VISITS
+ * message. Each message is inserted with a single set of prepared
+ * statements and a single host cache. */
+#define IMPORT_CHUNK_SIZE 1000
+
+/* How many chunks may be queued on the history thread before we stop
+ * parsing and wait for it to catch up. This is what keeps memory use
+ * bounded for huge files. */
+#define IMPORT_MAX_PENDING_CHUNKS 4
+
+#define IMPORT_BUFFER_SIZE 65536
+
+typedef struct {
+  EphyHistoryService *service;
+
+  char *title;
+  char *location;
+  char *current;
+  long long int visit_count;
+  long long int last_visit;
+  long long int first_visit;
+  double zoom_level;
+
+  /* The current chunk, in reverse order. */
+  GList *visits;
+  guint n_visits;
+
+  guint pending_chunks;
+  gboolean failed;
+} ImportData;
+
+static void
+history_parse_start_element (GMarkupParseContext *context,
+                             const char          *element_name,
+                             const char         **attribute_names,
+                             const char         **attribute_values,
+                             gpointer             user_data,
+                             GError             **error)
+{
+  ImportData *data = user_data;
+
+  if (g_str_equal (element_name, "node")) {
+    /* Starting a new node, reset all values */
+    g_free (data->title);
+    data->title = NULL;
+
+    g_free (data->location);
+    data->location = NULL;
+
+    data->visit_count = 0;
+    data->last_visit = 0;
+    data->first_visit = 0;
+    data->zoom_level = 1.0;
+  } else if (g_str_equal (element_name, "property")) {
+    const char **name, **value;
+
+    for (name = attribute_names, value = attribute_values; *name; name++, value++) {
+      if (g_str_equal (*name, "id")) {
+        g_free (data->current);
+        data->current = g_strdup (*value);
+        break;
+      }
+    }
+  }
+}
+
+static void
+history_parse_text (GMarkupParseContext *context,
+                    const char          *text,
+                    gsize                text_len,
+                    gpointer             user_data,
+                    GError             **error)
+{
+  ImportData *data = user_data;
+  char *value;
+
+  if (!data->current)
+    return;
+
+  value = g_strndup (text, text_len);
+
+  if (g_str_equal (data->current, "2")) {
+    /* Title */
+    g_free (data->title);
+    data->title = value;
+    value = NULL;
+  } else if (g_str_equal (data->current, "3")) {
+    /* Location */
+    g_free (data->location);
+    data->location = value;
+    value = NULL;
+  } else if (g_str_equal (data->current, "4")) {
+    /* Visit count */
+    sscanf (value, "%lld", &data->visit_count);
+  } else if (g_str_equal (data->current, "5")) {
+    /* Last visit */
+    sscanf (value, "%lld", &data->last_visit);
+  } else if (g_str_equal (data->current, "6")) {
+    /* First visit */
+    sscanf (value, "%lld", &data->first_visit);
+  } else if (g_str_equal (data->current, "10")) {
+    /* Zoom level. */
+    sscanf (value, "%lf", &data->zoom_level);
+  }
+
+  g_free (value);
+  g_free (data->current);
+  data->current = NULL;
+}
+
+static void
+add_visits_cb (EphyHistoryService *service,
+               gboolean success,
+               gpointer result_data,
+               gpointer user_data)
+{
+  ImportData *data = user_data;
+
+  data->pending_chunks--;
+  if (!success)
+    data->failed = TRUE;
+}
+
+static void
+flush_visits (ImportData *data)
+{
+  if (data->visits == NULL)
+    return;
+
+  data->visits = g_list_reverse (data->visits);
+
+  data->pending_chunks++;
+  ephy_history_service_add_visits (data->service, data->visits, NULL,
+                                   (EphyHistoryJobCallback) add_visits_cb, data);
+
+  ephy_history_page_visit_list_free (data->visits);
+  data->visits = NULL;
+  data->n_visits = 0;
+}
+
+static void
+wait_for_pending_chunks (ImportData *data, guint max_pending)
+{
+  while (data->pending_chunks > max_pending)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+history_parse_end_element (GMarkupParseContext *context,
+                           const char          *element_name,
+                           gpointer             user_data,
+                           GError             **error)
+{
+  ImportData *data = user_data;
+  EphyHistoryPageVisit *visit;
+
+  if (!g_str_equal (element_name, "node"))
+    return;
+
+  /* Add one item to History */
+  visit = ephy_history_page_visit_new (data->location ? data->location : "",
+                                       data->last_visit, EPHY_PAGE_VISIT_TYPED);
+  g_free (visit->url->title);
+  visit->url->title = g_strdup (data->title);
+
+  if (data->zoom_level != 1.0) {
+    /* Zoom levels are only stored per host in the old history, so
+     * creating a new host here is OK. */
+    g_assert (!visit->url->host);
+    visit->url->host = ephy_history_host_new (data->location, data->title,
+                                              data->visit_count, data->zoom_level);
+  }
+
+  data->visits = g_list_prepend (data->visits, visit);
+  if (++data->n_visits >= IMPORT_CHUNK_SIZE)
+    flush_visits (data);
+}
+
+static GMarkupParser history_parse_funcs =
+{
+  history_parse_start_element,
+  history_parse_end_element,
+  history_parse_text,
+  NULL,
+  NULL,
+};
+
+/**
+ * ephy_history_import_legacy_file:
+ * @service: the #EphyHistoryService to import into
+ * @filename: path of an ephy-history.xml file
+ * @progress_callback: (allow-none): called as the file is read
+ * @progress_data: user data for @progress_callback
+ * @error: return location for a #GError
+ *
+ * Reads the history file of Epiphany versions before 3.0 and adds every
+ * entry in it as a visit to @service. The file is parsed in pieces and
+ * handed to the history thread in chunks of visits as it goes, so the
+ * whole file is never held in memory.
+ *
+ * This iterates the default main context until the history thread has
+ * stored the last chunk, so it must be called from the thread that owns
+ * it.
+ *
+ * Returns: %TRUE if all the entries were imported
+ **/
+gboolean
+ephy_history_import_legacy_file (EphyHistoryService   *service,
+                                 const char           *filename,
+                                 GFileProgressCallback progress_callback,
+                                 gpointer              progress_data,
+                                 GError              **error)
+{
+  GFile *file;
+  GFileInputStream *input;
+  GFileInfo *info;
+  GMarkupParseContext *context;
+  ImportData data;
+  goffset total = 0, current = 0;
+  char *buffer;
+  gboolean ret = TRUE;
+
+  g_return_val_if_fail (EPHY_IS_HISTORY_SERVICE (service), FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  file = g_file_new_for_path (filename);
+  input = g_file_read (file, NULL, error);
+  g_object_unref (file);
+
+  if (input == NULL)
+    return FALSE;
+
+  info = g_file_input_stream_query_info (input, G_FILE_ATTRIBUTE_STANDARD_SIZE, NULL, NULL);
+  if (info) {
+    total = g_file_info_get_size (info);
+    g_object_unref (info);
+  }
+
+  memset (&data, 0, sizeof (ImportData));
+  data.service = service;
+  data.zoom_level = 1.0;
+
+  buffer = g_malloc (IMPORT_BUFFER_SIZE);
+  context = g_markup_parse_context_new (&history_parse_funcs, 0, &data, NULL);
+
+  while (TRUE) {
+    gssize count;
+
+    count = g_input_stream_read (G_INPUT_STREAM (input), buffer,
+                                 IMPORT_BUFFER_SIZE, NULL, error);
+    if (count < 0) {
+      ret = FALSE;
+      break;
+    }
+
+    if (count == 0) {
+      ret = g_markup_parse_context_end_parse (context, error);
+      break;
+    }
+
+    if (!g_markup_parse_context_parse (context, buffer, count, error)) {
+      ret = FALSE;
+      break;
+    }
+
+    current += count;
+    if (progress_callback)
+      progress_callback (current, MAX (total, current), progress_data);
+
+    wait_for_pending_chunks (&data, IMPORT_MAX_PENDING_CHUNKS);
+  }
+
+  /* Whatever was parsed before an error is still worth keeping. */
+  flush_visits (&data);
+  wait_for_pending_chunks (&data, 0);
+
+  g_markup_parse_context_free (context);
+  g_free (buffer);
+  g_input_stream_close (G_INPUT_STREAM (input), NULL, NULL);
+  g_object_unref (input);
+
+  g_free (data.title);
+  g_free (data.location);
+  g_free (data.current);
+
+  if (ret && data.failed) {
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                         "Could not store the imported history");
+    ret = FALSE;
+  }
+
+  LOG ("Imported legacy history from %s: %s", filename, ret ? "succeeded" : "FAILED");
+
+  return ret;
+}
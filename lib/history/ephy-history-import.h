@@ -0,0 +1,37 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2; -*- */
+/* vim: set sw=2 ts=2 sts=2 et: */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef EPHY_HISTORY_IMPORT_H
+#define EPHY_HISTORY_IMPORT_H
+
+#include <gio/gio.h>
+#include "ephy-history-service.h"
+
+G_BEGIN_DECLS
+
+gboolean ephy_history_import_legacy_file (EphyHistoryService   *service,
+                                          const char           *filename,
+                                          GFileProgressCallback progress_callback,
+                                          gpointer              progress_data,
+                                          GError              **error);
+
+G_END_DECLS
+
+#endif /* EPHY_HISTORY_IMPORT_H */
@@ -31,22 +31,27 @@ ephy_history_service_initialize_hosts_table (EphyHistoryService *self)
   EphyHistoryServicePrivate *priv = EPHY_HISTORY_SERVICE (self)->priv;
   GError *error = NULL;
 
-  if (ephy_sqlite_connection_table_exists (priv->history_database, "hosts")) {
-    return TRUE;
+  if (!ephy_sqlite_connection_table_exists (priv->history_database, "hosts")) {
+    ephy_sqlite_connection_execute (priv->history_database,
+      "CREATE TABLE hosts ("
+      "id INTEGER PRIMARY KEY,"
+      "url LONGVARCAR,"
+      "title LONGVARCAR,"
+      "visit_count INTEGER DEFAULT 0 NOT NULL,"
+      "zoom_level REAL DEFAULT 1.0)", &error);
+
+    if (error) {
+      g_error("Could not create hosts table: %s", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
   }
-  ephy_sqlite_connection_execute (priv->history_database,
-    "CREATE TABLE hosts ("
-    "id INTEGER PRIMARY KEY,"
-    "url LONGVARCAR,"
-    "title LONGVARCAR,"
-    "visit_count INTEGER DEFAULT 0 NOT NULL,"
-    "zoom_level REAL DEFAULT 1.0)", &error);
 
-  if (error) {
-    g_error("Could not create hosts table: %s", error->message);
-    g_error_free (error);
-    return FALSE;
-  }
+  /* Every visit and zoom level change looks its host up by URL. */
+  if (!ephy_sqlite_connection_execute (priv->history_database,
+                                       "CREATE INDEX IF NOT EXISTS hosts_url ON hosts (url)", NULL))
+    g_warning ("Could not create hosts table index");
+
   ephy_history_service_schedule_commit (self);
   return TRUE;
 }
@@ -473,7 +478,8 @@ ephy_history_service_delete_host_row (EphyHistoryService *self,
   g_object_unref (statement);
 }
 
-void
+/* Returns whether any host was deleted. */
+gboolean
 ephy_history_service_delete_orphan_hosts (EphyHistoryService *self)
 {
   EphyHistoryServicePrivate *priv = EPHY_HISTORY_SERVICE (self)->priv;
@@ -495,5 +501,8 @@ ephy_history_service_delete_orphan_hosts (EphyHistoryService *self)
   if (error) {
     g_error ("Couldn't remove orphan hosts from database: %s", error->message);
     g_error_free (error);
+    return FALSE;
   }
+
+  return ephy_sqlite_connection_get_changes (priv->history_database) > 0;
 }
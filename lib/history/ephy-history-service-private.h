@@ -20,6 +20,7 @@
 #ifndef EPHY_HISTORY_SERVICE_PRIVATE_H
 #define EPHY_HISTORY_SERVICE_PRIVATE_H
 
+#include "ephy-metrics.h"
 #include "ephy-sqlite-connection.h"
 
 struct _EphyHistoryServicePrivate {
@@ -29,20 +30,50 @@ struct _EphyHistoryServicePrivate {
   GAsyncQueue *queue;
   gboolean scheduled_to_quit;
   gboolean scheduled_to_commit;
-  int queue_urls_visited_id;
+
+  /* Changes made by the history thread and not yet announced. */
+  GMutex changes_lock;
+  EphyHistoryChanges *pending_changes;
+  gboolean orphan_hosts_deleted;
+  guint changes_source_id;
+
+  /* Retention policy; only used from the history thread. */
+  int retention_max_age_days;
+  int retention_max_visits;
+  int retention_stage;
+  int retention_excess_visits;
+  gint64 retention_idle_delay;
+  gint64 retention_next_run;
+  gint64 retention_size_before;
+
+  /* Per-host zoom levels; only used from the main thread. */
+  GHashTable *zoom_levels;
+  gboolean zoom_levels_loaded;
+  gboolean zoom_levels_loading;
+  guint zoom_levels_generation;
+
+  EphyMetricsCounter *queue_depth_metric;
+  EphyMetricsHistogram *query_metric;
+  EphyMetricsHistogram *write_metric;
 };
 
 void                     ephy_history_service_schedule_commit         (EphyHistoryService *self); 
+void                     ephy_history_service_set_retention_idle_delay (EphyHistoryService *self, gint64 delay);
 gboolean                 ephy_history_service_initialize_urls_table   (EphyHistoryService *self);
 EphyHistoryURL *         ephy_history_service_get_url_row             (EphyHistoryService *self, const char *url_string, EphyHistoryURL *url);
 void                     ephy_history_service_add_url_row             (EphyHistoryService *self, EphyHistoryURL *url);
 void                     ephy_history_service_update_url_row          (EphyHistoryService *self, EphyHistoryURL *url);
 GList*                   ephy_history_service_find_url_rows           (EphyHistoryService *self, EphyHistoryQuery *query);
 void                     ephy_history_service_delete_url              (EphyHistoryService *self, EphyHistoryURL *url);
+void                     ephy_history_service_delete_url_rows         (EphyHistoryService *self, GList *urls);
+GList *                  ephy_history_service_find_unvisited_url_rows (EphyHistoryService *self, int limit);
 
 gboolean                 ephy_history_service_initialize_visits_table (EphyHistoryService *self);
 void                     ephy_history_service_add_visit_row           (EphyHistoryService *self, EphyHistoryPageVisit *visit);
 GList *                  ephy_history_service_find_visit_rows         (EphyHistoryService *self, EphyHistoryQuery *query);
+void                     ephy_history_service_ensure_visits_indices   (EphyHistoryService *self);
+int                      ephy_history_service_count_visit_rows        (EphyHistoryService *self);
+int                      ephy_history_service_expire_visit_rows       (EphyHistoryService *self, gint64 older_than, int limit);
 
 gboolean                 ephy_history_service_initialize_hosts_table  (EphyHistoryService *self);
 void                     ephy_history_service_add_host_row            (EphyHistoryService *self, EphyHistoryHost *host);
@@ -52,6 +83,6 @@ GList *                  ephy_history_service_get_all_hosts           (EphyHisto
 GList*                   ephy_history_service_find_host_rows          (EphyHistoryService *self, EphyHistoryQuery *query);
 EphyHistoryHost *        ephy_history_service_get_host_row_from_url   (EphyHistoryService *self, const gchar *url);
 void                     ephy_history_service_delete_host_row         (EphyHistoryService *self, EphyHistoryHost *host);
-void                     ephy_history_service_delete_orphan_hosts     (EphyHistoryService *self);
+gboolean                 ephy_history_service_delete_orphan_hosts     (EphyHistoryService *self);
 
 #endif /* EPHY_HISTORY_SERVICE_PRIVATE_H */
@@ -23,6 +23,9 @@
 #include "ephy-history-service.h"
 #include "ephy-history-service-private.h"
 
+/* Stay well below SQLITE_MAX_VARIABLE_NUMBER (999 by default). */
+#define DELETE_URLS_CHUNK_SIZE 500
+
 gboolean
 ephy_history_service_initialize_urls_table (EphyHistoryService *self)
 {
@@ -413,3 +416,155 @@ ephy_history_service_delete_url (EphyHistoryService *self, EphyHistoryURL *url)
   }
   g_object_unref (statement);
 }
+
+static void
+delete_url_rows_chunk (EphyHistoryService *self,
+                       const char *column,
+                       GPtrArray *keys,
+                       guint offset,
+                       guint n_keys,
+                       gboolean keys_are_ids)
+{
+  EphyHistoryServicePrivate *priv = EPHY_HISTORY_SERVICE (self)->priv;
+  EphySQLiteStatement *statement = NULL;
+  GString *statement_str;
+  GError *error = NULL;
+  guint i;
+
+  statement_str = g_string_new ("DELETE FROM urls WHERE ");
+  g_string_append_printf (statement_str, "%s IN (?", column);
+  for (i = 1; i < n_keys; i++)
+    statement_str = g_string_append (statement_str, ",?");
+  statement_str = g_string_append (statement_str, ")");
+
+  statement = ephy_sqlite_connection_create_statement (priv->history_database,
+                                                       statement_str->str, &error);
+  g_string_free (statement_str, TRUE);
+
+  if (error) {
+    g_error ("Could not build urls table query statement: %s", error->message);
+    g_error_free (error);
+    return;
+  }
+
+  for (i = 0; i < n_keys; i++) {
+    gpointer key = g_ptr_array_index (keys, offset + i);
+    gboolean bound;
+
+    if (keys_are_ids)
+      bound = ephy_sqlite_statement_bind_int (statement, i, GPOINTER_TO_INT (key), &error);
+    else
+      bound = ephy_sqlite_statement_bind_string (statement, i, (const char *)key, &error);
+
+    if (bound == FALSE) {
+      g_error ("Could not build urls table query statement: %s", error->message);
+      g_error_free (error);
+      g_object_unref (statement);
+      return;
+    }
+  }
+
+  ephy_sqlite_statement_step (statement, &error);
+  if (error) {
+    g_error ("Could not delete URLs from urls table: %s", error->message);
+    g_error_free (error);
+  }
+  g_object_unref (statement);
+}
+
+static void
+delete_url_rows_in_chunks (EphyHistoryService *self,
+                           const char *column,
+                           GPtrArray *keys,
+                           gboolean keys_are_ids)
+{
+  guint offset;
+
+  for (offset = 0; offset < keys->len; offset += DELETE_URLS_CHUNK_SIZE)
+    delete_url_rows_chunk (self, column, keys, offset,
+                           MIN (DELETE_URLS_CHUNK_SIZE, keys->len - offset),
+                           keys_are_ids);
+}
+
+/* Set-based variant of ephy_history_service_delete_url(). Rows are
+ * deleted with one DELETE ... IN (...) statement per chunk of URLs,
+ * within the long-running history transaction; the visits go away
+ * through the ON DELETE CASCADE constraint. */
+void
+ephy_history_service_delete_url_rows (EphyHistoryService *self, GList *urls)
+{
+  EphyHistoryServicePrivate *priv = EPHY_HISTORY_SERVICE (self)->priv;
+  GPtrArray *ids;
+  GPtrArray *strings;
+  GList *l;
+
+  g_assert (priv->history_thread == g_thread_self ());
+  g_assert (priv->history_database != NULL);
+
+  ids = g_ptr_array_new ();
+  strings = g_ptr_array_new ();
+
+  for (l = urls; l != NULL; l = l->next) {
+    EphyHistoryURL *url = (EphyHistoryURL *)l->data;
+
+    if (url->id != -1)
+      g_ptr_array_add (ids, GINT_TO_POINTER (url->id));
+    else if (url->url)
+      g_ptr_array_add (strings, url->url);
+  }
+
+  delete_url_rows_in_chunks (self, "id", ids, TRUE);
+  delete_url_rows_in_chunks (self, "url", strings, FALSE);
+
+  g_ptr_array_free (ids, TRUE);
+  g_ptr_array_free (strings, TRUE);
+}
+
+/* Returns up to @limit URLs which were never visited. URLs whose
+ * visits expired still count their visits, so they are kept. */
+GList *
+ephy_history_service_find_unvisited_url_rows (EphyHistoryService *self, int limit)
+{
+  EphyHistoryServicePrivate *priv = EPHY_HISTORY_SERVICE (self)->priv;
+  EphySQLiteStatement *statement = NULL;
+  GList *urls = NULL;
+  GError *error = NULL;
+
+  g_assert (priv->history_thread == g_thread_self ());
+  g_assert (priv->history_database != NULL);
+
+  statement = ephy_sqlite_connection_create_statement (priv->history_database,
+    "SELECT urls.id, urls.url FROM urls "
+    "WHERE urls.visit_count = 0 "
+    "AND NOT EXISTS (SELECT 1 FROM visits WHERE visits.url = urls.id) "
+    "LIMIT ?", &error);
+  if (error) {
+    g_error ("Could not build urls table query statement: %s", error->message);
+    g_error_free (error);
+    return NULL;
+  }
+
+  if (ephy_sqlite_statement_bind_int (statement, 0, limit, &error) == FALSE) {
+    g_error ("Could not build urls table query statement: %s", error->message);
+    g_error_free (error);
+    g_object_unref (statement);
+    return NULL;
+  }
+
+  while (ephy_sqlite_statement_step (statement, &error)) {
+    EphyHistoryURL *url;
+
+    url = ephy_history_url_new (ephy_sqlite_statement_get_column_as_string (statement, 1),
+                                NULL, 0, 0, 0);
+    url->id = ephy_sqlite_statement_get_column_as_int (statement, 0);
+    urls = g_list_prepend (urls, url);
+  }
+
+  if (error) {
+    g_error ("Could not execute urls table query statement: %s", error->message);
+    g_error_free (error);
+  }
+
+  g_object_unref (statement);
+  return g_list_reverse (urls);
+}
@@ -217,3 +217,106 @@ ephy_history_service_find_visit_rows (EphyHistoryService *self, EphyHistoryQuery
   g_object_unref (statement);
   return visits;
 }
+
+void
+ephy_history_service_ensure_visits_indices (EphyHistoryService *self)
+{
+  EphyHistoryServicePrivate *priv = EPHY_HISTORY_SERVICE (self)->priv;
+
+  g_assert (priv->history_thread == g_thread_self ());
+  g_assert (priv->history_database != NULL);
+
+  /* Both are needed to expire visits and find orphaned URLs without
+   * scanning the whole visits table once per slice. */
+  if (!ephy_sqlite_connection_execute (priv->history_database,
+                                       "CREATE INDEX IF NOT EXISTS visits_visit_time ON visits (visit_time)", NULL) ||
+      !ephy_sqlite_connection_execute (priv->history_database,
+                                       "CREATE INDEX IF NOT EXISTS visits_url ON visits (url)", NULL))
+    g_warning ("Could not create visits table indices");
+  else
+    ephy_history_service_schedule_commit (self);
+}
+
+int
+ephy_history_service_count_visit_rows (EphyHistoryService *self)
+{
+  EphyHistoryServicePrivate *priv = EPHY_HISTORY_SERVICE (self)->priv;
+  EphySQLiteStatement *statement;
+  GError *error = NULL;
+  int count = 0;
+
+  g_assert (priv->history_thread == g_thread_self ());
+  g_assert (priv->history_database != NULL);
+
+  statement = ephy_sqlite_connection_create_statement (priv->history_database,
+                                                       "SELECT COUNT(*) FROM visits", &error);
+  if (error) {
+    g_error ("Could not build visits table query statement: %s", error->message);
+    g_error_free (error);
+    return 0;
+  }
+
+  if (ephy_sqlite_statement_step (statement, &error))
+    count = ephy_sqlite_statement_get_column_as_int (statement, 0);
+
+  if (error) {
+    g_error ("Could not execute visits table query statement: %s", error->message);
+    g_error_free (error);
+  }
+
+  g_object_unref (statement);
+  return count;
+}
+
+/* Deletes at most @limit visits, those older than @older_than when it
+ * is positive or the oldest ones otherwise. Returns the number of
+ * deleted rows. The per-URL aggregates (visit_count, last_visit_time)
+ * live in the urls table, which is not touched here. */
+int
+ephy_history_service_expire_visit_rows (EphyHistoryService *self,
+                                        gint64 older_than,
+                                        int limit)
+{
+  EphyHistoryServicePrivate *priv = EPHY_HISTORY_SERVICE (self)->priv;
+  EphySQLiteStatement *statement;
+  GError *error = NULL;
+  int i = 0;
+  int deleted = 0;
+
+  g_assert (priv->history_thread == g_thread_self ());
+  g_assert (priv->history_database != NULL);
+
+  if (older_than > 0)
+    statement = ephy_sqlite_connection_create_statement (priv->history_database,
+      "DELETE FROM visits WHERE id IN "
+      "  (SELECT id FROM visits WHERE visit_time < ? LIMIT ?)", &error);
+  else
+    statement = ephy_sqlite_connection_create_statement (priv->history_database,
+      "DELETE FROM visits WHERE id IN "
+      "  (SELECT id FROM visits ORDER BY visit_time LIMIT ?)", &error);
+
+  if (error) {
+    g_error ("Could not build visits table deletion statement: %s", error->message);
+    g_error_free (error);
+    return 0;
+  }
+
+  if ((older_than > 0 &&
+       ephy_sqlite_statement_bind_int64 (statement, i++, older_than, &error) == FALSE) ||
+      ephy_sqlite_statement_bind_int (statement, i++, limit, &error) == FALSE) {
+    g_error ("Could not build visits table deletion statement: %s", error->message);
+    g_error_free (error);
+    g_object_unref (statement);
+    return 0;
+  }
+
+  ephy_sqlite_statement_step (statement, &error);
+  if (error) {
+    g_error ("Could not delete visits from visits table: %s", error->message);
+    g_error_free (error);
+  } else
+    deleted = ephy_sqlite_connection_get_changes (priv->history_database);
+
+  g_object_unref (statement);
+  return deleted;
+}
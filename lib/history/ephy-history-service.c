@@ -19,10 +19,32 @@
 #include "config.h"
 #include "ephy-history-service.h"
 
+#include "ephy-debug.h"
 #include "ephy-history-service-private.h"
 #include "ephy-history-types.h"
 #include "ephy-history-type-builtins.h"
 #include "ephy-sqlite-connection.h"
+#include "ephy-string.h"
+
+/* Retention work only starts after the queue has been empty for
+ * RETENTION_IDLE_DELAY, and is split in slices touching at most
+ * RETENTION_SLICE_SIZE rows so that incoming queries wait at most
+ * one slice. All times are in microseconds. */
+#define RETENTION_IDLE_DELAY      (5 * G_USEC_PER_SEC)
+#define RETENTION_SLICE_DELAY     (G_USEC_PER_SEC / 10)
+#define RETENTION_INTERVAL        ((gint64)6 * 60 * 60 * G_USEC_PER_SEC)
+#define RETENTION_SLICE_SIZE      1000
+#define RETENTION_VACUUM_PAGES    128
+#define SECONDS_PER_DAY           (60 * 60 * 24)
+
+typedef enum {
+  RETENTION_STAGE_IDLE,
+  RETENTION_STAGE_EXPIRE_BY_AGE,
+  RETENTION_STAGE_EXPIRE_BY_BUDGET,
+  RETENTION_STAGE_DELETE_UNVISITED_URLS,
+  RETENTION_STAGE_DELETE_ORPHAN_HOSTS,
+  RETENTION_STAGE_VACUUM
+} RetentionStage;
 
 typedef gboolean (*EphyHistoryServiceMethod)                              (EphyHistoryService *self, gpointer data, gpointer *result);
 
@@ -37,6 +59,8 @@ typedef enum {
   DELETE_URLS,
   DELETE_HOST,
   CLEAR,
+  SET_RETENTION_POLICY,
+  SET_RETENTION_IDLE_DELAY,
   /* QUIT */
   QUIT,
   /* READ */
@@ -53,8 +77,10 @@ enum {
   URLS_VISITED,
   CLEARED,
   URL_TITLE_CHANGED,
-  URL_DELETED,
+  URLS_DELETED,
   HOST_DELETED,
+  COMPACTED,
+  CHANGED,
   LAST_SIGNAL
 };
 
@@ -75,7 +101,10 @@ typedef struct _EphyHistoryServiceMessage {
 static gpointer run_history_service_thread                                (EphyHistoryService *self);
 static void ephy_history_service_process_message                          (EphyHistoryService *self, EphyHistoryServiceMessage *message);
 static gboolean ephy_history_service_execute_quit                         (EphyHistoryService *self, gpointer data, gpointer *result);
+static gint64 ephy_history_service_get_retention_timeout                  (EphyHistoryService *self);
+static void ephy_history_service_run_retention_slice                      (EphyHistoryService *self);
 static void ephy_history_service_quit                                     (EphyHistoryService *self, EphyHistoryJobCallback callback, gpointer user_data);
+static void ephy_history_service_invalidate_zoom_levels                   (EphyHistoryService *self);
 
 enum {
   PROP_0,
@@ -126,39 +155,250 @@ ephy_history_service_finalize (GObject *self)
   if (priv->history_thread)
     g_thread_join (priv->history_thread);
 
+  /* The history thread is gone, nothing can queue changes anymore. */
+  if (priv->changes_source_id)
+    g_source_remove (priv->changes_source_id);
+  ephy_history_changes_free (priv->pending_changes);
+  g_mutex_clear (&priv->changes_lock);
+
   g_free (priv->history_filename);
+  g_hash_table_destroy (priv->zoom_levels);
 
   G_OBJECT_CLASS (ephy_history_service_parent_class)->finalize (self);
 }
 
+/* Changes made by the history thread within this many milliseconds
+ * of each other are announced together. */
+#define CHANGES_DELAY 50
+
+static gboolean
+emit_changes (EphyHistoryService *self)
+{
+  EphyHistoryServicePrivate *priv = self->priv;
+  EphyHistoryChanges *changes;
+  gboolean orphan_hosts_deleted;
+  guint i;
+
+  g_mutex_lock (&priv->changes_lock);
+  changes = priv->pending_changes;
+  priv->pending_changes = NULL;
+  orphan_hosts_deleted = priv->orphan_hosts_deleted;
+  priv->orphan_hosts_deleted = FALSE;
+  priv->changes_source_id = 0;
+  g_mutex_unlock (&priv->changes_lock);
+
+  /* Clearing is handled as soon as its job is done. Hosts only go away
+   * along with their URLs without being announced, but their zoom
+   * levels must not be served anymore. */
+  if (orphan_hosts_deleted || (changes && changes->deleted_hosts->len))
+    ephy_history_service_invalidate_zoom_levels (self);
+
+  if (changes == NULL || ephy_history_changes_is_empty (changes)) {
+    ephy_history_changes_free (changes);
+    return FALSE;
+  }
+
+  g_object_ref (self);
+
+  g_signal_emit (self, signals[CHANGED], 0, changes);
+
+  if (changes->cleared)
+    g_signal_emit (self, signals[CLEARED], 0);
+
+  for (i = 0; i < changes->retitled_urls->len; i++) {
+    EphyHistoryURL *url = g_ptr_array_index (changes->retitled_urls, i);
+
+    g_signal_emit (self, signals[URL_TITLE_CHANGED], 0, url->url, url->title);
+  }
+
+  if (changes->deleted_urls->len) {
+    guint n_deleted = changes->deleted_urls->len;
+
+    g_ptr_array_add (changes->deleted_urls, NULL);
+    g_signal_emit (self, signals[URLS_DELETED], 0, changes->deleted_urls->pdata);
+    g_ptr_array_set_size (changes->deleted_urls, n_deleted);
+  }
+
+  for (i = 0; i < changes->deleted_hosts->len; i++)
+    g_signal_emit (self, signals[HOST_DELETED], 0, g_ptr_array_index (changes->deleted_hosts, i));
+
+  if (changes->visited_urls->len)
+    g_signal_emit (self, signals[URLS_VISITED], 0);
+
+  ephy_history_changes_free (changes);
+  g_object_unref (self);
+
+  return FALSE;
+}
+
+static EphyHistoryChanges *
+ephy_history_service_lock_changes (EphyHistoryService *self)
+{
+  EphyHistoryServicePrivate *priv = self->priv;
+
+  g_assert (priv->history_thread == g_thread_self ());
+
+  g_mutex_lock (&priv->changes_lock);
+  if (priv->pending_changes == NULL)
+    priv->pending_changes = ephy_history_changes_new ();
+
+  return priv->pending_changes;
+}
+
 static void
-ephy_history_service_dispose (GObject *self)
+ephy_history_service_unlock_changes (EphyHistoryService *self)
 {
-  EphyHistoryServicePrivate *priv = EPHY_HISTORY_SERVICE (self)->priv;
+  EphyHistoryServicePrivate *priv = self->priv;
+
+  if (priv->changes_source_id == 0)
+    priv->changes_source_id = g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE, CHANGES_DELAY,
+                                                  (GSourceFunc)emit_changes, self, NULL);
+  g_mutex_unlock (&priv->changes_lock);
+}
+
+static int
+find_url (GPtrArray *urls, const char *url_string)
+{
+  guint i;
 
-  if (priv->queue_urls_visited_id) {
-    g_source_remove (priv->queue_urls_visited_id);
-    priv->queue_urls_visited_id = 0;
+  for (i = 0; i < urls->len; i++) {
+    EphyHistoryURL *url = g_ptr_array_index (urls, i);
+
+    if (g_strcmp0 (url->url, url_string) == 0)
+      return i;
   }
+
+  return -1;
 }
 
-static gboolean
-emit_urls_visited (EphyHistoryService *self)
+static int
+find_string (GPtrArray *strings, const char *string)
 {
-  g_signal_emit (self, signals[URLS_VISITED], 0);
-  self->priv->queue_urls_visited_id = 0;
+  guint i;
 
-  return FALSE;
+  for (i = 0; i < strings->len; i++) {
+    if (g_strcmp0 (g_ptr_array_index (strings, i), string) == 0)
+      return i;
+  }
+
+  return -1;
 }
 
+/* Only the latest state of each URL is kept in a batch. */
 static void
-ephy_history_service_queue_urls_visited (EphyHistoryService *self)
+replace_url (GPtrArray *urls, EphyHistoryURL *url)
 {
-  if (self->priv->queue_urls_visited_id)
+  int i = find_url (urls, url->url);
+
+  if (i != -1)
+    g_ptr_array_remove_index (urls, i);
+  g_ptr_array_add (urls, ephy_history_url_copy (url));
+}
+
+static void
+ephy_history_service_record_visit (EphyHistoryService *self,
+                                   EphyHistoryURL *url)
+{
+  EphyHistoryChanges *changes;
+  int i;
+
+  changes = ephy_history_service_lock_changes (self);
+
+  i = find_string (changes->deleted_urls, url->url);
+  if (i != -1)
+    g_ptr_array_remove_index (changes->deleted_urls, i);
+  replace_url (changes->visited_urls, url);
+
+  ephy_history_service_unlock_changes (self);
+}
+
+static void
+ephy_history_service_record_title_change (EphyHistoryService *self,
+                                          EphyHistoryURL *url)
+{
+  EphyHistoryChanges *changes;
+  int i;
+
+  changes = ephy_history_service_lock_changes (self);
+
+  replace_url (changes->retitled_urls, url);
+
+  i = find_url (changes->visited_urls, url->url);
+  if (i != -1) {
+    EphyHistoryURL *visited = g_ptr_array_index (changes->visited_urls, i);
+
+    g_free (visited->title);
+    visited->title = g_strdup (url->title);
+  }
+
+  ephy_history_service_unlock_changes (self);
+}
+
+static void
+ephy_history_service_record_deleted_urls (EphyHistoryService *self,
+                                          GList *urls)
+{
+  EphyHistoryChanges *changes;
+  GList *l;
+
+  changes = ephy_history_service_lock_changes (self);
+
+  for (l = urls; l != NULL; l = l->next) {
+    EphyHistoryURL *url = (EphyHistoryURL *)l->data;
+    int i;
+
+    if (url->url == NULL)
+      continue;
+
+    i = find_url (changes->visited_urls, url->url);
+    if (i != -1)
+      g_ptr_array_remove_index (changes->visited_urls, i);
+    i = find_url (changes->retitled_urls, url->url);
+    if (i != -1)
+      g_ptr_array_remove_index (changes->retitled_urls, i);
+
+    g_ptr_array_add (changes->deleted_urls, g_strdup (url->url));
+  }
+
+  ephy_history_service_unlock_changes (self);
+}
+
+static void
+ephy_history_service_record_deleted_host (EphyHistoryService *self,
+                                          const char *host_url)
+{
+  EphyHistoryChanges *changes;
+
+  changes = ephy_history_service_lock_changes (self);
+  if (find_string (changes->deleted_hosts, host_url) == -1)
+    g_ptr_array_add (changes->deleted_hosts, g_strdup (host_url));
+  ephy_history_service_unlock_changes (self);
+}
+
+static void
+ephy_history_service_delete_orphan_hosts_and_record (EphyHistoryService *self)
+{
+  if (!ephy_history_service_delete_orphan_hosts (self))
     return;
 
-  self->priv->queue_urls_visited_id =
-    g_idle_add_full (G_PRIORITY_LOW, (GSourceFunc)emit_urls_visited, self, NULL);
+  ephy_history_service_lock_changes (self);
+  self->priv->orphan_hosts_deleted = TRUE;
+  ephy_history_service_unlock_changes (self);
+}
+
+static void
+ephy_history_service_record_cleared (EphyHistoryService *self)
+{
+  EphyHistoryServicePrivate *priv = self->priv;
+
+  ephy_history_service_lock_changes (self);
+
+  /* Whatever happened before does not matter anymore. */
+  ephy_history_changes_free (priv->pending_changes);
+  priv->pending_changes = ephy_history_changes_new ();
+  priv->pending_changes->cleared = TRUE;
+
+  ephy_history_service_unlock_changes (self);
 }
 
 static gboolean
@@ -173,8 +413,6 @@ impl_visit_url (EphyHistoryService *self, const char *url, EphyHistoryPageVisitT
                                   visit, NULL, NULL, NULL);
   ephy_history_page_visit_free (visit);
 
-  ephy_history_service_queue_urls_visited (self);
-
   return FALSE;
 }
 
@@ -184,7 +422,6 @@ ephy_history_service_class_init (EphyHistoryServiceClass *klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
 
   gobject_class->finalize = ephy_history_service_finalize;
-  gobject_class->dispose  = ephy_history_service_dispose;
   gobject_class->get_property = ephy_history_service_get_property;
   gobject_class->set_property = ephy_history_service_set_property;
 
@@ -207,7 +444,7 @@ ephy_history_service_class_init (EphyHistoryServiceClass *klass)
  * @service: the #EphyHistoryService that received the signal
  *
  * The ::urls-visited signal is emitted after one or more visits to
- * URLS have taken place. This signal is intended for use-cases when
+ * URLS have been stored, once per batch of changes. This signal is intended for use-cases when
  * precise information of the actual URLS visited is not important and
  * there is only interest in the fact that there have been changes in
  * the history. For more precise information, you can use ::visit-url
@@ -241,15 +478,23 @@ ephy_history_service_class_init (EphyHistoryServiceClass *klass)
                   G_TYPE_STRING | G_SIGNAL_TYPE_STATIC_SCOPE,
                   G_TYPE_STRING | G_SIGNAL_TYPE_STATIC_SCOPE);
 
-  signals[URL_DELETED] =
-    g_signal_new ("url-deleted",
+/**
+ * EphyHistoryService::urls-deleted:
+ * @service: the #EphyHistoryService that received the signal
+ * @urls: a %NULL-terminated array with the URLs that were deleted
+ *
+ * The ::urls-deleted signal is emitted once per batch of changes,
+ * with all the URLs removed from the history since the previous one.
+ **/
+  signals[URLS_DELETED] =
+    g_signal_new ("urls-deleted",
                   G_OBJECT_CLASS_TYPE (gobject_class),
                   G_SIGNAL_RUN_LAST,
                   0, NULL, NULL,
-                  g_cclosure_marshal_VOID__STRING,
+                  g_cclosure_marshal_VOID__BOXED,
                   G_TYPE_NONE,
                   1,
-                  G_TYPE_STRING | G_SIGNAL_TYPE_STATIC_SCOPE);
+                  G_TYPE_STRV | G_SIGNAL_TYPE_STATIC_SCOPE);
 
   signals[HOST_DELETED] =
     g_signal_new ("host-deleted",
@@ -261,6 +506,51 @@ ephy_history_service_class_init (EphyHistoryServiceClass *klass)
                   1,
                   G_TYPE_STRING | G_SIGNAL_TYPE_STATIC_SCOPE);
 
+/**
+ * EphyHistoryService::compacted:
+ * @service: the #EphyHistoryService that received the signal
+ * @size_before: the size of the database, in bytes, before expiring visits
+ * @size_after: the size of the database, in bytes, after compaction
+ *
+ * The ::compacted signal is emitted each time the retention policy
+ * set with ephy_history_service_set_retention_policy() has been
+ * applied to the whole database.
+ **/
+  signals[COMPACTED] =
+    g_signal_new ("compacted",
+                  G_OBJECT_CLASS_TYPE (gobject_class),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_generic,
+                  G_TYPE_NONE,
+                  2,
+                  G_TYPE_INT64,
+                  G_TYPE_INT64);
+
+/**
+ * EphyHistoryService::changed:
+ * @service: the #EphyHistoryService that received the signal
+ * @changes: an #EphyHistoryChanges
+ *
+ * The ::changed signal is emitted on the main thread at most once
+ * every few tens of milliseconds with all the changes the history
+ * thread made since the previous emission, before the more specific
+ * signals for the same changes. If @changes is cleared, every change
+ * listed in it happened after the history was cleared.
+ *
+ * Only visits added with ephy_history_service_add_visit() are listed,
+ * a bulk import with ephy_history_service_add_visits() is not.
+ **/
+  signals[CHANGED] =
+    g_signal_new ("changed",
+                  G_OBJECT_CLASS_TYPE (gobject_class),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__POINTER,
+                  G_TYPE_NONE,
+                  1,
+                  G_TYPE_POINTER);
+
   g_object_class_install_property (gobject_class,
                                    PROP_HISTORY_FILENAME,
                                    g_param_spec_string ("history-filename",
@@ -277,6 +567,17 @@ ephy_history_service_init (EphyHistoryService *self)
 {
   self->priv = EPHY_HISTORY_SERVICE_GET_PRIVATE (self);
 
+  self->priv->queue_depth_metric = ephy_metrics_counter_get ("history.queue-depth");
+  self->priv->query_metric = ephy_metrics_histogram_get ("history.query");
+  self->priv->write_metric = ephy_metrics_histogram_get ("history.write");
+
+  g_mutex_init (&self->priv->changes_lock);
+
+  self->priv->retention_idle_delay = RETENTION_IDLE_DELAY;
+
+  self->priv->zoom_levels = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                   g_free, g_free);
+
   self->priv->history_thread = g_thread_new ("EphyHistoryService", (GThreadFunc) run_history_service_thread, self);
   self->priv->queue = g_async_queue_new ();
 }
@@ -301,6 +602,7 @@ ephy_history_service_send_message (EphyHistoryService *self, EphyHistoryServiceM
   EphyHistoryServicePrivate *priv = self->priv;
 
   g_async_queue_push_sorted (priv->queue, message, (GCompareDataFunc)sort_messages, NULL);
+  ephy_metrics_counter_set (priv->queue_depth_metric, g_async_queue_length (priv->queue));
 }
 
 static void
@@ -365,6 +667,11 @@ ephy_history_service_open_database_connections (EphyHistoryService *self)
 
   ephy_history_service_enable_foreign_keys (self);
 
+  /* Only effective for databases created from now on; for older ones
+   * PRAGMA incremental_vacuum is a no-op. */
+  ephy_sqlite_connection_execute (priv->history_database,
+                                  "PRAGMA auto_vacuum = INCREMENTAL", NULL);
+
   ephy_sqlite_connection_begin_transaction (priv->history_database, &error);
   if (error) {
     g_error ("Could not begin long running transaction in history database: %s", error->message);
@@ -457,12 +764,24 @@ run_history_service_thread (EphyHistoryService *self)
   do {
     message = g_async_queue_try_pop (priv->queue);
     if (!message) {
+      gint64 timeout;
+
       /* Schedule commit if needed. */
       if (ephy_history_service_is_scheduled_to_commit (self))
         ephy_history_service_commit (self);
 
-      /* Block the thread until there's data in the queue. */
-      message = g_async_queue_pop (priv->queue);
+      timeout = ephy_history_service_get_retention_timeout (self);
+      if (timeout > 0) {
+        /* Apply the retention policy when the queue stays idle. */
+        message = g_async_queue_timeout_pop (priv->queue, timeout);
+        if (!message) {
+          ephy_history_service_run_retention_slice (self);
+          continue;
+        }
+      } else {
+        /* Block the thread until there's data in the queue. */
+        message = g_async_queue_pop (priv->queue);
+      }
     }
 
     /* Process item. */
@@ -516,6 +835,11 @@ ephy_history_service_execute_job_callback (gpointer data)
 
   g_assert (message->callback || message->type == CLEAR);
 
+  /* The history is gone even if the caller is no longer interested,
+   * and zoom levels must not be served from the cache meanwhile. */
+  if (message->type == CLEAR)
+    ephy_history_service_invalidate_zoom_levels (message->service);
+
   if (g_cancellable_is_cancelled (message->cancellable)) {
     ephy_history_service_message_free (message);
     return FALSE;
@@ -524,9 +848,6 @@ ephy_history_service_execute_job_callback (gpointer data)
   if (message->callback)
     message->callback (message->service, message->success, message->result, message->user_data);
 
-  if (message->type == CLEAR)
-    g_signal_emit (message->service, signals[CLEARED], 0);
-    
   ephy_history_service_message_free (message);
 
   return FALSE;
@@ -611,20 +932,229 @@ ephy_history_service_execute_add_visit (EphyHistoryService *self, EphyHistoryPag
   g_assert (self->priv->history_thread == g_thread_self ());
 
   success = ephy_history_service_execute_add_visit_helper (self, visit);
+  if (success)
+    ephy_history_service_record_visit (self, visit->url);
+
   return success;
 }
 
+/* State shared by all the visits of one ADD_VISITS message. Statements
+ * are prepared once and reset between visits, and hosts are looked up
+ * once and written back once, when the batch is done. */
+typedef struct {
+  EphyHistoryService *service;
+  GHashTable *hosts_by_key;
+  GHashTable *hosts;
+  EphySQLiteStatement *select_url;
+  EphySQLiteStatement *insert_url;
+  EphySQLiteStatement *update_url;
+  EphySQLiteStatement *insert_visit;
+} AddVisitsBatch;
+
+static EphySQLiteStatement *
+add_visits_batch_prepare (AddVisitsBatch *batch, const char *sql)
+{
+  EphySQLiteStatement *statement;
+  GError *error = NULL;
+
+  statement = ephy_sqlite_connection_create_statement (batch->service->priv->history_database,
+                                                       sql, &error);
+  if (error) {
+    g_error ("Could not build visits batch statement: %s", error->message);
+    g_error_free (error);
+  }
+
+  return statement;
+}
+
+static AddVisitsBatch *
+add_visits_batch_new (EphyHistoryService *self)
+{
+  AddVisitsBatch *batch = g_slice_new0 (AddVisitsBatch);
+
+  batch->service = self;
+  batch->hosts_by_key = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  batch->hosts = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                        NULL, (GDestroyNotify) ephy_history_host_free);
+
+  batch->select_url = add_visits_batch_prepare (batch,
+    "SELECT id FROM urls WHERE url=?");
+  batch->insert_url = add_visits_batch_prepare (batch,
+    "INSERT INTO urls (url, title, visit_count, typed_count, last_visit_time, host) "
+    " VALUES (?, ?, 1, ?, ?, ?)");
+  batch->update_url = add_visits_batch_prepare (batch,
+    "UPDATE urls SET title=COALESCE(?, title), visit_count=visit_count+1, "
+    "last_visit_time=MAX(last_visit_time, ?) WHERE id=?");
+  batch->insert_visit = add_visits_batch_prepare (batch,
+    "INSERT INTO visits (url, visit_time, visit_type) "
+    " VALUES (?, ?, ?) ");
+
+  return batch;
+}
+
+static void
+add_visits_batch_free (AddVisitsBatch *batch)
+{
+  GHashTableIter iter;
+  EphyHistoryHost *host;
+
+  /* Every cached host got at least one visit, write them all back. */
+  g_hash_table_iter_init (&iter, batch->hosts);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &host))
+    ephy_history_service_update_host_row (batch->service, host);
+
+  g_clear_object (&batch->select_url);
+  g_clear_object (&batch->insert_url);
+  g_clear_object (&batch->update_url);
+  g_clear_object (&batch->insert_visit);
+
+  g_hash_table_destroy (batch->hosts_by_key);
+  g_hash_table_destroy (batch->hosts);
+
+  g_slice_free (AddVisitsBatch, batch);
+}
+
+/* URLs with the same scheme and host name always resolve to the same
+ * host row, so that is all we need to key the cache on. */
+static char *
+get_host_cache_key (const char *url)
+{
+  char *scheme, *hostname, *key;
+
+  scheme = g_uri_parse_scheme (url);
+  hostname = ephy_string_get_host_name (url);
+  key = g_strconcat (scheme ? scheme : "", "://", hostname ? hostname : "", NULL);
+
+  g_free (scheme);
+  g_free (hostname);
+
+  return key;
+}
+
+static EphyHistoryHost *
+add_visits_batch_get_host (AddVisitsBatch *batch, const char *url)
+{
+  EphyHistoryHost *host, *cached;
+  char *key;
+
+  key = get_host_cache_key (url);
+  host = g_hash_table_lookup (batch->hosts_by_key, key);
+  if (host) {
+    g_free (key);
+    return host;
+  }
+
+  host = ephy_history_service_get_host_row_from_url (batch->service, url);
+
+  /* Different keys can still end up in the same row, e.g. the https
+   * and http versions of a site, keep a single copy of it. */
+  cached = g_hash_table_lookup (batch->hosts, GINT_TO_POINTER (host->id));
+  if (cached) {
+    ephy_history_host_free (host);
+    host = cached;
+  } else
+    g_hash_table_insert (batch->hosts, GINT_TO_POINTER (host->id), host);
+
+  g_hash_table_insert (batch->hosts_by_key, key, host);
+
+  return host;
+}
+
+static gboolean
+add_visits_batch_add (AddVisitsBatch *batch, EphyHistoryPageVisit *visit)
+{
+  EphyHistoryService *self = batch->service;
+  EphyHistoryURL *url = visit->url;
+  EphyHistoryHost *host;
+  GError *error = NULL;
+
+  host = add_visits_batch_get_host (batch, url->url);
+  host->visit_count++;
+
+  /* See ephy_history_service_execute_add_visit_helper(). */
+  if (url->host && url->host->id == -1)
+    host->zoom_level = url->host->zoom_level;
+
+  ephy_sqlite_statement_reset (batch->select_url);
+  if (!ephy_sqlite_statement_bind_string (batch->select_url, 0, url->url, &error)) {
+    g_error ("Could not build urls table query statement: %s", error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+
+  if (ephy_sqlite_statement_step (batch->select_url, &error)) {
+    url->id = ephy_sqlite_statement_get_column_as_int (batch->select_url, 0);
+
+    ephy_sqlite_statement_reset (batch->update_url);
+    if (ephy_sqlite_statement_bind_string (batch->update_url, 0, url->title, &error) == FALSE ||
+        ephy_sqlite_statement_bind_int (batch->update_url, 1, visit->visit_time, &error) == FALSE ||
+        ephy_sqlite_statement_bind_int (batch->update_url, 2, url->id, &error) == FALSE) {
+      g_error ("Could not modify URL in urls table: %s", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+    ephy_sqlite_statement_step (batch->update_url, &error);
+  } else if (error == NULL) {
+    ephy_sqlite_statement_reset (batch->insert_url);
+    if (ephy_sqlite_statement_bind_string (batch->insert_url, 0, url->url, &error) == FALSE ||
+        ephy_sqlite_statement_bind_string (batch->insert_url, 1, url->title, &error) == FALSE ||
+        ephy_sqlite_statement_bind_int (batch->insert_url, 2, url->typed_count, &error) == FALSE ||
+        ephy_sqlite_statement_bind_int (batch->insert_url, 3, visit->visit_time, &error) == FALSE ||
+        ephy_sqlite_statement_bind_int (batch->insert_url, 4, host->id, &error) == FALSE) {
+      g_error ("Could not insert URL into urls table: %s", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+    ephy_sqlite_statement_step (batch->insert_url, &error);
+    if (error == NULL)
+      url->id = ephy_sqlite_connection_get_last_insert_id (self->priv->history_database);
+  }
+
+  if (error) {
+    g_error ("Adding visit failed: %s", error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+
+  ephy_sqlite_statement_reset (batch->insert_visit);
+  if (ephy_sqlite_statement_bind_int (batch->insert_visit, 0, url->id, &error) == FALSE ||
+      ephy_sqlite_statement_bind_int (batch->insert_visit, 1, visit->visit_time, &error) == FALSE ||
+      ephy_sqlite_statement_bind_int (batch->insert_visit, 2, visit->visit_type, &error) == FALSE) {
+    g_error ("Could not build visits table addition statement: %s", error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+
+  ephy_sqlite_statement_step (batch->insert_visit, &error);
+  if (error) {
+    g_error ("Could not insert URL into visits table: %s", error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+
+  visit->id = ephy_sqlite_connection_get_last_insert_id (self->priv->history_database);
+
+  return TRUE;
+}
+
 static gboolean
 ephy_history_service_execute_add_visits (EphyHistoryService *self, GList *visits, gpointer *result)
 {
+  AddVisitsBatch *batch;
   gboolean success = TRUE;
   g_assert (self->priv->history_thread == g_thread_self ());
 
+  batch = add_visits_batch_new (self);
+
   while (visits) {
-    success = success && ephy_history_service_execute_add_visit_helper (self, (EphyHistoryPageVisit *) visits->data);
+    success = success && add_visits_batch_add (batch, (EphyHistoryPageVisit *) visits->data);
     visits = visits->next;
   }
 
+  add_visits_batch_free (batch);
+
   ephy_history_service_schedule_commit (self);
 
   return success;
@@ -792,16 +1322,6 @@ ephy_history_service_query_hosts (EphyHistoryService *self,
   ephy_history_service_send_message (self, message);
 }
 
-static gboolean
-set_url_title_signal_emit (SignalEmissionContext *ctx)
-{
-  EphyHistoryURL *url = (EphyHistoryURL *)ctx->user_data;
-
-  g_signal_emit (ctx->service, signals[URL_TITLE_CHANGED], 0, url->url, url->title);
-
-  return FALSE;
-}
-
 static gboolean
 ephy_history_service_execute_set_url_title (EphyHistoryService *self,
                                             EphyHistoryURL *url,
@@ -814,19 +1334,12 @@ ephy_history_service_execute_set_url_title (EphyHistoryService *self,
     g_free (title);
     return FALSE;
   } else {
-    SignalEmissionContext *ctx;
-
     g_free (url->title);
     url->title = title;
     ephy_history_service_update_url_row (self, url);
     ephy_history_service_schedule_commit (self);
 
-    ctx = signal_emission_context_new (self,
-                                       ephy_history_url_copy (url),
-                                       (GDestroyNotify)ephy_history_url_free);
-    g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-                     (GSourceFunc)set_url_title_signal_emit,
-                     ctx, (GDestroyNotify)signal_emission_context_free);
+    ephy_history_service_record_title_change (self, url);
     return TRUE;
   }
 }
@@ -852,6 +1365,48 @@ ephy_history_service_set_url_title (EphyHistoryService *self,
   ephy_history_service_send_message (self, message);
 }
 
+/* Hosts are stored once per scheme and with and without "www.", and
+ * looked up through all of those aliases, so the cache is keyed on
+ * the bare host name. Other schemes always go through the database. */
+static char *
+get_zoom_level_key (const char *url)
+{
+  char *hostname;
+  char *key;
+
+  if (!g_str_has_prefix (url, "http://") && !g_str_has_prefix (url, "https://"))
+    return NULL;
+
+  hostname = ephy_string_get_host_name (url);
+  if (hostname == NULL)
+    return NULL;
+
+  if (g_str_has_prefix (hostname, "www.")) {
+    key = g_strdup (hostname + 4);
+    g_free (hostname);
+  } else
+    key = hostname;
+
+  return key;
+}
+
+static void
+set_cached_zoom_level (EphyHistoryService *self,
+                       const char *url,
+                       double zoom_level)
+{
+  char *key;
+
+  key = get_zoom_level_key (url);
+  if (key == NULL)
+    return;
+
+  /* Written through even before the cache is loaded, so that the
+   * load does not bring back a zoom level older than this one. */
+  g_hash_table_insert (self->priv->zoom_levels, key,
+                       g_memdup (&zoom_level, sizeof (double)));
+}
+
 static gboolean
 ephy_history_service_execute_set_url_zoom_level (EphyHistoryService *self,
                                                  GVariant *variant,
@@ -895,6 +1450,120 @@ ephy_history_service_set_url_zoom_level (EphyHistoryService *self,
                                               variant, (GDestroyNotify)g_variant_unref,
                                               cancellable, callback, user_data);
   ephy_history_service_send_message (self, message);
+
+  set_cached_zoom_level (self, url, zoom_level);
+}
+
+static void
+load_zoom_levels_cb (EphyHistoryService *self,
+                     gboolean success,
+                     GList *hosts,
+                     gpointer user_data)
+{
+  EphyHistoryServicePrivate *priv = self->priv;
+  GList *l;
+
+  /* The hosts table changed while it was being read. */
+  if (GPOINTER_TO_UINT (user_data) != priv->zoom_levels_generation) {
+    g_list_free_full (hosts, (GDestroyNotify)ephy_history_host_free);
+    return;
+  }
+
+  for (l = hosts; l != NULL; l = l->next) {
+    EphyHistoryHost *host = (EphyHistoryHost *)l->data;
+    char *key;
+
+    if (host->zoom_level == 1.0)
+      continue;
+
+    key = get_zoom_level_key (host->url);
+    if (key == NULL)
+      continue;
+
+    /* Zoom levels set since the hosts were read are more recent. */
+    if (g_hash_table_contains (priv->zoom_levels, key)) {
+      g_free (key);
+      continue;
+    }
+
+    g_hash_table_insert (priv->zoom_levels, key,
+                         g_memdup (&host->zoom_level, sizeof (double)));
+  }
+
+  priv->zoom_levels_loaded = success;
+  priv->zoom_levels_loading = FALSE;
+  g_list_free_full (hosts, (GDestroyNotify)ephy_history_host_free);
+}
+
+static void
+ephy_history_service_load_zoom_levels (EphyHistoryService *self)
+{
+  EphyHistoryServicePrivate *priv = self->priv;
+
+  if (priv->zoom_levels_loaded || priv->zoom_levels_loading)
+    return;
+
+  priv->zoom_levels_loading = TRUE;
+  ephy_history_service_get_hosts (self, NULL,
+                                  (EphyHistoryJobCallback)load_zoom_levels_cb,
+                                  GUINT_TO_POINTER (priv->zoom_levels_generation));
+}
+
+static void
+ephy_history_service_invalidate_zoom_levels (EphyHistoryService *self)
+{
+  EphyHistoryServicePrivate *priv = self->priv;
+
+  g_hash_table_remove_all (priv->zoom_levels);
+  priv->zoom_levels_loaded = FALSE;
+  priv->zoom_levels_loading = FALSE;
+  priv->zoom_levels_generation++;
+}
+
+/**
+ * ephy_history_service_get_cached_zoom_level:
+ * @self: an #EphyHistoryService
+ * @url: the URL of a web page
+ * @zoom_level: (out): return location for the zoom level of its host
+ *
+ * Looks up the zoom level stored for the host of @url without going
+ * through the history thread. The zoom levels of all hosts are loaded
+ * the first time this is called, and after history is cleared or
+ * hosts are deleted; until they are, %FALSE is returned and
+ * ephy_history_service_get_host_for_url() should be used instead.
+ *
+ * Returns: %TRUE if @zoom_level was set
+ **/
+gboolean
+ephy_history_service_get_cached_zoom_level (EphyHistoryService *self,
+                                            const char *url,
+                                            double *zoom_level)
+{
+  EphyHistoryServicePrivate *priv;
+  double *cached;
+  char *key;
+
+  g_return_val_if_fail (EPHY_IS_HISTORY_SERVICE (self), FALSE);
+  g_return_val_if_fail (url != NULL, FALSE);
+  g_return_val_if_fail (zoom_level != NULL, FALSE);
+
+  priv = self->priv;
+
+  key = get_zoom_level_key (url);
+  if (key == NULL)
+    return FALSE;
+
+  if (!priv->zoom_levels_loaded) {
+    ephy_history_service_load_zoom_levels (self);
+    g_free (key);
+    return FALSE;
+  }
+
+  cached = g_hash_table_lookup (priv->zoom_levels, key);
+  *zoom_level = cached ? *cached : 1.0;
+  g_free (key);
+
+  return TRUE;
 }
 
 static gboolean
@@ -1046,51 +1715,18 @@ ephy_history_service_get_host_for_url (EphyHistoryService *self,
   ephy_history_service_send_message (self, message);
 }
 
-static gboolean
-delete_urls_signal_emit (SignalEmissionContext *ctx)
-{
-  char *url = (char *)ctx->user_data;
-
-  g_signal_emit (ctx->service, signals[URL_DELETED], 0, url);
-
-  return FALSE;
-}
-
 static gboolean
 ephy_history_service_execute_delete_urls (EphyHistoryService *self,
                                           GList *urls,
                                           gpointer *result)
 {
-  GList *l;
-  EphyHistoryURL *url;
-  SignalEmissionContext *ctx;
-
-  for (l = urls; l != NULL; l = l->next) {
-    url = l->data;
-    ephy_history_service_delete_url (self, url);
-
-    ctx = signal_emission_context_new (self, g_strdup (url->url),
-                                       (GDestroyNotify) g_free);
-    g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-                     (GSourceFunc)delete_urls_signal_emit,
-                     ctx,
-                     (GDestroyNotify)signal_emission_context_free);
-  }
-
-  ephy_history_service_delete_orphan_hosts (self);
+  ephy_history_service_delete_url_rows (self, urls);
+  ephy_history_service_delete_orphan_hosts_and_record (self);
   ephy_history_service_schedule_commit (self);
 
-  return TRUE;
-}
-
-static gboolean
-delete_host_signal_emit (SignalEmissionContext *ctx)
-{
-  char *host = (char *)ctx->user_data;
-
-  g_signal_emit (ctx->service, signals[HOST_DELETED], 0, host);
+  ephy_history_service_record_deleted_urls (self, urls);
 
-  return FALSE;
+  return TRUE;
 }
 
 static gboolean
@@ -1099,17 +1735,10 @@ ephy_history_service_execute_delete_host (EphyHistoryService *self,
                                           EphyHistoryJobCallback callback,
                                           gpointer user_data)
 {
-  SignalEmissionContext *ctx;
-
   ephy_history_service_delete_host_row (self, host);
   ephy_history_service_schedule_commit (self);
 
-  ctx = signal_emission_context_new (self, g_strdup (host->url),
-                                     (GDestroyNotify)g_free);
-  g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-                   (GSourceFunc) delete_host_signal_emit,
-                   ctx,
-                   (GDestroyNotify) signal_emission_context_free);
+  ephy_history_service_record_deleted_host (self, host->url);
 
   return TRUE;
 }
@@ -1123,6 +1752,8 @@ ephy_history_service_execute_clear (EphyHistoryService *self,
   ephy_history_service_clear_all (self);
   ephy_history_service_schedule_commit (self);
 
+  ephy_history_service_record_cleared (self);
+
   return TRUE;
 }
 
@@ -1174,6 +1805,246 @@ ephy_history_service_clear (EphyHistoryService *self,
   ephy_history_service_send_message (self, message);
 }
 
+static gboolean
+compacted_signal_emit (SignalEmissionContext *ctx)
+{
+  gint64 size_before, size_after;
+
+  g_variant_get ((GVariant *)ctx->user_data, "(xx)", &size_before, &size_after);
+  g_signal_emit (ctx->service, signals[COMPACTED], 0, size_before, size_after);
+
+  return FALSE;
+}
+
+static int
+ephy_history_service_get_pragma (EphyHistoryService *self,
+                                 const char *sql)
+{
+  EphySQLiteStatement *statement;
+  GError *error = NULL;
+  int value = 0;
+
+  statement = ephy_sqlite_connection_create_statement (self->priv->history_database,
+                                                       sql, &error);
+  if (error) {
+    g_warning ("Could not query history database: %s", error->message);
+    g_error_free (error);
+    return 0;
+  }
+
+  if (ephy_sqlite_statement_step (statement, &error))
+    value = ephy_sqlite_statement_get_column_as_int (statement, 0);
+
+  if (error) {
+    g_warning ("Could not query history database: %s", error->message);
+    g_error_free (error);
+  }
+
+  g_object_unref (statement);
+  return value;
+}
+
+static gint64
+ephy_history_service_get_database_size (EphyHistoryService *self)
+{
+  return (gint64)ephy_history_service_get_pragma (self, "PRAGMA page_count") *
+    ephy_history_service_get_pragma (self, "PRAGMA page_size");
+}
+
+static gint64
+ephy_history_service_get_retention_timeout (EphyHistoryService *self)
+{
+  EphyHistoryServicePrivate *priv = self->priv;
+  gint64 now;
+
+  if (priv->history_database == NULL ||
+      (priv->retention_max_age_days <= 0 && priv->retention_max_visits <= 0))
+    return 0;
+
+  if (priv->retention_stage != RETENTION_STAGE_IDLE)
+    return RETENTION_SLICE_DELAY;
+
+  now = g_get_monotonic_time ();
+
+  return MAX (priv->retention_idle_delay, priv->retention_next_run - now);
+}
+
+static void
+ephy_history_service_finish_retention (EphyHistoryService *self)
+{
+  EphyHistoryServicePrivate *priv = self->priv;
+  SignalEmissionContext *ctx;
+  gint64 size_after;
+
+  size_after = ephy_history_service_get_database_size (self);
+
+  LOG ("History retention done, database size went from %" G_GINT64_FORMAT
+       " to %" G_GINT64_FORMAT " bytes", priv->retention_size_before, size_after);
+
+  ctx = signal_emission_context_new (self,
+                                     g_variant_new ("(xx)", priv->retention_size_before, size_after),
+                                     (GDestroyNotify)g_variant_unref);
+  g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                   (GSourceFunc)compacted_signal_emit,
+                   ctx,
+                   (GDestroyNotify)signal_emission_context_free);
+
+  priv->retention_stage = RETENTION_STAGE_IDLE;
+  priv->retention_next_run = g_get_monotonic_time () + RETENTION_INTERVAL;
+}
+
+/* Runs one bounded step of the retention policy. Each stage moves on
+ * to the next one once a slice comes back short. */
+static void
+ephy_history_service_run_retention_slice (EphyHistoryService *self)
+{
+  EphyHistoryServicePrivate *priv = self->priv;
+  GList *urls;
+  int deleted;
+
+  g_assert (priv->history_thread == g_thread_self ());
+
+  switch (priv->retention_stage) {
+  case RETENTION_STAGE_IDLE:
+    priv->retention_size_before = ephy_history_service_get_database_size (self);
+    ephy_history_service_ensure_visits_indices (self);
+    priv->retention_stage = RETENTION_STAGE_EXPIRE_BY_AGE;
+    break;
+  case RETENTION_STAGE_EXPIRE_BY_AGE:
+    if (priv->retention_max_age_days > 0) {
+      gint64 cutoff = time (NULL) - (gint64)priv->retention_max_age_days * SECONDS_PER_DAY;
+
+      deleted = ephy_history_service_expire_visit_rows (self, cutoff, RETENTION_SLICE_SIZE);
+      if (deleted == RETENTION_SLICE_SIZE)
+        break;
+    }
+
+    priv->retention_excess_visits = 0;
+    if (priv->retention_max_visits > 0)
+      priv->retention_excess_visits = MAX (0, ephy_history_service_count_visit_rows (self) - priv->retention_max_visits);
+    priv->retention_stage = RETENTION_STAGE_EXPIRE_BY_BUDGET;
+    break;
+  case RETENTION_STAGE_EXPIRE_BY_BUDGET:
+    if (priv->retention_excess_visits > 0) {
+      deleted = ephy_history_service_expire_visit_rows (self, 0,
+                                                        MIN (priv->retention_excess_visits, RETENTION_SLICE_SIZE));
+      priv->retention_excess_visits -= deleted;
+      if (deleted > 0 && priv->retention_excess_visits > 0)
+        break;
+    }
+    priv->retention_stage = RETENTION_STAGE_DELETE_UNVISITED_URLS;
+    break;
+  case RETENTION_STAGE_DELETE_UNVISITED_URLS:
+    /* URLs whose visits expired keep their aggregates, only those that
+     * were never visited are dropped. */
+    urls = ephy_history_service_find_unvisited_url_rows (self, RETENTION_SLICE_SIZE);
+    if (urls) {
+      ephy_history_service_delete_url_rows (self, urls);
+      ephy_history_service_record_deleted_urls (self, urls);
+      deleted = g_list_length (urls);
+      ephy_history_url_list_free (urls);
+      if (deleted == RETENTION_SLICE_SIZE)
+        break;
+    }
+    priv->retention_stage = RETENTION_STAGE_DELETE_ORPHAN_HOSTS;
+    break;
+  case RETENTION_STAGE_DELETE_ORPHAN_HOSTS:
+    ephy_history_service_delete_orphan_hosts_and_record (self);
+    priv->retention_stage = RETENTION_STAGE_VACUUM;
+    break;
+  case RETENTION_STAGE_VACUUM:
+    if (ephy_history_service_get_pragma (self, "PRAGMA freelist_count") > 0 &&
+        ephy_history_service_get_pragma (self, "PRAGMA auto_vacuum") == 2) {
+      char *sql = g_strdup_printf ("PRAGMA incremental_vacuum(%d)", RETENTION_VACUUM_PAGES);
+      gboolean success = ephy_sqlite_connection_execute (priv->history_database, sql, NULL);
+
+      g_free (sql);
+      if (success)
+        break;
+    }
+    ephy_history_service_finish_retention (self);
+    break;
+  default:
+    g_assert_not_reached ();
+  }
+
+  ephy_history_service_schedule_commit (self);
+}
+
+static gboolean
+ephy_history_service_execute_set_retention_policy (EphyHistoryService *self,
+                                                   GVariant *variant,
+                                                   gpointer *result)
+{
+  EphyHistoryServicePrivate *priv = self->priv;
+
+  g_variant_get (variant, "(ii)", &priv->retention_max_age_days, &priv->retention_max_visits);
+
+  /* Apply the new policy at the next idle period. */
+  if (priv->retention_stage == RETENTION_STAGE_IDLE)
+    priv->retention_next_run = 0;
+
+  return TRUE;
+}
+
+/**
+ * ephy_history_service_set_retention_policy:
+ * @self: an #EphyHistoryService
+ * @max_age_days: visits older than this many days are expired, or 0
+ * @max_visits: maximum number of visits to keep, or 0 for no limit
+ *
+ * Sets the policy used to expire old visits. It is applied on the
+ * history thread whenever the service has been idle for a while, and
+ * then periodically, and the database is compacted afterwards. URLs
+ * keep their visit count and last visit time when their visits
+ * expire; only URLs that were never visited are deleted. Pass 0 for
+ * both limits to disable it.
+ **/
+void
+ephy_history_service_set_retention_policy (EphyHistoryService *self,
+                                           int max_age_days,
+                                           int max_visits)
+{
+  EphyHistoryServiceMessage *message;
+
+  g_return_if_fail (EPHY_IS_HISTORY_SERVICE (self));
+  g_return_if_fail (max_age_days >= 0 && max_visits >= 0);
+
+  message = ephy_history_service_message_new (self, SET_RETENTION_POLICY,
+                                              g_variant_new ("(ii)", max_age_days, max_visits),
+                                              (GDestroyNotify)g_variant_unref,
+                                              NULL, NULL, NULL);
+  ephy_history_service_send_message (self, message);
+}
+
+static gboolean
+ephy_history_service_execute_set_retention_idle_delay (EphyHistoryService *self,
+                                                       GVariant *variant,
+                                                       gpointer *result)
+{
+  self->priv->retention_idle_delay = g_variant_get_int64 (variant);
+
+  return TRUE;
+}
+
+/* Sets how long the queue has to stay empty before the retention
+ * policy runs, in microseconds. Only meant for the tests. */
+void
+ephy_history_service_set_retention_idle_delay (EphyHistoryService *self,
+                                               gint64 delay)
+{
+  EphyHistoryServiceMessage *message;
+
+  g_return_if_fail (EPHY_IS_HISTORY_SERVICE (self));
+  g_return_if_fail (delay > 0);
+
+  message = ephy_history_service_message_new (self, SET_RETENTION_IDLE_DELAY,
+                                              g_variant_new_int64 (delay),
+                                              (GDestroyNotify)g_variant_unref,
+                                              NULL, NULL, NULL);
+  ephy_history_service_send_message (self, message);
+}
+
 static void
 ephy_history_service_quit (EphyHistoryService *self,
                            EphyHistoryJobCallback callback,
@@ -1196,6 +2067,8 @@ static EphyHistoryServiceMethod methods[] = {
   (EphyHistoryServiceMethod)ephy_history_service_execute_delete_urls,
   (EphyHistoryServiceMethod)ephy_history_service_execute_delete_host,
   (EphyHistoryServiceMethod)ephy_history_service_execute_clear,
+  (EphyHistoryServiceMethod)ephy_history_service_execute_set_retention_policy,
+  (EphyHistoryServiceMethod)ephy_history_service_execute_set_retention_idle_delay,
   (EphyHistoryServiceMethod)ephy_history_service_execute_quit,
   (EphyHistoryServiceMethod)ephy_history_service_execute_get_url,
   (EphyHistoryServiceMethod)ephy_history_service_execute_get_host_for_url,
@@ -1216,9 +2089,13 @@ ephy_history_service_process_message (EphyHistoryService *self,
                                       EphyHistoryServiceMessage *message)
 {
   EphyHistoryServiceMethod method;
+  gint64 start;
 
   g_assert (self->priv->history_thread == g_thread_self ());
 
+  ephy_metrics_counter_set (self->priv->queue_depth_metric,
+                            g_async_queue_length (self->priv->queue));
+
   if (g_cancellable_is_cancelled (message->cancellable) &&
       !ephy_history_service_message_is_write (message)) {
     ephy_history_service_message_free (message);
@@ -1227,7 +2104,11 @@ ephy_history_service_process_message (EphyHistoryService *self,
 
   method = methods[message->type];
   message->result = NULL;
+  start = g_get_monotonic_time ();
   message->success = method (message->service, message->method_argument, &message->result);
+  ephy_metrics_histogram_add (ephy_history_service_message_is_write (message) ?
+                              self->priv->write_metric : self->priv->query_metric,
+                              g_get_monotonic_time () - start);
 
   if (message->callback || message->type == CLEAR)
     g_idle_add ((GSourceFunc)ephy_history_service_execute_job_callback, message);
@@ -223,3 +223,39 @@ ephy_history_query_copy (EphyHistoryQuery *query)
 
   return copy;
 }
+
+EphyHistoryChanges *
+ephy_history_changes_new (void)
+{
+  EphyHistoryChanges *changes = g_slice_new0 (EphyHistoryChanges);
+
+  changes->visited_urls = g_ptr_array_new_with_free_func ((GDestroyNotify) ephy_history_url_free);
+  changes->retitled_urls = g_ptr_array_new_with_free_func ((GDestroyNotify) ephy_history_url_free);
+  changes->deleted_urls = g_ptr_array_new_with_free_func (g_free);
+  changes->deleted_hosts = g_ptr_array_new_with_free_func (g_free);
+
+  return changes;
+}
+
+void
+ephy_history_changes_free (EphyHistoryChanges *changes)
+{
+  if (changes == NULL)
+    return;
+
+  g_ptr_array_unref (changes->visited_urls);
+  g_ptr_array_unref (changes->retitled_urls);
+  g_ptr_array_unref (changes->deleted_urls);
+  g_ptr_array_unref (changes->deleted_hosts);
+  g_slice_free (EphyHistoryChanges, changes);
+}
+
+gboolean
+ephy_history_changes_is_empty (EphyHistoryChanges *changes)
+{
+  return !changes->cleared &&
+    changes->visited_urls->len == 0 &&
+    changes->retitled_urls->len == 0 &&
+    changes->deleted_urls->len == 0 &&
+    changes->deleted_hosts->len == 0;
+}
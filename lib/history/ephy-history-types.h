@@ -95,6 +95,17 @@ typedef struct _EphyHistoryQuery
   EphyHistorySortType sort_type;
 } EphyHistoryQuery;
 
+/* The changes made to the history during one batch, see the
+ * EphyHistoryService::changed signal. */
+typedef struct _EphyHistoryChanges
+{
+  gboolean cleared;
+  GPtrArray *visited_urls;  /* EphyHistoryURL, after the visit */
+  GPtrArray *retitled_urls; /* EphyHistoryURL, with the new title */
+  GPtrArray *deleted_urls;  /* char * */
+  GPtrArray *deleted_hosts; /* char *, the URL of each host */
+} EphyHistoryChanges;
+
 EphyHistoryPageVisit *          ephy_history_page_visit_new (const char *url, gint64 visit_time, EphyHistoryPageVisitType visit_type);
 EphyHistoryPageVisit *          ephy_history_page_visit_new_with_url (EphyHistoryURL *url, gint64 visit_time, EphyHistoryPageVisitType visit_type);
 EphyHistoryPageVisit *          ephy_history_page_visit_copy (EphyHistoryPageVisit *visit);
@@ -118,6 +129,10 @@ EphyHistoryQuery *              ephy_history_query_new (void);
 void                            ephy_history_query_free (EphyHistoryQuery *query);
 EphyHistoryQuery *              ephy_history_query_copy (EphyHistoryQuery *query);
 
+EphyHistoryChanges *            ephy_history_changes_new (void);
+void                            ephy_history_changes_free (EphyHistoryChanges *changes);
+gboolean                        ephy_history_changes_is_empty (EphyHistoryChanges *changes);
+
 G_END_DECLS
 
 #endif /* EPHY_HISTORY_TYPES_H */
@@ -31,8 +31,18 @@
 struct _EphyFrecentStorePrivate
 {
   gint history_length;
+
+  /* URL -> FrecentRow, for every row of the store. */
+  GHashTable *rows;
 };
 
+/* Rows are kept sorted by visit count, like the query returns them,
+ * so the last row is always the one to evict. */
+typedef struct {
+  GtkTreeRowReference *ref;
+  int visit_count;
+} FrecentRow;
+
 enum
 {
   PROP_0,
@@ -41,6 +51,48 @@ enum
 
 G_DEFINE_TYPE (EphyFrecentStore, ephy_frecent_store, EPHY_TYPE_OVERVIEW_STORE)
 
+static void
+frecent_row_free (FrecentRow *row)
+{
+  gtk_tree_row_reference_free (row->ref);
+  g_slice_free (FrecentRow, row);
+}
+
+static void
+track_row (EphyFrecentStore *store,
+           GtkTreeIter *iter,
+           const char *url,
+           int visit_count)
+{
+  FrecentRow *row;
+  GtkTreePath *path;
+
+  path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), iter);
+
+  row = g_slice_new (FrecentRow);
+  row->ref = gtk_tree_row_reference_new (GTK_TREE_MODEL (store), path);
+  row->visit_count = visit_count;
+  g_hash_table_replace (store->priv->rows, g_strdup (url), row);
+
+  gtk_tree_path_free (path);
+}
+
+static int
+get_row_visit_count (EphyFrecentStore *store,
+                     GtkTreeIter *iter)
+{
+  FrecentRow *row;
+  char *url;
+
+  gtk_tree_model_get (GTK_TREE_MODEL (store), iter,
+                      EPHY_OVERVIEW_STORE_URI, &url,
+                      -1);
+  row = url ? g_hash_table_lookup (store->priv->rows, url) : NULL;
+  g_free (url);
+
+  return row ? row->visit_count : 0;
+}
+
 static void
 on_find_urls_cb (EphyHistoryService *service,
                  gboolean success,
@@ -58,6 +110,8 @@ on_find_urls_cb (EphyHistoryService *service,
   if (success != TRUE)
     return;
 
+  g_hash_table_remove_all (store->priv->rows);
+
   valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (store),
                                          &treeiter);
 
@@ -100,6 +154,8 @@ on_find_urls_cb (EphyHistoryService *service,
       ephy_overview_store_peek_snapshot (EPHY_OVERVIEW_STORE (store),
                                          NULL, &treeiter);
 
+    track_row (store, &treeiter, url->url, url->visit_count);
+
     valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (store), &treeiter);
   }
 
@@ -128,119 +184,227 @@ ephy_frecent_store_fetch_urls (EphyFrecentStore *store,
   ephy_history_query_free (query);
 }
 
-static gboolean
-on_urls_visited_cb (EphyHistoryService *service,
-                    EphyFrecentStore *store)
-{
-  ephy_frecent_store_fetch_urls (store, service);
-
-  return FALSE;
-}
-
-static void
-on_cleared_cb (EphyHistoryService *service,
-               EphyFrecentStore *store)
-{
-  /* Should probably emit a signal notifying that this is empty, this
-     signal probably should live in EphyOverviewStore. */
-
-  gtk_list_store_clear (GTK_LIST_STORE (store));
-}
-
 static void
-on_url_title_changed (EphyHistoryService *service,
-                      const char *url,
-                      const char *title,
-                      EphyFrecentStore *store)
+update_titles (EphyFrecentStore *store,
+               GPtrArray *retitled_urls)
 {
   GtkTreeIter iter;
   gchar *iter_url;
+  GHashTable *titles;
+  guint i;
 
   if (!gtk_tree_model_get_iter_first (GTK_TREE_MODEL (store), &iter))
     return;
 
+  titles = g_hash_table_new (g_str_hash, g_str_equal);
+  for (i = 0; i < retitled_urls->len; i++) {
+    EphyHistoryURL *url = g_ptr_array_index (retitled_urls, i);
+
+    g_hash_table_insert (titles, url->url, url->title);
+  }
+
   do {
     gtk_tree_model_get (GTK_TREE_MODEL (store), &iter,
                         EPHY_OVERVIEW_STORE_URI, &iter_url,
                         -1);
-    if (g_strcmp0 (iter_url, url) == 0) {
+    if (iter_url && g_hash_table_contains (titles, iter_url))
       gtk_list_store_set (GTK_LIST_STORE (store), &iter,
-                          EPHY_OVERVIEW_STORE_TITLE, title,
+                          EPHY_OVERVIEW_STORE_TITLE, g_hash_table_lookup (titles, iter_url),
                           -1);
-      g_free (iter_url);
-      break;
-    }
     g_free (iter_url);
   } while (gtk_tree_model_iter_next (GTK_TREE_MODEL (store), &iter));
+
+  g_hash_table_destroy (titles);
 }
 
-static void
-on_url_deleted (EphyHistoryService *service,
-                const char *url,
-                EphyFrecentStore *store)
+static gboolean
+remove_deleted (EphyFrecentStore *store,
+                GPtrArray *deleted_urls,
+                GPtrArray *deleted_hosts)
 {
   GtkTreeIter iter;
   gchar *iter_url;
-  gboolean needs_update = FALSE;
+  GHashTable *urls, *hosts;
+  gboolean removed = FALSE;
+  gboolean remove, valid;
+  guint i;
 
   if (!gtk_tree_model_get_iter_first (GTK_TREE_MODEL (store), &iter))
-    return;
+    return FALSE;
+
+  urls = g_hash_table_new (g_str_hash, g_str_equal);
+  for (i = 0; i < deleted_urls->len; i++)
+    g_hash_table_add (urls, g_ptr_array_index (deleted_urls, i));
+
+  hosts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (i = 0; i < deleted_hosts->len; i++) {
+    SoupURI *deleted_uri = soup_uri_new (g_ptr_array_index (deleted_hosts, i));
+
+    if (deleted_uri && soup_uri_get_host (deleted_uri))
+      g_hash_table_add (hosts, g_strdup (soup_uri_get_host (deleted_uri)));
+    if (deleted_uri)
+      soup_uri_free (deleted_uri);
+  }
 
   do {
     gtk_tree_model_get (GTK_TREE_MODEL (store), &iter,
                         EPHY_OVERVIEW_STORE_URI, &iter_url,
                         -1);
-    if (g_strcmp0 (iter_url, url) == 0) {
-      needs_update = TRUE;
-      ephy_overview_store_remove (EPHY_OVERVIEW_STORE (store), &iter);
-      g_free (iter_url);
-      break;
+    remove = iter_url && g_hash_table_contains (urls, iter_url);
+    if (!remove && iter_url && g_hash_table_size (hosts)) {
+      SoupURI *store_uri = soup_uri_new (iter_url);
+
+      remove = store_uri && soup_uri_get_host (store_uri) &&
+        g_hash_table_contains (hosts, soup_uri_get_host (store_uri));
+      if (store_uri)
+        soup_uri_free (store_uri);
     }
     g_free (iter_url);
-  } while (gtk_tree_model_iter_next (GTK_TREE_MODEL (store), &iter));
 
-  if (needs_update)
-    ephy_frecent_store_fetch_urls (store, service);
+    if (remove) {
+      valid = ephy_overview_store_remove (EPHY_OVERVIEW_STORE (store), &iter);
+      removed = TRUE;
+    } else
+      valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (store), &iter);
+  } while (valid);
+
+  g_hash_table_destroy (urls);
+  g_hash_table_destroy (hosts);
+
+  return removed;
 }
 
+/* Moves the row at @iter up past the rows with fewer visits. */
 static void
-on_host_deleted (EphyHistoryService *service,
-                 const char *deleted_url,
-                 EphyFrecentStore *store)
+move_row_up (EphyFrecentStore *store,
+             GtkTreeIter *iter,
+             int visit_count)
+{
+  GtkTreeIter prev, target;
+  gboolean move = FALSE;
+
+  prev = *iter;
+  while (gtk_tree_model_iter_previous (GTK_TREE_MODEL (store), &prev) &&
+         get_row_visit_count (store, &prev) < visit_count) {
+    target = prev;
+    move = TRUE;
+  }
+
+  if (move)
+    gtk_list_store_move_before (GTK_LIST_STORE (store), iter, &target);
+}
+
+static void
+apply_visit (EphyFrecentStore *store,
+             EphyHistoryURL *url)
 {
+  EphyFrecentStorePrivate *priv = store->priv;
+  GtkTreeModel *model = GTK_TREE_MODEL (store);
+  FrecentRow *row;
   GtkTreeIter iter;
-  gchar *iter_url;
-  SoupURI *store_uri;
-  SoupURI *deleted_uri;
-  gboolean needs_update = FALSE;
-  gboolean remove, valid;
+  GdkPixbuf *default_icon;
+  int n_rows, position;
+  gboolean valid;
 
-  if (!gtk_tree_model_get_iter_first (GTK_TREE_MODEL (store), &iter))
+  if (url->hidden)
     return;
 
-  deleted_uri = soup_uri_new (deleted_url);
+  row = g_hash_table_lookup (priv->rows, url->url);
+  if (row && gtk_tree_row_reference_valid (row->ref)) {
+    GtkTreePath *path = gtk_tree_row_reference_get_path (row->ref);
 
-  do {
-    gtk_tree_model_get (GTK_TREE_MODEL (store), &iter,
-                        EPHY_OVERVIEW_STORE_URI, &iter_url,
+    gtk_tree_model_get_iter (model, &iter, path);
+    gtk_tree_path_free (path);
+
+    row->visit_count = url->visit_count;
+    gtk_list_store_set (GTK_LIST_STORE (store), &iter,
+                        EPHY_OVERVIEW_STORE_LAST_VISIT, url->last_visit_time,
                         -1);
-    store_uri = soup_uri_new (iter_url);
-    remove = g_strcmp0 (soup_uri_get_host (deleted_uri), soup_uri_get_host (store_uri)) == 0;
-    soup_uri_free (store_uri);
-    g_free (iter_url);
+    if (url->title)
+      gtk_list_store_set (GTK_LIST_STORE (store), &iter,
+                          EPHY_OVERVIEW_STORE_TITLE, url->title,
+                          -1);
+    move_row_up (store, &iter, url->visit_count);
+    return;
+  }
 
-    if (remove) {
-      valid = ephy_overview_store_remove (EPHY_OVERVIEW_STORE (store), &iter);
-      needs_update = TRUE;
-    } else
-      valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (store), &iter);
-  } while (valid);
+  /* The row was removed from the store since it was tracked. */
+  if (row)
+    g_hash_table_remove (priv->rows, url->url);
+
+  n_rows = gtk_tree_model_iter_n_children (model, NULL);
+  if (n_rows >= priv->history_length) {
+    char *evicted;
+
+    gtk_tree_model_iter_nth_child (model, &iter, NULL, n_rows - 1);
+    if (url->visit_count <= get_row_visit_count (store, &iter))
+      return;
 
-  soup_uri_free (deleted_uri);
+    gtk_tree_model_get (model, &iter,
+                        EPHY_OVERVIEW_STORE_URI, &evicted,
+                        -1);
+    if (evicted)
+      g_hash_table_remove (priv->rows, evicted);
+    g_free (evicted);
+
+    ephy_overview_store_remove (EPHY_OVERVIEW_STORE (store), &iter);
+  }
+
+  position = 0;
+  valid = gtk_tree_model_get_iter_first (model, &iter);
+  while (valid && get_row_visit_count (store, &iter) >= url->visit_count) {
+    position++;
+    valid = gtk_tree_model_iter_next (model, &iter);
+  }
+
+  g_object_get (store,
+                "default-icon", &default_icon,
+                NULL);
+  gtk_list_store_insert_with_values (GTK_LIST_STORE (store), &iter, position,
+                                     EPHY_OVERVIEW_STORE_TITLE, url->title,
+                                     EPHY_OVERVIEW_STORE_URI, url->url,
+                                     EPHY_OVERVIEW_STORE_LAST_VISIT, url->last_visit_time,
+                                     EPHY_OVERVIEW_STORE_SNAPSHOT, default_icon,
+                                     -1);
+  if (default_icon)
+    g_object_unref (default_icon);
+
+  track_row (store, &iter, url->url, url->visit_count);
+  ephy_overview_store_peek_snapshot (EPHY_OVERVIEW_STORE (store),
+                                     NULL, &iter);
+}
+
+static void
+on_history_changed (EphyHistoryService *service,
+                    EphyHistoryChanges *changes,
+                    EphyFrecentStore *store)
+{
+  gboolean needs_update = FALSE;
+  guint i;
 
-  if (needs_update)
+  /* Should probably emit a signal notifying that this is empty, this
+     signal probably should live in EphyOverviewStore. */
+  if (changes->cleared) {
+    gtk_list_store_clear (GTK_LIST_STORE (store));
+    g_hash_table_remove_all (store->priv->rows);
+  }
+
+  if (changes->retitled_urls->len)
+    update_titles (store, changes->retitled_urls);
+
+  if ((changes->deleted_urls->len || changes->deleted_hosts->len) &&
+      remove_deleted (store, changes->deleted_urls, changes->deleted_hosts))
+    needs_update = TRUE;
+
+  /* Only deletions can bring back URLs that are not in the store,
+   * visits are merged into it without querying the history. */
+  if (needs_update) {
     ephy_frecent_store_fetch_urls (store, service);
+    return;
+  }
 
+  for (i = 0; i < changes->visited_urls->len; i++)
+    apply_visit (store, g_ptr_array_index (changes->visited_urls, i));
 }
 
 static void
@@ -252,16 +416,8 @@ setup_history_service (EphyFrecentStore *store)
 
   ephy_frecent_store_fetch_urls (store, service);
 
-  g_signal_connect (service, "urls-visited",
-                    G_CALLBACK (on_urls_visited_cb), store);
-  g_signal_connect (service, "cleared",
-                    G_CALLBACK (on_cleared_cb), store);
-  g_signal_connect (service, "url-title-changed",
-                    G_CALLBACK (on_url_title_changed), store);
-  g_signal_connect (service, "url-deleted",
-                    G_CALLBACK (on_url_deleted), store);
-  g_signal_connect (service, "host-deleted",
-                    G_CALLBACK (on_host_deleted), store);
+  g_signal_connect (service, "changed",
+                    G_CALLBACK (on_history_changed), store);
   g_object_unref (service);
 }
 
@@ -314,11 +470,22 @@ ephy_frecent_store_get_property (GObject *object,
   }
 }
 
+static void
+ephy_frecent_store_finalize (GObject *object)
+{
+  EphyFrecentStore *store = EPHY_FRECENT_STORE (object);
+
+  g_hash_table_destroy (store->priv->rows);
+
+  G_OBJECT_CLASS (ephy_frecent_store_parent_class)->finalize (object);
+}
+
 static void
 ephy_frecent_store_class_init (EphyFrecentStoreClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
+  object_class->finalize = ephy_frecent_store_finalize;
   object_class->notify = ephy_frecent_store_notify;
   object_class->set_property = ephy_frecent_store_set_property;
   object_class->get_property = ephy_frecent_store_get_property;
@@ -338,6 +505,8 @@ static void
 ephy_frecent_store_init (EphyFrecentStore *self)
 {
   self->priv = EPHY_FRECENT_STORE_GET_PRIVATE (self);
+  self->priv->rows = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                            g_free, (GDestroyNotify)frecent_row_free);
 }
 
 EphyFrecentStore *
@@ -24,6 +24,7 @@
 #include "ephy-embed-prefs.h"
 #include "ephy-favicon-helpers.h"
 #include "ephy-hosts-store.h"
+#include "ephy-metrics.h"
 
 #include <glib/gi18n.h>
 #ifdef HAVE_WEBKIT2
@@ -32,9 +33,17 @@
 
 G_DEFINE_TYPE (EphyHostsStore, ephy_hosts_store, GTK_TYPE_LIST_STORE)
 
+#define EPHY_HOSTS_STORE_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), EPHY_TYPE_HOSTS_STORE, EphyHostsStorePrivate))
+
+struct _EphyHostsStorePrivate
+{
+  EphyMetricsHistogram *favicon_load_metric;
+};
+
 typedef struct {
   GtkListStore *model;
   GtkTreeRowReference *row_reference;
+  gint64 start_time;
 } IconLoadData;
 
 static void
@@ -62,6 +71,9 @@ async_update_favicon_icon (GObject *source, GAsyncResult *result, gpointer user_
   favicon = webkit_favicon_database_get_favicon_pixbuf_finish (database, result, NULL);
 #endif
 
+  ephy_metrics_histogram_add (EPHY_HOSTS_STORE (data->model)->priv->favicon_load_metric,
+                              g_get_monotonic_time () - data->start_time);
+
   if (favicon) {
     /* The completion model might have changed its contents */
     if (gtk_tree_row_reference_valid (data->row_reference)) {
@@ -116,6 +128,7 @@ icon_changed_cb (WebKitFaviconDatabase *database,
       data->model = GTK_LIST_STORE (g_object_ref (model));
       path = gtk_tree_model_get_path (model, &iter);
       data->row_reference = gtk_tree_row_reference_new (model, path);
+      data->start_time = g_get_monotonic_time ();
       gtk_tree_path_free (path);
 
       webkit_favicon_database_get_favicon (database,
@@ -169,6 +182,8 @@ ephy_hosts_store_class_init (EphyHostsStoreClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->finalize = ephy_hosts_store_finalize;
+
+  g_type_class_add_private (object_class, sizeof (EphyHostsStorePrivate));
 }
 
 static void
@@ -176,6 +191,9 @@ ephy_hosts_store_init (EphyHostsStore *self)
 {
   GType types[EPHY_HOSTS_STORE_N_COLUMNS];
 
+  self->priv = EPHY_HOSTS_STORE_GET_PRIVATE (self);
+  self->priv->favicon_load_metric = ephy_metrics_histogram_get ("favicon.load");
+
   types[EPHY_HOSTS_STORE_COLUMN_ID]          = G_TYPE_INT;
   types[EPHY_HOSTS_STORE_COLUMN_TITLE]       = G_TYPE_STRING;
   types[EPHY_HOSTS_STORE_COLUMN_ADDRESS]     = G_TYPE_STRING;
@@ -250,6 +268,7 @@ ephy_hosts_store_add_hosts (EphyHostsStore *store,
       data->model = GTK_LIST_STORE (g_object_ref (store));
       path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), &treeiter);
       data->row_reference = gtk_tree_row_reference_new (GTK_TREE_MODEL (store), path);
+      data->start_time = g_get_monotonic_time ();
       gtk_tree_path_free (path);
 
 #ifdef HAVE_WEBKIT2
@@ -51,6 +51,7 @@ typedef enum {
 struct _EphyHostsStore
 {
   GtkListStore parent;
+  EphyHostsStorePrivate *priv;
 };
 
 struct _EphyHostsStoreClass
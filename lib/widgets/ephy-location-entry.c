@@ -27,19 +27,15 @@
 #include "ephy-about-handler.h"
 #include "ephy-debug.h"
 #include "ephy-dnd.h"
+#include "ephy-embed-shell.h"
 #include "ephy-gui.h"
+#include "ephy-predictor.h"
 #include "ephy-signal-accumulator.h"
 
-#include <libsoup/soup.h>
 #include <gdk/gdkkeysyms.h>
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
 #include <string.h>
-#ifdef HAVE_WEBKIT2
-#include <webkit2/webkit2.h>
-#else
-#include <webkit/webkit.h>
-#endif
 
 /**
  * SECTION:ephy-location-entry
@@ -930,14 +926,14 @@ ephy_location_entry_new (void)
 }
 
 typedef struct {
-	SoupURI *uri;
+	char *url;
 	EphyLocationEntry *entry;
 } PrefetchHelper;
 
 static void
 free_prefetch_helper (PrefetchHelper *helper)
 {
-	soup_uri_free (helper->uri);
+	g_free (helper->url);
 	g_object_unref (helper->entry);
 	g_slice_free (PrefetchHelper, helper);
 }
@@ -945,17 +941,11 @@ free_prefetch_helper (PrefetchHelper *helper)
 static gboolean
 do_dns_prefetch (PrefetchHelper *helper)
 {
-#ifdef HAVE_WEBKIT2
-	WebKitWebContext *context = webkit_web_context_get_default ();
-
-	if (helper->uri)
-		webkit_web_context_prefetch_dns (context, helper->uri->host);
-#else
-	SoupSession *session = webkit_get_default_session ();
+	EphyPredictor *predictor;
 
-	if (helper->uri)
-		soup_session_prefetch_dns (session, helper->uri->host, NULL, NULL, NULL);
-#endif
+	/* Resolves the host and the hosts its pages usually need. */
+	predictor = EPHY_PREDICTOR (ephy_embed_shell_get_predictor (ephy_embed_shell_get_default ()));
+	ephy_predictor_predict (predictor, helper->url);
 
 	helper->entry->priv->dns_prefetch_handler = 0;
 
@@ -966,20 +956,16 @@ static void
 schedule_dns_prefetch (EphyLocationEntry *entry, guint interval, const gchar *url)
 {
 	PrefetchHelper *helper;
-	SoupURI *uri;
 
-	uri = soup_uri_new (url);
-	if (!uri || !uri->host) {
-		soup_uri_free (uri);
+	if (url == NULL)
 		return;
-	}
 
 	if (entry->priv->dns_prefetch_handler)
 		g_source_remove (entry->priv->dns_prefetch_handler);
 
 	helper = g_slice_new0 (PrefetchHelper);
 	helper->entry = g_object_ref (entry);
-	helper->uri = uri;
+	helper->url = g_strdup (url);
 
 	entry->priv->dns_prefetch_handler =
 		g_timeout_add_full (G_PRIORITY_DEFAULT, interval,
@@ -0,0 +1,31 @@
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __EPHY_NODE_VIEW_PRIVATE_H
+#define __EPHY_NODE_VIEW_PRIVATE_H
+
+#include "ephy-node-view.h"
+
+G_BEGIN_DECLS
+
+gboolean	 ephy_node_view_is_refiltering	(EphyNodeView *view);
+
+G_END_DECLS
+
+#endif /* __EPHY_NODE_VIEW_PRIVATE_H */
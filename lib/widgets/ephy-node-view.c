@@ -24,6 +24,7 @@
 #include <gdk/gdkkeysyms.h>
 
 #include "ephy-node-view.h"
+#include "ephy-node-view-private.h"
 #include "ephy-tree-model-sort.h"
 #include "eggtreemultidnd.h"
 #include "ephy-dnd.h"
@@ -57,10 +58,15 @@ struct _EphyNodeViewPrivate
 	int toggle_column;
 
 	EphyNodeFilter *filter;
+	GHashTable *visibility;
+	GPtrArray *refilter_queue;
+	guint refilter_index;
+	guint refilter_id;
 
 	GtkTargetList *drag_targets;
 
 	int sort_column;
+	guint sort_prop_id;
 	GtkSortType sort_type;
 	guint priority_prop_id;
 	int priority_column;
@@ -81,6 +87,7 @@ struct _EphyNodeViewPrivate
 	guint scroll_id;
 
 	guint changing_selection : 1;
+	guint use_cached_visibility : 1;
 };
 
 enum
@@ -102,6 +109,13 @@ enum
 
 #define AUTO_SCROLL_MARGIN 20
 
+/* Time spent re-evaluating the filter before yielding to the main loop */
+#define REFILTER_SLICE_USEC 5000
+
+/* Values of the visibility cache */
+#define NODE_VISIBLE GINT_TO_POINTER (1)
+#define NODE_HIDDEN  GINT_TO_POINTER (2)
+
 static GObjectClass *parent_class = NULL;
 
 static guint ephy_node_view_signals[LAST_SIGNAL] = { 0 };
@@ -139,6 +153,13 @@ ephy_node_view_finalize (GObject *object)
 {
 	EphyNodeView *view = EPHY_NODE_VIEW (object);
 
+	if (view->priv->refilter_id != 0)
+	{
+		g_source_remove (view->priv->refilter_id);
+	}
+	g_hash_table_destroy (view->priv->visibility);
+	g_ptr_array_free (view->priv->refilter_queue, TRUE);
+
 	g_object_unref (G_OBJECT (view->priv->sortmodel));
 	g_object_unref (G_OBJECT (view->priv->filtermodel));
 	g_object_unref (G_OBJECT (view->priv->nodemodel));
@@ -490,37 +511,144 @@ ephy_node_view_enable_drag_dest (EphyNodeView *view,
 			  G_CALLBACK (drag_leave_cb), view);
 }
 
+static void
+set_node_visible (EphyNodeView *view,
+		  EphyNode *node,
+		  gboolean visible)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL (view->priv->nodemodel);
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	gpointer value = visible ? NODE_VISIBLE : NODE_HIDDEN;
+
+	if (g_hash_table_lookup (view->priv->visibility, node) == value) return;
+
+	g_hash_table_insert (view->priv->visibility, node, value);
+
+	/* Makes the filter model check this row again, see
+	 * filter_visible_func() */
+	ephy_tree_model_node_iter_from_node (view->priv->nodemodel, node, &iter);
+	path = gtk_tree_model_get_path (model, &iter);
+
+	view->priv->use_cached_visibility = TRUE;
+	gtk_tree_model_row_changed (model, path, &iter);
+	view->priv->use_cached_visibility = FALSE;
+
+	gtk_tree_path_free (path);
+}
+
+static gboolean
+refilter_idle_cb (EphyNodeView *view)
+{
+	EphyNodeViewPrivate *priv = view->priv;
+	gint64 deadline;
+
+	deadline = g_get_monotonic_time () + REFILTER_SLICE_USEC;
+
+	while (priv->refilter_index < priv->refilter_queue->len)
+	{
+		EphyNode *node;
+
+		node = g_ptr_array_index (priv->refilter_queue, priv->refilter_index++);
+		set_node_visible (view, node,
+				  priv->filter == NULL ||
+				  ephy_node_filter_evaluate (priv->filter, node));
+
+		if (g_get_monotonic_time () > deadline)
+		{
+			return TRUE;
+		}
+	}
+
+	g_ptr_array_set_size (priv->refilter_queue, 0);
+	priv->refilter_index = 0;
+	priv->refilter_id = 0;
+
+	return FALSE;
+}
+
 static void
 filter_changed_cb (EphyNodeFilter *filter,
 		   EphyNodeView *view)
 {
-	GtkWidget *window;
-	GdkWindow *gdk_window;
+	EphyNodeViewPrivate *priv = view->priv;
+	EphyNodeFilterChange change;
+	GPtrArray *children;
+	guint i;
 
 	g_return_if_fail (EPHY_IS_NODE_VIEW (view));
 
-	window = gtk_widget_get_toplevel (GTK_WIDGET (view));
-	gdk_window = gtk_widget_get_window (window);
+	change = ephy_node_filter_get_last_change (filter);
 
-	if (window != NULL && gdk_window != NULL)
+	/* The rows a previous pass did not get to yet may be stale either
+	 * way, so check everything again. */
+	if (priv->refilter_id != 0)
 	{
-		/* nice busy cursor */
-		GdkCursor *cursor;
+		change = EPHY_NODE_FILTER_CHANGE_ANY;
+	}
 
-		cursor = gdk_cursor_new (GDK_WATCH);
-		gdk_window_set_cursor (gdk_window, cursor);
-		g_object_unref (cursor);
+	g_ptr_array_set_size (priv->refilter_queue, 0);
+	priv->refilter_index = 0;
 
-		gdk_flush ();
+	/* Only queue the rows the change can affect: the visible ones
+	 * when the filter got stricter, the hidden ones when it got
+	 * looser. */
+	children = ephy_node_get_children (priv->root);
+	for (i = 0; i < children->len; i++)
+	{
+		EphyNode *node;
+		gpointer visibility;
+
+		node = g_ptr_array_index (children, i);
+		visibility = g_hash_table_lookup (priv->visibility, node);
 
-		gdk_window_set_cursor (gdk_window, NULL);
+		if (change == EPHY_NODE_FILTER_CHANGE_ANY || visibility == NULL ||
+		    (change == EPHY_NODE_FILTER_CHANGE_REFINED && visibility == NODE_VISIBLE) ||
+		    (change == EPHY_NODE_FILTER_CHANGE_RELAXED && visibility == NODE_HIDDEN))
+		{
+			g_ptr_array_add (priv->refilter_queue, node);
+		}
+	}
 
-		/* no flush: this will cause the cursor to be reset
-		 * only when the UI is free again */
+	if (priv->refilter_id == 0 && priv->refilter_queue->len > 0)
+	{
+		priv->refilter_id = g_idle_add ((GSourceFunc) refilter_idle_cb, view);
 	}
+}
+
+/* Whether some rows still have to be checked against the filter, see
+ * filter_changed_cb(). */
+gboolean
+ephy_node_view_is_refiltering (EphyNodeView *view)
+{
+	g_return_val_if_fail (EPHY_IS_NODE_VIEW (view), FALSE);
 
-	gtk_tree_model_filter_refilter
-			(GTK_TREE_MODEL_FILTER (view->priv->filtermodel));
+	return view->priv->refilter_id != 0;
+}
+
+static void
+root_child_removed_cb (EphyNode *node,
+		       EphyNode *child,
+		       guint old_index,
+		       EphyNodeView *view)
+{
+	EphyNodeViewPrivate *priv = view->priv;
+	guint i;
+
+	g_hash_table_remove (priv->visibility, child);
+
+	for (i = 0; i < priv->refilter_queue->len; i++)
+	{
+		if (g_ptr_array_index (priv->refilter_queue, i) == child)
+		{
+			g_ptr_array_remove_index (priv->refilter_queue, i);
+			if (i < priv->refilter_index)
+			{
+				priv->refilter_index--;
+			}
+			break;
+		}
+	}
 }
 
 static void
@@ -941,6 +1069,15 @@ ephy_node_view_set_filter (EphyNodeView *view, EphyNodeFilter *filter)
 
 	if (refilter)
 	{
+		if (view->priv->refilter_id != 0)
+		{
+			g_source_remove (view->priv->refilter_id);
+			view->priv->refilter_id = 0;
+		}
+		g_ptr_array_set_size (view->priv->refilter_queue, 0);
+		view->priv->refilter_index = 0;
+		g_hash_table_remove_all (view->priv->visibility);
+
 		gtk_tree_model_filter_refilter
 				(GTK_TREE_MODEL_FILTER (view->priv->filtermodel));
 	}
@@ -1059,36 +1196,39 @@ renderer_editing_canceled_cb (GtkCellRendererText *cell,
 	}
 }
 
-static inline int
-compare_string_values (const GValue *a_value, const GValue *b_value)
-{
-	const char *str1, *str2;
-	int retval;
+static int
+compare_string_nodes (EphyNodeView *view,
+		      GtkTreeModel *model,
+		      GtkTreeIter *a,
+		      GtkTreeIter *b)
+{
+	GtkTreeIter a_iter, b_iter;
+	EphyNode *a_node, *b_node;
+	const char *key1, *key2;
+
+	/* The collation keys are cached on the nodes, so sorting does
+	 * not have to casefold and collate both strings on every
+	 * comparison. */
+	gtk_tree_model_filter_convert_iter_to_child_iter
+		(GTK_TREE_MODEL_FILTER (model), &a_iter, a);
+	gtk_tree_model_filter_convert_iter_to_child_iter
+		(GTK_TREE_MODEL_FILTER (model), &b_iter, b);
+	a_node = ephy_tree_model_node_node_from_iter (view->priv->nodemodel, &a_iter);
+	b_node = ephy_tree_model_node_node_from_iter (view->priv->nodemodel, &b_iter);
 
-	str1 = g_value_get_string (a_value);
-	str2 = g_value_get_string (b_value);
+	key1 = ephy_node_get_property_collate_key (a_node, view->priv->sort_prop_id);
+	key2 = ephy_node_get_property_collate_key (b_node, view->priv->sort_prop_id);
 
-	if (str1 == NULL)
+	if (key1 == NULL)
 	{
-		retval = -1;
+		return -1;
 	}
-	else if (str2 == NULL)
-	{
-		retval = 1;
-	}
-	else
+	else if (key2 == NULL)
 	{
-		char *str_a;
-		char *str_b;
-
-		str_a = g_utf8_casefold (str1, -1);
-		str_b = g_utf8_casefold (str2, -1);
-		retval = g_utf8_collate (str_a, str_b);
-		g_free (str_a);
-		g_free (str_b);
+		return 1;
 	}
 
-	return retval;
+	return strcmp (key1, key2);
 }
 
 static int
@@ -1138,14 +1278,17 @@ ephy_node_view_sort_func (GtkTreeModel *model,
 
 		type = gtk_tree_model_get_column_type (model, column);
 
+		if (G_TYPE_FUNDAMENTAL (type) == G_TYPE_STRING)
+		{
+			retval = compare_string_nodes (view, model, a, b);
+			goto out;
+		}
+
 		gtk_tree_model_get_value (model, a, column, &a_value);
 		gtk_tree_model_get_value (model, b, column, &b_value);
 
 		switch (G_TYPE_FUNDAMENTAL (type))
 		{
-		case G_TYPE_STRING:
-			retval = compare_string_values (&a_value, &b_value);
-			break;
 		case G_TYPE_INT:
 			if (g_value_get_int (&a_value) < g_value_get_int (&b_value))
 			{
@@ -1183,6 +1326,7 @@ ephy_node_view_sort_func (GtkTreeModel *model,
 		g_value_unset (&b_value);
 	}
 
+out:
 	if (sort_type == GTK_SORT_DESCENDING)
 	{
 		if (retval > 0)
@@ -1420,6 +1564,7 @@ ephy_node_view_set_sort (EphyNodeView *view, GType value_type, guint prop_id,
 	column = ephy_tree_model_node_add_prop_column
 		(view->priv->nodemodel, value_type, prop_id);
 	view->priv->sort_column = column;
+	view->priv->sort_prop_id = prop_id;
 	view->priv->sort_type = sort_type;
 
 	gtk_tree_sortable_set_default_sort_func
@@ -1440,6 +1585,8 @@ ephy_node_view_init (EphyNodeView *view)
 	view->priv->priority_prop_id = 0;
 	view->priv->sort_column = -1;
 	view->priv->sort_type = GTK_SORT_ASCENDING;
+	view->priv->visibility = g_hash_table_new (g_direct_hash, g_direct_equal);
+	view->priv->refilter_queue = g_ptr_array_new ();
 
 	gtk_tree_view_set_enable_search (GTK_TREE_VIEW (view), FALSE);
 }
@@ -1694,15 +1841,21 @@ filter_visible_func (GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
 {
 	EphyNode *node;
 	EphyNodeView *view = EPHY_NODE_VIEW (data);
+	gboolean visible;
 
-	if (view->priv->filter)
-	{
-		node = ephy_tree_model_node_node_from_iter (view->priv->nodemodel, iter);
+	node = ephy_tree_model_node_node_from_iter (view->priv->nodemodel, iter);
 
-		return ephy_node_filter_evaluate (view->priv->filter, node);
+	if (view->priv->use_cached_visibility)
+	{
+		return g_hash_table_lookup (view->priv->visibility, node) == NODE_VISIBLE;
 	}
 
-	return TRUE;
+	visible = view->priv->filter == NULL ||
+		  ephy_node_filter_evaluate (view->priv->filter, node);
+	g_hash_table_insert (view->priv->visibility, node,
+			     visible ? NODE_VISIBLE : NODE_HIDDEN);
+
+	return visible;
 }
 
 static GObject *
@@ -1727,6 +1880,10 @@ ephy_node_view_constructor (GType type, guint n_construct_properties,
 						filter_visible_func, view, NULL);
 	priv->sortmodel = ephy_tree_model_sort_new (priv->filtermodel);
 	gtk_tree_view_set_model (GTK_TREE_VIEW (object), GTK_TREE_MODEL (priv->sortmodel));
+	ephy_node_signal_connect_object (priv->root,
+					 EPHY_NODE_CHILD_REMOVED,
+					 (EphyNodeCallback) root_child_removed_cb,
+					 object);
 	g_signal_connect_object (object, "button_press_event",
 				 G_CALLBACK (ephy_node_view_button_press_cb),
 				 view, 0);
@@ -179,6 +179,7 @@ typedef struct {
   WebKitWebView *webview;
   GCancellable *cancellable;
   time_t timestamp;
+  int priority;
 } PeekContext;
 
 static void
@@ -231,6 +232,7 @@ ephy_overview_store_set_snapshot_internal (EphyOverviewStore *store,
 typedef struct {
   EphyHistoryURL *url;
   EphyHistoryService *history_service;
+  GtkTreeRowReference *ref;
 } ThumbnailTimeContext;
 
 static void
@@ -238,9 +240,28 @@ on_snapshot_saved_cb (EphySnapshotService *service,
                       GAsyncResult *res,
                       ThumbnailTimeContext *ctx)
 {
-  ephy_history_service_set_url_thumbnail_time (ctx->history_service,
-                                               ctx->url->url, ctx->url->thumbnail_time,
-                                               NULL, NULL, NULL);
+  GdkPixbuf *pixbuf;
+  GtkTreePath *path;
+  GtkTreeIter iter;
+
+  pixbuf = ephy_snapshot_service_save_surface_finish (service, res, NULL);
+  if (pixbuf && gtk_tree_row_reference_valid (ctx->ref)) {
+    path = gtk_tree_row_reference_get_path (ctx->ref);
+    gtk_tree_model_get_iter (gtk_tree_row_reference_get_model (ctx->ref), &iter, path);
+    gtk_tree_path_free (path);
+
+    ephy_overview_store_set_snapshot_internal (EPHY_OVERVIEW_STORE (gtk_tree_row_reference_get_model (ctx->ref)),
+                                               &iter, pixbuf, ctx->url->thumbnail_time);
+  }
+
+  if (pixbuf) {
+    ephy_history_service_set_url_thumbnail_time (ctx->history_service,
+                                                 ctx->url->url, ctx->url->thumbnail_time,
+                                                 NULL, NULL, NULL);
+    g_object_unref (pixbuf);
+  }
+
+  gtk_tree_row_reference_free (ctx->ref);
   ephy_history_url_free (ctx->url);
   g_slice_free (ThumbnailTimeContext, ctx);
 }
@@ -250,15 +271,13 @@ ephy_overview_store_set_snapshot (EphyOverviewStore *store,
                                   GtkTreeIter *iter,
                                   cairo_surface_t *snapshot)
 {
-  GdkPixbuf *pixbuf;
   char *url;
   ThumbnailTimeContext *ctx;
   EphySnapshotService *snapshot_service;
+  GtkTreePath *path;
   int mtime;
 
   mtime = time (NULL);
-  pixbuf = ephy_snapshot_service_crop_snapshot (snapshot);
-  ephy_overview_store_set_snapshot_internal (store, iter, pixbuf, mtime);
   gtk_tree_model_get (GTK_TREE_MODEL (store), iter,
                       EPHY_OVERVIEW_STORE_URI, &url,
                       -1);
@@ -267,15 +286,19 @@ ephy_overview_store_set_snapshot (EphyOverviewStore *store,
   ctx->url = ephy_history_url_new (url, NULL, 0, 0, 0);
   ctx->url->thumbnail_time = mtime;
   ctx->history_service = store->priv->history_service;
+  path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), iter);
+  ctx->ref = gtk_tree_row_reference_new (GTK_TREE_MODEL (store), path);
+  gtk_tree_path_free (path);
   g_free (url);
 
+  /* Cropping, scaling and encoding are done in a worker thread, the
+     row is updated once the snapshot is ready. */
   snapshot_service = ephy_snapshot_service_get_default ();
-  ephy_snapshot_service_save_snapshot_async (snapshot_service,
-                                             pixbuf, ctx->url->url, ctx->url->thumbnail_time,
-                                             NULL,
-                                             (GAsyncReadyCallback) on_snapshot_saved_cb,
-                                             ctx);
-  g_object_unref (pixbuf);
+  ephy_snapshot_service_save_surface_async (snapshot_service,
+                                            snapshot, ctx->url->url, ctx->url->thumbnail_time,
+                                            NULL,
+                                            (GAsyncReadyCallback) on_snapshot_saved_cb,
+                                            ctx);
 }
 
 
@@ -342,6 +365,17 @@ on_snapshot_retrieved_for_url_cb (GObject *object,
   snapshot = ephy_snapshot_service_get_snapshot_for_url_finish (EPHY_SNAPSHOT_SERVICE (object),
                                                                 res, NULL);
 
+  /* The cached snapshot was expected to be fresh but is gone, take a
+     new one from the web view. */
+  if (snapshot == NULL && ctx->webview &&
+      !g_cancellable_is_cancelled (ctx->cancellable)) {
+    ephy_snapshot_service_get_snapshot_async (EPHY_SNAPSHOT_SERVICE (object),
+                                              ctx->webview, ctx->timestamp, ctx->cancellable,
+                                              (GAsyncReadyCallback) on_snapshot_retrieved_cb,
+                                              ctx);
+    return;
+  }
+
   set_snapshot (EPHY_OVERVIEW_STORE (gtk_tree_row_reference_get_model (ctx->ref)),
                 snapshot, ctx->ref, ctx->timestamp);
   if (snapshot)
@@ -358,20 +392,30 @@ history_service_url_cb (gpointer service,
 {
   EphySnapshotService *snapshot_service;
 
+  /* The URL is not in the history (anymore), keep the default icon. */
+  if (!success || url == NULL) {
+    peek_context_free (ctx);
+    return;
+  }
+
   snapshot_service = ephy_snapshot_service_get_default ();
 
   ctx->timestamp = url->thumbnail_time;
 
-  if (ctx->webview)
+  /* Only capture the web view again when the cached snapshot is stale;
+     a lookup is much cheaper than rendering and encoding a new one. */
+  if (ctx->webview &&
+      (ctx->timestamp == 0 || time (NULL) - ctx->timestamp > THUMBNAIL_UPDATE_THRESHOLD))
     ephy_snapshot_service_get_snapshot_async (snapshot_service,
                                               ctx->webview, ctx->timestamp, ctx->cancellable,
                                               (GAsyncReadyCallback) on_snapshot_retrieved_cb,
                                               ctx);
   else
-    ephy_snapshot_service_get_snapshot_for_url_async (snapshot_service,
-                                                      ctx->url, ctx->timestamp, ctx->cancellable,
-                                                      (GAsyncReadyCallback) on_snapshot_retrieved_for_url_cb,
-                                                      ctx);
+    ephy_snapshot_service_get_snapshot_for_url_full (snapshot_service,
+                                                     ctx->url, ctx->timestamp, ctx->priority,
+                                                     ctx->cancellable,
+                                                     (GAsyncReadyCallback) on_snapshot_retrieved_for_url_cb,
+                                                     ctx);
   ephy_history_url_free (url);
 }
 
@@ -413,6 +457,9 @@ ephy_overview_store_peek_snapshot (EphyOverviewStore *self,
   ctx->url = url;
   ctx->webview = webview ? g_object_ref (webview) : NULL;
   ctx->cancellable = cancellable;
+  /* Rows at the top of the overview are the visible ones, so let them
+     go first. */
+  ctx->priority = G_PRIORITY_DEFAULT + gtk_tree_path_get_indices (path)[0];
   ephy_history_service_get_url (self->priv->history_service,
                                 url, NULL, (EphyHistoryJobCallback)history_service_url_cb,
                                 ctx);
@@ -33,6 +33,7 @@
 #include "ephy-node-common.h"
 #include "ephy-node-view.h"
 #include "ephy-prefs.h"
+#include "ephy-private.h"
 #include "ephy-session.h"
 #include "ephy-settings.h"
 #include "ephy-shell.h"
@@ -299,25 +300,41 @@ cmd_open_bookmarks_in_tabs (GtkAction *action,
 			    EphyBookmarksEditor *editor)
 {
 	EphyWindow *window;
+	EphyLoadScheduler *scheduler;
 	GList *selection;
 	GList *l;
 
 	window = EPHY_WINDOW (get_target_window (editor));
 	selection = ephy_node_view_get_selection (EPHY_NODE_VIEW (editor->priv->bm_view));
+	scheduler = ephy_shell_get_load_scheduler (ephy_shell_get_default ());
 
 	for (l = selection; l; l = l->next)
 	{
 		EphyNode *node = l->data;
 		EphyEmbed *new_embed;
 		const char *location;
+		const char *title;
 
 		location = ephy_node_get_property_string (node,
 						EPHY_NODE_BMK_PROP_LOCATION);
+		title = ephy_node_get_property_string (node,
+						EPHY_NODE_BMK_PROP_TITLE);
 
+		/* The tabs are created right away but their loads go through
+		 * the load scheduler, so opening a large topic does not start
+		 * every page at once.
+		 */
 		new_embed = ephy_shell_new_tab (ephy_shell_get_default (),
 						window, NULL, location,
-				 	        EPHY_NEW_TAB_OPEN_PAGE |
-					        EPHY_NEW_TAB_IN_EXISTING_WINDOW);
+						EPHY_NEW_TAB_DELAYED_OPEN_PAGE |
+						EPHY_NEW_TAB_IN_EXISTING_WINDOW);
+		if (ephy_embed_has_load_pending (new_embed))
+		{
+			ephy_web_view_set_placeholder (ephy_embed_get_web_view (new_embed),
+						       location, title ? title : location);
+			ephy_load_scheduler_add (scheduler, new_embed);
+		}
+
 		/* if there was no target window, a new one was opened. Get it
 		 * from the new tab so we open the remaining links in the
 		 * same window. See bug 138343.
@@ -529,16 +546,98 @@ add_bookmarks_source (const char *file,
 	g_strfreev (path);
 }
 
+typedef struct
+{
+	EphyBookmarksEditor *editor;
+	char *filename;
+	GCancellable *cancellable;
+	GtkWidget *progress_dialog;
+	GtkWidget *progress_bar;
+} ImportData;
+
 static void
-import_bookmarks (EphyBookmarksEditor *editor,
-		  const char *filename)
+import_progress_cb (goffset current_num_bytes,
+		    goffset total_num_bytes,
+		    gpointer user_data)
 {
-	if (ephy_bookmarks_import (editor->priv->bookmarks, filename) == FALSE)
+	ImportData *data = user_data;
+
+	if (total_num_bytes > 0)
+	{
+		gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (data->progress_bar),
+					       (double) current_num_bytes / total_num_bytes);
+	}
+	else
+	{
+		gtk_progress_bar_pulse (GTK_PROGRESS_BAR (data->progress_bar));
+	}
+}
+
+static void
+import_progress_response_cb (GtkDialog *dialog,
+			     int response,
+			     ImportData *data)
+{
+	/* Closing the window cancels too. The dialog goes away from
+	 * import_bookmarks_cb once the import has noticed it. */
+	gtk_dialog_set_response_sensitive (dialog, GTK_RESPONSE_CANCEL, FALSE);
+	g_cancellable_cancel (data->cancellable);
+}
+
+static GtkWidget *
+import_progress_dialog_new (EphyBookmarksEditor *editor,
+			    ImportData *data)
+{
+	GtkWidget *dialog, *content_area;
+	char *basename, *text;
+
+	basename = g_filename_display_basename (data->filename);
+	/* Translators: %s is the name of the file being imported. */
+	text = g_strdup_printf (_("Importing bookmarks from “%s”"), basename);
+
+	dialog = gtk_message_dialog_new (GTK_WINDOW (editor),
+					 0,
+					 GTK_MESSAGE_INFO,
+					 GTK_BUTTONS_CANCEL,
+					 "%s", text);
+	gtk_window_set_title (GTK_WINDOW (dialog), _("Import Bookmarks"));
+
+	data->progress_bar = gtk_progress_bar_new ();
+	content_area = gtk_message_dialog_get_message_area (GTK_MESSAGE_DIALOG (dialog));
+	gtk_box_pack_start (GTK_BOX (content_area), data->progress_bar,
+			    FALSE, FALSE, 0);
+	gtk_widget_show (data->progress_bar);
+
+	g_signal_connect (dialog, "response",
+			  G_CALLBACK (import_progress_response_cb), data);
+
+	gtk_window_group_add_window (gtk_window_get_group (GTK_WINDOW (editor)),
+				     GTK_WINDOW (dialog));
+
+	g_free (text);
+	g_free (basename);
+
+	return dialog;
+}
+
+static void
+import_bookmarks_cb (GObject *source,
+		     GAsyncResult *result,
+		     gpointer user_data)
+{
+	ImportData *data = user_data;
+	EphyBookmarksEditor *editor = data->editor;
+	GError *error = NULL;
+
+	gtk_widget_destroy (data->progress_dialog);
+
+	if (ephy_bookmarks_import_finish (EPHY_BOOKMARKS (source), result, &error) == FALSE &&
+	    !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
 	{
 		GtkWidget *dialog;
 		char *basename;
 
-		basename = g_filename_display_basename (filename);
+		basename = g_filename_display_basename (data->filename);
 		dialog = gtk_message_dialog_new (GTK_WINDOW (editor),
 						 GTK_DIALOG_MODAL,
 						 GTK_MESSAGE_ERROR,
@@ -561,6 +660,32 @@ import_bookmarks (EphyBookmarksEditor *editor,
 		g_free (basename);
 		gtk_widget_destroy (dialog);
 	}
+
+	g_clear_error (&error);
+	g_free (data->filename);
+	g_object_unref (data->cancellable);
+	g_object_unref (data->editor);
+	g_slice_free (ImportData, data);
+}
+
+static void
+import_bookmarks (EphyBookmarksEditor *editor,
+		  const char *filename)
+{
+	ImportData *data;
+
+	data = g_slice_new (ImportData);
+	data->editor = g_object_ref (editor);
+	data->filename = g_strdup (filename);
+	data->cancellable = g_cancellable_new ();
+	data->progress_dialog = import_progress_dialog_new (editor, data);
+
+	gtk_window_present (GTK_WINDOW (data->progress_dialog));
+
+	ephy_bookmarks_import_async (editor->priv->bookmarks, filename,
+				     data->cancellable,
+				     import_progress_cb, data,
+				     import_bookmarks_cb, data);
 }
 
 static void
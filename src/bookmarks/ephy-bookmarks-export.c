@@ -60,42 +60,144 @@ sanitise_string (const xmlChar *string)
 	return copy;
 }
 
-static int
-write_topics_list (EphyNode *topics,
-		   EphyNode *bmk,
-		   xmlTextWriterPtr writer)
+struct _EphyBookmarksSnapshot
+{
+	/* keywords first, then bookmarks, in the order they are saved */
+	GPtrArray *nodes;
+	guint n_keywords;
+	guint smart_bookmarks_id;
+};
+
+static gboolean
+snapshot_keyword (EphyBookmarks *bookmarks,
+		  EphyNode *node)
+{
+	return node != ephy_bookmarks_get_bookmarks (bookmarks) &&
+	       node != ephy_bookmarks_get_not_categorized (bookmarks) &&
+	       node != ephy_bookmarks_get_local (bookmarks);
+}
+
+/**
+ * ephy_bookmarks_snapshot_new:
+ * @bookmarks: an #EphyBookmarks
+ *
+ * Copies every keyword and bookmark that gets persisted into an
+ * #EphyBookmarksSnapshot. Only property values and parent ids are copied,
+ * which is cheap compared to serializing them; the result can then be
+ * written out from any thread with ephy_bookmarks_snapshot_write_xml()
+ * and ephy_bookmarks_snapshot_export_rdf(). Local (zeroconf) bookmarks
+ * are left out.
+ *
+ * Returns: a new snapshot, free it with ephy_bookmarks_snapshot_free()
+ **/
+EphyBookmarksSnapshot *
+ephy_bookmarks_snapshot_new (EphyBookmarks *bookmarks)
 {
+	EphyBookmarksSnapshot *snapshot;
+	EphyNode *local;
 	GPtrArray *children;
-	GList *keywords = NULL, *l;
-	int i;
-	int ret = 0;
+	guint i;
+
+	g_return_val_if_fail (EPHY_IS_BOOKMARKS (bookmarks), NULL);
 
-	children = ephy_node_get_children (topics);
+	START_PROFILER ("Snapshotting bookmarks")
+
+	snapshot = g_slice_new0 (EphyBookmarksSnapshot);
+	snapshot->smart_bookmarks_id =
+		ephy_node_get_id (ephy_bookmarks_get_smart_bookmarks (bookmarks));
+
+	children = ephy_node_get_children (ephy_bookmarks_get_keywords (bookmarks));
+	snapshot->nodes = g_ptr_array_new_full (children->len,
+						(GDestroyNotify) ephy_node_snapshot_free);
 	for (i = 0; i < children->len; i++)
 	{
-		EphyNode *kid;
-		EphyNodePriority priority;
+		EphyNode *kid = g_ptr_array_index (children, i);
 
-		kid = g_ptr_array_index (children, i);
+		if (snapshot_keyword (bookmarks, kid))
+		{
+			g_ptr_array_add (snapshot->nodes, ephy_node_snapshot_new (kid));
+		}
+	}
+	snapshot->n_keywords = snapshot->nodes->len;
 
-		priority = ephy_node_get_property_int (kid, EPHY_NODE_KEYWORD_PROP_PRIORITY);
-		if (priority == -1) priority = EPHY_NODE_NORMAL_PRIORITY;
+	local = ephy_bookmarks_get_local (bookmarks);
+	children = ephy_node_get_children (ephy_bookmarks_get_bookmarks (bookmarks));
+	for (i = 0; i < children->len; i++)
+	{
+		EphyNode *kid = g_ptr_array_index (children, i);
 
-		if (priority == EPHY_NODE_NORMAL_PRIORITY &&
-		    ephy_node_has_child (kid, bmk))
+		if (!ephy_node_has_child (local, kid))
 		{
-			keywords = g_list_prepend (keywords, kid);
+			g_ptr_array_add (snapshot->nodes, ephy_node_snapshot_new (kid));
 		}
 	}
 
-	for (l = keywords; l != NULL; l = l->next)
+	STOP_PROFILER ("Snapshotting bookmarks")
+
+	return snapshot;
+}
+
+void
+ephy_bookmarks_snapshot_free (EphyBookmarksSnapshot *snapshot)
+{
+	if (snapshot == NULL) return;
+
+	g_ptr_array_free (snapshot->nodes, TRUE);
+	g_slice_free (EphyBookmarksSnapshot, snapshot);
+}
+
+/**
+ * ephy_bookmarks_snapshot_write_xml:
+ * @snapshot: an #EphyBookmarksSnapshot
+ * @filename: the file to write to
+ * @root: the root element
+ * @version: the version attribute of @root
+ * @comment: a comment to place inside @root, or %NULL
+ *
+ * Writes @snapshot in the #EphyNodeDb XML format, atomically replacing
+ * @filename.
+ *
+ * Returns: 0 on success, -1 on failure
+ **/
+int
+ephy_bookmarks_snapshot_write_xml (EphyBookmarksSnapshot *snapshot,
+				   const char *filename,
+				   const char *root,
+				   const char *version,
+				   const char *comment)
+{
+	g_return_val_if_fail (snapshot != NULL, -1);
+
+	return ephy_node_db_write_snapshots_to_xml_safe
+		((const xmlChar *) filename,
+		 (const xmlChar *) root,
+		 (const xmlChar *) version,
+		 (const xmlChar *) comment,
+		 snapshot->nodes);
+}
+
+static int
+write_topics_list (EphyBookmarksSnapshot *snapshot,
+		   GHashTable *topics,
+		   EphyNodeSnapshot *bmk,
+		   xmlTextWriterPtr writer)
+{
+	const guint *parents;
+	guint n_parents, i;
+	int ret = 0;
+
+	parents = ephy_node_snapshot_get_parents (bmk, &n_parents);
+	for (i = 0; i < n_parents; i++)
 	{
-		EphyNode *node = l->data;
+		EphyNodeSnapshot *topic;
 		const char *name;
 		xmlChar *safeName;
 
-		name = ephy_node_get_property_string
-			(node, EPHY_NODE_KEYWORD_PROP_NAME);
+		topic = g_hash_table_lookup (topics, GUINT_TO_POINTER (parents[i]));
+		if (topic == NULL) continue;
+
+		name = ephy_node_snapshot_get_property_string
+			(topic, EPHY_NODE_KEYWORD_PROP_NAME);
 		safeName = sanitise_string ((const xmlChar *) name);
 
 		ret = xmlTextWriterWriteElementNS
@@ -109,27 +211,74 @@ write_topics_list (EphyNode *topics,
 		if (ret < 0) break;
 	}
 
-	g_list_free (keywords);
-
 	return ret >= 0 ? 0 : -1;
 }
 
+static char *
+get_link (EphyBookmarksSnapshot *snapshot,
+	  EphyNodeSnapshot *bmk,
+	  gboolean *smart_url)
+{
+	const char *url;
+	char *scheme;
+	char *host_name;
+	char *link;
+
+	*smart_url = ephy_node_snapshot_has_parent (bmk, snapshot->smart_bookmarks_id);
+	url = ephy_node_snapshot_get_property_string
+		(bmk, EPHY_NODE_BMK_PROP_LOCATION);
+
+	if (!*smart_url || url == NULL)
+	{
+		return g_strdup (url);
+	}
+
+	scheme = g_uri_parse_scheme (url);
+	host_name = ephy_string_get_host_name (url);
+	link = g_strconcat (scheme,
+			    "://",
+			    host_name,
+			    NULL);
+
+	g_free (scheme);
+	g_free (host_name);
+
+	return link;
+}
+
 static int
-write_rdf (EphyBookmarks *bookmarks,
+write_rdf (EphyBookmarksSnapshot *snapshot,
 	   GFile *file,
 	   xmlTextWriterPtr writer)
 {
-	EphyNode *bmks, *topics, *smart_bmks;
-	GPtrArray *children;
+	GHashTable *topics;
 	char *file_uri;
-	int i, ret;
+	guint i;
+	int ret;
 	xmlChar *safeString;
-#ifdef ENABLE_ZEROCONF
-	EphyNode *local;
-#endif
 
 	START_PROFILER ("Writing RDF")
 
+	/* only user-visible keywords end up as dc:subject */
+	topics = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = 0; i < snapshot->n_keywords; i++)
+	{
+		EphyNodeSnapshot *kid;
+		EphyNodePriority priority;
+
+		kid = g_ptr_array_index (snapshot->nodes, i);
+
+		priority = ephy_node_snapshot_get_property_int (kid, EPHY_NODE_KEYWORD_PROP_PRIORITY);
+		if (priority == -1) priority = EPHY_NODE_NORMAL_PRIORITY;
+
+		if (priority == EPHY_NODE_NORMAL_PRIORITY)
+		{
+			g_hash_table_insert (topics,
+					     GUINT_TO_POINTER (ephy_node_snapshot_get_id (kid)),
+					     kid);
+		}
+	}
+
 	ret = xmlTextWriterStartDocument (writer, "1.0", NULL, NULL);
 	if (ret < 0) goto out;
 
@@ -147,7 +296,7 @@ write_rdf (EphyBookmarks *bookmarks,
 	if (ret < 0) goto out;
 
 	ret = xmlTextWriterWriteAttributeNS
-		(writer, 
+		(writer,
 		 (xmlChar *) "xmlns",
 		 (xmlChar *) "dc",
 		 NULL,
@@ -179,7 +328,7 @@ write_rdf (EphyBookmarks *bookmarks,
 	xmlFree (safeString);
 	if (ret < 0) goto out;
 
-	ret = xmlTextWriterWriteElement 
+	ret = xmlTextWriterWriteElement
 		(writer,
 		 (xmlChar *) "title",
 		 (xmlChar *) "Epiphany bookmarks");
@@ -196,54 +345,22 @@ write_rdf (EphyBookmarks *bookmarks,
 
 	ret = xmlTextWriterStartElementNS
 		(writer,
-		 (xmlChar *) "rdf", 
+		 (xmlChar *) "rdf",
 		 (xmlChar *) "Seq",
 		 NULL);
 	if (ret < 0) goto out;
 
-	bmks = ephy_bookmarks_get_bookmarks (bookmarks);
-	topics = ephy_bookmarks_get_keywords (bookmarks);
-	smart_bmks = ephy_bookmarks_get_smart_bookmarks (bookmarks);
-#ifdef ENABLE_ZEROCONF
-	local = ephy_bookmarks_get_local (bookmarks);
-#endif
-
-	children = ephy_node_get_children (bmks);
-	for (i=0; i < children->len; i++)
+	for (i = snapshot->n_keywords; i < snapshot->nodes->len; i++)
 	{
-		EphyNode *kid;
-		const char *url;
-		char *link = NULL;
+		EphyNodeSnapshot *kid;
+		char *link;
 		gboolean smart_url;
 		xmlChar *safeLink;
 
-		kid = g_ptr_array_index (children, i);
+		kid = g_ptr_array_index (snapshot->nodes, i);
 
-#ifdef ENABLE_ZEROCONF
-		/* Don't export the local bookmarks */
-		if (ephy_node_has_child (local, kid)) continue;
-#endif
-
-		smart_url = ephy_node_has_child (smart_bmks, kid);
-		url = ephy_node_get_property_string
-			(kid, EPHY_NODE_BMK_PROP_LOCATION);
-		if (smart_url && url)
-		{
-			char *scheme;
-			char *host_name;
-			
-			scheme = g_uri_parse_scheme (url);
-			host_name = ephy_string_get_host_name (url);
-			link = g_strconcat (scheme,
-					    "://",
-					    host_name,
-					    NULL);
-
-			g_free (scheme);
-			g_free (host_name);
-		}
-
-		safeLink = sanitise_string (link ? (const xmlChar *) link : (const xmlChar *) url);
+		link = get_link (snapshot, kid, &smart_url);
+		safeLink = sanitise_string ((const xmlChar *) link);
 		g_free (link);
 
 		ret = xmlTextWriterStartElementNS
@@ -275,53 +392,28 @@ write_rdf (EphyBookmarks *bookmarks,
 
 	ret = xmlTextWriterEndElement (writer); /* channel */
 	if (ret < 0) goto out;
-	
-	children = ephy_node_get_children (bmks);
-	for (i=0; i < children->len; i++)
+
+	for (i = snapshot->n_keywords; i < snapshot->nodes->len; i++)
 	{
-		EphyNode *kid;
-		const char *url, *title;
-		char *link = NULL;
+		EphyNodeSnapshot *kid;
+		const char *title;
+		char *link;
 		gboolean smart_url;
 		xmlChar *safeLink, *safeTitle;
 
-		kid = g_ptr_array_index (children, i);
+		kid = g_ptr_array_index (snapshot->nodes, i);
 
-#ifdef ENABLE_ZEROCONF
-		/* Don't export the local bookmarks */
-		if (ephy_node_has_child (local, kid)) continue;
-#endif
-
-		smart_url = ephy_node_has_child (smart_bmks, kid);
-		url = ephy_node_get_property_string
-			(kid, EPHY_NODE_BMK_PROP_LOCATION);
-		title = ephy_node_get_property_string
+		title = ephy_node_snapshot_get_property_string
 			(kid, EPHY_NODE_BMK_PROP_TITLE);
+		link = get_link (snapshot, kid, &smart_url);
 
-		if (smart_url && url)
-		{
-			char *scheme;
-			char *host_name;
-
-			scheme = g_uri_parse_scheme (url);
-			host_name = ephy_string_get_host_name (url);
-
-			link = g_strconcat (scheme,
-					    "://",
-					    host_name,
-					    NULL);
-			g_free (scheme);
-			g_free (host_name);
-		}
-
-		if (link == NULL)
+		ret = xmlTextWriterStartElement (writer, (xmlChar *) "item");
+		if (ret < 0)
 		{
-			link = g_strdup (url);
+			g_free (link);
+			break;
 		}
 
-		ret = xmlTextWriterStartElement (writer, (xmlChar *) "item");
-		if (ret < 0) break;
-
 		safeLink = sanitise_string ((const xmlChar *) link);
 		g_free (link);
 
@@ -343,7 +435,11 @@ write_rdf (EphyBookmarks *bookmarks,
 			 (xmlChar *) "title",
 			 safeTitle);
 		xmlFree (safeTitle);
-		if (ret < 0) break;
+		if (ret < 0)
+		{
+			xmlFree (safeLink);
+			break;
+		}
 
 		ret = xmlTextWriterWriteElement
 			(writer,
@@ -356,7 +452,9 @@ write_rdf (EphyBookmarks *bookmarks,
 		{
 			xmlChar *safeSmartLink;
 
-			safeSmartLink = sanitise_string ((const xmlChar *) url);
+			safeSmartLink = sanitise_string
+				((const xmlChar *) ephy_node_snapshot_get_property_string
+					(kid, EPHY_NODE_BMK_PROP_LOCATION));
 			ret = xmlTextWriterWriteElementNS
 				(writer,
 				 (xmlChar *) "ephy",
@@ -367,7 +465,7 @@ write_rdf (EphyBookmarks *bookmarks,
 			if (ret < 0) break;
 		}
 
-		ret = write_topics_list (topics, kid, writer);
+		ret = write_topics_list (snapshot, topics, kid, writer);
 		if (ret < 0) break;
 
 		ret = xmlTextWriterEndElement (writer); /* item */
@@ -380,14 +478,25 @@ write_rdf (EphyBookmarks *bookmarks,
 	ret = xmlTextWriterEndDocument (writer);
 
 out:
+	g_hash_table_destroy (topics);
+
 	STOP_PROFILER ("Writing RDF")
 
 	return ret;
 }
 
+/**
+ * ephy_bookmarks_snapshot_export_rdf:
+ * @snapshot: an #EphyBookmarksSnapshot
+ * @file_path: the file to write to
+ *
+ * Exports @snapshot as RDF, atomically replacing @file_path. This does
+ * not touch the #EphyBookmarks the snapshot was taken from, so it can
+ * be called from a worker thread.
+ **/
 void
-ephy_bookmarks_export_rdf (EphyBookmarks *bookmarks,
-			   const char *file_path)
+ephy_bookmarks_snapshot_export_rdf (EphyBookmarksSnapshot *snapshot,
+				    const char *file_path)
 {
 	xmlTextWriterPtr writer;
 	xmlBufferPtr buf;
@@ -416,14 +525,14 @@ ephy_bookmarks_export_rdf (EphyBookmarks *bookmarks,
 
 	ret = xmlTextWriterSetIndentString (writer, (xmlChar *) "  ");
 	if (ret < 0) goto out;
-	
+
 	file = g_file_new_for_path (file_path);
-	ret = write_rdf (bookmarks, file, writer);
+	ret = write_rdf (snapshot, file, writer);
 	g_object_unref (file);
-	if (ret < 0) goto out;
 
-	xmlFreeTextWriter (writer);
 out:
+	xmlFreeTextWriter (writer);
+
 	if (ret >= 0)
 	{
 		if (g_file_set_contents (file_path,
@@ -442,10 +551,22 @@ out:
 	LOG ("Exporting as RDF %s.", ret >= 0 ? "succeeded" : "FAILED");
 }
 
+void
+ephy_bookmarks_export_rdf (EphyBookmarks *bookmarks,
+			   const char *file_path)
+{
+	EphyBookmarksSnapshot *snapshot;
+
+	snapshot = ephy_bookmarks_snapshot_new (bookmarks);
+	ephy_bookmarks_snapshot_export_rdf (snapshot, file_path);
+	ephy_bookmarks_snapshot_free (snapshot);
+}
+
 void
 ephy_bookmarks_export_mozilla (EphyBookmarks *bookmarks,
 			       const char *filename)
 {
+	EphyBookmarksSnapshot *snapshot;
 	xsltStylesheetPtr cur = NULL;
 	xmlTextWriterPtr writer;
 	xmlDocPtr doc = NULL, res;
@@ -470,9 +591,11 @@ ephy_bookmarks_export_mozilla (EphyBookmarks *bookmarks,
 
 	START_PROFILER ("Exporting as Mozilla");
 	
+	snapshot = ephy_bookmarks_snapshot_new (bookmarks);
 	tmp_file = g_file_new_for_path (tmp_file_path);
-	ret = write_rdf (bookmarks, tmp_file, writer);
+	ret = write_rdf (snapshot, tmp_file, writer);
 	g_object_unref (tmp_file);
+	ephy_bookmarks_snapshot_free (snapshot);
 
 	if (ret < 0) goto out;
 
@@ -28,6 +28,21 @@
 
 G_BEGIN_DECLS
 
+typedef struct _EphyBookmarksSnapshot EphyBookmarksSnapshot;
+
+EphyBookmarksSnapshot *ephy_bookmarks_snapshot_new (EphyBookmarks *bookmarks);
+
+void ephy_bookmarks_snapshot_free (EphyBookmarksSnapshot *snapshot);
+
+int  ephy_bookmarks_snapshot_write_xml (EphyBookmarksSnapshot *snapshot,
+					const char *filename,
+					const char *root,
+					const char *version,
+					const char *comment);
+
+void ephy_bookmarks_snapshot_export_rdf (EphyBookmarksSnapshot *snapshot,
+					 const char *filename);
+
 void ephy_bookmarks_export_rdf (EphyBookmarks *bookmarks,
 				const char *filename);
 
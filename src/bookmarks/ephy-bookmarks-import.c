@@ -22,6 +22,7 @@
 #include "config.h"
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <libxml/HTMLtree.h>
 #include <libxml/xmlreader.h>
@@ -34,6 +35,8 @@
 #include "ephy-prefs.h"
 #include "ephy-settings.h"
 
+#define IMPORT_PROGRESS_INTERVAL 100 /* ms */
+
 /**
  * NSItemType: netscape bookmark item type
  */
@@ -47,55 +50,146 @@ typedef enum
 	NS_UNKNOWN
 } NSItemType;
 
-static EphyNode *
-bookmark_add (EphyBookmarks *bookmarks,
-	      const char *title,
-	      const char *address)
+typedef enum
+{
+	IMPORT_FORMAT_UNKNOWN,
+	IMPORT_FORMAT_RDF,
+	IMPORT_FORMAT_XBEL,
+	IMPORT_FORMAT_MOZILLA
+} ImportFormat;
+
+/* The parsers only collect EphyBookmarksBatchItems into an ImportContext,
+ * they never touch the EphyBookmarks. This lets them run in a worker
+ * thread; the items are then added with ephy_bookmarks_add_batch().
+ */
+typedef struct
+{
+	GPtrArray *items;
+	GCancellable *cancellable;
+	goffset total;
+	/* Bytes parsed so far; bookmark files are far below 2 GB. */
+	volatile gint current;
+} ImportContext;
+
+static void
+batch_item_free (EphyBookmarksBatchItem *item)
 {
-	if (!ephy_bookmarks_find_bookmark (bookmarks, address))
+	g_free (item->title);
+	g_free (item->address);
+	g_strfreev (item->topics);
+
+	g_slice_free (EphyBookmarksBatchItem, item);
+}
+
+static ImportContext *
+import_context_new (const char *filename,
+		    GCancellable *cancellable)
+{
+	ImportContext *ctx;
+	GStatBuf buf;
+
+	ctx = g_slice_new0 (ImportContext);
+	ctx->items = g_ptr_array_new_with_free_func ((GDestroyNotify) batch_item_free);
+	ctx->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+
+	if (g_stat (filename, &buf) == 0)
 	{
-		return ephy_bookmarks_add (bookmarks, title, address);
+		ctx->total = buf.st_size;
 	}
-	else
+
+	return ctx;
+}
+
+static void
+import_context_free (ImportContext *ctx)
+{
+	g_ptr_array_free (ctx->items, TRUE);
+	if (ctx->cancellable)
 	{
-		return NULL;
+		g_object_unref (ctx->cancellable);
 	}
+
+	g_slice_free (ImportContext, ctx);
 }
 
-gboolean
-ephy_bookmarks_import (EphyBookmarks *bookmarks,
-		       const char *filename)
+static gboolean
+import_context_is_cancelled (ImportContext *ctx)
+{
+	return g_cancellable_is_cancelled (ctx->cancellable);
+}
+
+static void
+import_context_set_progress (ImportContext *ctx,
+			     goffset current)
+{
+	g_atomic_int_set (&ctx->current, (gint) MIN (current, G_MAXINT));
+}
+
+static goffset
+import_context_get_progress (ImportContext *ctx)
+{
+	return g_atomic_int_get (&ctx->current);
+}
+
+/* @topics is a list of topic names, %NULL entries are skipped */
+static void
+import_context_add (ImportContext *ctx,
+		    const char *title,
+		    const char *address,
+		    GList *topics)
+{
+	EphyBookmarksBatchItem *item;
+	GList *l;
+	guint n = 0;
+
+	if (address == NULL) return;
+
+	item = g_slice_new0 (EphyBookmarksBatchItem);
+	item->title = g_strdup (title);
+	item->address = g_strdup (address);
+
+	if (topics != NULL)
+	{
+		item->topics = g_new0 (char *, g_list_length (topics) + 1);
+		for (l = topics; l != NULL; l = l->next)
+		{
+			if (l->data != NULL)
+			{
+				item->topics[n++] = g_strdup (l->data);
+			}
+		}
+	}
+
+	g_ptr_array_add (ctx->items, item);
+}
+
+static ImportFormat
+get_import_format (const char *filename)
 {
 	const char *type;
 	char *basename;
-	gboolean success = FALSE;
+	ImportFormat format = IMPORT_FORMAT_UNKNOWN;
 	GFile *file;
 	GFileInfo *file_info;
 
-	if (g_settings_get_boolean (EPHY_SETTINGS_LOCKDOWN,
-				    EPHY_PREFS_LOCKDOWN_BOOKMARK_EDITING))
-		return FALSE;
-
-	g_return_val_if_fail (filename != NULL, FALSE);
-	
 	file = g_file_new_for_path (filename);
 	file_info = g_file_query_info (file,
 				       G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
 				       0, NULL, NULL);
-	type = g_file_info_get_content_type (file_info);
+	type = file_info ? g_file_info_get_content_type (file_info) : NULL;
 
 	g_debug ("Importing bookmarks of type %s", type ? type : "(null)");
 
 	if (type != NULL && (strcmp (type, "application/rdf+xml") == 0 ||
 			     strcmp (type, "text/rdf") == 0))
 	{
-		success = ephy_bookmarks_import_rdf (bookmarks, filename);
+		format = IMPORT_FORMAT_RDF;
 	}
 	else if ((type != NULL && strcmp (type, "application/x-xbel") == 0) ||
 		 strstr (filename, GALEON_BOOKMARKS_DIR) != NULL ||
 		 strstr (filename, KDE_BOOKMARKS_DIR) != NULL)
 	{
-		success = ephy_bookmarks_import_xbel (bookmarks, filename);
+		format = IMPORT_FORMAT_XBEL;
 	}
 	else if ((type != NULL && strcmp (type, "application/x-mozilla-bookmarks") == 0) ||
 		 (type != NULL && strcmp (type, "text/html") == 0) ||
@@ -104,7 +198,7 @@ ephy_bookmarks_import (EphyBookmarks *bookmarks,
                  strstr (filename, FIREFOX_BOOKMARKS_DIR_1) != NULL ||
 		 strstr (filename, FIREFOX_BOOKMARKS_DIR_2) != NULL)
 	{
-		success = ephy_bookmarks_import_mozilla (bookmarks, filename);
+		format = IMPORT_FORMAT_MOZILLA;
 	}
 	else if (type == NULL)
 	{
@@ -112,29 +206,27 @@ ephy_bookmarks_import (EphyBookmarks *bookmarks,
 
 		if (g_str_has_suffix (basename, ".rdf"))
 		{
-			success = ephy_bookmarks_import_rdf (bookmarks, filename);
+			format = IMPORT_FORMAT_RDF;
 		}
 		else if (g_str_has_suffix (basename, ".xbel"))
 		{
-			success = ephy_bookmarks_import_xbel (bookmarks, filename);
+			format = IMPORT_FORMAT_XBEL;
 		}
 		else if (g_str_has_suffix (basename, ".html"))
 		{
-			success = ephy_bookmarks_import_mozilla (bookmarks, filename);
-		}
-		else
-		{
-			/* else FIXME: put up some UI to warn user about unrecognised format? */
-			g_warning ("Couldn't determine the type of the bookmarks file %s!\n", filename);
+			format = IMPORT_FORMAT_MOZILLA;
 		}
 
 		g_free (basename);
 	}
 
-	g_object_unref (file_info);
+	if (file_info)
+	{
+		g_object_unref (file_info);
+	}
 	g_object_unref (file);
 
-	return success;
+	return format;
 }
 
 /* XBEL import */
@@ -154,10 +246,9 @@ typedef enum
 } EphyXBELImporterState;
 
 static int
-xbel_parse_bookmark (EphyBookmarks *eb, xmlTextReaderPtr reader, EphyNode **ret_node)
+xbel_parse_bookmark (ImportContext *ctx, xmlTextReaderPtr reader, GList *folders)
 {
 	EphyXBELImporterState state = STATE_BOOKMARK;
-	EphyNode *node;
 	xmlChar *title = NULL;
 	xmlChar *address = NULL;
 	int ret = 1;
@@ -266,28 +357,17 @@ xbel_parse_bookmark (EphyBookmarks *eb, xmlTextReaderPtr reader, EphyNode **ret_
 		return ret;
 	}
 
-	if (title == NULL)
-	{
-		title = xmlStrdup ((xmlChar *) _("Untitled"));
-	}
-
-	node = bookmark_add (eb, (const char *) title, (const char *) address);
-	if (node == NULL)
-	{
-		/* probably a duplicate */
-		node = ephy_bookmarks_find_bookmark (eb, (const char *) address);
-	}
+	/* duplicates are sorted out by ephy_bookmarks_add_batch() */
+	import_context_add (ctx, (const char *) title, (const char *) address, folders);
 
 	xmlFree (title);
 	xmlFree (address);
 
-	*ret_node = node;
-
 	return ret;
 }
 
 static int
-xbel_parse_folder (EphyBookmarks *eb, xmlTextReaderPtr reader, GList *folders)
+xbel_parse_folder (ImportContext *ctx, xmlTextReaderPtr reader, GList *folders)
 {
 	EphyXBELImporterState state = STATE_FOLDER;
 	char *folder = NULL;
@@ -322,29 +402,9 @@ xbel_parse_folder (EphyBookmarks *eb, xmlTextReaderPtr reader, GList *folders)
 		}
 		else if (xmlStrEqual (tag, (xmlChar *) "bookmark") && type == 1 && state == STATE_FOLDER)
 		{
-			EphyNode *node = NULL, *keyword;
-			GList *l;
-
-			ret = xbel_parse_bookmark (eb, reader, &node);
+			ret = xbel_parse_bookmark (ctx, reader, folders);
 
-			for (l = folders; l != NULL; l=l->next)
-			{
-				char *title;
-				
-				title = l->data ? (char *) l->data : "";
-				
-				keyword = ephy_bookmarks_find_keyword (eb, title, FALSE);
-			
-				if (keyword == NULL && title[0] != '\0')
-				{
-					keyword = ephy_bookmarks_add_keyword (eb, title);
-				}
-
-				if (node != NULL && keyword != NULL)
-				{
-					ephy_bookmarks_set_keyword (eb, keyword, node);
-				}
-			}
+			import_context_set_progress (ctx, xmlTextReaderByteConsumed (reader));
 
 			if (ret != 1) break;
 		}
@@ -353,7 +413,7 @@ xbel_parse_folder (EphyBookmarks *eb, xmlTextReaderPtr reader, GList *folders)
 		{
 			if (type == XML_READER_TYPE_ELEMENT)
 			{
-				ret = xbel_parse_folder (eb, reader, folders);
+				ret = xbel_parse_folder (ctx, reader, folders);
 				
 				if (ret != 1) break;
 			}
@@ -402,6 +462,12 @@ xbel_parse_folder (EphyBookmarks *eb, xmlTextReaderPtr reader, GList *folders)
 			/* eat it */
 		}
 
+		if (import_context_is_cancelled (ctx))
+		{
+			ret = -1;
+			break;
+		}
+
 		/* next one, please */
 		ret = xmlTextReaderRead (reader);
 	}
@@ -416,7 +482,7 @@ xbel_parse_folder (EphyBookmarks *eb, xmlTextReaderPtr reader, GList *folders)
 }
 
 static int
-xbel_parse_xbel (EphyBookmarks *eb, xmlTextReaderPtr reader)
+xbel_parse_xbel (ImportContext *ctx, xmlTextReaderPtr reader)
 {
 	EphyXBELImporterState state = STATE_XBEL;
 	int ret;
@@ -438,10 +504,8 @@ xbel_parse_xbel (EphyBookmarks *eb, xmlTextReaderPtr reader)
 		else if (xmlStrEqual (tag, (xmlChar *) "bookmark") && type == XML_READER_TYPE_ELEMENT
 			 && state == STATE_XBEL)
 		{
-			EphyNode *node = NULL;
-
 			/* this will eat the </bookmark> too */
-			ret = xbel_parse_bookmark (eb, reader, &node);
+			ret = xbel_parse_bookmark (ctx, reader, NULL);
 
 			if (ret != 1) break;
 		}
@@ -449,7 +513,7 @@ xbel_parse_xbel (EphyBookmarks *eb, xmlTextReaderPtr reader)
 			 && state == STATE_XBEL)
 		{
 			/* this will eat the </folder> too */
-			ret = xbel_parse_folder (eb, reader, NULL);
+			ret = xbel_parse_folder (ctx, reader, NULL);
 
 			if (ret != 1) break;
 		}
@@ -497,6 +561,14 @@ xbel_parse_xbel (EphyBookmarks *eb, xmlTextReaderPtr reader)
 			}
 		}
 
+		import_context_set_progress (ctx, xmlTextReaderByteConsumed (reader));
+
+		if (import_context_is_cancelled (ctx))
+		{
+			ret = -1;
+			break;
+		}
+
 		/* next one, please */
 		ret = xmlTextReaderRead (reader);
 	}
@@ -506,22 +578,59 @@ xbel_parse_xbel (EphyBookmarks *eb, xmlTextReaderPtr reader)
 
 /* Mozilla/Netscape import */
 
-static gchar *
-gul_general_read_line_from_file (FILE *f)
+typedef struct
 {
-	gchar *line = g_strdup ("");
-	gchar *t;
-	gchar *buf = g_new0 (gchar, 256);
-	while ( ! ( strchr (buf, '\n') || feof (f) ) ) {
-		if (fgets(buf, 256, f))
-		{
-			t = line;
-			line = g_strconcat (line, buf, NULL);
-			g_free (t);
-		}
+	FILE *file;
+	GString *line;
+	GRegex *site_regex;
+	GRegex *folder_regex;
+	GRegex *folder_end_regex;
+} NSParser;
+
+static void
+ns_parser_init (NSParser *parser, FILE *f)
+{
+	parser->file = f;
+	parser->line = g_string_sized_new (256);
+
+	/* Compiled once per file rather than once per line */
+	parser->site_regex = g_regex_new
+		 ("<a href=\"(?P<url>[^\"]*).*?>\\s*(?P<name>.*?)\\s*</a>",
+		 G_REGEX_CASELESS | G_REGEX_OPTIMIZE, G_REGEX_MATCH_NOTEMPTY, NULL);
+	parser->folder_regex = g_regex_new
+		("<h3.*>(?P<name>\\w.*)</h3>",
+		 G_REGEX_CASELESS | G_REGEX_OPTIMIZE, G_REGEX_MATCH_NOTEMPTY, NULL);
+	parser->folder_end_regex = g_regex_new
+		("</dl>",
+		 G_REGEX_CASELESS | G_REGEX_OPTIMIZE, G_REGEX_MATCH_NOTEMPTY, NULL);
+}
+
+static void
+ns_parser_clear (NSParser *parser)
+{
+	g_string_free (parser->line, TRUE);
+	g_regex_unref (parser->site_regex);
+	g_regex_unref (parser->folder_regex);
+	g_regex_unref (parser->folder_end_regex);
+}
+
+/* Reads the next line into parser->line, appending in place instead of
+ * concatenating a new string for every chunk. */
+static gboolean
+ns_parser_read_line (NSParser *parser)
+{
+	char buf[1024];
+
+	g_string_truncate (parser->line, 0);
+
+	while (fgets (buf, sizeof (buf), parser->file))
+	{
+		g_string_append (parser->line, buf);
+
+		if (parser->line->str[parser->line->len - 1] == '\n') break;
 	}
-	g_free (buf);
-	return line;
+
+	return parser->line->len > 0;
 }
 
 /**
@@ -529,17 +638,14 @@ gul_general_read_line_from_file (FILE *f)
  */
 /* this has been tested fairly well */
 static NSItemType
-ns_get_bookmark_item (FILE *f, GString *name, GString *url)
+ns_get_bookmark_item (NSParser *parser, GString *name, GString *url)
 {
-	char *line = NULL;
-	GRegex *regex;
 	GMatchInfo *match_info;
 	int ret = NS_UNKNOWN;
 	char *match_url = NULL;
 	char *match_name = NULL;
+	const char *line = parser->line->str;
 
-	line = gul_general_read_line_from_file (f);
-	
 	/*
 	 * Regex parsing of the html file:
 	 * 1. check if it's a bookmark, or a folder, or the end of a folder,
@@ -550,12 +656,7 @@ ns_get_bookmark_item (FILE *f, GString *name, GString *url)
 	 */
 	
 	/* check if it's a bookmark */
-	regex = g_regex_new
-		 ("<a href=\"(?P<url>[^\"]*).*?>\\s*(?P<name>.*?)\\s*</a>",
-		 G_REGEX_CASELESS, G_REGEX_MATCH_NOTEMPTY, NULL);
-	g_regex_match (regex, line, 0, &match_info);
-	
-	if (g_match_info_matches (match_info))
+	if (g_regex_match (parser->site_regex, line, 0, &match_info))
 	{
 		match_url = g_match_info_fetch_named (match_info, "url");
 		match_name = g_match_info_fetch_named (match_info, "name");
@@ -563,28 +664,18 @@ ns_get_bookmark_item (FILE *f, GString *name, GString *url)
 		goto end;
 	}
 	g_match_info_free (match_info);
-	g_regex_unref (regex);
 	
 	/* check if it's a folder start */
-	regex = g_regex_new ("<h3.*>(?P<name>\\w.*)</h3>", 
-				G_REGEX_CASELESS, G_REGEX_MATCH_NOTEMPTY, NULL);
-
-	g_regex_match (regex, line, 0, &match_info);
-	if (g_match_info_matches (match_info))
+	if (g_regex_match (parser->folder_regex, line, 0, &match_info))
 	{
 		match_name = g_match_info_fetch_named (match_info, "name");
 		ret = NS_FOLDER;
 		goto end;
 	}
 	g_match_info_free (match_info);
-	g_regex_unref (regex);
 	
 	/* check if it's a folder end */
-	regex = g_regex_new ("</dl>", 
-				G_REGEX_CASELESS, G_REGEX_MATCH_NOTEMPTY, NULL);
-
-	g_regex_match (regex, line, 0, &match_info);
-	if (g_match_info_matches (match_info))
+	if (g_regex_match (parser->folder_end_regex, line, 0, &match_info))
 	{
 		ret = NS_FOLDER_END;
 		goto end;
@@ -592,12 +683,10 @@ ns_get_bookmark_item (FILE *f, GString *name, GString *url)
 	
 	/* now let's use the collected stuff */
 	end:
-		/* Due to the goto we'll always have an unfreed @match_info and 
-		 * @regex. Note that this two free/unrefs correspond to the last 
-		 * if() block too.
+		/* Due to the goto we'll always have an unfreed @match_info.
+		 * Note that this free corresponds to the last if() block too.
 		 */
 		g_match_info_free (match_info);
-		g_regex_unref (regex);
 
 		if (match_name)
 		{
@@ -611,7 +700,6 @@ ns_get_bookmark_item (FILE *f, GString *name, GString *url)
 			g_free (match_url);
 		}
 
-		g_free (line);
 		return ret;
 }
 
@@ -704,32 +792,36 @@ ns_parse_bookmark_item (GString *string)
 	return temp;
 }
 
-gboolean
-ephy_bookmarks_import_mozilla (EphyBookmarks *bookmarks,
-			       const char *filename)
+static gboolean
+parse_mozilla (ImportContext *ctx,
+	       const char *filename)
 {
 	FILE *bf;  /* bookmark file */
+	NSParser parser;
 	GString *name, *url;
 	char *parsedname;
 	GList *folders = NULL;
 	gboolean retval = TRUE;
 
-	if (g_settings_get_boolean (EPHY_SETTINGS_LOCKDOWN,
-				    EPHY_PREFS_LOCKDOWN_BOOKMARK_EDITING))
-		return FALSE;
-
 	if (!(bf = fopen (filename, "r"))) {
 		g_warning ("Failed to open file: %s\n", filename);
 		return FALSE;
 	}
 
+	ns_parser_init (&parser, bf);
 	name = g_string_new (NULL);
 	url = g_string_new (NULL);
 
-	while (!feof (bf)) {
-		EphyNode *node;
+	while (ns_parser_read_line (&parser)) {
 		NSItemType t;
-		t = ns_get_bookmark_item (bf, name, url);
+
+		if (import_context_is_cancelled (ctx))
+		{
+			retval = FALSE;
+			break;
+		}
+
+		t = ns_get_bookmark_item (&parser, name, url);
 		switch (t)
 		{
 		case NS_FOLDER:
@@ -748,61 +840,33 @@ ephy_bookmarks_import_mozilla (EphyBookmarks *bookmarks,
 		case NS_SITE:
 			parsedname = ns_parse_bookmark_item (name);
 
-			node = bookmark_add (bookmarks, parsedname, url->str);
-
-			if (node == NULL)
-			{
-				node = ephy_bookmarks_find_bookmark (bookmarks, url->str);
-				if (node == NULL) {
-					g_warning ("%s: `node' is NULL", G_STRFUNC);
-					retval = FALSE;
-					goto out;
-				}
-			}
-
-			if (folders != NULL)
-			{
-				EphyNode *keyword;
-				GList *l;
-
-				for (l = folders; l != NULL; l = l->next)
-				{
-					keyword = ephy_bookmarks_find_keyword (bookmarks, l->data, FALSE);
-					if (keyword == NULL)
-					{
-						keyword = ephy_bookmarks_add_keyword (bookmarks, l->data);
-					}
-
-					ephy_bookmarks_set_keyword (bookmarks, keyword, node);
-				}
-			}
+			import_context_add (ctx, parsedname, url->str, folders);
 
 			g_free (parsedname);
 
+			import_context_set_progress (ctx, ftell (bf));
 			break;
 		default:
 			break;
 		}
 	}
-out:
+
 	fclose (bf);
+	ns_parser_clear (&parser);
 	g_string_free (name, TRUE);
 	g_string_free (url, TRUE);
+	g_list_free_full (folders, g_free);
 
 	return retval;
 }
 
-gboolean
-ephy_bookmarks_import_xbel (EphyBookmarks *bookmarks,
-			    const char *filename)
+static gboolean
+parse_xbel (ImportContext *ctx,
+	    const char *filename)
 {
 	xmlTextReaderPtr reader;
 	int ret;
 
-	if (g_settings_get_boolean (EPHY_SETTINGS_LOCKDOWN,
-				    EPHY_PREFS_LOCKDOWN_BOOKMARK_EDITING))
-		return FALSE;
-
 	if (g_file_test (filename, G_FILE_TEST_EXISTS) == FALSE)
 	{
 		return FALSE;
@@ -814,7 +878,7 @@ ephy_bookmarks_import_xbel (EphyBookmarks *bookmarks,
 		return FALSE;
 	}
 
-	ret = xbel_parse_xbel (bookmarks, reader);
+	ret = xbel_parse_xbel (ctx, reader);
 
 	xmlFreeTextReader (reader);
 
@@ -883,7 +947,7 @@ parse_rdf_lang_tag (xmlNode  *child,
 }
 
 static void
-parse_rdf_item (EphyBookmarks *bookmarks,
+parse_rdf_item (ImportContext *ctx,
 		xmlNodePtr node)
 {
 	xmlChar *title = NULL;
@@ -894,9 +958,8 @@ parse_rdf_item (EphyBookmarks *bookmarks,
 	 * a localized link */
 	gboolean use_smartlink = FALSE;
 	xmlChar *subject = NULL;
-	GList *subjects = NULL, *l = NULL;
+	GList *subjects = NULL;
 	xmlNode *child;
-	EphyNode *bmk = NULL;
 
 	child = node->children;
 
@@ -937,79 +1000,352 @@ parse_rdf_item (EphyBookmarks *bookmarks,
 		child = child->next;
 	}
 
-	if (link)
-		bmk = bookmark_add (bookmarks, (char *) title, (char *) link);
+	import_context_add (ctx, (char *) title, (char *) link, subjects);
 
-	if (bmk)
-	{
-		l = subjects;
-	}
+	xmlFree (title);
+	xmlFree (link);
+
+	g_list_foreach (subjects, (GFunc)xmlFree, NULL);
+	g_list_free (subjects);
+}
 
-	for (; l != NULL; l = l->next)
+/* Streams the items one by one with an xmlTextReader instead of loading
+ * the whole document. Any parse error fails the whole import, like a
+ * failing xmlParseFile() did.
+ */
+static gboolean
+parse_rdf (ImportContext *ctx,
+	   const char *filename)
+{
+	xmlTextReaderPtr reader;
+	int ret;
+
+	if (g_file_test (filename, G_FILE_TEST_EXISTS) == FALSE)
+		return FALSE;
+
+	reader = xmlNewTextReaderFilename (filename);
+	if (reader == NULL)
+		return FALSE;
+
+	ret = xmlTextReaderRead (reader);
+
+	while (ret == 1)
 	{
-		char *topic_name = l->data;
-		EphyNode *topic;
+		if (xmlTextReaderDepth (reader) == 1 &&
+		    xmlTextReaderNodeType (reader) == XML_READER_TYPE_ELEMENT &&
+		    xmlStrEqual (xmlTextReaderConstLocalName (reader), (xmlChar *) "item"))
+		{
+			xmlNodePtr node;
 
-		topic = ephy_bookmarks_find_keyword (bookmarks, topic_name, FALSE);
+			node = xmlTextReaderExpand (reader);
+			if (node == NULL)
+			{
+				ret = -1;
+				break;
+			}
+
+			parse_rdf_item (ctx, node);
+
+			import_context_set_progress (ctx, xmlTextReaderByteConsumed (reader));
 
-		if (topic == NULL)
+			/* skip the subtree we just parsed */
+			ret = xmlTextReaderNext (reader);
+		}
+		else
 		{
-			topic = ephy_bookmarks_add_keyword (bookmarks, topic_name);
+			ret = xmlTextReaderRead (reader);
 		}
 
-		if (topic != NULL)
+		if (import_context_is_cancelled (ctx))
 		{
-			ephy_bookmarks_set_keyword (bookmarks, topic, bmk);
+			ret = -1;
 		}
 	}
 
-	xmlFree (title);
-	xmlFree (link);
+	xmlFreeTextReader (reader);
 
-	g_list_foreach (subjects, (GFunc)xmlFree, NULL);
-	g_list_free (subjects);
+	return ret == 0;
 }
 
-gboolean
-ephy_bookmarks_import_rdf (EphyBookmarks *bookmarks,
-			   const char *filename)
+static gboolean
+parse_file (ImportContext *ctx,
+	    const char *filename,
+	    ImportFormat format)
+{
+	gboolean success = FALSE;
+
+	START_PROFILER ("Parsing bookmarks")
+
+	switch (format)
+	{
+	case IMPORT_FORMAT_RDF:
+		success = parse_rdf (ctx, filename);
+		break;
+	case IMPORT_FORMAT_XBEL:
+		success = parse_xbel (ctx, filename);
+		break;
+	case IMPORT_FORMAT_MOZILLA:
+		success = parse_mozilla (ctx, filename);
+		break;
+	default:
+		break;
+	}
+
+	STOP_PROFILER ("Parsing bookmarks")
+
+	return success;
+}
+
+static gboolean
+import_sync (EphyBookmarks *bookmarks,
+	     const char *filename,
+	     ImportFormat format)
 {
-	xmlDocPtr doc;
-	xmlNodePtr child;
-	xmlNodePtr root;
+	ImportContext *ctx;
+	gboolean success;
 
 	if (g_settings_get_boolean (EPHY_SETTINGS_LOCKDOWN,
 				    EPHY_PREFS_LOCKDOWN_BOOKMARK_EDITING))
 		return FALSE;
 
-	if (g_file_test (filename, G_FILE_TEST_EXISTS) == FALSE)
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	ctx = import_context_new (filename, NULL);
+
+	success = parse_file (ctx, filename, format);
+	if (success)
+	{
+		ephy_bookmarks_add_batch (bookmarks, ctx->items);
+	}
+
+	import_context_free (ctx);
+
+	return success;
+}
+
+gboolean
+ephy_bookmarks_import (EphyBookmarks *bookmarks,
+		       const char *filename)
+{
+	ImportFormat format;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	format = get_import_format (filename);
+	if (format == IMPORT_FORMAT_UNKNOWN)
+	{
+		/* else FIXME: put up some UI to warn user about unrecognised format? */
+		g_warning ("Couldn't determine the type of the bookmarks file %s!\n", filename);
 		return FALSE;
+	}
+
+	return import_sync (bookmarks, filename, format);
+}
 
-	doc = xmlParseFile (filename);
-	if (doc == NULL)
+gboolean
+ephy_bookmarks_import_mozilla (EphyBookmarks *bookmarks,
+			       const char *filename)
+{
+	return import_sync (bookmarks, filename, IMPORT_FORMAT_MOZILLA);
+}
+
+gboolean
+ephy_bookmarks_import_xbel (EphyBookmarks *bookmarks,
+			    const char *filename)
+{
+	return import_sync (bookmarks, filename, IMPORT_FORMAT_XBEL);
+}
+
+gboolean
+ephy_bookmarks_import_rdf (EphyBookmarks *bookmarks,
+			   const char *filename)
+{
+	gboolean success;
+
+	success = import_sync (bookmarks, filename, IMPORT_FORMAT_RDF);
+	if (!success && g_file_test (filename, G_FILE_TEST_EXISTS))
 	{
 		/* FIXME: maybe put up a warning dialogue here, because this
 		 * is a severe dataloss?
 		 */
 		g_warning ("Failed to re-import the bookmarks. All bookmarks lost!\n");
-		return FALSE;
 	}
 
-	root = xmlDocGetRootElement (doc);
+	return success;
+}
 
-	child = root->children;
+typedef struct
+{
+	char *filename;
+	ImportFormat format;
+	ImportContext *ctx;
+	GFileProgressCallback progress_callback;
+	gpointer progress_data;
+	guint progress_timeout_id;
+} ImportAsyncData;
 
-	while (child != NULL)
+static void
+import_async_data_free (ImportAsyncData *data)
+{
+	if (data->progress_timeout_id)
+	{
+		g_source_remove (data->progress_timeout_id);
+	}
+
+	g_free (data->filename);
+	import_context_free (data->ctx);
+
+	g_slice_free (ImportAsyncData, data);
+}
+
+static gboolean
+import_progress_cb (ImportAsyncData *data)
+{
+	data->progress_callback (import_context_get_progress (data->ctx),
+				 data->ctx->total,
+				 data->progress_data);
+
+	return TRUE;
+}
+
+static void
+import_parse_thread (GTask *task,
+		     gpointer source_object,
+		     gpointer task_data,
+		     GCancellable *cancellable)
+{
+	ImportAsyncData *data = task_data;
+
+	g_task_return_boolean (task, parse_file (data->ctx, data->filename, data->format));
+}
+
+static void
+import_parsed_cb (GObject *source_object,
+		  GAsyncResult *result,
+		  gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	ImportAsyncData *data = g_task_get_task_data (task);
+	GError *error = NULL;
+
+	if (data->progress_timeout_id)
+	{
+		g_source_remove (data->progress_timeout_id);
+		data->progress_timeout_id = 0;
+	}
+
+	if (g_task_return_error_if_cancelled (task))
 	{
-		if (xmlStrEqual (child->name, (xmlChar *) "item"))
+		g_object_unref (task);
+		return;
+	}
+
+	if (!g_task_propagate_boolean (G_TASK (result), &error))
+	{
+		if (error == NULL)
 		{
-			parse_rdf_item (bookmarks, child);
+			error = g_error_new (G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					     _("The bookmarks from “%s” could not be parsed"),
+					     data->filename);
 		}
+		g_task_return_error (task, error);
+		g_object_unref (task);
+		return;
+	}
 
-		child = child->next;
+	/* Parsing is done, now insert everything in one go */
+	ephy_bookmarks_add_batch (EPHY_BOOKMARKS (source_object), data->ctx->items);
+
+	if (data->progress_callback)
+	{
+		data->progress_callback (data->ctx->total, data->ctx->total,
+					 data->progress_data);
 	}
 
-	xmlFreeDoc (doc);
+	g_task_return_boolean (task, TRUE);
+	g_object_unref (task);
+}
 
-	return TRUE;
+/**
+ * ephy_bookmarks_import_async:
+ * @bookmarks: an #EphyBookmarks
+ * @filename: the file to import
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @progress_callback: (allow-none): called on the main thread with the
+ *   number of bytes of @filename parsed so far, or %NULL
+ * @progress_data: data for @progress_callback
+ * @callback: called when the import is finished
+ * @user_data: data for @callback
+ *
+ * Imports the bookmarks in @filename, guessing its format like
+ * ephy_bookmarks_import(). The file is parsed in a worker thread and the
+ * results are added on the main thread with a single call to
+ * ephy_bookmarks_add_batch(). If the file cannot be parsed nothing is
+ * added.
+ **/
+void
+ephy_bookmarks_import_async (EphyBookmarks *bookmarks,
+			     const char *filename,
+			     GCancellable *cancellable,
+			     GFileProgressCallback progress_callback,
+			     gpointer progress_data,
+			     GAsyncReadyCallback callback,
+			     gpointer user_data)
+{
+	GTask *task, *parse_task;
+	ImportAsyncData *data;
+
+	g_return_if_fail (EPHY_IS_BOOKMARKS (bookmarks));
+	g_return_if_fail (filename != NULL);
+
+	task = g_task_new (bookmarks, cancellable, callback, user_data);
+
+	if (g_settings_get_boolean (EPHY_SETTINGS_LOCKDOWN,
+				    EPHY_PREFS_LOCKDOWN_BOOKMARK_EDITING))
+	{
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED,
+					 _("Bookmark editing is disabled"));
+		g_object_unref (task);
+		return;
+	}
+
+	data = g_slice_new0 (ImportAsyncData);
+	data->filename = g_strdup (filename);
+	data->format = get_import_format (filename);
+	data->ctx = import_context_new (filename, cancellable);
+	data->progress_callback = progress_callback;
+	data->progress_data = progress_data;
+	g_task_set_task_data (task, data, (GDestroyNotify) import_async_data_free);
+
+	if (data->format == IMPORT_FORMAT_UNKNOWN)
+	{
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+					 _("Couldn't determine the type of the bookmarks file %s"),
+					 filename);
+		g_object_unref (task);
+		return;
+	}
+
+	if (progress_callback)
+	{
+		data->progress_timeout_id =
+			g_timeout_add (IMPORT_PROGRESS_INTERVAL,
+				       (GSourceFunc) import_progress_cb, data);
+	}
+
+	/* task is unreffed in import_parsed_cb */
+	parse_task = g_task_new (bookmarks, cancellable, import_parsed_cb, task);
+	g_task_set_task_data (parse_task, data, NULL);
+	g_task_run_in_thread (parse_task, import_parse_thread);
+	g_object_unref (parse_task);
+}
+
+gboolean
+ephy_bookmarks_import_finish (EphyBookmarks *bookmarks,
+			      GAsyncResult *result,
+			      GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, bookmarks), FALSE);
+
+	return g_task_propagate_boolean (G_TASK (result), error);
 }
@@ -27,6 +27,8 @@
 
 #include "ephy-bookmarks.h"
 
+#include <gio/gio.h>
+
 G_BEGIN_DECLS
 
 #define MOZILLA_BOOKMARKS_DIR	".mozilla"
@@ -39,6 +41,18 @@ G_BEGIN_DECLS
 gboolean ephy_bookmarks_import         (EphyBookmarks *bookmarks,
 					const char *filename);
 
+void     ephy_bookmarks_import_async   (EphyBookmarks *bookmarks,
+					const char *filename,
+					GCancellable *cancellable,
+					GFileProgressCallback progress_callback,
+					gpointer progress_data,
+					GAsyncReadyCallback callback,
+					gpointer user_data);
+
+gboolean ephy_bookmarks_import_finish  (EphyBookmarks *bookmarks,
+					GAsyncResult *result,
+					GError **error);
+
 gboolean ephy_bookmarks_import_mozilla (EphyBookmarks *bookmarks,
 					const char *filename);
 
@@ -169,11 +169,12 @@ ephy_bookmarks_ui_attach_window (EphyWindow *window)
 	GtkActionGroup *actions;
 	GtkAction *action;
 
+	data = g_object_get_data (G_OBJECT (window), BM_WINDOW_DATA_KEY);
+	if (data != NULL) return;
+
 	eb = ephy_shell_get_bookmarks (ephy_shell_get_default ());
 	bookmarks = ephy_bookmarks_get_bookmarks (eb);
 	topics = ephy_bookmarks_get_keywords (eb);
-	data = g_object_get_data (G_OBJECT (window), BM_WINDOW_DATA_KEY);
-	g_return_if_fail (data == NULL);
 
 	manager = ephy_window_get_ui_manager (window);
 
@@ -238,15 +239,20 @@ ephy_bookmarks_ui_attach_window (EphyWindow *window)
 void
 ephy_bookmarks_ui_detach_window (EphyWindow *window)
 {
-	EphyBookmarks *eb = ephy_shell_get_bookmarks (ephy_shell_get_default ());
-	EphyNode *bookmarks = ephy_bookmarks_get_bookmarks (eb);
-	EphyNode *topics = ephy_bookmarks_get_keywords (eb);
+	EphyBookmarks *eb;
+	EphyNode *bookmarks;
+	EphyNode *topics;
 
 	BookmarksWindowData *data = g_object_get_data (G_OBJECT (window), BM_WINDOW_DATA_KEY);
 	GtkUIManager *manager = ephy_window_get_ui_manager (window);
 	GtkAction *action;
 
-	g_return_if_fail (data != 0);
+	/* The window was closed before the bookmarks were loaded. */
+	if (data == NULL) return;
+
+	eb = ephy_shell_get_bookmarks (ephy_shell_get_default ());
+	bookmarks = ephy_bookmarks_get_bookmarks (eb);
+	topics = ephy_bookmarks_get_keywords (eb);
 
 	if (data->bookmarks_menu)
 		gtk_ui_manager_remove_ui (manager, data->bookmarks_menu);
@@ -30,6 +30,7 @@
 #include "ephy-embed-shell.h"
 #include "ephy-file-helpers.h"
 #include "ephy-history-service.h"
+#include "ephy-metrics.h"
 #include "ephy-node-common.h"
 #include "ephy-prefs.h"
 #include "ephy-profile-utils.h"
@@ -65,6 +66,8 @@ struct _EphyBookmarksPrivate
 {
 	gboolean init_defaults;
 	gboolean dirty;
+	gboolean saving;
+	gboolean save_pending;
 	guint save_timeout_id;
 	char *xml_file;
 	char *rdf_file;
@@ -81,6 +84,9 @@ struct _EphyBookmarksPrivate
 	GaClient *ga_client;
 	GaServiceBrowser *browse_handles[G_N_ELEMENTS (zeroconf_protos)];
 	GHashTable *resolve_handles;
+
+	EphyMetricsHistogram *snapshot_metric;
+	EphyMetricsHistogram *save_metric;
 };
 
 static const char *default_topics [] =
@@ -158,53 +164,154 @@ ephy_bookmarks_class_init (EphyBookmarksClass *klass)
 	g_type_class_add_private (object_class, sizeof(EphyBookmarksPrivate));
 }
 
-static gboolean
-save_filter (EphyNode *node,
-	     EphyBookmarks *bookmarks)
+typedef struct
 {
-	EphyBookmarksPrivate *priv = bookmarks->priv;
+	EphyBookmarksSnapshot *snapshot;
+	char *xml_file;
+	char *rdf_file;
+	EphyMetricsHistogram *save_metric;
+} SaveData;
+
+static SaveData *
+save_data_new (EphyBookmarks *eb)
+{
+	SaveData *data;
+	gint64 start;
+
+	start = g_get_monotonic_time ();
+
+	data = g_slice_new0 (SaveData);
+	data->snapshot = ephy_bookmarks_snapshot_new (eb);
+	data->xml_file = g_strdup (eb->priv->xml_file);
+	data->rdf_file = g_strdup (eb->priv->rdf_file);
+	data->save_metric = eb->priv->save_metric;
+
+	ephy_metrics_histogram_add (eb->priv->snapshot_metric,
+				    g_get_monotonic_time () - start);
 
-	return node != priv->bookmarks &&
-	       node != priv->notcategorized &&
-	       node != priv->local;
+	return data;
 }
 
-static gboolean
-save_filter_local (EphyNode *node,
-		   EphyBookmarks *bookmarks)
+static void
+save_data_free (SaveData *data)
 {
-	EphyBookmarksPrivate *priv = bookmarks->priv;
+	ephy_bookmarks_snapshot_free (data->snapshot);
+	g_free (data->xml_file);
+	g_free (data->rdf_file);
 
-	return !ephy_node_has_child (priv->local, node);
+	g_slice_free (SaveData, data);
 }
 
 static void
-ephy_bookmarks_save (EphyBookmarks *eb)
+save_data_write (SaveData *data)
 {
+	gint64 start;
 
 	LOG ("Saving bookmarks");
 
-	ephy_node_db_write_to_xml_safe
-		(eb->priv->db,
-		 (xmlChar *) eb->priv->xml_file,
-		 (xmlChar *) EPHY_BOOKMARKS_XML_ROOT,
-		 (xmlChar *) EPHY_BOOKMARKS_XML_VERSION,
-		 (xmlChar *) "Do not rely on this file, it's only for internal use. Use bookmarks.rdf instead.",
-		 eb->priv->keywords, (EphyNodeFilterFunc) save_filter, eb,
-		 eb->priv->bookmarks, (EphyNodeFilterFunc) save_filter_local, eb,
-		 NULL);
+	start = g_get_monotonic_time ();
+
+	ephy_bookmarks_snapshot_write_xml
+		(data->snapshot,
+		 data->xml_file,
+		 EPHY_BOOKMARKS_XML_ROOT,
+		 EPHY_BOOKMARKS_XML_VERSION,
+		 "Do not rely on this file, it's only for internal use. Use bookmarks.rdf instead.");
 
 	/* Export bookmarks in rdf */
-	ephy_bookmarks_export_rdf (eb, eb->priv->rdf_file);
+	ephy_bookmarks_snapshot_export_rdf (data->snapshot, data->rdf_file);
+
+	ephy_metrics_histogram_add (data->save_metric,
+				    g_get_monotonic_time () - start);
+}
+
+static void
+ephy_bookmarks_save (EphyBookmarks *eb)
+{
+	SaveData *data;
+
+	data = save_data_new (eb);
+	save_data_write (data);
+	save_data_free (data);
+}
+
+static void
+save_bookmarks_thread (GTask *task,
+		       gpointer source_object,
+		       gpointer task_data,
+		       GCancellable *cancellable)
+{
+	save_data_write ((SaveData *) task_data);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void ephy_bookmarks_save_async (EphyBookmarks *eb);
+
+static void
+save_bookmarks_in_thread_cb (GObject *source_object,
+			     GAsyncResult *res,
+			     gpointer user_data)
+{
+	EphyBookmarks *eb = EPHY_BOOKMARKS (source_object);
+	GApplication *application = user_data;
+
+	eb->priv->saving = FALSE;
+
+	/* Changes made while the worker was busy were not part of its
+	 * snapshot; write them out now, as a single save. */
+	if (eb->priv->save_pending)
+	{
+		eb->priv->save_pending = FALSE;
+		ephy_bookmarks_save_async (eb);
+	}
+
+	if (application)
+	{
+		g_application_release (application);
+	}
+}
+
+/* Takes a snapshot of the bookmarks on the main thread and writes it
+ * out from a worker. Only one save runs at a time, any saves requested
+ * meanwhile are coalesced into a single one that starts when it is done.
+ */
+static void
+ephy_bookmarks_save_async (EphyBookmarks *eb)
+{
+	EphyBookmarksPrivate *priv = eb->priv;
+	GApplication *application;
+	GTask *task;
+
+	if (priv->saving)
+	{
+		priv->save_pending = TRUE;
+		return;
+	}
+
+	priv->saving = TRUE;
+
+	/* Keep the application alive until the files are on disk. */
+	application = g_application_get_default ();
+	if (application)
+	{
+		g_application_hold (application);
+	}
+
+	task = g_task_new (eb, NULL, save_bookmarks_in_thread_cb, application);
+	g_task_set_task_data (task, save_data_new (eb), (GDestroyNotify) save_data_free);
+	g_task_run_in_thread (task, save_bookmarks_thread);
+	g_object_unref (task);
 }
 
 static gboolean
 save_bookmarks_delayed (EphyBookmarks *bookmarks)
 {
-	ephy_bookmarks_save (bookmarks);
 	bookmarks->priv->dirty = FALSE;
 	bookmarks->priv->save_timeout_id = 0;
 
+	ephy_bookmarks_save_async (bookmarks);
+
 	return FALSE;
 }
 
@@ -270,14 +377,33 @@ ephy_setup_history_notifiers (EphyBookmarks *eb)
 #endif
 }
 
+static void
+set_bookmark_keywords (EphyNode *bookmark, GString *list)
+{
+	const char *title;
+	char *normalized_keywords, *case_normalized_keywords;
+
+	title = ephy_node_get_property_string
+		(bookmark, EPHY_NODE_BMK_PROP_TITLE);
+	g_string_append (list, " ");
+	g_string_append (list, title);
+
+	normalized_keywords = g_utf8_normalize (list->str, -1, G_NORMALIZE_ALL);
+	case_normalized_keywords = g_utf8_casefold (normalized_keywords, -1);
+
+	ephy_node_set_property_string (bookmark, EPHY_NODE_BMK_PROP_KEYWORDS,
+				       case_normalized_keywords);
+
+	g_free (normalized_keywords);
+	g_free (case_normalized_keywords);
+}
+
 static void
 update_bookmark_keywords (EphyBookmarks *eb, EphyNode *bookmark)
 {
 	GPtrArray *children;
 	int i;
 	GString *list;
-	const char *title;
-	char *normalized_keywords, *case_normalized_keywords;
 
 	list = g_string_new (NULL);
 
@@ -301,20 +427,9 @@ update_bookmark_keywords (EphyBookmarks *eb, EphyNode *bookmark)
 		}
 	}
 
-	title = ephy_node_get_property_string
-		(bookmark, EPHY_NODE_BMK_PROP_TITLE);
-	g_string_append (list, " ");
-	g_string_append (list, title);
-
-	normalized_keywords = g_utf8_normalize (list->str, -1, G_NORMALIZE_ALL);
-	case_normalized_keywords = g_utf8_casefold (normalized_keywords, -1);
-
-	ephy_node_set_property_string (bookmark, EPHY_NODE_BMK_PROP_KEYWORDS,
-				       case_normalized_keywords);
+	set_bookmark_keywords (bookmark, list);
 
 	g_string_free (list, TRUE);
-	g_free (normalized_keywords);
-	g_free (case_normalized_keywords);
 }
 
 static void
@@ -964,6 +1079,9 @@ ephy_bookmarks_init (EphyBookmarks *eb)
 					       EPHY_BOOKMARKS_FILE_RDF,
 					       NULL);
 
+	eb->priv->snapshot_metric = ephy_metrics_histogram_get ("bookmarks.snapshot");
+	eb->priv->save_metric = ephy_metrics_histogram_get ("bookmarks.save");
+
 	/* Bookmarks */
 	eb->priv->bookmarks = ephy_node_new_with_id (db, BOOKMARKS_NODE_ID);
 	
@@ -1147,10 +1265,10 @@ update_has_smart_address (EphyBookmarks *bookmarks, EphyNode *bmk, const char *a
 	}
 }
 
-EphyNode *
-ephy_bookmarks_add (EphyBookmarks *eb,
-		    const char *title,
-		    const char *url)
+static EphyNode *
+new_bookmark_node (EphyBookmarks *eb,
+		   const char *title,
+		   const char *url)
 {
 	EphyNode *bm;
 	WebKitFaviconDatabase *favicon_database;
@@ -1184,6 +1302,20 @@ ephy_bookmarks_add (EphyBookmarks *eb,
 		}
 	}
 
+	return bm;
+}
+
+EphyNode *
+ephy_bookmarks_add (EphyBookmarks *eb,
+		    const char *title,
+		    const char *url)
+{
+	EphyNode *bm;
+
+	bm = new_bookmark_node (eb, title, url);
+
+	if (bm == NULL) return NULL;
+
 	update_has_smart_address (eb, bm, url);
 	update_bookmark_keywords (eb, bm);
 
@@ -1195,6 +1327,234 @@ ephy_bookmarks_add (EphyBookmarks *eb,
 	return bm;
 }
 
+static gboolean
+ptr_array_contains (GPtrArray *array, gpointer data)
+{
+	guint i;
+
+	for (i = 0; i < array->len; i++)
+	{
+		if (g_ptr_array_index (array, i) == data) return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+ * ephy_bookmarks_add_batch:
+ * @eb: an #EphyBookmarks
+ * @items: a #GPtrArray of #EphyBookmarksBatchItem
+ *
+ * Adds many bookmarks at once, as the importers do. An address that is
+ * already bookmarked, or that appears more than once in @items, is only
+ * added once, but still gets the topics of every item naming it.
+ *
+ * Calling ephy_bookmarks_add() and ephy_bookmarks_set_keyword() for each
+ * entry costs a scan of all bookmarks and all topics per call. Here the
+ * lookups go through hash tables, each new bookmark gets its search
+ * keywords computed once before it is attached to the tree, and
+ * #EphyBookmarks::tree-changed and the save are only triggered once.
+ *
+ * Return value: the number of bookmarks that were added
+ **/
+guint
+ephy_bookmarks_add_batch (EphyBookmarks *eb,
+			  GPtrArray *items)
+{
+	EphyBookmarksPrivate *priv;
+	GHashTable *bookmarks, *keywords, *new_topics, *touched;
+	GPtrArray *children, *added;
+	GHashTableIter iter;
+	gpointer key;
+	guint i, j;
+
+	g_return_val_if_fail (EPHY_IS_BOOKMARKS (eb), 0);
+	g_return_val_if_fail (items != NULL, 0);
+
+	priv = eb->priv;
+
+	START_PROFILER ("Adding bookmarks batch")
+
+	/* address -> bookmark, first match wins like in find_bookmark */
+	bookmarks = g_hash_table_new (g_str_hash, g_str_equal);
+	children = ephy_node_get_children (priv->bookmarks);
+	for (i = 0; i < children->len; i++)
+	{
+		EphyNode *kid;
+		const char *location;
+
+		kid = g_ptr_array_index (children, i);
+		location = ephy_node_get_property_string
+			(kid, EPHY_NODE_BMK_PROP_LOCATION);
+
+		if (location != NULL && !g_hash_table_contains (bookmarks, location))
+		{
+			g_hash_table_insert (bookmarks, (gpointer) location, kid);
+		}
+	}
+
+	/* name -> user topic, last match wins like in find_keyword */
+	keywords = g_hash_table_new (g_str_hash, g_str_equal);
+	children = ephy_node_get_children (priv->keywords);
+	for (i = 0; i < children->len; i++)
+	{
+		EphyNode *kid;
+		const char *name;
+		int priority;
+
+		kid = g_ptr_array_index (children, i);
+		name = ephy_node_get_property_string
+			(kid, EPHY_NODE_KEYWORD_PROP_NAME);
+
+		priority = ephy_node_get_property_int
+			(kid, EPHY_NODE_KEYWORD_PROP_PRIORITY);
+
+		if (name != NULL &&
+		    (priority == EPHY_NODE_NORMAL_PRIORITY || priority == -1))
+		{
+			g_hash_table_insert (keywords, (gpointer) name, kid);
+		}
+	}
+
+	/* new bookmark -> GPtrArray of its topics, not attached yet */
+	new_topics = g_hash_table_new_full (NULL, NULL, NULL,
+					    (GDestroyNotify) g_ptr_array_unref);
+	added = g_ptr_array_new ();
+	/* bookmarks that existed before and got new topics */
+	touched = g_hash_table_new (NULL, NULL);
+
+	for (i = 0; i < items->len; i++)
+	{
+		EphyBookmarksBatchItem *item;
+		EphyNode *bmk;
+		GPtrArray *topics;
+
+		item = g_ptr_array_index (items, i);
+		if (item->address == NULL) continue;
+
+		bmk = g_hash_table_lookup (bookmarks, item->address);
+		if (bmk == NULL)
+		{
+			bmk = new_bookmark_node (eb, item->title, item->address);
+			if (bmk == NULL) continue;
+
+			g_hash_table_insert (bookmarks,
+					     (gpointer) ephy_node_get_property_string
+						(bmk, EPHY_NODE_BMK_PROP_LOCATION),
+					     bmk);
+			g_hash_table_insert (new_topics, bmk, g_ptr_array_new ());
+			g_ptr_array_add (added, bmk);
+		}
+
+		topics = g_hash_table_lookup (new_topics, bmk);
+
+		for (j = 0; item->topics != NULL && item->topics[j] != NULL; j++)
+		{
+			EphyNode *keyword;
+			const char *name = item->topics[j];
+
+			if (name[0] == '\0') continue;
+
+			keyword = g_hash_table_lookup (keywords, name);
+			if (keyword == NULL)
+			{
+				keyword = ephy_bookmarks_add_keyword (eb, name);
+				if (keyword == NULL) continue;
+
+				g_hash_table_insert (keywords,
+						     (gpointer) ephy_node_get_property_string
+							(keyword, EPHY_NODE_KEYWORD_PROP_NAME),
+						     keyword);
+			}
+
+			if (topics != NULL)
+			{
+				if (!ptr_array_contains (topics, keyword))
+				{
+					g_ptr_array_add (topics, keyword);
+				}
+			}
+			else if (!ephy_node_has_child (keyword, bmk))
+			{
+				ephy_node_add_child (keyword, bmk);
+				g_hash_table_add (touched, bmk);
+			}
+		}
+	}
+
+	/* Index and attach the new bookmarks in one go, so that every
+	 * node only emits CHILD_ADDED for its final set of parents. */
+	for (i = 0; i < added->len; i++)
+	{
+		EphyNode *bmk;
+		GPtrArray *topics;
+		GString *list;
+
+		bmk = g_ptr_array_index (added, i);
+		topics = g_hash_table_lookup (new_topics, bmk);
+
+		list = g_string_new (NULL);
+		for (j = 0; j < topics->len; j++)
+		{
+			g_string_append (list, ephy_node_get_property_string
+					 (g_ptr_array_index (topics, j),
+					  EPHY_NODE_KEYWORD_PROP_NAME));
+			g_string_append (list, " ");
+		}
+		set_bookmark_keywords (bmk, list);
+		g_string_free (list, TRUE);
+
+		update_has_smart_address (eb, bmk,
+					  ephy_node_get_property_string
+					  (bmk, EPHY_NODE_BMK_PROP_LOCATION));
+
+		ephy_node_add_child (priv->bookmarks, bmk);
+
+		if (topics->len == 0)
+		{
+			ephy_node_add_child (priv->notcategorized, bmk);
+		}
+
+		for (j = 0; j < topics->len; j++)
+		{
+			ephy_node_add_child (g_ptr_array_index (topics, j), bmk);
+		}
+	}
+
+	g_hash_table_iter_init (&iter, touched);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+	{
+		EphyNode *bmk = key;
+
+		if (ephy_node_has_child (priv->notcategorized, bmk))
+		{
+			ephy_node_remove_child (priv->notcategorized, bmk);
+		}
+
+		update_bookmark_keywords (eb, bmk);
+	}
+
+	if (added->len > 0 || g_hash_table_size (touched) > 0)
+	{
+		g_signal_emit (G_OBJECT (eb), ephy_bookmarks_signals[TREE_CHANGED], 0);
+		ephy_bookmarks_save_delayed (eb, 0);
+	}
+
+	i = added->len;
+
+	g_hash_table_destroy (bookmarks);
+	g_hash_table_destroy (keywords);
+	g_hash_table_destroy (new_topics);
+	g_hash_table_destroy (touched);
+	g_ptr_array_free (added, TRUE);
+
+	STOP_PROFILER ("Adding bookmarks batch")
+
+	LOG ("Added %u of %u bookmarks", i, items->len);
+
+	return i;
+}
+
 void
 ephy_bookmarks_set_address (EphyBookmarks *eb,
 			    EphyNode *bookmark,
@@ -55,6 +55,21 @@ typedef enum
 	EPHY_NODE_BMK_PROP_IMMUTABLE	= 15
 } EphyBookmarkProperty;
 
+/**
+ * EphyBookmarksBatchItem:
+ * @title: the bookmark title, or %NULL
+ * @address: the bookmark address
+ * @topics: %NULL-terminated array of topic names, or %NULL
+ *
+ * One entry for ephy_bookmarks_add_batch().
+ */
+typedef struct
+{
+	char *title;
+	char *address;
+	char **topics;
+} EphyBookmarksBatchItem;
+
 struct _EphyBookmarks
 {
 	GObject parent;
@@ -86,6 +101,9 @@ EphyNode	 *ephy_bookmarks_add			(EphyBookmarks *eb,
 							 const char *title,
 							 const char *url);
 
+guint		  ephy_bookmarks_add_batch		(EphyBookmarks *eb,
+							 GPtrArray *items);
+
 EphyNode*	  ephy_bookmarks_find_bookmark		(EphyBookmarks *eb,
 							 const char *url);
 
@@ -97,14 +97,10 @@ static void
 ephy_completion_model_init (EphyCompletionModel *model)
 {
   EphyCompletionModelPrivate *priv;
-  EphyBookmarks *bookmarks_service;
 
   model->priv = priv = EPHY_COMPLETION_MODEL_GET_PRIVATE (model);
 
   priv->history_service = EPHY_HISTORY_SERVICE (ephy_embed_shell_get_global_history_service (ephy_embed_shell_get_default ()));
-
-  bookmarks_service = ephy_shell_get_bookmarks (ephy_shell_get_default ());
-  priv->bookmarks = ephy_bookmarks_get_bookmarks (bookmarks_service);
 }
 
 static gboolean
@@ -404,7 +400,11 @@ query_completed_cb (EphyHistoryService *service,
   GSList *list = NULL;
   int i;
 
-  /* Bookmarks */
+  /* Bookmarks. Loaded on the first query at the latest, the model is
+   * created with the first window. */
+  if (priv->bookmarks == NULL)
+    priv->bookmarks = ephy_bookmarks_get_bookmarks (ephy_shell_get_bookmarks (ephy_shell_get_default ()));
+
   children = ephy_node_get_children (priv->bookmarks);
 
   /* FIXME: perhaps this could be done in a service thread? There
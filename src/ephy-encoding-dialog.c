@@ -368,7 +368,6 @@ ephy_encoding_dialog_init (EphyEncodingDialog *dialog)
 	GtkTreeSelection *selection;
 	GList *encodings, *p;
 	GtkListStore *store;
-	GtkTreeIter iter;
 	GtkCellRenderer *renderer;
 
 	dialog->priv = EPHY_ENCODING_DIALOG_GET_PRIVATE (dialog);
@@ -389,25 +388,21 @@ ephy_encoding_dialog_init (EphyEncodingDialog *dialog)
 
 	encodings = ephy_encodings_get_all (dialog->priv->encodings);
 	store = gtk_list_store_new (NUM_COLS, G_TYPE_STRING, G_TYPE_STRING);
-	for (p = encodings; p; p = p->next) 
+	/* ephy_encodings_get_all() returns the encodings sorted by title
+	 * already, so the store does not need to sort them again. */
+	for (p = encodings; p; p = p->next)
 	{
 		EphyEncoding *encoding = EPHY_ENCODING (p->data);
 
-		gtk_list_store_append (store, &iter);
-		gtk_list_store_set (store, &iter,
-				    COL_TITLE_ELIDED, 
-				    ephy_encoding_get_title_elided (encoding),
-				    -1);
-		gtk_list_store_set (store, &iter,
-				    COL_ENCODING, 
-				    ephy_encoding_get_encoding (encoding),
-				    -1);
+		gtk_list_store_insert_with_values (store, NULL, -1,
+						   COL_TITLE_ELIDED,
+						   ephy_encoding_get_title_elided (encoding),
+						   COL_ENCODING,
+						   ephy_encoding_get_encoding (encoding),
+						   -1);
 	}
 	g_list_free (encodings);
 
-	gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (store), COL_TITLE_ELIDED,
-					      GTK_SORT_ASCENDING);
-
 	treeview = gtk_tree_view_new ();
 	renderer = gtk_cell_renderer_text_new ();
 
@@ -59,6 +59,7 @@ struct _EphyEncodingMenuPrivate
 
 static void	ephy_encoding_menu_class_init	  (EphyEncodingMenuClass *klass);
 static void	ephy_encoding_menu_init		  (EphyEncodingMenu *menu);
+static void	ensure_encodings		  (EphyEncodingMenu *menu);
 
 enum
 {
@@ -72,10 +73,6 @@ static void
 ephy_encoding_menu_init (EphyEncodingMenu *menu)
 {
 	menu->priv = EPHY_ENCODING_MENU_GET_PRIVATE (menu);
-
-	menu->priv->encodings =
-		EPHY_ENCODINGS (ephy_embed_shell_get_encodings
-				(EPHY_EMBED_SHELL (ephy_shell_get_default ())));
 }
 
 static int
@@ -124,6 +121,8 @@ update_encoding_menu_cb (GtkAction *dummy, EphyEncodingMenu *menu)
 
 	START_PROFILER ("Rebuilding encoding menu")
 
+	ensure_encodings (menu);
+
 	/* FIXME: block the "activate" signal on the actions instead; needs to 
 	 * wait until g_signal_handlers_block_matched supports blocking
 	 * by signal id alone.
@@ -164,8 +163,8 @@ update_encoding_menu_cb (GtkAction *dummy, EphyEncodingMenu *menu)
 	/* get encodings related to the current encoding */
 	groups = ephy_encoding_get_language_groups (enc_node);
 
+	/* already sorted by title */
 	related = ephy_encodings_get_encodings (p->encodings, groups);
-	related = g_list_sort (related, (GCompareFunc)sort_encodings);
 
 	/* add the current encoding to the list of
 	 * things to display, making sure we don't add it more than once
@@ -296,6 +295,38 @@ add_action (EphyEncodings *encodings, EphyEncoding *encoding, EphyEncodingMenu *
 	g_object_unref (action);
 }
 
+/* The encodings are only needed once the menu is opened, so they are
+ * not loaded while the window is being built. */
+static void
+ensure_encodings (EphyEncodingMenu *menu)
+{
+	GList *encodings, *p;
+
+	if (menu->priv->encodings != NULL) return;
+
+	menu->priv->encodings =
+		EPHY_ENCODINGS (ephy_embed_shell_get_encodings
+				(EPHY_EMBED_SHELL (ephy_shell_get_default ())));
+
+	/* add actions for the existing encodings */
+	encodings = ephy_encodings_get_all (menu->priv->encodings);
+	for (p = encodings; p; p = p->next)
+	{
+		EphyEncoding *encoding;
+
+		encoding = (EphyEncoding *)p->data;
+		add_action (menu->priv->encodings, encoding, menu);
+	}
+	g_list_free (encodings);
+
+	/* When we encounter an unknown encoding, it is added to the
+	 * database, so we need to listen to child_added on the
+	 * encodings node to add an action for it.
+	 */
+	g_signal_connect_object (menu->priv->encodings, "encoding-added",
+				 G_CALLBACK (add_action), menu, 0);
+}
+
 static void
 ephy_encoding_menu_view_dialog_cb (GtkAction *action, EphyEncodingMenu *menu)
 {
@@ -355,7 +386,6 @@ ephy_encoding_menu_set_window (EphyEncodingMenu *menu, EphyWindow *window)
 {
 	GtkActionGroup *action_group;
 	GtkAction *action;
-	GList *encodings, *p;
 
 	g_return_if_fail (EPHY_IS_WINDOW (window));
 
@@ -371,24 +401,6 @@ ephy_encoding_menu_set_window (EphyEncodingMenu *menu, EphyWindow *window)
 	gtk_action_group_add_toggle_actions (action_group, toggle_menu_entries,
                                     	     G_N_ELEMENTS (toggle_menu_entries), menu);
 
-	/* add actions for the existing encodings */
-	encodings = ephy_encodings_get_all (menu->priv->encodings);
-	for (p = encodings; p; p = p->next)
-	{
-		EphyEncoding *encoding;
-
-		encoding = (EphyEncoding *)p->data;
-		add_action (menu->priv->encodings, encoding, menu);
-	}
-	g_list_free (encodings);
-
-	/* When we encounter an unknown encoding, it is added to the
-	 * database, so we need to listen to child_added on the
-	 * encodings node to add an action for it.
-	 */
-	g_signal_connect (menu->priv->encodings, "encoding-added",
-			  G_CALLBACK (add_action), menu);
-
 	gtk_ui_manager_insert_action_group (menu->priv->manager,
 					    action_group, 0);
 	g_object_unref (action_group);
@@ -0,0 +1,311 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+#include "ephy-load-scheduler.h"
+
+#include "ephy-debug.h"
+#include "ephy-prefs.h"
+#include "ephy-settings.h"
+#include "ephy-web-view.h"
+
+/**
+ * SECTION:ephy-load-scheduler
+ * @short_description: Throttles the loads of tabs opened in bulk
+ *
+ * Opening many pages at once (several URIs on the command line, or
+ * "Open in New Tabs" on a set of bookmarks) creates all the tabs right
+ * away, each with a delayed load request, and hands them to the
+ * #EphyLoadScheduler. The scheduler starts at most
+ * #EPHY_PREFS_MAX_CONCURRENT_TAB_LOADS of those loads at a time and
+ * starts the next queued one whenever a load finishes. A tab that is
+ * switched to loads immediately, regardless of the limit, because
+ * #EphyEmbed loads its delayed request as soon as it is mapped.
+ */
+
+#define EPHY_LOAD_SCHEDULER_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), EPHY_TYPE_LOAD_SCHEDULER, EphyLoadSchedulerPrivate))
+
+struct _EphyLoadSchedulerPrivate {
+  GQueue *pending;
+  GList *active;
+};
+
+G_DEFINE_TYPE (EphyLoadScheduler, ephy_load_scheduler, G_TYPE_OBJECT)
+
+static void schedule_loads (EphyLoadScheduler *scheduler);
+
+static void
+embed_destroy_cb (EphyEmbed *embed,
+                  EphyLoadScheduler *scheduler);
+
+#ifdef HAVE_WEBKIT2
+static void
+load_changed_cb (EphyWebView *view,
+                 WebKitLoadEvent load_event,
+                 EphyLoadScheduler *scheduler);
+#else
+static void
+load_status_cb (EphyWebView *view,
+                GParamSpec *pspec,
+                EphyLoadScheduler *scheduler);
+#endif
+
+static void
+untrack_embed (EphyLoadScheduler *scheduler,
+               EphyEmbed *embed)
+{
+  EphyWebView *view = ephy_embed_get_web_view (embed);
+
+  g_signal_handlers_disconnect_by_func (embed, embed_destroy_cb, scheduler);
+#ifdef HAVE_WEBKIT2
+  g_signal_handlers_disconnect_by_func (view, load_changed_cb, scheduler);
+#else
+  g_signal_handlers_disconnect_by_func (view, load_status_cb, scheduler);
+#endif
+}
+
+static void
+load_finished (EphyLoadScheduler *scheduler,
+               EphyWebView *view)
+{
+  EphyLoadSchedulerPrivate *priv = scheduler->priv;
+  GList *l;
+
+  /* The load that was started may have replaced the placeholder
+   * load, so only consider the tab done once nothing is loading. */
+  if (ephy_web_view_is_loading (view))
+    return;
+
+  for (l = priv->active; l; l = l->next) {
+    EphyEmbed *embed = l->data;
+
+    if (ephy_embed_get_web_view (embed) == view) {
+      LOG ("Scheduled load finished for embed %p", embed);
+      untrack_embed (scheduler, embed);
+      priv->active = g_list_delete_link (priv->active, l);
+      break;
+    }
+  }
+
+  schedule_loads (scheduler);
+}
+
+#ifdef HAVE_WEBKIT2
+static void
+load_changed_cb (EphyWebView *view,
+                 WebKitLoadEvent load_event,
+                 EphyLoadScheduler *scheduler)
+{
+  if (load_event == WEBKIT_LOAD_FINISHED)
+    load_finished (scheduler, view);
+}
+#else
+static void
+load_status_cb (EphyWebView *view,
+                GParamSpec *pspec,
+                EphyLoadScheduler *scheduler)
+{
+  WebKitLoadStatus status;
+
+  status = webkit_web_view_get_load_status (WEBKIT_WEB_VIEW (view));
+  if (status == WEBKIT_LOAD_FINISHED || status == WEBKIT_LOAD_FAILED)
+    load_finished (scheduler, view);
+}
+#endif
+
+static void
+embed_destroy_cb (EphyEmbed *embed,
+                  EphyLoadScheduler *scheduler)
+{
+  EphyLoadSchedulerPrivate *priv = scheduler->priv;
+  GList *l;
+
+  untrack_embed (scheduler, embed);
+  g_queue_remove (priv->pending, embed);
+
+  l = g_list_find (priv->active, embed);
+  if (l) {
+    priv->active = g_list_delete_link (priv->active, l);
+    schedule_loads (scheduler);
+  }
+}
+
+static guint
+get_max_loads (void)
+{
+  int max_loads;
+
+  max_loads = g_settings_get_int (EPHY_SETTINGS_MAIN,
+                                  EPHY_PREFS_MAX_CONCURRENT_TAB_LOADS);
+
+  return max_loads > 0 ? (guint)max_loads : G_MAXUINT;
+}
+
+static void
+schedule_loads (EphyLoadScheduler *scheduler)
+{
+  EphyLoadSchedulerPrivate *priv = scheduler->priv;
+  guint max_loads = get_max_loads ();
+  guint n_active = g_list_length (priv->active);
+
+  while (n_active < max_loads && !g_queue_is_empty (priv->pending)) {
+    EphyEmbed *embed = g_queue_pop_head (priv->pending);
+    EphyWebView *view = ephy_embed_get_web_view (embed);
+
+    /* The tab was switched to and started loading on its own. */
+    if (!ephy_embed_has_load_pending (embed)) {
+      untrack_embed (scheduler, embed);
+      continue;
+    }
+
+    LOG ("Starting scheduled load for embed %p (%u active, %u queued)",
+         embed, n_active + 1, g_queue_get_length (priv->pending));
+
+    ephy_embed_load_delayed_request (embed);
+
+#ifdef HAVE_WEBKIT2
+    g_signal_connect (view, "load-changed",
+                      G_CALLBACK (load_changed_cb), scheduler);
+#else
+    g_signal_connect (view, "notify::load-status",
+                      G_CALLBACK (load_status_cb), scheduler);
+#endif
+    priv->active = g_list_prepend (priv->active, embed);
+    n_active++;
+  }
+}
+
+static void
+max_loads_changed_cb (GSettings *settings,
+                      const char *key,
+                      EphyLoadScheduler *scheduler)
+{
+  schedule_loads (scheduler);
+}
+
+static void
+ephy_load_scheduler_init (EphyLoadScheduler *scheduler)
+{
+  scheduler->priv = EPHY_LOAD_SCHEDULER_GET_PRIVATE (scheduler);
+  scheduler->priv->pending = g_queue_new ();
+
+  g_signal_connect (EPHY_SETTINGS_MAIN,
+                    "changed::" EPHY_PREFS_MAX_CONCURRENT_TAB_LOADS,
+                    G_CALLBACK (max_loads_changed_cb), scheduler);
+}
+
+static void
+ephy_load_scheduler_dispose (GObject *object)
+{
+  EphyLoadScheduler *scheduler = EPHY_LOAD_SCHEDULER (object);
+  EphyLoadSchedulerPrivate *priv = scheduler->priv;
+  GList *l;
+
+  g_signal_handlers_disconnect_by_func (EPHY_SETTINGS_MAIN,
+                                        max_loads_changed_cb, scheduler);
+
+  if (priv->pending) {
+    for (l = priv->pending->head; l; l = l->next)
+      untrack_embed (scheduler, l->data);
+    g_queue_free (priv->pending);
+    priv->pending = NULL;
+  }
+
+  for (l = priv->active; l; l = l->next)
+    untrack_embed (scheduler, l->data);
+  g_list_free (priv->active);
+  priv->active = NULL;
+
+  G_OBJECT_CLASS (ephy_load_scheduler_parent_class)->dispose (object);
+}
+
+static void
+ephy_load_scheduler_class_init (EphyLoadSchedulerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = ephy_load_scheduler_dispose;
+
+  g_type_class_add_private (object_class, sizeof (EphyLoadSchedulerPrivate));
+}
+
+EphyLoadScheduler *
+ephy_load_scheduler_new (void)
+{
+  return g_object_new (EPHY_TYPE_LOAD_SCHEDULER, NULL);
+}
+
+/**
+ * ephy_load_scheduler_add:
+ * @scheduler: an #EphyLoadScheduler
+ * @embed: an #EphyEmbed with a delayed load request
+ *
+ * Queues the delayed load of @embed. It starts as soon as fewer than
+ * #EPHY_PREFS_MAX_CONCURRENT_TAB_LOADS scheduled loads are running, or
+ * earlier if the tab is switched to.
+ **/
+void
+ephy_load_scheduler_add (EphyLoadScheduler *scheduler,
+                         EphyEmbed *embed)
+{
+  g_return_if_fail (EPHY_IS_LOAD_SCHEDULER (scheduler));
+  g_return_if_fail (EPHY_IS_EMBED (embed));
+
+  if (!ephy_embed_has_load_pending (embed))
+    return;
+
+  if (g_queue_find (scheduler->priv->pending, embed) ||
+      g_list_find (scheduler->priv->active, embed))
+    return;
+
+  g_signal_connect (embed, "destroy",
+                    G_CALLBACK (embed_destroy_cb), scheduler);
+  g_queue_push_tail (scheduler->priv->pending, embed);
+
+  schedule_loads (scheduler);
+}
+
+/**
+ * ephy_load_scheduler_get_n_pending:
+ * @scheduler: an #EphyLoadScheduler
+ *
+ * Returns: the number of tabs waiting for a free load slot
+ **/
+guint
+ephy_load_scheduler_get_n_pending (EphyLoadScheduler *scheduler)
+{
+  g_return_val_if_fail (EPHY_IS_LOAD_SCHEDULER (scheduler), 0);
+
+  return g_queue_get_length (scheduler->priv->pending);
+}
+
+/**
+ * ephy_load_scheduler_get_n_active:
+ * @scheduler: an #EphyLoadScheduler
+ *
+ * Returns: the number of loads started by @scheduler that are still running
+ **/
+guint
+ephy_load_scheduler_get_n_active (EphyLoadScheduler *scheduler)
+{
+  g_return_val_if_fail (EPHY_IS_LOAD_SCHEDULER (scheduler), 0);
+
+  return g_list_length (scheduler->priv->active);
+}
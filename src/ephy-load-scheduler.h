@@ -0,0 +1,71 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2013 Igalia S.L.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#if !defined (__EPHY_EPIPHANY_H_INSIDE__) && !defined (EPIPHANY_COMPILATION)
+#error "Only <epiphany/epiphany.h> can be included directly."
+#endif
+
+#ifndef EPHY_LOAD_SCHEDULER_H
+#define EPHY_LOAD_SCHEDULER_H
+
+#include "ephy-embed.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define EPHY_TYPE_LOAD_SCHEDULER          (ephy_load_scheduler_get_type ())
+#define EPHY_LOAD_SCHEDULER(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), EPHY_TYPE_LOAD_SCHEDULER, EphyLoadScheduler))
+#define EPHY_LOAD_SCHEDULER_CLASS(k)      (G_TYPE_CHECK_CLASS_CAST((k), EPHY_TYPE_LOAD_SCHEDULER, EphyLoadSchedulerClass))
+#define EPHY_IS_LOAD_SCHEDULER(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), EPHY_TYPE_LOAD_SCHEDULER))
+#define EPHY_IS_LOAD_SCHEDULER_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), EPHY_TYPE_LOAD_SCHEDULER))
+#define EPHY_LOAD_SCHEDULER_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), EPHY_TYPE_LOAD_SCHEDULER, EphyLoadSchedulerClass))
+
+typedef struct _EphyLoadSchedulerClass   EphyLoadSchedulerClass;
+typedef struct _EphyLoadScheduler        EphyLoadScheduler;
+typedef struct _EphyLoadSchedulerPrivate EphyLoadSchedulerPrivate;
+
+struct _EphyLoadSchedulerClass
+{
+  GObjectClass parent_class;
+};
+
+struct _EphyLoadScheduler
+{
+  GObject parent_instance;
+
+  /*< private >*/
+  EphyLoadSchedulerPrivate *priv;
+};
+
+GType              ephy_load_scheduler_get_type        (void);
+
+EphyLoadScheduler *ephy_load_scheduler_new             (void);
+
+void               ephy_load_scheduler_add             (EphyLoadScheduler *scheduler,
+                                                        EphyEmbed         *embed);
+
+guint              ephy_load_scheduler_get_n_pending   (EphyLoadScheduler *scheduler);
+
+guint              ephy_load_scheduler_get_n_active    (EphyLoadScheduler *scheduler);
+
+G_END_DECLS
+
+#endif
@@ -749,21 +749,24 @@ actions_child_changed_cb (EphyNode *node,
 }
 
 static void
-ephy_location_controller_init (EphyLocationController *controller)
+bookmarks_loaded_cb (EphyShell *shell,
+		     EphyLocationController *controller)
 {
-	EphyLocationControllerPrivate *priv;
-
-	priv = controller->priv = EPHY_LOCATION_CONTROLLER_GET_PRIVATE (controller);
+	EphyLocationControllerPrivate *priv = controller->priv;
 
-	priv->address = g_strdup ("");
-	priv->editable = TRUE;
-	priv->bookmarks = ephy_shell_get_bookmarks (ephy_shell_get_default ());
+	priv->bookmarks = ephy_shell_get_bookmarks (shell);
 	priv->smart_bmks = ephy_bookmarks_get_smart_bookmarks
 		(controller->priv->bookmarks);
-	priv->sync_address_is_blocked = FALSE;
 
-	init_actions_list (controller);
-	
+	if (priv->location_entry != NULL)
+	{
+		update_actions_list (controller);
+	}
+	else
+	{
+		init_actions_list (controller);
+	}
+
 	ephy_node_signal_connect_object (priv->smart_bmks,
 					 EPHY_NODE_CHILD_ADDED,
 					 (EphyNodeCallback)actions_child_added_cb,
@@ -778,6 +781,33 @@ ephy_location_controller_init (EphyLocationController *controller)
 					 G_OBJECT (controller));
 }
 
+static void
+ephy_location_controller_init (EphyLocationController *controller)
+{
+	EphyLocationControllerPrivate *priv;
+	EphyShell *shell;
+
+	priv = controller->priv = EPHY_LOCATION_CONTROLLER_GET_PRIVATE (controller);
+
+	priv->address = g_strdup ("");
+	priv->editable = TRUE;
+	priv->sync_address_is_blocked = FALSE;
+
+	/* The smart bookmarks only matter once the user starts typing, don't
+	 * load the bookmarks for them on the way to the first window. */
+	shell = ephy_shell_get_default ();
+	if (ephy_shell_peek_bookmarks (shell) != NULL)
+	{
+		bookmarks_loaded_cb (shell, controller);
+	}
+	else
+	{
+		g_signal_connect_object (shell, "bookmarks-loaded",
+					 G_CALLBACK (bookmarks_loaded_cb),
+					 controller, 0);
+	}
+}
+
 static void
 ephy_location_controller_finalize (GObject *object)
 {
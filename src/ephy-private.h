@@ -28,6 +28,7 @@
 #include "ephy-embed.h"
 #include "ephy-embed-event.h"
 #include "ephy-embed-private.h"
+#include "ephy-load-scheduler.h"
 #include "ephy-location-controller.h"
 #include "ephy-session.h"
 #include "ephy-shell.h"
@@ -63,6 +64,8 @@ EphyShellStartupContext *ephy_shell_startup_context_new       (EphyStartupFlags
 
 void                     _ephy_shell_create_instance          (EphyEmbedShellMode        mode);
 
+EphyLoadScheduler       *ephy_shell_get_load_scheduler        (EphyShell                *shell);
+
 /* EphySession */
 
 void                     ephy_session_clear                   (EphySession *session);
@@ -30,6 +30,7 @@
 #include "ephy-embed.h"
 #include "ephy-file-helpers.h"
 #include "ephy-gui.h"
+#include "ephy-metrics.h"
 #include "ephy-notebook.h"
 #include "ephy-prefs.h"
 #include "ephy-private.h"
@@ -851,6 +852,9 @@ save_session_sync (GTask *task,
 	xmlTextWriterPtr writer;
 	GList *w;
 	int ret = -1;
+	gint64 start;
+
+	start = g_get_monotonic_time ();
 
 	buffer = xmlBufferCreate ();
 	writer = xmlNewTextWriterMemory (buffer, 0);
@@ -909,6 +913,9 @@ out:
 
 	g_task_return_boolean (task, TRUE);
 
+	ephy_metrics_histogram_add (ephy_metrics_histogram_get ("session.save"),
+				    g_get_monotonic_time () - start);
+
 	STOP_PROFILER ("Saving session")
 }
 
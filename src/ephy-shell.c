@@ -28,6 +28,7 @@
 #endif
 #include "ephy-bookmarks-editor.h"
 #include "ephy-bookmarks-import.h"
+#include "ephy-bookmarks-ui.h"
 #include "ephy-debug.h"
 #include "ephy-embed-container.h"
 #include "ephy-embed-prefs.h"
@@ -37,7 +38,9 @@
 #include "ephy-gui.h"
 #include "ephy-history-window.h"
 #include "ephy-home-action.h"
+#include "ephy-load-scheduler.h"
 #include "ephy-lockdown.h"
+#include "ephy-metrics.h"
 #include "ephy-prefs.h"
 #include "ephy-private.h"
 #include "ephy-session.h"
@@ -58,6 +61,7 @@ struct _EphyShellPrivate {
   EphySession *session;
   GList *windows;
   GObject *lockdown;
+  EphyLoadScheduler *load_scheduler;
   EphyBookmarks *bookmarks;
   GNetworkMonitor *network_monitor;
   GtkWidget *bme;
@@ -67,8 +71,19 @@ struct _EphyShellPrivate {
   GList *del_on_exit;
   EphyShellStartupContext *startup_context;
   guint open_uris_idle_id;
+  gint64 time_to_first_window;
+  guint deferred_init_id;
+  guint deferred_stage;
 };
 
+enum {
+  BOOKMARKS_LOADED,
+
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
 EphyShell *ephy_shell = NULL;
 
 static void ephy_shell_class_init (EphyShellClass *klass);
@@ -243,6 +258,113 @@ ephy_shell_setup_environment (EphyShell *shell)
 }
 #endif
 
+static void
+load_bookmarks_stage (EphyShell *shell)
+{
+  ephy_shell_get_bookmarks (shell);
+}
+
+static void
+load_encodings_stage (EphyShell *shell)
+{
+  ephy_embed_shell_get_encodings (EPHY_EMBED_SHELL (shell));
+}
+
+#ifndef HAVE_WEBKIT2
+static void
+load_adblock_stage (EphyShell *shell)
+{
+  /* Tests must not depend on the filters of the user. */
+  if (ephy_embed_shell_get_mode (EPHY_EMBED_SHELL (shell)) == EPHY_EMBED_SHELL_MODE_TEST)
+    return;
+
+  ephy_embed_shell_get_adblock_manager (EPHY_EMBED_SHELL (shell));
+}
+#endif
+
+/* Services nothing needs to draw the first window. They are created
+ * one per idle iteration once it is on screen, or earlier if someone
+ * asks for them. */
+static const struct {
+  const char *name;
+  void (* load) (EphyShell *shell);
+} deferred_stages[] = {
+  { "bookmarks", load_bookmarks_stage },
+  { "encodings", load_encodings_stage },
+#ifndef HAVE_WEBKIT2
+  { "adblock", load_adblock_stage },
+#endif
+};
+
+static gboolean
+run_deferred_stage (EphyShell *shell)
+{
+  EphyShellPrivate *priv = shell->priv;
+  const char *name;
+
+  name = deferred_stages[priv->deferred_stage].name;
+
+  START_TRACE (name)
+  deferred_stages[priv->deferred_stage].load (shell);
+  STOP_TRACE (name)
+
+  if (++priv->deferred_stage < G_N_ELEMENTS (deferred_stages))
+    return TRUE;
+
+  priv->deferred_init_id = 0;
+
+  ephy_trace_write ();
+
+  return FALSE;
+}
+
+static gboolean
+first_window_draw_cb (GtkWidget *window,
+                      cairo_t *cr,
+                      EphyShell *shell)
+{
+  EphyShellPrivate *priv = shell->priv;
+
+  g_signal_handlers_disconnect_by_func (window, first_window_draw_cb, shell);
+
+  /* Another window got here first. */
+  if (priv->time_to_first_window != -1)
+    return FALSE;
+
+  priv->time_to_first_window = ephy_trace_get_elapsed ();
+  ephy_trace_mark ("first-window", __FILE__);
+
+  ephy_metrics_histogram_add (ephy_metrics_histogram_get ("startup.first_window"),
+                              priv->time_to_first_window);
+  if (priv->time_to_first_window > EPHY_SHELL_FIRST_WINDOW_BUDGET_MS * 1000) {
+    LOG ("First window took %" G_GINT64_FORMAT " ms, budget is %d ms",
+         priv->time_to_first_window / 1000, EPHY_SHELL_FIRST_WINDOW_BUDGET_MS);
+    ephy_metrics_counter_add (ephy_metrics_counter_get ("startup.first_window_over_budget"), 1);
+  }
+
+  priv->deferred_init_id = g_idle_add_full (G_PRIORITY_LOW,
+                                            (GSourceFunc) run_deferred_stage,
+                                            shell, NULL);
+
+  return FALSE;
+}
+
+static void
+window_added_cb (GtkApplication *application,
+                 GtkWindow *window,
+                 gpointer user_data)
+{
+  EphyShell *shell = EPHY_SHELL (application);
+
+  if (shell->priv->time_to_first_window != -1) {
+    g_signal_handlers_disconnect_by_func (application, window_added_cb, user_data);
+    return;
+  }
+
+  g_signal_connect_after (window, "draw",
+                          G_CALLBACK (first_window_draw_cb), shell);
+}
+
 static void
 ephy_shell_startup (GApplication* application)
 {
@@ -251,6 +373,8 @@ ephy_shell_startup (GApplication* application)
   char *disk_cache_dir;
 #endif
 
+  START_TRACE ("ephy_shell_startup")
+
   G_APPLICATION_CLASS (ephy_shell_parent_class)->startup (application);
 
   /* We're not remoting; start our services */
@@ -271,7 +395,12 @@ ephy_shell_startup (GApplication* application)
   g_free (disk_cache_dir);
 #endif
 
+  START_TRACE ("ephy_embed_prefs_init")
   ephy_embed_prefs_init ();
+  STOP_TRACE ("ephy_embed_prefs_init")
+
+  g_signal_connect (application, "window-added",
+                    G_CALLBACK (window_added_cb), NULL);
 
   if (mode != EPHY_EMBED_SHELL_MODE_APPLICATION) {
     GtkBuilder *builder;
@@ -300,6 +429,8 @@ ephy_shell_startup (GApplication* application)
                                   G_MENU_MODEL (gtk_builder_get_object (builder, "app-menu")));
     g_object_unref (builder);
   }
+
+  STOP_TRACE ("ephy_shell_startup")
 }
 
 static void
@@ -319,6 +450,8 @@ session_load_cb (GObject *object,
   EphyShell *shell = EPHY_SHELL (user_data);
 
   ephy_session_resume_finish (session, result, NULL);
+  STOP_TRACE ("ephy_session_resume")
+
   ephy_shell_startup_continue (shell);
 }
 
@@ -336,6 +469,7 @@ ephy_shell_activate (GApplication *application)
     EphyShellStartupContext *ctx;
 
     ctx = shell->priv->startup_context;
+    START_TRACE ("ephy_session_resume")
     ephy_session_resume (ephy_shell_get_session (shell),
                          ctx->user_time, NULL, session_load_cb, shell);
   } else
@@ -525,11 +659,6 @@ ephy_shell_constructed (GObject *object)
   /* FIXME: not sure if this is the best place to put this stuff. */
   ephy_shell_get_lockdown (EPHY_SHELL (object));
 
-#ifndef HAVE_WEBKIT2
-  if (ephy_embed_shell_get_mode (EPHY_EMBED_SHELL (object)) != EPHY_EMBED_SHELL_MODE_TEST)
-    ephy_embed_shell_get_adblock_manager (EPHY_EMBED_SHELL (object));
-#endif
-
   if (G_OBJECT_CLASS (ephy_shell_parent_class)->constructed)
     G_OBJECT_CLASS (ephy_shell_parent_class)->constructed (object);
 }
@@ -550,6 +679,22 @@ ephy_shell_class_init (EphyShellClass *klass)
   application_class->before_emit = ephy_shell_before_emit;
   application_class->add_platform_data = ephy_shell_add_platform_data;
 
+/**
+ * EphyShell::bookmarks-loaded:
+ * @shell: the #EphyShell
+ *
+ * Emitted once, when the bookmarks are loaded. This happens after the
+ * first window is drawn, or earlier if ephy_shell_get_bookmarks() is
+ * called before that.
+ **/
+  signals[BOOKMARKS_LOADED] =
+    g_signal_new ("bookmarks-loaded",
+                  EPHY_TYPE_SHELL,
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__VOID,
+                  G_TYPE_NONE, 0);
+
   g_type_class_add_private (object_class, sizeof(EphyShellPrivate));
 }
 
@@ -607,6 +752,7 @@ ephy_shell_init (EphyShell *shell)
 #endif
 
   shell->priv = EPHY_SHELL_GET_PRIVATE (shell);
+  shell->priv->time_to_first_window = -1;
 
   /* globally accessible singleton */
   g_assert (ephy_shell == NULL);
@@ -641,6 +787,7 @@ ephy_shell_dispose (GObject *object)
 
   g_clear_object (&priv->session);
   g_clear_object (&priv->lockdown);
+  g_clear_object (&priv->load_scheduler);
   g_clear_pointer (&priv->bme, gtk_widget_destroy);
   g_clear_pointer (&priv->history_window, gtk_widget_destroy);
   g_clear_object (&priv->pdm_dialog);
@@ -653,6 +800,11 @@ ephy_shell_dispose (GObject *object)
     priv->open_uris_idle_id = 0;
   }
 
+  if (priv->deferred_init_id > 0) {
+    g_source_remove (priv->deferred_init_id);
+    priv->deferred_init_id = 0;
+  }
+
   G_OBJECT_CLASS (ephy_shell_parent_class)->dispose (object);
 }
 
@@ -902,6 +1054,26 @@ ephy_shell_get_session (EphyShell *shell)
   return shell->priv->session;
 }
 
+/**
+ * ephy_shell_get_load_scheduler:
+ * @shell: the #EphyShell
+ *
+ * Returns the #EphyLoadScheduler that throttles the loads of tabs
+ * opened in bulk.
+ *
+ * Return value: (transfer none): the shell's #EphyLoadScheduler
+ **/
+EphyLoadScheduler *
+ephy_shell_get_load_scheduler (EphyShell *shell)
+{
+  g_return_val_if_fail (EPHY_IS_SHELL (shell), NULL);
+
+  if (shell->priv->load_scheduler == NULL)
+    shell->priv->load_scheduler = ephy_load_scheduler_new ();
+
+  return shell->priv->load_scheduler;
+}
+
 /**
  * ephy_shell_get_bookmarks:
  *
@@ -911,12 +1083,47 @@ EphyBookmarks *
 ephy_shell_get_bookmarks (EphyShell *shell)
 {
   if (shell->priv->bookmarks == NULL) {
+    START_TRACE ("ephy_bookmarks_new")
     shell->priv->bookmarks = ephy_bookmarks_new ();
+    STOP_TRACE ("ephy_bookmarks_new")
+
+    g_signal_emit (shell, signals[BOOKMARKS_LOADED], 0);
   }
 
   return shell->priv->bookmarks;
 }
 
+/**
+ * ephy_shell_peek_bookmarks:
+ *
+ * Like ephy_shell_get_bookmarks(), but does not load the bookmarks if
+ * that has not happened yet. Use this on the way to the first window,
+ * and connect to #EphyShell::bookmarks-loaded when it returns %NULL.
+ *
+ * Return value: (transfer none): the bookmarks, or %NULL
+ **/
+EphyBookmarks *
+ephy_shell_peek_bookmarks (EphyShell *shell)
+{
+  g_return_val_if_fail (EPHY_IS_SHELL (shell), NULL);
+
+  return shell->priv->bookmarks;
+}
+
+/**
+ * ephy_shell_get_time_to_first_window:
+ *
+ * Returns: the time in microseconds from process start until the first
+ * window was drawn, or -1 if that has not happened yet
+ **/
+gint64
+ephy_shell_get_time_to_first_window (EphyShell *shell)
+{
+  g_return_val_if_fail (EPHY_IS_SHELL (shell), -1);
+
+  return shell->priv->time_to_first_window;
+}
+
 /**
  * ephy_shell_get_net_monitor:
  *
@@ -1188,19 +1395,30 @@ static gboolean
 ephy_shell_open_uris_idle (OpenURIsData *data)
 {
   EphyEmbed *embed;
+  EphyNewTabFlags flags;
   EphyNewTabFlags page_flags;
   const char *url;
+  gboolean delayed = FALSE;
 #ifdef HAVE_WEBKIT2
   WebKitURIRequest *request = NULL;
 #else
   WebKitNetworkRequest *request = NULL;
 #endif
 
+  flags = data->flags;
   url = data->uris[data->current_uri];
   if (url[0] == '\0') {
     page_flags = EPHY_NEW_TAB_HOME_PAGE;
   } else {
-    page_flags = EPHY_NEW_TAB_OPEN_PAGE;
+    /* Only the first page loads right away and gets the focus, the
+     * others are queued in the load scheduler so that opening many
+     * pages at once does not start all their loads together. */
+    if (data->current_uri > 0) {
+      delayed = TRUE;
+      page_flags = EPHY_NEW_TAB_DELAYED_OPEN_PAGE;
+      flags &= ~(EPHY_NEW_TAB_JUMP | EPHY_NEW_TAB_FROM_EXTERNAL);
+    } else
+      page_flags = EPHY_NEW_TAB_OPEN_PAGE;
 #ifdef HAVE_WEBKIT2
     request = webkit_uri_request_new (url);
 #else
@@ -1212,7 +1430,7 @@ ephy_shell_open_uris_idle (OpenURIsData *data)
                                    data->window,
                                    NULL /* parent tab */,
                                    request,
-                                   data->flags | page_flags,
+                                   flags | page_flags,
                                    EPHY_WEB_VIEW_CHROME_ALL,
                                    FALSE /* is popup? */,
                                    data->user_time);
@@ -1220,6 +1438,12 @@ ephy_shell_open_uris_idle (OpenURIsData *data)
   if (request)
     g_object_unref (request);
 
+  /* The tab may have loaded already if it was mapped right away. */
+  if (delayed && ephy_embed_has_load_pending (embed)) {
+    ephy_web_view_set_placeholder (ephy_embed_get_web_view (embed), url, url);
+    ephy_load_scheduler_add (ephy_shell_get_load_scheduler (data->shell), embed);
+  }
+
   data->window = EPHY_WINDOW (gtk_widget_get_toplevel (GTK_WIDGET (embed)));
   data->current_uri++;
 
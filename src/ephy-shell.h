@@ -50,6 +50,10 @@ G_BEGIN_DECLS
 #define EPHY_IS_SHELL_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), EPHY_TYPE_SHELL))
 #define EPHY_SHELL_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), EPHY_TYPE_SHELL, EphyShellClass))
 
+/* How long it may take from process start until the first window is
+ * drawn. Going over it is counted in about:performance. */
+#define EPHY_SHELL_FIRST_WINDOW_BUDGET_MS 1000
+
 typedef struct _EphyShell   EphyShell;
 typedef struct _EphyShellClass    EphyShellClass;
 typedef struct _EphyShellPrivate  EphyShellPrivate;
@@ -169,6 +173,10 @@ GNetworkMonitor *ephy_shell_get_net_monitor              (EphyShell *shell);
 
 EphyBookmarks   *ephy_shell_get_bookmarks                (EphyShell *shell);
 
+EphyBookmarks   *ephy_shell_peek_bookmarks               (EphyShell *shell);
+
+gint64          ephy_shell_get_time_to_first_window     (EphyShell *shell);
+
 GtkWidget       *ephy_shell_get_bookmarks_editor         (EphyShell *shell);
 
 GtkWidget       *ephy_shell_get_history_window           (EphyShell *shell);
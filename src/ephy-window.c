@@ -3941,7 +3941,17 @@ ephy_window_constructor (GType type,
 	/* Initialize the menus */
 	priv->enc_menu = ephy_encoding_menu_new (window);
 
-	ephy_bookmarks_ui_attach_window (window);
+	/* Bookmarks are loaded once the first window is on screen. */
+	if (ephy_shell_peek_bookmarks (ephy_shell_get_default ()) != NULL)
+	{
+		ephy_bookmarks_ui_attach_window (window);
+	}
+	else
+	{
+		g_signal_connect_object (ephy_shell_get_default (), "bookmarks-loaded",
+					 G_CALLBACK (ephy_bookmarks_ui_attach_window),
+					 window, G_CONNECT_SWAPPED);
+	}
 
 	/* other notifiers */
 	action = gtk_action_group_get_action (window->priv->action_group,
@@ -4440,30 +4450,35 @@ ephy_window_close (EphyWindow *window)
 {
 	EphyEmbed *modified_embed = NULL;
 	GList *tabs, *l;
-	gboolean modified = FALSE;
 
 	/* We ignore the delete_event if the disable_quit lockdown has been set
 	 */
 	if (g_settings_get_boolean (EPHY_SETTINGS_LOCKDOWN,
 				    EPHY_PREFS_LOCKDOWN_QUIT)) return FALSE;
 
-	tabs = impl_get_children (EPHY_EMBED_CONTAINER (window));
-	for (l = tabs; l != NULL; l = l->next)
+	/* Checking the tabs must not block on the web process, see
+	 * ephy_web_view_has_modified_forms().
+	 */
+	if (g_settings_get_boolean (EPHY_SETTINGS_MAIN,
+				    EPHY_PREFS_WARN_ON_CLOSE_UNSUBMITTED_DATA))
 	{
-		EphyEmbed *embed = (EphyEmbed *) l->data;
+		tabs = impl_get_children (EPHY_EMBED_CONTAINER (window));
+		for (l = tabs; l != NULL; l = l->next)
+		{
+			EphyEmbed *embed = (EphyEmbed *) l->data;
 
-		g_return_val_if_fail (EPHY_IS_EMBED (embed), FALSE);
+			g_return_val_if_fail (EPHY_IS_EMBED (embed), FALSE);
 
-		if (ephy_web_view_has_modified_forms (ephy_embed_get_web_view (embed)))
-		{
-			modified = TRUE;
-			modified_embed = embed;
-			break;
+			if (ephy_web_view_has_modified_forms (ephy_embed_get_web_view (embed)))
+			{
+				modified_embed = embed;
+				break;
+			}
 		}
+		g_list_free (tabs);
 	}
-	g_list_free (tabs);
 
-	if (modified)
+	if (modified_embed != NULL)
 	{
 		/* jump to the first tab with modified forms */
 		impl_set_active_child (EPHY_EMBED_CONTAINER (window),
@@ -4476,7 +4491,6 @@ ephy_window_close (EphyWindow *window)
 		}
 	}
 
-
 	if (window_has_ongoing_downloads (window) && confirm_close_with_downloads (window) == FALSE)
 	{
 		/* stop window close */
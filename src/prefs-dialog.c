@@ -242,25 +242,20 @@ create_node_combo (EphyDialog *dialog,
 
 	store = gtk_list_store_new (NUM_COLS, G_TYPE_STRING, G_TYPE_STRING);
 	all_encodings = ephy_encodings_get_all (encodings);
-	for (p = all_encodings; p; p = p->next) 
+	/* ephy_encodings_get_all() returns the encodings sorted by title
+	 * already, so the store does not need to sort them again. */
+	for (p = all_encodings; p; p = p->next)
 	{
-		GtkTreeIter iter;
 		EphyEncoding *encoding = EPHY_ENCODING (p->data);
-		
-		gtk_list_store_append (store, &iter);
-		gtk_list_store_set (store, &iter,
-				    COL_TITLE_ELIDED, 
-				    ephy_encoding_get_title_elided (encoding),
-				    -1);
-		gtk_list_store_set (store, &iter,
-				    COL_ENCODING, 
-				    ephy_encoding_get_encoding (encoding),
-				    -1);
+
+		gtk_list_store_insert_with_values (store, NULL, -1,
+						   COL_TITLE_ELIDED,
+						   ephy_encoding_get_title_elided (encoding),
+						   COL_ENCODING,
+						   ephy_encoding_get_encoding (encoding),
+						   -1);
 	}
 	g_list_free (all_encodings);
-
-	gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (store), COL_TITLE_ELIDED,
-					      GTK_SORT_ASCENDING);
 	gtk_combo_box_set_model (combo, GTK_TREE_MODEL (store));
 
 	renderer = gtk_cell_renderer_text_new ();
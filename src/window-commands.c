@@ -50,7 +50,6 @@
 #include "ephy-shell.h"
 #include "ephy-string.h"
 #include "ephy-web-app-utils.h"
-#include "ephy-web-dom-utils.h"
 #include "ephy-zoom.h"
 #include "pdm-dialog.h"
 
@@ -694,69 +693,6 @@ download_icon_or_take_snapshot (EphyApplicationDialogData *data,
 	}
 }
 
-#ifdef HAVE_WEBKIT2
-static void
-fill_default_application_image_cb (GObject *source,
-				   GAsyncResult *async_result,
-				   gpointer user_data)
-{
-	EphyApplicationDialogData *data = user_data;
-	GVariant *result;
-	char *uri = NULL;
-	char *color = NULL;
-	gboolean res = FALSE;
-
-	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source),
-					   async_result,
-					   NULL);
-
-	if (result)
-	{
-		g_variant_get (result, "(bss)", &res, &uri, &color);
-		g_variant_unref (result);
-	}
-
-	download_icon_or_take_snapshot (data, res, uri, color);
-}
-#endif
-
-static void
-fill_default_application_image (EphyApplicationDialogData *data)
-{
-	const char *base_uri;
-#ifdef HAVE_WEBKIT2
-	GDBusProxy *web_extension;
-#else
-	char *uri = NULL;
-	char *color = NULL;
-	gboolean res;
-#endif
-
-	base_uri = webkit_web_view_get_uri (WEBKIT_WEB_VIEW (data->view));
-
-#ifdef HAVE_WEBKIT2
-	web_extension = ephy_embed_shell_get_web_extension_proxy (ephy_embed_shell_get_default ());
-	if (web_extension)
-		g_dbus_proxy_call (web_extension,
-				   "GetBestWebAppIcon",
-				   g_variant_new("(ts)", webkit_web_view_get_page_id (WEBKIT_WEB_VIEW (data->view)), base_uri),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   -1,
-				   NULL,
-				   fill_default_application_image_cb,
-				   data);
-	else
-		download_icon_or_take_snapshot (data, FALSE, NULL, NULL);
-#else
-	res = ephy_web_dom_utils_get_best_icon (webkit_web_view_get_dom_document (WEBKIT_WEB_VIEW (data->view)),
-						base_uri,
-						&uri,
-						&color);
-
-	download_icon_or_take_snapshot (data, res, uri, color);
-#endif
-}
-
 typedef struct {
 	const char *host;
 	const char *name;
@@ -823,52 +759,35 @@ set_default_application_title (EphyApplicationDialogData *data,
 	g_free (title);
 }
 
-#ifdef HAVE_WEBKIT2
 static void
-fill_default_application_title_cb (GObject *source,
-				   GAsyncResult *async_result,
-				   gpointer user_data)
+fill_default_application_info_cb (GObject *source,
+				  GAsyncResult *result,
+				  gpointer user_data)
 {
 	EphyApplicationDialogData *data = user_data;
-	GVariant *result;
 	char *title = NULL;
+	char *uri = NULL;
+	char *color = NULL;
 
-	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source),
-					   async_result,
-					   NULL);
-
-	if (result)
-	{
-		g_variant_get (result, "(s)", &title);
-		g_variant_unref (result);
-	}
+	ephy_web_view_get_web_app_info_finish (EPHY_WEB_VIEW (source),
+					       result,
+					       &title,
+					       &uri,
+					       &color,
+					       NULL);
 
+	download_icon_or_take_snapshot (data, uri != NULL, uri, color);
 	set_default_application_title (data, title);
+	g_free (color);
 }
-#endif
 
 static void
-fill_default_application_title (EphyApplicationDialogData *data)
+fill_default_application_info (EphyApplicationDialogData *data)
 {
-#ifdef HAVE_WEBKIT2
-	GDBusProxy *web_extension;
-	web_extension = ephy_embed_shell_get_web_extension_proxy (ephy_embed_shell_get_default ());
-	if (web_extension)
-		g_dbus_proxy_call (web_extension,
-				   "GetWebAppTitle",
-				   g_variant_new("(t)", webkit_web_view_get_page_id (WEBKIT_WEB_VIEW (data->view))),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   -1,
-				   NULL,
-				   fill_default_application_title_cb,
-				   data);
-	else
-		set_default_application_title (data, NULL);
-#else
-	WebKitDOMDocument *document = webkit_web_view_get_dom_document (WEBKIT_WEB_VIEW (data->view));
-	char *title = ephy_web_dom_utils_get_application_title (document);
-	set_default_application_title (data, title);
-#endif
+	ephy_web_view_get_web_app_info_async (data->view,
+					      NULL,
+					      fill_default_application_info_cb,
+					      data);
 }
 
 static void
@@ -1045,8 +964,7 @@ window_cmd_file_save_as_application (GtkAction *action,
 
 	g_object_bind_property (image, "visible", data->spinner_box, "visible", G_BINDING_INVERT_BOOLEAN);
 
-	fill_default_application_image (data);
-	fill_default_application_title (data);
+	fill_default_application_info (data);
 
 	gtk_widget_show_all (dialog);
 
@@ -21,10 +21,16 @@
 #include "config.h"
 #include "ephy-bookmarks.h"
 
+#include "ephy-bookmarks-export.h"
+#include "ephy-bookmarks-import.h"
 #include "ephy-debug.h"
 #include "ephy-file-helpers.h"
+#include "ephy-node-common.h"
 #include "ephy-profile-utils.h"
 
+#include <glib/gstdio.h>
+#include <string.h>
+
 const char* bookmarks_paths[] = { EPHY_BOOKMARKS_FILE, EPHY_BOOKMARKS_FILE_RDF };
 
 static void
@@ -97,6 +103,157 @@ test_ephy_bookmarks_set_address (void)
   clear_bookmark_files ();
 }
 
+static void
+test_ephy_bookmarks_snapshot (void)
+{
+  EphyBookmarks *bookmarks;
+  EphyBookmarksSnapshot *snapshot;
+  EphyNode *node;
+  char *path, *contents;
+
+  bookmarks = ephy_bookmarks_new ();
+  node = ephy_bookmarks_add (bookmarks, "GNOME", "http://www.gnome.org");
+  g_assert (node);
+
+  snapshot = ephy_bookmarks_snapshot_new (bookmarks);
+
+  /* Changes made after the snapshot was taken must not show up. */
+  ephy_node_set_property_string (node, EPHY_NODE_BMK_PROP_TITLE, "Changed");
+
+  path = g_build_filename (ephy_dot_dir (), "snapshot.rdf", NULL);
+  ephy_bookmarks_snapshot_export_rdf (snapshot, path);
+  ephy_bookmarks_snapshot_free (snapshot);
+
+  g_assert (g_file_get_contents (path, &contents, NULL, NULL));
+  g_assert (strstr (contents, "<title>GNOME</title>") != NULL);
+  g_assert (strstr (contents, "http://www.gnome.org") != NULL);
+  g_assert (strstr (contents, "Changed") == NULL);
+
+  g_unlink (path);
+  g_free (contents);
+  g_free (path);
+
+  g_object_unref (bookmarks);
+  clear_bookmark_files ();
+}
+
+#define N_IMPORTED 1000
+
+static char *
+write_mozilla_bookmarks (void)
+{
+  GString *html;
+  char *path;
+  int i;
+
+  html = g_string_new ("<!DOCTYPE NETSCAPE-Bookmark-file-1>\n<DL><p>\n"
+                       "<DT><H3>Folder</H3>\n<DL><p>\n");
+  for (i = 0; i < N_IMPORTED; i++)
+    g_string_append_printf (html, "<DT><A HREF=\"http://example.com/%d\">Site %d</A>\n", i, i);
+  /* A duplicate, which should only be added once. */
+  g_string_append (html, "<DT><A HREF=\"http://example.com/0\">Again</A>\n");
+  g_string_append (html, "</DL><p>\n</DL><p>\n");
+
+  path = g_build_filename (ephy_dot_dir (), "import.html", NULL);
+  g_assert (g_file_set_contents (path, html->str, html->len, NULL));
+  g_string_free (html, TRUE);
+
+  return path;
+}
+
+static void
+check_imported (EphyBookmarks *bookmarks, int n_before)
+{
+  EphyNode *node, *keyword;
+
+  g_assert_cmpint (ephy_node_get_n_children (ephy_bookmarks_get_bookmarks (bookmarks)),
+                   ==, n_before + N_IMPORTED);
+
+  node = ephy_bookmarks_find_bookmark (bookmarks, "http://example.com/0");
+  g_assert (node);
+  g_assert_cmpstr (ephy_node_get_property_string (node, EPHY_NODE_BMK_PROP_TITLE), ==, "Site 0");
+
+  keyword = ephy_bookmarks_find_keyword (bookmarks, "Folder", FALSE);
+  g_assert (keyword);
+  g_assert (ephy_bookmarks_has_keyword (bookmarks, keyword, node));
+  g_assert (!ephy_node_has_child (ephy_bookmarks_get_not_categorized (bookmarks), node));
+  g_assert (strstr (ephy_node_get_property_string (node, EPHY_NODE_BMK_PROP_KEYWORDS), "folder") != NULL);
+}
+
+static void
+test_ephy_bookmarks_import (void)
+{
+  EphyBookmarks *bookmarks;
+  char *path;
+  int n_before;
+
+  path = write_mozilla_bookmarks ();
+
+  bookmarks = ephy_bookmarks_new ();
+  n_before = ephy_node_get_n_children (ephy_bookmarks_get_bookmarks (bookmarks));
+
+  g_assert (ephy_bookmarks_import_mozilla (bookmarks, path));
+  check_imported (bookmarks, n_before);
+
+  /* Importing again must not add anything. */
+  g_assert (ephy_bookmarks_import_mozilla (bookmarks, path));
+  check_imported (bookmarks, n_before);
+
+  g_object_unref (bookmarks);
+  g_unlink (path);
+  g_free (path);
+  clear_bookmark_files ();
+}
+
+static void
+import_progress_cb (goffset current, goffset total, gpointer user_data)
+{
+  goffset *last = user_data;
+
+  g_assert_cmpint (current, <=, total);
+  *last = current;
+}
+
+static void
+import_finished_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  gboolean *finished = user_data;
+
+  g_assert (ephy_bookmarks_import_finish (EPHY_BOOKMARKS (source), result, NULL));
+  *finished = TRUE;
+
+  gtk_main_quit ();
+}
+
+static void
+test_ephy_bookmarks_import_async (void)
+{
+  EphyBookmarks *bookmarks;
+  char *path;
+  int n_before;
+  goffset progress = -1;
+  gboolean finished = FALSE;
+
+  path = write_mozilla_bookmarks ();
+
+  bookmarks = ephy_bookmarks_new ();
+  n_before = ephy_node_get_n_children (ephy_bookmarks_get_bookmarks (bookmarks));
+
+  ephy_bookmarks_import_async (bookmarks, path, NULL,
+                               import_progress_cb, &progress,
+                               import_finished_cb, &finished);
+  gtk_main ();
+
+  g_assert (finished);
+  g_assert_cmpint (progress, >, 0);
+  check_imported (bookmarks, n_before);
+
+  g_object_unref (bookmarks);
+  g_unlink (path);
+  g_free (path);
+  clear_bookmark_files ();
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -121,6 +278,15 @@ main (int argc, char *argv[])
   g_test_add_func ("/src/bookmarks/ephy-bookmarks/set_address",
                    test_ephy_bookmarks_set_address);
 
+  g_test_add_func ("/src/bookmarks/ephy-bookmarks/snapshot",
+                   test_ephy_bookmarks_snapshot);
+
+  g_test_add_func ("/src/bookmarks/ephy-bookmarks/import",
+                   test_ephy_bookmarks_import);
+
+  g_test_add_func ("/src/bookmarks/ephy-bookmarks/import_async",
+                   test_ephy_bookmarks_import_async);
+
   ret = g_test_run ();
 
   return ret;
@@ -72,6 +72,50 @@ test_ephy_encodings_get (void)
   g_list_free (all);
 }
 
+static void
+test_ephy_encodings_sorted (void)
+{
+  EphyEmbedShell *embed_shell = ephy_embed_shell_get_default ();
+  EphyEncodings *encodings;
+  EphyEncoding *encoding;
+  GList *list, *p;
+
+  encodings = EPHY_ENCODINGS (ephy_embed_shell_get_encodings (embed_shell));
+
+  /* Known encodings are looked up without being added. */
+  encoding = ephy_encodings_get_encoding (encodings, "KOI8-R", FALSE);
+  g_assert (EPHY_IS_ENCODING (encoding));
+  g_assert_cmpstr (ephy_encoding_get_encoding (encoding), ==, "KOI8-R");
+  g_assert (ephy_encodings_get_encoding (encodings, "x-no-such-encoding", FALSE) == NULL);
+
+  list = ephy_encodings_get_encodings (encodings, LG_CYRILLIC);
+  g_assert_cmpint (g_list_length (list), ==, 7);
+  g_assert (g_list_find (list, encoding));
+  for (p = list; p; p = p->next) {
+    g_assert_cmpint (ephy_encoding_get_language_groups (p->data) & LG_CYRILLIC, !=, 0);
+    if (p->next)
+      g_assert_cmpstr (ephy_encoding_get_collation_key (p->data), <=,
+                       ephy_encoding_get_collation_key (p->next->data));
+  }
+  g_list_free (list);
+
+  list = ephy_encodings_get_encodings (encodings, LG_GREEK | LG_TURKISH);
+  g_assert_cmpint (g_list_length (list), ==, 7);
+  g_list_free (list);
+
+  /* Unknown encodings are added in order too. */
+  encoding = ephy_encodings_get_encoding (encodings, "x-no-such-encoding", TRUE);
+  g_assert (EPHY_IS_ENCODING (encoding));
+
+  list = ephy_encodings_get_all (encodings);
+  g_assert_cmpint (g_list_length (list), ==, NUM_ENCODINGS + 1);
+  g_assert (g_list_find (list, encoding));
+  for (p = list; p && p->next; p = p->next)
+    g_assert_cmpstr (ephy_encoding_get_collation_key (p->data), <=,
+                     ephy_encoding_get_collation_key (p->next->data));
+  g_list_free (list);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -98,6 +142,9 @@ main (int argc, char *argv[])
   g_test_add_func ("/src/ephy-encodings/get",
                    test_ephy_encodings_get);
 
+  g_test_add_func ("/src/ephy-encodings/sorted",
+                   test_ephy_encodings_sorted);
+
   ret = g_test_run ();
 
   ephy_file_helpers_shutdown ();
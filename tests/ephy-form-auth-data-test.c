@@ -0,0 +1,213 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * Copyright © 2013 Igalia S.L.
+ *
+ * Epiphany is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Epiphany is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Epiphany; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+#include "ephy-form-auth-data.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+/* The caches are created empty, so the keyring of the user running
+ * the tests is never looked at. */
+
+static char *
+get_usernames (EphyFormAuthDataCache *cache,
+               const char *host)
+{
+  GString *usernames;
+  GSList *l;
+
+  usernames = g_string_new (NULL);
+
+  for (l = ephy_form_auth_data_cache_get_list (cache, host); l; l = l->next) {
+    EphyFormAuthData *data = l->data;
+
+    if (usernames->len)
+      g_string_append_c (usernames, ' ');
+    g_string_append (usernames, data->username);
+  }
+
+  return g_string_free (usernames, FALSE);
+}
+
+#define assert_usernames(cache, host, expected) G_STMT_START {  \
+  char *usernames = get_usernames (cache, host);                \
+  g_assert_cmpstr (usernames, ==, expected);                    \
+  g_free (usernames);                                           \
+} G_STMT_END
+
+static const char *
+lookup_username (EphyFormAuthDataCache *cache,
+                 const char *host,
+                 const char *form_username,
+                 const char *form_password)
+{
+  EphyFormAuthData *data;
+
+  data = ephy_form_auth_data_cache_lookup (cache, host, form_username, form_password);
+
+  return data ? data->username : NULL;
+}
+
+static void
+test_ephy_form_auth_data_cache_lookup (void)
+{
+  EphyFormAuthDataCache *cache;
+
+  cache = ephy_form_auth_data_cache_new_empty ();
+
+  ephy_form_auth_data_cache_add (cache, "example.com", "user", "pass", "alice");
+  ephy_form_auth_data_cache_add (cache, "example.com", "login", "secret", "bob");
+
+  g_assert_cmpstr (lookup_username (cache, "example.com", "user", "pass"), ==, "alice");
+  g_assert_cmpstr (lookup_username (cache, "example.com", "login", "secret"), ==, "bob");
+
+  /* Both field names have to match. */
+  g_assert_cmpstr (lookup_username (cache, "example.com", "user", "secret"), ==, NULL);
+  g_assert_cmpstr (lookup_username (cache, "example.com", "login", "pass"), ==, NULL);
+
+  /* Forms without a username or password field are never known. */
+  g_assert_cmpstr (lookup_username (cache, "example.com", NULL, "pass"), ==, NULL);
+  g_assert_cmpstr (lookup_username (cache, "example.com", "user", NULL), ==, NULL);
+
+  /* The data is kept per host. */
+  g_assert_cmpstr (lookup_username (cache, "example.org", "user", "pass"), ==, NULL);
+
+  ephy_form_auth_data_cache_free (cache);
+}
+
+static void
+test_ephy_form_auth_data_cache_add (void)
+{
+  EphyFormAuthDataCache *cache;
+
+  cache = ephy_form_auth_data_cache_new_empty ();
+
+  ephy_form_auth_data_cache_add (cache, "example.com", "user", "pass", "alice");
+  ephy_form_auth_data_cache_add (cache, "example.com", "user", "pass", "bob");
+  assert_usernames (cache, "example.com", "alice bob");
+
+  /* Adding a login again does not duplicate it. */
+  ephy_form_auth_data_cache_add (cache, "example.com", "user", "pass", "alice");
+  ephy_form_auth_data_cache_add (cache, "example.com", "user", "pass", "bob");
+  assert_usernames (cache, "example.com", "alice bob");
+
+  /* The same username in another form is another login. */
+  ephy_form_auth_data_cache_add (cache, "example.com", "login", "secret", "alice");
+  assert_usernames (cache, "example.com", "alice bob alice");
+
+  /* The index keeps pointing to the first login added for the fields. */
+  g_assert_cmpstr (lookup_username (cache, "example.com", "user", "pass"), ==, "alice");
+
+  ephy_form_auth_data_cache_free (cache);
+}
+
+static void
+test_ephy_form_auth_data_cache_remove (void)
+{
+  EphyFormAuthDataCache *cache;
+
+  cache = ephy_form_auth_data_cache_new_empty ();
+
+  ephy_form_auth_data_cache_add (cache, "example.com", "user", "pass", "alice");
+  ephy_form_auth_data_cache_add (cache, "example.com", "login", "secret", "carol");
+  ephy_form_auth_data_cache_add (cache, "example.com", "user", "pass", "bob");
+
+  /* Removing what is not there changes nothing. */
+  ephy_form_auth_data_cache_remove (cache, "example.com", "user", "pass", "dave");
+  ephy_form_auth_data_cache_remove (cache, "example.org", "user", "pass", "alice");
+  assert_usernames (cache, "example.com", "alice carol bob");
+  g_assert_cmpstr (lookup_username (cache, "example.com", "user", "pass"), ==, "alice");
+
+  /* Removing a login that is not the first for its fields leaves the
+   * index alone. */
+  ephy_form_auth_data_cache_add (cache, "example.com", "user", "pass", "erin");
+  ephy_form_auth_data_cache_remove (cache, "example.com", "user", "pass", "erin");
+  assert_usernames (cache, "example.com", "alice carol bob");
+  g_assert_cmpstr (lookup_username (cache, "example.com", "user", "pass"), ==, "alice");
+
+  /* Removing the first one points the index to the next login for the
+   * same fields, not to the next login of the host. */
+  ephy_form_auth_data_cache_remove (cache, "example.com", "user", "pass", "alice");
+  assert_usernames (cache, "example.com", "carol bob");
+  g_assert_cmpstr (lookup_username (cache, "example.com", "user", "pass"), ==, "bob");
+  g_assert_cmpstr (lookup_username (cache, "example.com", "login", "secret"), ==, "carol");
+
+  ephy_form_auth_data_cache_remove (cache, "example.com", "user", "pass", "bob");
+  assert_usernames (cache, "example.com", "carol");
+  g_assert_cmpstr (lookup_username (cache, "example.com", "user", "pass"), ==, NULL);
+  g_assert_cmpstr (lookup_username (cache, "example.com", "login", "secret"), ==, "carol");
+
+  /* Adding a login back after its fields were emptied indexes it again,
+   * and appends it after the remaining ones. */
+  ephy_form_auth_data_cache_add (cache, "example.com", "user", "pass", "alice");
+  assert_usernames (cache, "example.com", "carol alice");
+  g_assert_cmpstr (lookup_username (cache, "example.com", "user", "pass"), ==, "alice");
+
+  ephy_form_auth_data_cache_free (cache);
+}
+
+static void
+test_ephy_form_auth_data_cache_unknown_host (void)
+{
+  EphyFormAuthDataCache *cache;
+
+  cache = ephy_form_auth_data_cache_new_empty ();
+
+  /* Pages are only queried for logins when the cache knows the host
+   * or the form: for a host without logins both answers are empty. */
+  g_assert (ephy_form_auth_data_cache_get_list (cache, "example.com") == NULL);
+  g_assert_cmpstr (lookup_username (cache, "example.com", "user", "pass"), ==, NULL);
+
+  ephy_form_auth_data_cache_add (cache, "example.com", "user", "pass", "alice");
+  g_assert (ephy_form_auth_data_cache_get_list (cache, "example.com") != NULL);
+  g_assert (ephy_form_auth_data_cache_get_list (cache, "example.org") == NULL);
+
+  /* Once its last login is removed the host is forgotten again. */
+  ephy_form_auth_data_cache_remove (cache, "example.com", "user", "pass", "alice");
+  g_assert (ephy_form_auth_data_cache_get_list (cache, "example.com") == NULL);
+  g_assert_cmpstr (lookup_username (cache, "example.com", "user", "pass"), ==, NULL);
+
+  ephy_form_auth_data_cache_free (cache);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean ret;
+
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/lib/ephy-form-auth-data/cache_lookup",
+                   test_ephy_form_auth_data_cache_lookup);
+
+  g_test_add_func ("/lib/ephy-form-auth-data/cache_add",
+                   test_ephy_form_auth_data_cache_add);
+
+  g_test_add_func ("/lib/ephy-form-auth-data/cache_remove",
+                   test_ephy_form_auth_data_cache_remove);
+
+  g_test_add_func ("/lib/ephy-form-auth-data/cache_unknown_host",
+                   test_ephy_form_auth_data_cache_unknown_host);
+
+  ret = g_test_run ();
+
+  return ret;
+}
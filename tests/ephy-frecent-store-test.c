@@ -0,0 +1,258 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * Copyright © 2013 Igalia S.L.
+ *
+ * Epiphany is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Epiphany is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Epiphany; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+#include "ephy-frecent-store.h"
+#include "ephy-history-service.h"
+
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+/* The history is kept empty, the store is only fed the batches of
+ * changes emitted by hand below. Any query the store runs replaces
+ * its rows with the (empty) history, which the tests can see. */
+
+static void
+query_done_cb (EphyHistoryService *service,
+               gboolean success,
+               GList *urls,
+               GMainLoop *loop)
+{
+  g_list_free_full (urls, (GDestroyNotify)ephy_history_url_free);
+  g_main_loop_quit (loop);
+}
+
+/* Waits until the history service has answered everything that was
+ * asked before. */
+static void
+wait_for_history (EphyHistoryService *service)
+{
+  EphyHistoryQuery *query;
+  GMainLoop *loop;
+
+  loop = g_main_loop_new (NULL, FALSE);
+
+  query = ephy_history_query_new ();
+  ephy_history_service_query_urls (service, query, NULL,
+                                   (EphyHistoryJobCallback)query_done_cb, loop);
+  ephy_history_query_free (query);
+
+  g_main_loop_run (loop);
+  g_main_loop_unref (loop);
+}
+
+static EphyHistoryURL *
+visited_url (const char *url,
+             int visit_count,
+             gboolean hidden)
+{
+  EphyHistoryURL *history_url;
+
+  history_url = ephy_history_url_new (url, url, visit_count, 0, visit_count);
+  history_url->hidden = hidden;
+
+  return history_url;
+}
+
+static char *
+get_store_urls (EphyFrecentStore *store)
+{
+  GString *urls;
+  GtkTreeIter iter;
+  gboolean valid;
+
+  urls = g_string_new (NULL);
+
+  valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (store), &iter);
+  while (valid) {
+    char *url;
+
+    gtk_tree_model_get (GTK_TREE_MODEL (store), &iter,
+                        EPHY_OVERVIEW_STORE_URI, &url,
+                        -1);
+    if (urls->len)
+      g_string_append_c (urls, ' ');
+    g_string_append (urls, url);
+    g_free (url);
+
+    valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (store), &iter);
+  }
+
+  return g_string_free (urls, FALSE);
+}
+
+#define assert_store_urls(store, expected) G_STMT_START {  \
+  char *urls = get_store_urls (store);                     \
+  g_assert_cmpstr (urls, ==, expected);                    \
+  g_free (urls);                                           \
+} G_STMT_END
+
+static EphyFrecentStore *
+create_store (EphyHistoryService *service)
+{
+  EphyFrecentStore *store;
+  GdkPixbuf *icon;
+
+  icon = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, 1, 1);
+  store = ephy_frecent_store_new ();
+  g_object_set (store,
+                "history-length", 3,
+                "default-icon", icon,
+                "history-service", service,
+                NULL);
+  g_object_unref (icon);
+
+  /* Let the initial query land before feeding changes. */
+  wait_for_history (service);
+  assert_store_urls (store, "");
+
+  return store;
+}
+
+static EphyHistoryService *
+create_history_service (void)
+{
+  char *filename;
+  EphyHistoryService *service;
+
+  filename = g_build_filename (g_get_tmp_dir (), "epiphany-frecent-store-test.db", NULL);
+  if (g_file_test (filename, G_FILE_TEST_IS_REGULAR))
+    g_unlink (filename);
+
+  service = ephy_history_service_new (filename);
+  g_free (filename);
+
+  return service;
+}
+
+static void
+test_ephy_frecent_store_visits (void)
+{
+  EphyHistoryService *service;
+  EphyFrecentStore *store;
+  EphyHistoryChanges *changes;
+
+  service = create_history_service ();
+  store = create_store (service);
+
+  /* Rows are inserted at their position by visit count. */
+  changes = ephy_history_changes_new ();
+  g_ptr_array_add (changes->visited_urls, visited_url ("http://b.com/", 3, FALSE));
+  g_ptr_array_add (changes->visited_urls, visited_url ("http://c.com/", 1, FALSE));
+  g_ptr_array_add (changes->visited_urls, visited_url ("http://a.com/", 5, FALSE));
+  g_signal_emit_by_name (service, "changed", changes);
+  ephy_history_changes_free (changes);
+  assert_store_urls (store, "http://a.com/ http://b.com/ http://c.com/");
+
+  /* When the store is full, the last row makes room for a URL with
+   * more visits, and URLs with fewer visits are left out. */
+  changes = ephy_history_changes_new ();
+  g_ptr_array_add (changes->visited_urls, visited_url ("http://d.com/", 2, FALSE));
+  g_signal_emit_by_name (service, "changed", changes);
+  ephy_history_changes_free (changes);
+  assert_store_urls (store, "http://a.com/ http://b.com/ http://d.com/");
+
+  changes = ephy_history_changes_new ();
+  g_ptr_array_add (changes->visited_urls, visited_url ("http://e.com/", 1, FALSE));
+  g_signal_emit_by_name (service, "changed", changes);
+  ephy_history_changes_free (changes);
+  assert_store_urls (store, "http://a.com/ http://b.com/ http://d.com/");
+
+  /* A row whose visit count grows moves up. */
+  changes = ephy_history_changes_new ();
+  g_ptr_array_add (changes->visited_urls, visited_url ("http://d.com/", 6, FALSE));
+  g_signal_emit_by_name (service, "changed", changes);
+  ephy_history_changes_free (changes);
+  assert_store_urls (store, "http://d.com/ http://a.com/ http://b.com/");
+
+  /* Hidden URLs are skipped. */
+  changes = ephy_history_changes_new ();
+  g_ptr_array_add (changes->visited_urls, visited_url ("http://f.com/", 10, TRUE));
+  g_signal_emit_by_name (service, "changed", changes);
+  ephy_history_changes_free (changes);
+  assert_store_urls (store, "http://d.com/ http://a.com/ http://b.com/");
+
+  /* None of the batches above queried the history, or the rows would
+   * have been replaced by its empty contents. */
+  wait_for_history (service);
+  assert_store_urls (store, "http://d.com/ http://a.com/ http://b.com/");
+
+  g_object_unref (store);
+  g_object_unref (service);
+}
+
+static void
+test_ephy_frecent_store_deletions (void)
+{
+  EphyHistoryService *service;
+  EphyFrecentStore *store;
+  EphyHistoryChanges *changes;
+
+  service = create_history_service ();
+  store = create_store (service);
+
+  changes = ephy_history_changes_new ();
+  g_ptr_array_add (changes->visited_urls, visited_url ("http://a.com/", 2, FALSE));
+  g_ptr_array_add (changes->visited_urls, visited_url ("http://b.com/", 1, FALSE));
+  g_signal_emit_by_name (service, "changed", changes);
+  ephy_history_changes_free (changes);
+  assert_store_urls (store, "http://a.com/ http://b.com/");
+
+  /* Deleting a URL that is not in the store changes nothing. */
+  changes = ephy_history_changes_new ();
+  g_ptr_array_add (changes->deleted_urls, g_strdup ("http://z.com/"));
+  g_signal_emit_by_name (service, "changed", changes);
+  ephy_history_changes_free (changes);
+  wait_for_history (service);
+  assert_store_urls (store, "http://a.com/ http://b.com/");
+
+  /* Deleting a row removes it right away, and the store queries the
+   * history to fill the free slot: here that drops the other row,
+   * which only lived in the store. */
+  changes = ephy_history_changes_new ();
+  g_ptr_array_add (changes->deleted_urls, g_strdup ("http://a.com/"));
+  g_signal_emit_by_name (service, "changed", changes);
+  ephy_history_changes_free (changes);
+  assert_store_urls (store, "http://b.com/");
+
+  wait_for_history (service);
+  assert_store_urls (store, "");
+
+  g_object_unref (store);
+  g_object_unref (service);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean ret;
+
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/lib/widgets/ephy-frecent-store/visits",
+                   test_ephy_frecent_store_visits);
+
+  g_test_add_func ("/lib/widgets/ephy-frecent-store/deletions",
+                   test_ephy_frecent_store_deletions);
+
+  ret = g_test_run ();
+
+  return ret;
+}
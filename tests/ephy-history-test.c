@@ -23,10 +23,14 @@
  */
 
 #include "config.h"
+#include "ephy-history-import.h"
 #include "ephy-history-service.h"
+#include "ephy-history-service-private.h"
+#include "ephy-test-utils.h"
 
 #include <glib/gstdio.h>
 #include <gtk/gtk.h>
+#include <string.h>
 
 static EphyHistoryService *
 ensure_empty_history (const char* filename)
@@ -475,6 +479,477 @@ test_clear (void)
   gtk_main ();
 }
 
+static void
+urls_deleted_cb (EphyHistoryService *service,
+                 const char **urls,
+                 gpointer user_data)
+{
+  guint *n_emissions = (guint *)user_data;
+
+  /* All the URLs are reported in a single emission. */
+  g_assert_cmpuint (g_strv_length ((char **)urls), ==, 1000);
+  (*n_emissions)++;
+
+  g_object_unref (service);
+  gtk_main_quit ();
+}
+
+static void
+perform_delete_urls (EphyHistoryService *service,
+                     gboolean success,
+                     gpointer result_data,
+                     gpointer user_data)
+{
+  GList *urls = (GList *)result_data;
+
+  g_assert (success == TRUE);
+  g_assert_cmpint (g_list_length (urls), ==, 1000);
+
+  ephy_history_service_delete_urls (service, urls, NULL, NULL, NULL);
+  ephy_history_url_list_free (urls);
+}
+
+static void
+perform_query_before_delete (EphyHistoryService *service,
+                             gboolean success,
+                             gpointer result_data,
+                             gpointer user_data)
+{
+  EphyHistoryQuery *query;
+
+  g_assert (success == TRUE);
+
+  query = ephy_history_query_new ();
+  query->sort_type = EPHY_HISTORY_SORT_MV;
+  ephy_history_service_query_urls (service, query, NULL, perform_delete_urls, NULL);
+  ephy_history_query_free (query);
+}
+
+static void
+test_delete_urls (void)
+{
+  gchar *temporary_file = g_build_filename (g_get_tmp_dir (), "epiphany-history-test.db", NULL);
+  EphyHistoryService *service = ensure_empty_history (temporary_file);
+  GList *visits = NULL;
+  guint n_emissions = 0;
+  int i;
+
+  for (i = 0; i < 1000; i++) {
+    char *url = g_strdup_printf ("http://www.gnome.org/%d", i);
+    visits = g_list_prepend (visits, ephy_history_page_visit_new (url, i, EPHY_PAGE_VISIT_TYPED));
+    g_free (url);
+  }
+
+  g_signal_connect (service, "urls-deleted",
+                    G_CALLBACK (urls_deleted_cb), &n_emissions);
+
+  ephy_history_service_add_visits (service, visits, NULL, perform_query_before_delete, NULL);
+  ephy_history_page_visit_list_free (visits);
+  g_free (temporary_file);
+
+  gtk_main ();
+
+  g_assert_cmpuint (n_emissions, ==, 1);
+}
+
+typedef struct {
+  guint n_emissions;
+  int visit_count;
+  char *title;
+} ChangesData;
+
+static void
+history_changed_cb (EphyHistoryService *service,
+                    EphyHistoryChanges *changes,
+                    ChangesData *data)
+{
+  guint i;
+
+  data->n_emissions++;
+
+  g_assert (!changes->cleared);
+  g_assert_cmpuint (changes->deleted_urls->len, ==, 0);
+
+  /* Only the latest state of the URL is listed. */
+  g_assert_cmpuint (changes->visited_urls->len, <=, 1);
+  for (i = 0; i < changes->visited_urls->len; i++) {
+    EphyHistoryURL *url = g_ptr_array_index (changes->visited_urls, i);
+
+    g_assert_cmpstr (url->url, ==, "http://www.gnome.org/");
+    data->visit_count = url->visit_count;
+  }
+
+  for (i = 0; i < changes->retitled_urls->len; i++) {
+    EphyHistoryURL *url = g_ptr_array_index (changes->retitled_urls, i);
+
+    g_free (data->title);
+    data->title = g_strdup (url->title);
+  }
+
+  if (data->visit_count == 3 && data->title) {
+    g_object_unref (service);
+    gtk_main_quit ();
+  }
+}
+
+static void
+test_changes (void)
+{
+  gchar *temporary_file = g_build_filename (g_get_tmp_dir (), "epiphany-history-test.db", NULL);
+  EphyHistoryService *service = ensure_empty_history (temporary_file);
+  ChangesData data = { 0, 0, NULL };
+  int i;
+
+  g_signal_connect (service, "changed",
+                    G_CALLBACK (history_changed_cb), &data);
+
+  for (i = 0; i < 3; i++) {
+    EphyHistoryPageVisit *visit = ephy_history_page_visit_new ("http://www.gnome.org/", i, EPHY_PAGE_VISIT_TYPED);
+
+    ephy_history_service_add_visit (service, visit, NULL, NULL, NULL);
+    ephy_history_page_visit_free (visit);
+  }
+  ephy_history_service_set_url_title (service, "http://www.gnome.org/", "GNOME", NULL, NULL, NULL);
+  g_free (temporary_file);
+
+  gtk_main ();
+
+  /* Four changes, announced in fewer emissions. */
+  g_assert_cmpuint (data.n_emissions, <, 4);
+  g_assert_cmpstr (data.title, ==, "GNOME");
+  g_free (data.title);
+}
+
+static void
+zoom_levels_cleared_cb (EphyHistoryService *service,
+                        gboolean success,
+                        gpointer result_data,
+                        gpointer user_data)
+{
+  double zoom_level;
+
+  g_assert (success == TRUE);
+
+  /* The cache is dropped before anybody hears about the clear. */
+  g_assert (!ephy_history_service_get_cached_zoom_level (service, "http://www.gnome.org/", &zoom_level));
+
+  g_object_unref (service);
+  gtk_main_quit ();
+}
+
+static gboolean
+zoom_levels_are_loaded (EphyHistoryService *service)
+{
+  double zoom_level;
+
+  return ephy_history_service_get_cached_zoom_level (service, "http://www.gnome.org/about", &zoom_level);
+}
+
+static void
+check_cached_zoom_levels (EphyHistoryService *service)
+{
+  double zoom_level;
+
+  ephy_test_utils_wait_for_condition ((EphyTestUtilsConditionFunc)zoom_levels_are_loaded, service);
+
+  /* Hosts match regardless of the scheme and of the "www." prefix. */
+  g_assert (ephy_history_service_get_cached_zoom_level (service, "http://www.gnome.org/about", &zoom_level));
+  g_assert_cmpfloat (zoom_level, ==, 1.5);
+  g_assert (ephy_history_service_get_cached_zoom_level (service, "https://gnome.org/", &zoom_level));
+  g_assert_cmpfloat (zoom_level, ==, 1.5);
+  g_assert (ephy_history_service_get_cached_zoom_level (service, "http://www.igalia.com/", &zoom_level));
+  g_assert_cmpfloat (zoom_level, ==, 1.0);
+
+  /* Zoom levels are written through to the cache. */
+  ephy_history_service_set_url_zoom_level (service, "http://www.igalia.com/", 0.8, NULL, NULL, NULL);
+  g_assert (ephy_history_service_get_cached_zoom_level (service, "http://igalia.com/", &zoom_level));
+  g_assert_cmpfloat (zoom_level, ==, 0.8);
+
+  /* Other schemes are not cached. */
+  g_assert (!ephy_history_service_get_cached_zoom_level (service, "file:///tmp/", &zoom_level));
+
+  ephy_history_service_clear (service, NULL, zoom_levels_cleared_cb, NULL);
+}
+
+static void
+zoom_level_set_cb (EphyHistoryService *service,
+                   gboolean success,
+                   gpointer result_data,
+                   gpointer user_data)
+{
+  double zoom_level;
+
+  g_assert (success == TRUE);
+
+  /* The first lookup only starts loading the zoom levels. */
+  g_assert (!ephy_history_service_get_cached_zoom_level (service, "http://www.gnome.org/", &zoom_level));
+  check_cached_zoom_levels (service);
+}
+
+static void
+test_cached_zoom_level (void)
+{
+  gchar *temporary_file = g_build_filename (g_get_tmp_dir (), "epiphany-history-test.db", NULL);
+  EphyHistoryService *service = ensure_empty_history (temporary_file);
+
+  ephy_history_service_set_url_zoom_level (service, "http://www.gnome.org/", 1.5, NULL, zoom_level_set_cb, NULL);
+  g_free (temporary_file);
+
+  gtk_main ();
+}
+
+static void
+verify_visits_after_compaction (EphyHistoryService *service,
+                                gboolean success,
+                                gpointer result_data,
+                                gpointer user_data)
+{
+  GList *visits = (GList*)result_data;
+
+  /* Every visit was older than the retention age. */
+  g_assert (success);
+  g_assert_cmpint (g_list_length (visits), ==, 0);
+
+  g_object_unref (service);
+  gtk_main_quit ();
+}
+
+static void
+verify_urls_after_compaction (EphyHistoryService *service,
+                              gboolean success,
+                              gpointer result_data,
+                              gpointer user_data)
+{
+  GList *urls = (GList*)result_data;
+  EphyHistoryURL *url;
+  EphyHistoryQuery *query;
+
+  /* The URLs outlive their visits, with their aggregates. */
+  g_assert (success);
+  g_assert_cmpint (g_list_length (urls), ==, 5);
+
+  url = (EphyHistoryURL *)urls->data;
+  g_assert_cmpstr (url->url, ==, "http://www.wikipedia.org");
+  g_assert_cmpint (url->visit_count, ==, 30);
+  g_assert_cmpint (url->last_visit_time, ==, 290);
+
+  url = (EphyHistoryURL *)g_list_last (urls)->data;
+  g_assert_cmpstr (url->url, ==, "http://www.webkitgtk.org");
+  g_assert_cmpint (url->visit_count, ==, 2);
+
+  g_list_free_full (urls, (GDestroyNotify)ephy_history_url_free);
+
+  query = ephy_history_query_new ();
+  ephy_history_service_query_visits (service, query, NULL, verify_visits_after_compaction, NULL);
+  ephy_history_query_free (query);
+}
+
+static void
+history_compacted_cb (EphyHistoryService *service,
+                      gint64 size_before,
+                      gint64 size_after,
+                      gpointer user_data)
+{
+  EphyHistoryQuery *query;
+
+  g_assert_cmpint (size_before, >, 0);
+  g_assert_cmpint (size_after, >, 0);
+
+  query = ephy_history_query_new ();
+  query->sort_type = EPHY_HISTORY_SORT_MV;
+  ephy_history_service_query_urls (service, query, NULL, verify_urls_after_compaction, NULL);
+  ephy_history_query_free (query);
+}
+
+static void
+history_urls_deleted_cb (EphyHistoryService *service,
+                         char **urls,
+                         gpointer user_data)
+{
+  /* Expiring visits does not delete visited URLs. */
+  g_assert_not_reached ();
+}
+
+static void
+test_retention_policy (void)
+{
+  gchar *temporary_file = g_build_filename (g_get_tmp_dir (), "epiphany-history-test.db", NULL);
+  EphyHistoryService *service = ensure_empty_history (temporary_file);
+  GList *visits = create_visits_for_complex_tests ();
+
+  g_signal_connect (service, "compacted",
+                    G_CALLBACK (history_compacted_cb), NULL);
+  g_signal_connect (service, "urls-deleted",
+                    G_CALLBACK (history_urls_deleted_cb), NULL);
+
+  /* Do not wait for the usual idle period before expiring visits. */
+  ephy_history_service_set_retention_idle_delay (service, G_USEC_PER_SEC / 100);
+
+  ephy_history_service_add_visits (service, visits, NULL, NULL, NULL);
+  ephy_history_service_set_retention_policy (service, 1, 0);
+  ephy_history_page_visit_list_free (visits);
+  g_free (temporary_file);
+
+  gtk_main ();
+}
+
+#define LEGACY_HISTORY_N_HOSTS 50
+
+static char *
+create_legacy_history_file (guint n_entries)
+{
+  GFileOutputStream *output;
+  GFile *file;
+  GString *node;
+  char *filename;
+  guint i;
+
+  filename = g_build_filename (g_get_tmp_dir (), "epiphany-legacy-history.xml", NULL);
+  file = g_file_new_for_path (filename);
+  output = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL);
+  g_assert (output);
+  g_object_unref (file);
+
+  node = g_string_new ("<?xml version=\"1.0\"?>\n<ephy_history version=\"1.0\">\n");
+
+  for (i = 0; i < n_entries; i++) {
+    g_string_append_printf (node,
+                            "  <node id=\"%u\">\n"
+                            "    <property id=\"2\" value_type=\"gchararray\">Page %u</property>\n"
+                            "    <property id=\"3\" value_type=\"gchararray\">http://host%u.example.com/page/%u</property>\n"
+                            "    <property id=\"4\" value_type=\"gint\">1</property>\n"
+                            "    <property id=\"5\" value_type=\"gint\">%u</property>\n"
+                            "    <property id=\"6\" value_type=\"gint\">%u</property>\n",
+                            i + 1, i, i % LEGACY_HISTORY_N_HOSTS, i, 1000 + i, 1000 + i);
+    if (i == 0)
+      g_string_append (node, "    <property id=\"10\" value_type=\"gfloat\">1.5</property>\n");
+    g_string_append (node, "  </node>\n");
+
+    if (node->len > 65536) {
+      g_assert (g_output_stream_write_all (G_OUTPUT_STREAM (output), node->str, node->len, NULL, NULL, NULL));
+      g_string_truncate (node, 0);
+    }
+  }
+
+  g_string_append (node, "</ephy_history>\n");
+  g_assert (g_output_stream_write_all (G_OUTPUT_STREAM (output), node->str, node->len, NULL, NULL, NULL));
+  g_string_free (node, TRUE);
+
+  g_assert (g_output_stream_close (G_OUTPUT_STREAM (output), NULL, NULL));
+  g_object_unref (output);
+
+  return filename;
+}
+
+typedef struct {
+  guint n_entries;
+  guint n_progress;
+  goffset last_progress;
+  goffset total;
+} LegacyImportData;
+
+static void
+legacy_import_progress_cb (goffset current_num_bytes,
+                           goffset total_num_bytes,
+                           gpointer user_data)
+{
+  LegacyImportData *data = user_data;
+
+  g_assert_cmpint (current_num_bytes, >, data->last_progress);
+  g_assert_cmpint (current_num_bytes, <=, total_num_bytes);
+
+  data->n_progress++;
+  data->last_progress = current_num_bytes;
+  data->total = total_num_bytes;
+}
+
+static void
+verify_legacy_import_hosts (EphyHistoryService *service,
+                            gboolean success,
+                            gpointer result_data,
+                            gpointer user_data)
+{
+  LegacyImportData *data = user_data;
+  GList *hosts = (GList *) result_data, *l;
+  int visit_count = 0;
+  gboolean found_zoom = FALSE;
+
+  g_assert (success);
+  g_assert_cmpint (g_list_length (hosts), ==, LEGACY_HISTORY_N_HOSTS);
+
+  for (l = hosts; l; l = l->next) {
+    EphyHistoryHost *host = (EphyHistoryHost *) l->data;
+
+    visit_count += host->visit_count;
+    if (host->zoom_level == 1.5) {
+      g_assert_cmpstr (host->url, ==, "http://host0.example.com/");
+      found_zoom = TRUE;
+    }
+  }
+
+  g_assert_cmpint (visit_count, ==, data->n_entries);
+  g_assert (found_zoom);
+
+  g_object_unref (service);
+  gtk_main_quit ();
+}
+
+static void
+verify_legacy_import_urls (EphyHistoryService *service,
+                           gboolean success,
+                           gpointer result_data,
+                           gpointer user_data)
+{
+  GList *urls = (GList *) result_data;
+  LegacyImportData *data = user_data;
+
+  g_assert (success);
+  g_assert_cmpint (g_list_length (urls), ==, data->n_entries);
+
+  ephy_history_service_get_hosts (service, NULL, verify_legacy_import_hosts, data);
+}
+
+static void
+test_import_legacy_history (void)
+{
+  gchar *temporary_file = g_build_filename (g_get_tmp_dir (), "epiphany-history-test.db", NULL);
+  EphyHistoryService *service = ensure_empty_history (temporary_file);
+  EphyHistoryQuery *query;
+  LegacyImportData data;
+  GError *error = NULL;
+  char *filename;
+  gboolean ret;
+
+  /* The full size run takes a while, keep it for -m perf. */
+  memset (&data, 0, sizeof (LegacyImportData));
+  data.n_entries = g_test_perf () ? 500000 : 5000;
+
+  filename = create_legacy_history_file (data.n_entries);
+
+  g_test_timer_start ();
+  ret = ephy_history_import_legacy_file (service, filename,
+                                         legacy_import_progress_cb, &data,
+                                         &error);
+  g_test_minimized_result (g_test_timer_elapsed (), "Imported %u legacy history entries", data.n_entries);
+
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  /* Progress must be reported as the file is read, not only at the end. */
+  g_assert_cmpuint (data.n_progress, >, 1);
+  g_assert_cmpint (data.last_progress, ==, data.total);
+
+  g_unlink (filename);
+  g_free (filename);
+  g_free (temporary_file);
+
+  query = ephy_history_query_new ();
+  ephy_history_service_query_urls (service, query, NULL, verify_legacy_import_urls, &data);
+  ephy_history_query_free (query);
+
+  gtk_main ();
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -492,6 +967,11 @@ main (int argc, char *argv[])
   g_test_add_func ("/embed/history/test_complex_url_query", test_complex_url_query);
   g_test_add_func ("/embed/history/test_complex_url_query_with_time_range", test_complex_url_query_with_time_range);
   g_test_add_func ("/embed/history/test_clear", test_clear);
+  g_test_add_func ("/embed/history/test_delete_urls", test_delete_urls);
+  g_test_add_func ("/embed/history/test_changes", test_changes);
+  g_test_add_func ("/embed/history/test_cached_zoom_level", test_cached_zoom_level);
+  g_test_add_func ("/embed/history/test_retention_policy", test_retention_policy);
+  g_test_add_func ("/embed/history/test_import_legacy_history", test_import_legacy_history);
 
   return g_test_run ();
 }
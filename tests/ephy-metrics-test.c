@@ -0,0 +1,132 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * Copyright © 2013 Igalia S.L.
+ *
+ * Epiphany is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Epiphany is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Epiphany; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+#include "ephy-metrics.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <string.h>
+
+#define N_THREADS 4
+#define N_INCREMENTS 10000
+
+static gpointer
+increment_counter (EphyMetricsCounter *counter)
+{
+  int i;
+
+  for (i = 0; i < N_INCREMENTS; i++)
+    ephy_metrics_counter_add (counter, 1);
+
+  return NULL;
+}
+
+static void
+test_ephy_metrics_counter (void)
+{
+  EphyMetricsCounter *counter;
+  GThread *threads[N_THREADS];
+  int i;
+
+  counter = ephy_metrics_counter_get ("test.counter.threads");
+  g_assert (counter == ephy_metrics_counter_get ("test.counter.threads"));
+
+  for (i = 0; i < N_THREADS; i++)
+    threads[i] = g_thread_new ("increment", (GThreadFunc)increment_counter, counter);
+  for (i = 0; i < N_THREADS; i++)
+    g_thread_join (threads[i]);
+
+  g_assert_cmpint (ephy_metrics_counter_get_value (counter), ==, N_THREADS * N_INCREMENTS);
+
+  ephy_metrics_counter_set (counter, 3);
+  g_assert_cmpint (ephy_metrics_counter_get_value (counter), ==, 3);
+}
+
+/* Returns the JSON of the histogram called @name in @json, which only
+ * lives until @json is freed. */
+static char *
+find_histogram_json (char *json,
+                     const char *name)
+{
+  char *key;
+  char *start;
+  char *end;
+
+  key = g_strdup_printf ("\"%s\":{", name);
+  start = strstr (json, key);
+  g_free (key);
+  g_assert (start != NULL);
+
+  end = strstr (start, "]}");
+  g_assert (end != NULL);
+  end[2] = '\0';
+
+  return start;
+}
+
+static void
+test_ephy_metrics_histogram (void)
+{
+  EphyMetricsCounter *counter;
+  EphyMetricsHistogram *histogram;
+  char *json;
+  char *histogram_json;
+
+  /* Metrics live for the whole process, so the names are not shared
+   * with other tests. */
+  counter = ephy_metrics_counter_get ("test.histogram.counter");
+  ephy_metrics_counter_add (counter, 3);
+
+  histogram = ephy_metrics_histogram_get ("test.histogram.latency");
+  ephy_metrics_histogram_add (histogram, 50);
+  ephy_metrics_histogram_add (histogram, 3000);
+  ephy_metrics_histogram_add (histogram, G_USEC_PER_SEC * 10);
+  g_assert_cmpuint (ephy_metrics_histogram_get_count (histogram), ==, 3);
+
+  json = ephy_metrics_to_json ();
+  g_assert (strstr (json, "\"test.histogram.counter\":3") != NULL);
+
+  histogram_json = find_histogram_json (json, "test.histogram.latency");
+  g_assert (g_str_has_prefix (histogram_json,
+                              "\"test.histogram.latency\":{\"count\":3,\"total\":10003050,\"max\":10000000,"));
+  /* One sample in the first bucket, one under 5 ms and one in the last. */
+  g_assert (strstr (histogram_json, "{\"le\":100,\"count\":1}") != NULL);
+  g_assert (strstr (histogram_json, "{\"le\":5000,\"count\":1}") != NULL);
+  g_assert (strstr (histogram_json, "{\"le\":null,\"count\":1}") != NULL);
+  g_free (json);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean ret;
+
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/lib/ephy-metrics/counter",
+                   test_ephy_metrics_counter);
+  g_test_add_func ("/lib/ephy-metrics/histogram",
+                   test_ephy_metrics_histogram);
+
+  ret = g_test_run ();
+
+  return ret;
+}
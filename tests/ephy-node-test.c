@@ -0,0 +1,358 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * Copyright © 2013 Igalia S.L.
+ *
+ * Epiphany is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Epiphany is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Epiphany; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+#include "ephy-node.h"
+#include "ephy-node-db.h"
+#include "ephy-node-filter.h"
+#include "ephy-node-view-private.h"
+#include "ephy-test-utils.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <string.h>
+
+#define PROP_TITLE 2
+#define N_SORT_NODES 20000
+#define N_VIEW_NODES 5000
+
+static void
+test_ephy_node_collate_key (void)
+{
+  EphyNodeDb *db;
+  EphyNode *a, *b;
+  char *expected;
+
+  db = ephy_node_db_new ("TestCollateKey");
+  a = ephy_node_new (db);
+  b = ephy_node_new (db);
+
+  g_assert (ephy_node_get_property_casefold (a, PROP_TITLE) == NULL);
+  g_assert (ephy_node_get_property_collate_key (a, PROP_TITLE) == NULL);
+
+  ephy_node_set_property_string (a, PROP_TITLE, "GNOME Web");
+  ephy_node_set_property_string (b, PROP_TITLE, "epiphany");
+
+  g_assert_cmpstr (ephy_node_get_property_casefold (a, PROP_TITLE), ==, "gnome web");
+
+  expected = g_utf8_collate_key ("gnome web", -1);
+  g_assert_cmpstr (ephy_node_get_property_collate_key (a, PROP_TITLE), ==, expected);
+  g_free (expected);
+
+  g_assert_cmpint (strcmp (ephy_node_get_property_collate_key (b, PROP_TITLE),
+                           ephy_node_get_property_collate_key (a, PROP_TITLE)), <, 0);
+
+  /* Changing the property drops the cached keys. */
+  ephy_node_set_property_string (a, PROP_TITLE, "Alpha");
+  g_assert_cmpstr (ephy_node_get_property_casefold (a, PROP_TITLE), ==, "alpha");
+  g_assert_cmpint (strcmp (ephy_node_get_property_collate_key (a, PROP_TITLE),
+                           ephy_node_get_property_collate_key (b, PROP_TITLE)), <, 0);
+
+  ephy_node_unref (a);
+  ephy_node_unref (b);
+  g_object_unref (db);
+}
+
+static void
+set_search (EphyNodeFilter *filter,
+            const char *search)
+{
+  ephy_node_filter_empty (filter);
+  ephy_node_filter_add_expression (filter,
+                                   ephy_node_filter_expression_new (EPHY_NODE_FILTER_EXPRESSION_STRING_PROP_CONTAINS,
+                                                                    PROP_TITLE, search),
+                                   0);
+  ephy_node_filter_done_changing (filter);
+}
+
+static void
+test_ephy_node_filter_change (void)
+{
+  EphyNodeDb *db;
+  EphyNode *parent;
+  EphyNodeFilter *filter;
+
+  db = ephy_node_db_new ("TestFilterChange");
+  parent = ephy_node_new (db);
+  filter = ephy_node_filter_new ();
+
+  /* An empty filter matches everything. */
+  set_search (filter, "epi");
+  g_assert_cmpint (ephy_node_filter_get_last_change (filter), ==, EPHY_NODE_FILTER_CHANGE_REFINED);
+
+  set_search (filter, "epiph");
+  g_assert_cmpint (ephy_node_filter_get_last_change (filter), ==, EPHY_NODE_FILTER_CHANGE_REFINED);
+
+  set_search (filter, "ep");
+  g_assert_cmpint (ephy_node_filter_get_last_change (filter), ==, EPHY_NODE_FILTER_CHANGE_RELAXED);
+
+  set_search (filter, "web");
+  g_assert_cmpint (ephy_node_filter_get_last_change (filter), ==, EPHY_NODE_FILTER_CHANGE_ANY);
+
+  ephy_node_filter_empty (filter);
+  ephy_node_filter_add_expression (filter,
+                                   ephy_node_filter_expression_new (EPHY_NODE_FILTER_EXPRESSION_HAS_PARENT,
+                                                                    parent),
+                                   0);
+  ephy_node_filter_done_changing (filter);
+  g_assert_cmpint (ephy_node_filter_get_last_change (filter), ==, EPHY_NODE_FILTER_CHANGE_ANY);
+
+  ephy_node_filter_empty (filter);
+  ephy_node_filter_done_changing (filter);
+  g_assert_cmpint (ephy_node_filter_get_last_change (filter), ==, EPHY_NODE_FILTER_CHANGE_RELAXED);
+
+  g_object_unref (filter);
+  ephy_node_unref (parent);
+  g_object_unref (db);
+}
+
+static gboolean
+node_view_is_idle (EphyNodeView *view)
+{
+  return !ephy_node_view_is_refiltering (view);
+}
+
+static void
+wait_for_refilter (EphyNodeView *view)
+{
+  ephy_test_utils_wait_for_condition ((EphyTestUtilsConditionFunc)node_view_is_idle, view);
+}
+
+/* Checks that the rows of @view are exactly the children of @root
+ * that @filter matches. */
+static void
+assert_visible_rows (EphyNodeView *view,
+                     EphyNode *root,
+                     EphyNodeFilter *filter)
+{
+  GtkTreeSelection *selection;
+  GHashTable *visible;
+  GPtrArray *children;
+  GList *rows, *l;
+  guint n_matching = 0;
+  guint i;
+
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (view));
+  gtk_tree_selection_select_all (selection);
+  rows = ephy_node_view_get_selection (view);
+  gtk_tree_selection_unselect_all (selection);
+
+  visible = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (l = rows; l; l = l->next)
+    g_hash_table_insert (visible, l->data, l->data);
+
+  children = ephy_node_get_children (root);
+  for (i = 0; i < children->len; i++) {
+    EphyNode *node = g_ptr_array_index (children, i);
+    gboolean matches = ephy_node_filter_evaluate (filter, node);
+
+    g_assert_cmpint (g_hash_table_lookup (visible, node) != NULL, ==, matches);
+    if (matches)
+      n_matching++;
+  }
+  g_assert_cmpuint (g_list_length (rows), ==, n_matching);
+
+  g_hash_table_destroy (visible);
+  g_list_free (rows);
+}
+
+static void
+test_ephy_node_view_refilter (void)
+{
+  static const char *words[] = { "epiphany", "web browser", "gnome" };
+  EphyNodeDb *db;
+  EphyNode *root;
+  EphyNodeFilter *filter;
+  GtkWidget *view;
+  GPtrArray *nodes;
+  EphyNode *node;
+  guint i;
+
+  db = ephy_node_db_new ("TestNodeViewRefilter");
+  root = ephy_node_new (db);
+  filter = ephy_node_filter_new ();
+  nodes = g_ptr_array_new ();
+
+  view = ephy_node_view_new (root, filter);
+  g_object_ref_sink (view);
+  gtk_tree_selection_set_mode (gtk_tree_view_get_selection (GTK_TREE_VIEW (view)),
+                               GTK_SELECTION_MULTIPLE);
+
+  for (i = 0; i < N_VIEW_NODES; i++) {
+    char *title;
+
+    node = ephy_node_new (db);
+    title = g_strdup_printf ("%s %u", words[i % G_N_ELEMENTS (words)], i);
+    ephy_node_set_property_string (node, PROP_TITLE, title);
+    g_free (title);
+
+    ephy_node_add_child (root, node);
+    g_ptr_array_add (nodes, node);
+  }
+
+  /* An empty filter shows everything. */
+  assert_visible_rows (EPHY_NODE_VIEW (view), root, filter);
+
+  /* Rows are hidden from an idle callback. */
+  set_search (filter, "epi");
+  g_assert (ephy_node_view_is_refiltering (EPHY_NODE_VIEW (view)));
+  wait_for_refilter (EPHY_NODE_VIEW (view));
+  assert_visible_rows (EPHY_NODE_VIEW (view), root, filter);
+
+  /* Removing rows in the middle of a pass, both before and after the
+   * one being checked, does not make it skip or repeat any. */
+  set_search (filter, "e");
+  g_main_context_iteration (NULL, FALSE);
+
+  node = g_ptr_array_index (nodes, 1);
+  ephy_node_remove_child (root, node);
+  node = g_ptr_array_index (nodes, N_VIEW_NODES - 3);
+  ephy_node_remove_child (root, node);
+
+  wait_for_refilter (EPHY_NODE_VIEW (view));
+  assert_visible_rows (EPHY_NODE_VIEW (view), root, filter);
+
+  /* A change while a pass is pending starts it over. */
+  set_search (filter, "web");
+  set_search (filter, "gno");
+  wait_for_refilter (EPHY_NODE_VIEW (view));
+  assert_visible_rows (EPHY_NODE_VIEW (view), root, filter);
+
+  ephy_node_filter_empty (filter);
+  ephy_node_filter_done_changing (filter);
+  wait_for_refilter (EPHY_NODE_VIEW (view));
+  assert_visible_rows (EPHY_NODE_VIEW (view), root, filter);
+
+  gtk_widget_destroy (view);
+  g_object_unref (view);
+
+  for (i = 0; i < nodes->len; i++)
+    ephy_node_unref (g_ptr_array_index (nodes, i));
+  g_ptr_array_free (nodes, TRUE);
+  g_object_unref (filter);
+  ephy_node_unref (root);
+  g_object_unref (db);
+}
+
+static int
+compare_casefold_collate (gconstpointer a,
+                          gconstpointer b)
+{
+  EphyNode *node_a = *(EphyNode **)a;
+  EphyNode *node_b = *(EphyNode **)b;
+  char *str_a, *str_b;
+  int retval;
+
+  str_a = g_utf8_casefold (ephy_node_get_property_string (node_a, PROP_TITLE), -1);
+  str_b = g_utf8_casefold (ephy_node_get_property_string (node_b, PROP_TITLE), -1);
+  retval = g_utf8_collate (str_a, str_b);
+  g_free (str_a);
+  g_free (str_b);
+
+  return retval;
+}
+
+static int
+compare_collate_keys (gconstpointer a,
+                      gconstpointer b)
+{
+  EphyNode *node_a = *(EphyNode **)a;
+  EphyNode *node_b = *(EphyNode **)b;
+
+  return strcmp (ephy_node_get_property_collate_key (node_a, PROP_TITLE),
+                 ephy_node_get_property_collate_key (node_b, PROP_TITLE));
+}
+
+static void
+test_ephy_node_sort_perf (void)
+{
+  EphyNodeDb *db;
+  GPtrArray *nodes;
+  GTimer *timer;
+  double uncached, cached;
+  guint i;
+
+  db = ephy_node_db_new ("TestSortPerf");
+  nodes = g_ptr_array_new ();
+
+  for (i = 0; i < N_SORT_NODES; i++) {
+    EphyNode *node;
+    char *title;
+
+    node = ephy_node_new (db);
+    title = g_strdup_printf ("Bookmark Title %08X Über", g_random_int ());
+    ephy_node_set_property_string (node, PROP_TITLE, title);
+    g_free (title);
+
+    g_ptr_array_add (nodes, node);
+  }
+
+  timer = g_timer_new ();
+
+  g_ptr_array_sort (nodes, compare_casefold_collate);
+  uncached = g_timer_elapsed (timer, NULL);
+
+  /* Shuffle before sorting again, so both runs do the same work. */
+  for (i = nodes->len - 1; i > 0; i--) {
+    guint j = g_random_int_range (0, i + 1);
+    gpointer tmp = nodes->pdata[i];
+
+    nodes->pdata[i] = nodes->pdata[j];
+    nodes->pdata[j] = tmp;
+  }
+
+  g_timer_start (timer);
+  g_ptr_array_sort (nodes, compare_collate_keys);
+  cached = g_timer_elapsed (timer, NULL);
+
+  g_test_minimized_result (cached,
+                           "Sorted %u nodes in %f seconds with collation keys, "
+                           "%f seconds collating every comparison",
+                           N_SORT_NODES, cached, uncached);
+
+  g_timer_destroy (timer);
+  for (i = 0; i < nodes->len; i++)
+    ephy_node_unref (g_ptr_array_index (nodes, i));
+  g_ptr_array_free (nodes, TRUE);
+  g_object_unref (db);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean ret;
+
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/lib/ephy-node/collate_key",
+                   test_ephy_node_collate_key);
+  g_test_add_func ("/lib/ephy-node/filter_change",
+                   test_ephy_node_filter_change);
+  g_test_add_func ("/lib/ephy-node-view/refilter",
+                   test_ephy_node_view_refilter);
+
+  if (g_test_perf ())
+    g_test_add_func ("/lib/ephy-node/sort_perf",
+                     test_ephy_node_sort_perf);
+
+  ret = g_test_run ();
+
+  return ret;
+}
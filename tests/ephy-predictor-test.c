@@ -0,0 +1,219 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * Copyright © 2013 Igalia S.L.
+ *
+ * Epiphany is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Epiphany is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Epiphany; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+#include "ephy-predictor.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+static void
+load_page (EphyPredictor *predictor,
+           const char *from,
+           const char *to)
+{
+  ephy_predictor_take_prefetched (predictor, to);
+  ephy_predictor_learn_navigation (predictor, from, to);
+  ephy_predictor_learn_subresource (predictor, to, "http://cdn.example.net/style.css");
+  ephy_predictor_learn_subresource (predictor, to, "http://cdn.example.net/script.js");
+}
+
+static void
+test_ephy_predictor_predict (void)
+{
+  EphyPredictor *predictor;
+  guint n_prefetches, n_hits, n_misses;
+
+  predictor = ephy_predictor_new (NULL);
+
+  /* Nothing is known about the host yet, so only it is prefetched. */
+  ephy_predictor_predict (predictor, "http://www.example.com/");
+  ephy_predictor_get_stats (predictor, &n_prefetches, &n_hits, &n_misses);
+  g_assert_cmpuint (n_prefetches, ==, 1);
+  g_assert_cmpuint (n_hits, ==, 0);
+
+  g_assert (ephy_predictor_take_prefetched (predictor, "http://www.example.com/page"));
+  g_assert (!ephy_predictor_take_prefetched (predictor, "http://www.example.com/page"));
+
+  load_page (predictor, NULL, "http://www.example.com/");
+  load_page (predictor, "http://www.example.com/", "http://www.example.org/");
+
+  /* The CDN both pages load from is prefetched along with the host,
+   * and counts as a hit once the page uses it. */
+  ephy_predictor_predict (predictor, "http://www.example.com/news");
+  ephy_predictor_get_stats (predictor, &n_prefetches, &n_hits, &n_misses);
+  g_assert_cmpuint (n_prefetches, ==, 3);
+  g_assert_cmpuint (n_hits, ==, 1);
+
+  ephy_predictor_learn_subresource (predictor, "http://www.example.com/news",
+                                    "http://cdn.example.net/style.css");
+  ephy_predictor_get_stats (predictor, &n_prefetches, &n_hits, &n_misses);
+  g_assert_cmpuint (n_hits, ==, 2);
+  g_assert_cmpuint (n_misses, ==, 0);
+
+  /* Nothing is predicted for hosts that are not HTTP. */
+  ephy_predictor_predict (predictor, "file:///tmp/");
+  ephy_predictor_predict (predictor, "about:blank");
+  ephy_predictor_get_stats (predictor, &n_prefetches, NULL, NULL);
+  g_assert_cmpuint (n_prefetches, ==, 3);
+
+  g_object_unref (predictor);
+}
+
+static void
+test_ephy_predictor_clear (void)
+{
+  EphyPredictor *predictor;
+  guint n_prefetches;
+
+  predictor = ephy_predictor_new (NULL);
+
+  load_page (predictor, NULL, "http://www.example.com/");
+  ephy_predictor_clear (predictor);
+
+  /* Only the host itself, the CDN was forgotten. */
+  ephy_predictor_predict (predictor, "http://www.example.com/");
+  ephy_predictor_get_stats (predictor, &n_prefetches, NULL, NULL);
+  g_assert_cmpuint (n_prefetches, ==, 1);
+
+  g_object_unref (predictor);
+}
+
+static void
+test_ephy_predictor_forget_host (void)
+{
+  EphyPredictor *predictor;
+  guint n_prefetches, n_before;
+
+  predictor = ephy_predictor_new (NULL);
+
+  load_page (predictor, NULL, "http://www.example.com/");
+  load_page (predictor, NULL, "http://www.example.org/");
+
+  /* Other hosts keep what was learned about them. */
+  ephy_predictor_forget_host (predictor, "www.example.com");
+
+  ephy_predictor_get_stats (predictor, &n_before, NULL, NULL);
+  ephy_predictor_predict (predictor, "http://www.example.org/");
+  ephy_predictor_get_stats (predictor, &n_prefetches, NULL, NULL);
+  g_assert_cmpuint (n_prefetches, ==, n_before + 2);
+
+  n_before = n_prefetches;
+  ephy_predictor_predict (predictor, "http://www.example.com/");
+  ephy_predictor_get_stats (predictor, &n_prefetches, NULL, NULL);
+  g_assert_cmpuint (n_prefetches, ==, n_before + 1);
+  g_object_unref (predictor);
+
+  /* Forgetting a host also drops it as a target of other hosts. */
+  predictor = ephy_predictor_new (NULL);
+  load_page (predictor, NULL, "http://www.example.org/");
+  ephy_predictor_forget_host (predictor, "cdn.example.net");
+
+  ephy_predictor_predict (predictor, "http://www.example.org/");
+  ephy_predictor_get_stats (predictor, &n_prefetches, NULL, NULL);
+  g_assert_cmpuint (n_prefetches, ==, 1);
+
+  g_object_unref (predictor);
+}
+
+static void
+test_ephy_predictor_predict_keeps_origins (void)
+{
+  EphyPredictor *predictor;
+  guint n_prefetches, n_before;
+  guint i;
+
+  predictor = ephy_predictor_new (NULL);
+
+  load_page (predictor, NULL, "http://www.example.com/");
+
+  /* Hovering or typing many hosts does not push out the ones that
+   * were visited. */
+  for (i = 0; i < 1000; i++) {
+    char *uri = g_strdup_printf ("http://host%u.example.net/", i);
+
+    ephy_predictor_predict (predictor, uri);
+    g_free (uri);
+  }
+
+  ephy_predictor_get_stats (predictor, &n_before, NULL, NULL);
+  ephy_predictor_predict (predictor, "http://www.example.com/");
+  ephy_predictor_get_stats (predictor, &n_prefetches, NULL, NULL);
+  g_assert_cmpuint (n_prefetches, ==, n_before + 2);
+
+  g_object_unref (predictor);
+}
+
+static void
+test_ephy_predictor_transient_budget (void)
+{
+  EphyPredictor *predictor;
+  guint n_prefetches, n_before;
+  guint i;
+
+  predictor = ephy_predictor_new (NULL);
+
+  load_page (predictor, NULL, "http://www.example.com/");
+
+  /* Hosts that were never visited get more prefetches than a single
+   * visited host, but not an unlimited number. */
+  ephy_predictor_get_stats (predictor, &n_before, NULL, NULL);
+  for (i = 0; i < 100; i++) {
+    char *uri = g_strdup_printf ("http://host%u.example.net/", i);
+
+    ephy_predictor_predict (predictor, uri);
+    g_free (uri);
+  }
+
+  ephy_predictor_get_stats (predictor, &n_prefetches, NULL, NULL);
+  g_assert_cmpuint (n_prefetches - n_before, >, 8);
+  g_assert_cmpuint (n_prefetches - n_before, <, 100);
+
+  /* Their budget is not the one of the visited hosts. */
+  n_before = n_prefetches;
+  ephy_predictor_predict (predictor, "http://www.example.com/");
+  ephy_predictor_get_stats (predictor, &n_prefetches, NULL, NULL);
+  g_assert_cmpuint (n_prefetches, ==, n_before + 2);
+
+  g_object_unref (predictor);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean ret;
+
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/embed/ephy-predictor/predict",
+                   test_ephy_predictor_predict);
+  g_test_add_func ("/embed/ephy-predictor/clear",
+                   test_ephy_predictor_clear);
+  g_test_add_func ("/embed/ephy-predictor/forget_host",
+                   test_ephy_predictor_forget_host);
+  g_test_add_func ("/embed/ephy-predictor/predict_keeps_origins",
+                   test_ephy_predictor_predict_keeps_origins);
+  g_test_add_func ("/embed/ephy-predictor/transient_budget",
+                   test_ephy_predictor_transient_budget);
+
+  ret = g_test_run ();
+
+  return ret;
+}
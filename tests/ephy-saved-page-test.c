@@ -0,0 +1,241 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * Copyright © 2013 Igalia S.L.
+ *
+ * Epiphany is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Epiphany is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Epiphany; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+#include "ephy-saved-page.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <string.h>
+
+#define DOCUMENT_URI "http://example.com/news/index.html"
+
+static void
+add_resource (EphySavedPage *page,
+              const char *uri,
+              const char *data,
+              const char *expected_name)
+{
+  char *name;
+
+  name = ephy_saved_page_add_resource (page, uri, data, strlen (data));
+  g_assert_cmpstr (name, ==, expected_name);
+  g_free (name);
+}
+
+static char *
+rewrite (EphySavedPage *page,
+         const char *document)
+{
+  char *result;
+  gsize length = 0;
+
+  result = ephy_saved_page_rewrite_document (page, document, strlen (document), &length);
+  if (result)
+    g_assert_cmpuint (length, ==, strlen (result));
+
+  return result;
+}
+
+static void
+test_ephy_saved_page_names (void)
+{
+  EphySavedPage *page;
+
+  page = ephy_saved_page_new (DOCUMENT_URI, "Page%20Files");
+
+  add_resource (page, "http://example.com/style.css", "a {}", "style.css");
+
+  /* The same URI is only saved once. */
+  add_resource (page, "http://example.com/style.css", "a {}", NULL);
+
+  /* Names that are taken get a numeric prefix. */
+  add_resource (page, "http://example.org/style.css", "b {}", "1-style.css");
+  add_resource (page, "http://example.net/style.css", "c {}", "2-style.css");
+  g_assert_cmpstr (ephy_saved_page_lookup (page, "http://example.com/style.css"), ==,
+                   "Page%20Files/style.css");
+  g_assert_cmpstr (ephy_saved_page_lookup (page, "http://example.net/style.css"), ==,
+                   "Page%20Files/2-style.css");
+
+  /* Names are escaped. */
+  add_resource (page, "http://example.com/a%20b.png", "png", "a%2520b.png");
+  ephy_saved_page_free (page);
+}
+
+static void
+test_ephy_saved_page_checksum (void)
+{
+  EphySavedPage *page;
+
+  page = ephy_saved_page_new (DOCUMENT_URI, "Files");
+
+  add_resource (page, "http://example.com/logo.png", "same data", "logo.png");
+
+  /* Identical data under another URI shares the file. */
+  add_resource (page, "http://cdn.example.com/logo-copy.png", "same data", NULL);
+  g_assert_cmpstr (ephy_saved_page_lookup (page, "http://cdn.example.com/logo-copy.png"), ==,
+                   "Files/logo.png");
+
+  add_resource (page, "http://example.com/other.png", "other data", "other.png");
+  g_assert_cmpstr (ephy_saved_page_lookup (page, "http://example.com/missing.png"), ==, NULL);
+
+  ephy_saved_page_free (page);
+}
+
+static void
+test_ephy_saved_page_rewrite_prefix (void)
+{
+  EphySavedPage *page;
+  char *result;
+
+  page = ephy_saved_page_new (DOCUMENT_URI, "Files");
+  add_resource (page, "http://example.com/a.js", "js", "a.js");
+  add_resource (page, "http://example.com/a.json", "json", "a.json");
+
+  /* A URI is never taken for the start of a longer one. */
+  result = rewrite (page,
+                    "<script src=\"http://example.com/a.js\"></script>"
+                    "<script src='http://example.com/a.json'></script>"
+                    "<a href=\"http://example.com/a.jsx\">");
+  g_assert_cmpstr (result, ==,
+                   "<script src=\"Files/a.js\"></script>"
+                   "<script src='Files/a.json'></script>"
+                   "<a href=\"http://example.com/a.jsx\">");
+  g_free (result);
+
+  result = rewrite (page, "<a href=\"http://example.com/a.js?v=2\">");
+  g_assert_cmpstr (result, ==, NULL);
+
+  ephy_saved_page_free (page);
+}
+
+static void
+test_ephy_saved_page_rewrite_values (void)
+{
+  EphySavedPage *page;
+  char *result;
+
+  page = ephy_saved_page_new (DOCUMENT_URI, "Files");
+  add_resource (page, "http://example.com/bg.png", "png", "bg.png");
+
+  /* Unquoted attribute and url() values. */
+  result = rewrite (page,
+                    "<img src=http://example.com/bg.png>"
+                    "<style>b { background: url( http://example.com/bg.png ) }</style>");
+  g_assert_cmpstr (result, ==,
+                   "<img src=Files/bg.png>"
+                   "<style>b { background: url( Files/bg.png ) }</style>");
+  g_free (result);
+
+  /* Apostrophes in the text do not hide the references around them. */
+  result = rewrite (page,
+                    "<p>don't</p><img src=\"http://example.com/bg.png\"><p>it's</p>");
+  g_assert_cmpstr (result, ==,
+                   "<p>don't</p><img src=\"Files/bg.png\"><p>it's</p>");
+  g_free (result);
+
+  ephy_saved_page_free (page);
+}
+
+static void
+test_ephy_saved_page_rewrite_relative (void)
+{
+  EphySavedPage *page;
+  char *result;
+
+  page = ephy_saved_page_new (DOCUMENT_URI, "Files");
+  add_resource (page, "http://example.com/news/img/a.png", "png", "a.png");
+  add_resource (page, "http://example.com/style.css", "css", "style.css");
+
+  /* Relative references resolve against the document, not next to
+   * the saved file. */
+  result = rewrite (page,
+                    "<img src=\"img/a.png\">"
+                    "<img src='./img/a.png'>"
+                    "<link href=../style.css>"
+                    "<style>b { background: url(/news/img/a.png) }</style>"
+                    "<img src=\"//example.com/news/img/a.png\">");
+  g_assert_cmpstr (result, ==,
+                   "<img src=\"Files/a.png\">"
+                   "<img src='Files/a.png'>"
+                   "<link href=Files/style.css>"
+                   "<style>b { background: url(Files/a.png) }</style>"
+                   "<img src=\"Files/a.png\">");
+  g_free (result);
+
+  /* Values resolving to other URIs, and text, are left alone. */
+  result = rewrite (page,
+                    "<img src=\"a.png\"><a href=\"img/a.png#top\">"
+                    "<p title=\"style.css\">");
+  g_assert_cmpstr (result, ==, NULL);
+
+  ephy_saved_page_free (page);
+}
+
+static void
+test_ephy_saved_page_rewrite_nul (void)
+{
+  EphySavedPage *page;
+  static const char document[] = "<img src=\"http://example.com/bg.png\">\0<img src=\"http://example.com/bg.png\">";
+  static const char expected[] = "<img src=\"Files/bg.png\">\0<img src=\"Files/bg.png\">";
+  char *result;
+  gsize length = 0;
+
+  page = ephy_saved_page_new (DOCUMENT_URI, "Files");
+  add_resource (page, "http://example.com/bg.png", "png", "bg.png");
+
+  /* The whole document is kept, even past a NUL byte. */
+  result = ephy_saved_page_rewrite_document (page, document, sizeof (document) - 1, &length);
+  g_assert_cmpuint (length, ==, sizeof (expected) - 1);
+  g_assert (memcmp (result, expected, length) == 0);
+  g_free (result);
+
+  ephy_saved_page_free (page);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean ret;
+
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/lib/ephy-saved-page/names",
+                   test_ephy_saved_page_names);
+
+  g_test_add_func ("/lib/ephy-saved-page/checksum",
+                   test_ephy_saved_page_checksum);
+
+  g_test_add_func ("/lib/ephy-saved-page/rewrite_prefix",
+                   test_ephy_saved_page_rewrite_prefix);
+
+  g_test_add_func ("/lib/ephy-saved-page/rewrite_values",
+                   test_ephy_saved_page_rewrite_values);
+
+  g_test_add_func ("/lib/ephy-saved-page/rewrite_relative",
+                   test_ephy_saved_page_rewrite_relative);
+
+  g_test_add_func ("/lib/ephy-saved-page/rewrite_nul",
+                   test_ephy_saved_page_rewrite_nul);
+
+  ret = g_test_run ();
+
+  return ret;
+}
@@ -30,7 +30,9 @@
 #include "ephy-embed-private.h"
 #include "ephy-embed-utils.h"
 #include "ephy-file-helpers.h"
+#include "ephy-prefs.h"
 #include "ephy-private.h"
+#include "ephy-settings.h"
 #include "ephy-shell.h"
 #include "ephy-test-utils.h"
 #include "ephy-window.h"
@@ -358,6 +360,145 @@ test_ephy_shell_tab_no_history (void)
 #endif
 }
 
+static gboolean
+bookmarks_are_loaded (EphyShell *shell)
+{
+  return ephy_shell_peek_bookmarks (shell) != NULL;
+}
+
+static void
+test_ephy_shell_deferred_startup (void)
+{
+  EphyShell *ephy_shell;
+  EphyEmbed *embed;
+  GtkWidget *window;
+  gint64 elapsed;
+
+  ephy_shell = ephy_shell_get_default ();
+
+  /* Must run before anything else shows a window. */
+  g_assert_cmpint (ephy_shell_get_time_to_first_window (ephy_shell), ==, -1);
+
+  embed = ephy_shell_new_tab (ephy_shell, NULL, NULL, NULL,
+                              EPHY_NEW_TAB_IN_NEW_WINDOW);
+  window = gtk_widget_get_toplevel (GTK_WIDGET (embed));
+  g_assert (EPHY_IS_WINDOW (window));
+
+  /* Building the window must not have loaded the bookmarks. */
+  g_assert (ephy_shell_peek_bookmarks (ephy_shell) == NULL);
+
+  ephy_test_utils_wait_for_condition ((EphyTestUtilsConditionFunc)bookmarks_are_loaded, ephy_shell);
+
+  elapsed = ephy_shell_get_time_to_first_window (ephy_shell);
+  g_assert_cmpint (elapsed, >=, 0);
+
+  /* Only hold the budget against machines meant for measuring. */
+  g_test_minimized_result (elapsed / (double) G_USEC_PER_SEC, "Time to first window");
+  if (g_test_perf ())
+    g_assert_cmpint (elapsed, <=, EPHY_SHELL_FIRST_WINDOW_BUDGET_MS * 1000);
+
+  gtk_widget_destroy (window);
+}
+
+static gboolean
+load_scheduler_is_idle (EphyLoadScheduler *scheduler)
+{
+  return ephy_load_scheduler_get_n_active (scheduler) == 0 &&
+         ephy_load_scheduler_get_n_pending (scheduler) == 0;
+}
+
+static void
+test_ephy_shell_load_scheduler (void)
+{
+  EphyShell *ephy_shell;
+  EphyLoadScheduler *scheduler;
+  EphyEmbed *embeds[5];
+  GtkWidget *window = NULL;
+  guint i;
+
+  ephy_shell = ephy_shell_get_default ();
+  scheduler = ephy_shell_get_load_scheduler (ephy_shell);
+
+  g_settings_set_int (EPHY_SETTINGS_MAIN,
+                      EPHY_PREFS_MAX_CONCURRENT_TAB_LOADS, 2);
+
+  for (i = 0; i < G_N_ELEMENTS (embeds); i++) {
+    embeds[i] = ephy_shell_new_tab (ephy_shell, EPHY_WINDOW (window), NULL, "about:blank",
+                                    EPHY_NEW_TAB_DONT_SHOW_WINDOW | EPHY_NEW_TAB_IN_EXISTING_WINDOW |
+                                    EPHY_NEW_TAB_DELAYED_OPEN_PAGE);
+    window = gtk_widget_get_toplevel (GTK_WIDGET (embeds[i]));
+    g_assert (ephy_embed_has_load_pending (embeds[i]));
+
+    ephy_load_scheduler_add (scheduler, embeds[i]);
+  }
+
+  /* Only two loads start, the others wait for a free slot. */
+  g_assert_cmpuint (ephy_load_scheduler_get_n_active (scheduler), ==, 2);
+  g_assert_cmpuint (ephy_load_scheduler_get_n_pending (scheduler), ==, 3);
+  g_assert (!ephy_embed_has_load_pending (embeds[0]));
+  g_assert (!ephy_embed_has_load_pending (embeds[1]));
+  g_assert (ephy_embed_has_load_pending (embeds[2]));
+
+  /* Queued tabs start loading as earlier ones finish. */
+  ephy_test_utils_wait_for_condition ((EphyTestUtilsConditionFunc)load_scheduler_is_idle, scheduler);
+
+  for (i = 0; i < G_N_ELEMENTS (embeds); i++)
+    g_assert (!ephy_embed_has_load_pending (embeds[i]));
+
+  /* Closing tabs drops them from the queue. */
+  for (i = 0; i < G_N_ELEMENTS (embeds); i++) {
+    embeds[i] = ephy_shell_new_tab (ephy_shell, EPHY_WINDOW (window), NULL, "about:blank",
+                                    EPHY_NEW_TAB_DONT_SHOW_WINDOW | EPHY_NEW_TAB_IN_EXISTING_WINDOW |
+                                    EPHY_NEW_TAB_DELAYED_OPEN_PAGE);
+    ephy_load_scheduler_add (scheduler, embeds[i]);
+  }
+  g_assert_cmpuint (ephy_load_scheduler_get_n_pending (scheduler), ==, 3);
+
+  gtk_widget_destroy (window);
+
+  g_assert_cmpuint (ephy_load_scheduler_get_n_active (scheduler), ==, 0);
+  g_assert_cmpuint (ephy_load_scheduler_get_n_pending (scheduler), ==, 0);
+
+  g_settings_reset (EPHY_SETTINGS_MAIN, EPHY_PREFS_MAX_CONCURRENT_TAB_LOADS);
+}
+
+static void
+test_ephy_shell_close_all_windows (void)
+{
+  EphyShell *ephy_shell;
+  EphyEmbed *embed;
+  GtkWidget *window;
+  GtkWidget *window2;
+  guint n_windows;
+
+  ephy_shell = ephy_shell_get_default ();
+  n_windows = ephy_shell_get_n_windows (ephy_shell);
+
+  g_settings_set_boolean (EPHY_SETTINGS_MAIN,
+                          EPHY_PREFS_WARN_ON_CLOSE_UNSUBMITTED_DATA, TRUE);
+
+  embed = ephy_shell_new_tab_full (ephy_shell, NULL, NULL, NULL,
+                                   EPHY_NEW_TAB_DONT_SHOW_WINDOW | EPHY_NEW_TAB_IN_NEW_WINDOW,
+                                   EPHY_WEB_VIEW_CHROME_ALL, FALSE, 0);
+  window = gtk_widget_get_toplevel (GTK_WIDGET (embed));
+  ephy_shell_new_tab (ephy_shell, EPHY_WINDOW (window), NULL, "about:blank",
+                      EPHY_NEW_TAB_DONT_SHOW_WINDOW | EPHY_NEW_TAB_IN_EXISTING_WINDOW);
+
+  embed = ephy_shell_new_tab_full (ephy_shell, NULL, NULL, NULL,
+                                   EPHY_NEW_TAB_DONT_SHOW_WINDOW | EPHY_NEW_TAB_IN_NEW_WINDOW,
+                                   EPHY_WEB_VIEW_CHROME_ALL, FALSE, 0);
+  window2 = gtk_widget_get_toplevel (GTK_WIDGET (embed));
+  g_assert (window != window2);
+  g_assert_cmpuint (ephy_shell_get_n_windows (ephy_shell), ==, n_windows + 2);
+
+  /* File->Quit only quits the application if this returns TRUE, so with
+   * no modified forms it has to close every window right away. */
+  g_assert (ephy_shell_close_all_windows (ephy_shell));
+  g_assert_cmpuint (ephy_shell_get_n_windows (ephy_shell), ==, 0);
+
+  g_settings_reset (EPHY_SETTINGS_MAIN, EPHY_PREFS_WARN_ON_CLOSE_UNSUBMITTED_DATA);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -380,6 +521,10 @@ main (int argc, char *argv[])
   _ephy_shell_create_instance (EPHY_EMBED_SHELL_MODE_TEST);
   g_application_register (G_APPLICATION (ephy_shell_get_default ()), NULL, NULL);
 
+  /* Keep this first, it needs to see the first window being drawn. */
+  g_test_add_func ("/src/ephy-shell/deferred_startup",
+                   test_ephy_shell_deferred_startup);
+
   g_test_add_func ("/src/ephy-shell/basic_embeds",
                    test_ephy_shell_basic_embeds);
 
@@ -398,6 +543,13 @@ main (int argc, char *argv[])
   g_test_add_func ("/src/ephy-shell/tab_no_history",
                    test_ephy_shell_tab_no_history);
 
+  g_test_add_func ("/src/ephy-shell/load_scheduler",
+                   test_ephy_shell_load_scheduler);
+
+  /* Keep this last, closing the last window closes the session. */
+  g_test_add_func ("/src/ephy-shell/close_all_windows",
+                   test_ephy_shell_close_all_windows);
+
   ret = g_test_run ();
 
   g_object_unref (ephy_shell_get_default ());
@@ -0,0 +1,120 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * Copyright © 2013 Igalia S.L.
+ *
+ * Epiphany is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Epiphany is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Epiphany; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+#include "ephy-smaps.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <unistd.h>
+
+static void
+test_ephy_smaps_sample_pid (void)
+{
+  EphySMapsProcessSample sample;
+  EphySMapsCounters sum = { 0 };
+  int i;
+
+  if (!ephy_smaps_sample_pid (getpid (), EPHY_SMAPS_PROCESS_UI, FALSE, &sample))
+    return;
+
+  g_assert (sample.has_mappings);
+  g_assert_cmpuint (sample.total.rss, >, 0);
+  g_assert_cmpuint (sample.total.pss, <=, sample.total.rss);
+
+  /* Every mapping falls in exactly one class. */
+  for (i = 0; i < EPHY_SMAPS_N_MAPPINGS; i++) {
+    sum.rss += sample.anonymous[i].rss + sample.mapped[i].rss;
+    sum.private_dirty += sample.anonymous[i].private_dirty + sample.mapped[i].private_dirty;
+  }
+  g_assert_cmpuint (sum.rss, ==, sample.total.rss);
+  g_assert_cmpuint (sum.private_dirty, ==, sample.total.private_dirty);
+  g_assert_cmpuint (sample.mapped[EPHY_SMAPS_MAPPING_CODE].rss, >, 0);
+}
+
+static void
+test_ephy_smaps_sample_pid_rollup (void)
+{
+  EphySMapsProcessSample sample;
+
+  if (!ephy_smaps_sample_pid (getpid (), EPHY_SMAPS_PROCESS_UI, TRUE, &sample))
+    return;
+
+  g_assert_cmpuint (sample.total.rss, >, 0);
+}
+
+static void
+sampled_cb (EphySMaps *smaps,
+            EphySMapsSample *sample,
+            int *n_samples)
+{
+  if (++(*n_samples) == 3)
+    gtk_main_quit ();
+}
+
+static void
+test_ephy_smaps_ring_buffer (void)
+{
+  EphySMaps *smaps;
+  GArray *samples;
+  EphySMapsSample *first, *second;
+  int n_samples = 0;
+
+  smaps = ephy_smaps_new ();
+
+  /* The first sample is taken right away. */
+  ephy_smaps_start_sampling (smaps, 1, 2);
+  samples = ephy_smaps_get_samples (smaps);
+  g_assert_cmpuint (samples->len, ==, 1);
+  g_array_free (samples, TRUE);
+
+  g_signal_connect (smaps, "sampled", G_CALLBACK (sampled_cb), &n_samples);
+  gtk_main ();
+  ephy_smaps_stop_sampling (smaps);
+
+  /* Only the newest two are kept, oldest first. */
+  samples = ephy_smaps_get_samples (smaps);
+  g_assert_cmpuint (samples->len, ==, 2);
+  first = &g_array_index (samples, EphySMapsSample, 0);
+  second = &g_array_index (samples, EphySMapsSample, 1);
+  g_assert_cmpint (first->time, <, second->time);
+  g_array_free (samples, TRUE);
+
+  g_object_unref (smaps);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean ret;
+
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/lib/ephy-smaps/sample_pid",
+                   test_ephy_smaps_sample_pid);
+  g_test_add_func ("/lib/ephy-smaps/sample_pid_rollup",
+                   test_ephy_smaps_sample_pid_rollup);
+  g_test_add_func ("/lib/ephy-smaps/ring_buffer",
+                   test_ephy_smaps_ring_buffer);
+
+  ret = g_test_run ();
+
+  return ret;
+}
@@ -207,6 +207,235 @@ test_snapshot_and_timed_cancellation (void)
   gtk_main ();
 }
 
+static void
+on_snapshot_for_url_ready (GObject *source,
+                           GAsyncResult *res,
+                           gint *tests)
+{
+  GdkPixbuf *pixbuf;
+  GError *error = NULL;
+
+  pixbuf = ephy_snapshot_service_get_snapshot_for_url_finish (EPHY_SNAPSHOT_SERVICE (source),
+                                                              res, &error);
+  g_assert (GDK_IS_PIXBUF (pixbuf) || error != NULL);
+
+  if (pixbuf)
+    g_object_unref (pixbuf);
+  if (error)
+    g_error_free (error);
+
+  quit_when_test_done (NULL, NULL, tests);
+}
+
+static void
+test_coalesced_lookups (void)
+{
+  EphySnapshotService *service = ephy_snapshot_service_get_default ();
+  EphySnapshotServiceStats before, after;
+  gint tests = 3;
+  int i;
+
+  ephy_snapshot_service_get_stats (service, &before);
+
+  /* Keep the first lookup queued so the next requests find it. */
+  ephy_snapshot_service_freeze_lookups (service);
+  for (i = 0; i < tests; i++)
+    ephy_snapshot_service_get_snapshot_for_url_full (service,
+                                                     TEST_SERVER_URI "/coalesced",
+                                                     mtime,
+                                                     G_PRIORITY_DEFAULT + i,
+                                                     NULL,
+                                                     (GAsyncReadyCallback)on_snapshot_for_url_ready,
+                                                     &tests);
+
+  ephy_snapshot_service_get_stats (service, &after);
+  g_assert_cmpuint (after.queue_depth, ==, before.queue_depth + 1);
+  g_assert_cmpuint (after.coalesced - before.coalesced, ==, 2);
+
+  ephy_snapshot_service_thaw_lookups (service);
+  gtk_main ();
+
+  /* The three requests were answered by a single lookup. */
+  ephy_snapshot_service_get_stats (service, &after);
+  g_assert_cmpuint (after.queue_depth, ==, 0);
+  g_assert_cmpuint (after.running, ==, 0);
+  g_assert_cmpuint (after.completed - before.completed, ==, 1);
+  g_assert_cmpuint (after.coalesced - before.coalesced, ==, 2);
+}
+
+static void
+on_cancelled_snapshot_for_url_ready (GObject *source,
+                                     GAsyncResult *res,
+                                     gint *tests)
+{
+  GError *error = NULL;
+
+  g_assert (ephy_snapshot_service_get_snapshot_for_url_finish (EPHY_SNAPSHOT_SERVICE (source),
+                                                               res, &error) == NULL);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_error_free (error);
+
+  quit_when_test_done (NULL, NULL, tests);
+}
+
+static void
+on_uncancelled_snapshot_for_url_ready (GObject *source,
+                                       GAsyncResult *res,
+                                       gint *tests)
+{
+  GdkPixbuf *pixbuf;
+  GError *error = NULL;
+
+  /* There is no snapshot for this URL, but the lookup was made. */
+  pixbuf = ephy_snapshot_service_get_snapshot_for_url_finish (EPHY_SNAPSHOT_SERVICE (source),
+                                                              res, &error);
+  g_assert (pixbuf == NULL);
+  g_assert_error (error, EPHY_SNAPSHOT_SERVICE_ERROR, EPHY_SNAPSHOT_SERVICE_ERROR_NOT_FOUND);
+  g_error_free (error);
+
+  quit_when_test_done (NULL, NULL, tests);
+}
+
+static void
+test_cancelled_lookup (void)
+{
+  EphySnapshotService *service = ephy_snapshot_service_get_default ();
+  GCancellable *cancellable;
+  gint tests = 2;
+
+  /* A cancelled lookup does not fail a request made after it. */
+  cancellable = g_cancellable_new ();
+  ephy_snapshot_service_freeze_lookups (service);
+  ephy_snapshot_service_get_snapshot_for_url_full (service,
+                                                   TEST_SERVER_URI "/cancelled",
+                                                   mtime,
+                                                   G_PRIORITY_DEFAULT,
+                                                   cancellable,
+                                                   (GAsyncReadyCallback)on_cancelled_snapshot_for_url_ready,
+                                                   &tests);
+  g_cancellable_cancel (cancellable);
+  ephy_snapshot_service_thaw_lookups (service);
+
+  ephy_snapshot_service_get_snapshot_for_url_full (service,
+                                                   TEST_SERVER_URI "/cancelled",
+                                                   mtime,
+                                                   G_PRIORITY_DEFAULT,
+                                                   NULL,
+                                                   (GAsyncReadyCallback)on_uncancelled_snapshot_for_url_ready,
+                                                   &tests);
+  gtk_main ();
+
+  g_object_unref (cancellable);
+}
+
+static void
+on_cached_snapshot_for_url_ready (GObject *source,
+                                  GAsyncResult *res,
+                                  GdkPixbuf *expected)
+{
+  GdkPixbuf *pixbuf;
+
+  pixbuf = ephy_snapshot_service_get_snapshot_for_url_finish (EPHY_SNAPSHOT_SERVICE (source),
+                                                              res, NULL);
+  g_assert (pixbuf == expected);
+  g_object_unref (pixbuf);
+
+  gtk_main_quit ();
+}
+
+static void
+test_decoded_snapshot_cache (void)
+{
+  EphySnapshotService *service = ephy_snapshot_service_get_default ();
+  EphySnapshotServiceStats before, after;
+  GdkPixbuf *snapshot;
+
+  snapshot = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                             EPHY_THUMBNAIL_WIDTH, EPHY_THUMBNAIL_HEIGHT);
+  gdk_pixbuf_fill (snapshot, 0xff0000ff);
+
+  /* A saved snapshot is served from memory without decoding it again. */
+  ephy_snapshot_service_save_snapshot_async (service, snapshot,
+                                             TEST_SERVER_URI "/cached", mtime,
+                                             NULL, NULL, NULL);
+  ephy_snapshot_service_get_stats (service, &before);
+  ephy_snapshot_service_get_snapshot_for_url_async (service,
+                                                    TEST_SERVER_URI "/cached",
+                                                    mtime,
+                                                    NULL,
+                                                    (GAsyncReadyCallback)on_cached_snapshot_for_url_ready,
+                                                    snapshot);
+  gtk_main ();
+
+  ephy_snapshot_service_get_stats (service, &after);
+  g_assert_cmpuint (after.cache_hits, ==, before.cache_hits + 1);
+  g_assert_cmpuint (after.completed, ==, before.completed);
+  g_assert_cmpuint (after.cache_size, >, 0);
+
+  g_object_unref (snapshot);
+}
+
+#define BENCHMARK_SNAPSHOTS 50
+
+static void
+on_surface_saved (GObject *source,
+                  GAsyncResult *res,
+                  gint *tests)
+{
+  GdkPixbuf *pixbuf;
+
+  pixbuf = ephy_snapshot_service_save_surface_finish (EPHY_SNAPSHOT_SERVICE (source),
+                                                      res, NULL);
+  g_assert (GDK_IS_PIXBUF (pixbuf));
+  g_assert_cmpint (gdk_pixbuf_get_width (pixbuf), ==, EPHY_THUMBNAIL_WIDTH);
+  g_assert_cmpint (gdk_pixbuf_get_height (pixbuf), ==, EPHY_THUMBNAIL_HEIGHT);
+  g_object_unref (pixbuf);
+
+  quit_when_test_done (NULL, NULL, tests);
+}
+
+static void
+test_save_surface_main_thread_time (void)
+{
+  EphySnapshotService *service = ephy_snapshot_service_get_default ();
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  GTimer *timer;
+  gint tests = BENCHMARK_SNAPSHOTS;
+  double elapsed = 0;
+  int i;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 1280, 800);
+  cr = cairo_create (surface);
+  cairo_set_source_rgb (cr, 0.2, 0.4, 0.8);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  /* Only the time spent before returning to the main loop counts, the
+     crop, scale and encode happen in the worker thread. */
+  timer = g_timer_new ();
+  for (i = 0; i < BENCHMARK_SNAPSHOTS; i++) {
+    char *url = g_strdup_printf (TEST_SERVER_URI "/benchmark/%d", i);
+
+    g_timer_start (timer);
+    ephy_snapshot_service_save_surface_async (service, surface, url, mtime, NULL,
+                                              (GAsyncReadyCallback)on_surface_saved,
+                                              &tests);
+    g_timer_stop (timer);
+    elapsed += g_timer_elapsed (timer, NULL);
+
+    g_free (url);
+  }
+  g_timer_destroy (timer);
+
+  gtk_main ();
+  cairo_surface_destroy (surface);
+
+  g_test_minimized_result (elapsed * 1000 / BENCHMARK_SNAPSHOTS,
+                           "main thread time per snapshot: %f ms",
+                           elapsed * 1000 / BENCHMARK_SNAPSHOTS);
+}
+
 static void
 server_callback (SoupServer *server, SoupMessage *msg,
                  const char *path, GHashTable *query,
@@ -251,5 +480,14 @@ main (int argc, char *argv[])
                    test_already_cancelled_snapshot);
   g_test_add_func ("/lib/ephy-snapshot-service/test_snapshot_and_timed_cancellation",
                    test_snapshot_and_timed_cancellation);
+  g_test_add_func ("/lib/ephy-snapshot-service/test_coalesced_lookups",
+                   test_coalesced_lookups);
+  g_test_add_func ("/lib/ephy-snapshot-service/test_cancelled_lookup",
+                   test_cancelled_lookup);
+  g_test_add_func ("/lib/ephy-snapshot-service/test_decoded_snapshot_cache",
+                   test_decoded_snapshot_cache);
+  if (g_test_perf ())
+    g_test_add_func ("/lib/ephy-snapshot-service/test_save_surface_main_thread_time",
+                     test_save_surface_main_thread_time);
   return g_test_run ();
 }
@@ -135,3 +135,28 @@ ephy_test_utils_wait_until_load_is_committed (GMainLoop *loop)
   g_assert_cmpint (web_view_ready_counter, ==, 0);
   g_main_loop_unref (loop);
 }
+
+/* Long enough for a slow machine, short enough to not hang the run. */
+#define CONDITION_TIMEOUT_SECONDS 10
+
+static gboolean
+condition_timeout_cb (gpointer user_data)
+{
+  g_assert_not_reached ();
+
+  return FALSE;
+}
+
+/* Iterates the default main context until @condition returns TRUE,
+ * and fails the test if that takes too long. */
+void
+ephy_test_utils_wait_for_condition (EphyTestUtilsConditionFunc condition,
+                                    gpointer user_data)
+{
+  guint timeout_id;
+
+  timeout_id = g_timeout_add_seconds (CONDITION_TIMEOUT_SECONDS, condition_timeout_cb, NULL);
+  while (!condition (user_data))
+    g_main_context_iteration (NULL, TRUE);
+  g_source_remove (timeout_id);
+}
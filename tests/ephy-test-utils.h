@@ -47,6 +47,11 @@ GMainLoop* ephy_test_utils_setup_wait_until_load_is_committed (EphyWebView *view
 
 void ephy_test_utils_wait_until_load_is_committed (GMainLoop *loop);
 
+typedef gboolean (* EphyTestUtilsConditionFunc) (gpointer user_data);
+
+void ephy_test_utils_wait_for_condition (EphyTestUtilsConditionFunc condition,
+                                         gpointer user_data);
+
 G_END_DECLS
 
 #endif
@@ -0,0 +1,266 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * Copyright © 2013 Igalia S.L.
+ *
+ * Epiphany is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Epiphany is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Epiphany; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+#include "ephy-debug.h"
+#include "ephy-file-helpers.h"
+#include "ephy-metrics.h"
+#include "uri-tester.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#define FILTER_URL "http://adblock.invalid/filters.txt"
+#define N_THREADS 4
+#define N_REPLAYS 200
+
+static const char *filter_rules =
+  "! Test filter\n"
+  "/banner-ads/\n"
+  "||tracker.example.net^\n";
+
+/* A page load as recorded in a HAR file: the subresources requested by
+ * a page, and whether the test filter should block them. */
+static const struct {
+  const char *request;
+  const char *page;
+  gboolean blocked;
+} requests[] = {
+  { "http://example.com/style.css", "http://example.com/", FALSE },
+  { "http://example.com/script.js", "http://example.com/", FALSE },
+  { "http://example.com/banner-ads/top.png", "http://example.com/", TRUE },
+  { "http://cdn.example.org/jquery.js", "http://example.com/", FALSE },
+  { "http://tracker.example.net/pixel.gif", "http://example.com/", TRUE },
+  { "http://example.com/images/logo.png", "http://example.com/", FALSE },
+  { "http://example.com/banner-ads/side.png", "http://example.com/news", TRUE },
+  { "http://example.com/fonts/sans.woff", "http://example.com/news", FALSE },
+};
+
+static UriTester *
+create_tester (void)
+{
+  GFile *file;
+  char *data_dir;
+  char *path;
+  char *checksum;
+
+  /* Put the filter where UriTester would have downloaded it, and make
+   * it an hour old so that it is used instead of being refreshed. */
+  data_dir = g_build_filename (ephy_dot_dir (), "adblock", NULL);
+  g_mkdir_with_parents (data_dir, 0700);
+
+  path = g_build_filename (data_dir, "filters.list", NULL);
+  g_assert (g_file_set_contents (path, FILTER_URL ";", -1, NULL));
+  g_free (path);
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, FILTER_URL, -1);
+  path = g_build_filename (data_dir, checksum, NULL);
+  g_assert (g_file_set_contents (path, filter_rules, -1, NULL));
+
+  file = g_file_new_for_path (path);
+  g_assert (g_file_set_attribute_uint64 (file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                         g_get_real_time () / G_USEC_PER_SEC - 60 * 60,
+                                         G_FILE_QUERY_INFO_NONE, NULL, NULL));
+  g_object_unref (file);
+
+  g_free (path);
+  g_free (checksum);
+  g_free (data_dir);
+
+  return uri_tester_new (ephy_dot_dir ());
+}
+
+static void
+test_uri_tester_verdicts (void)
+{
+  UriTester *tester;
+  guint i;
+
+  tester = create_tester ();
+
+  /* The second round is answered from the verdicts cache. */
+  for (i = 0; i < 2 * G_N_ELEMENTS (requests); i++) {
+    guint j = i % G_N_ELEMENTS (requests);
+
+    g_test_message ("%s", requests[j].request);
+    g_assert_cmpint (uri_tester_test_uri (tester, requests[j].request, requests[j].page,
+                                          AD_URI_CHECK_TYPE_OTHER), ==, requests[j].blocked);
+  }
+
+  /* Top level documents are never blocked. */
+  g_assert (!uri_tester_test_uri (tester, requests[2].request, requests[2].page,
+                                  AD_URI_CHECK_TYPE_DOCUMENT));
+
+  g_object_unref (tester);
+}
+
+static void
+assert_verdicts (UriTester *tester)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (requests); i++)
+    g_assert_cmpint (uri_tester_test_uri (tester, requests[i].request, requests[i].page,
+                                          AD_URI_CHECK_TYPE_OTHER), ==, requests[i].blocked);
+}
+
+/* Creates a tester and checks how many filters it parsed and whether
+ * it mapped the compiled ruleset. */
+static UriTester *
+create_tester_checking_load (int expected_parsed,
+                             int expected_mapped)
+{
+  EphyMetricsCounter *parsed;
+  EphyMetricsCounter *mapped;
+  int parsed_before;
+  int mapped_before;
+  UriTester *tester;
+
+  parsed = ephy_metrics_counter_get ("adblock.filters-parsed");
+  mapped = ephy_metrics_counter_get ("adblock.ruleset-mapped");
+  parsed_before = ephy_metrics_counter_get_value (parsed);
+  mapped_before = ephy_metrics_counter_get_value (mapped);
+
+  tester = create_tester ();
+
+  g_assert_cmpint (ephy_metrics_counter_get_value (parsed) - parsed_before, ==, expected_parsed);
+  g_assert_cmpint (ephy_metrics_counter_get_value (mapped) - mapped_before, ==, expected_mapped);
+
+  return tester;
+}
+
+static void
+test_uri_tester_shared_ruleset (void)
+{
+  UriTester *tester;
+  char *path;
+
+  path = g_build_filename (ephy_dot_dir (), "adblock", "ruleset.bin", NULL);
+  g_unlink (path);
+
+  /* The first tester parses the filter and compiles it... */
+  tester = create_tester_checking_load (1, 1);
+  g_assert (g_file_test (path, G_FILE_TEST_IS_REGULAR));
+  assert_verdicts (tester);
+  g_object_unref (tester);
+
+  /* ...the next ones map the compiled ruleset without parsing... */
+  tester = create_tester_checking_load (0, 1);
+  assert_verdicts (tester);
+  g_object_unref (tester);
+
+  /* ...unless it cannot be trusted. */
+  g_assert (g_file_set_contents (path, "EPHYADB1", -1, NULL));
+  tester = create_tester_checking_load (1, 1);
+  assert_verdicts (tester);
+  g_object_unref (tester);
+
+  g_free (path);
+}
+
+static gpointer
+replay_requests (UriTester *tester)
+{
+  guint i, j;
+
+  for (i = 0; i < N_REPLAYS; i++) {
+    for (j = 0; j < G_N_ELEMENTS (requests); j++) {
+      if (uri_tester_test_uri (tester, requests[j].request, requests[j].page,
+                               AD_URI_CHECK_TYPE_OTHER) != requests[j].blocked)
+        return GINT_TO_POINTER (FALSE);
+    }
+  }
+
+  return GINT_TO_POINTER (TRUE);
+}
+
+static void
+test_uri_tester_threads (void)
+{
+  UriTester *tester;
+  GThread *threads[N_THREADS];
+  guint i;
+
+  tester = create_tester ();
+
+  for (i = 0; i < N_THREADS; i++)
+    threads[i] = g_thread_new ("uri-tester", (GThreadFunc)replay_requests, tester);
+
+  for (i = 0; i < N_THREADS; i++)
+    g_assert (GPOINTER_TO_INT (g_thread_join (threads[i])));
+
+  g_object_unref (tester);
+}
+
+static void
+test_uri_tester_replay (void)
+{
+  UriTester *tester;
+  GTimer *timer;
+  double elapsed;
+  guint n_requests = N_REPLAYS * G_N_ELEMENTS (requests);
+
+  tester = create_tester ();
+
+  timer = g_timer_new ();
+  g_assert (GPOINTER_TO_INT (replay_requests (tester)));
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_test_minimized_result (elapsed * G_USEC_PER_SEC / n_requests,
+                           "time per request: %f us",
+                           elapsed * G_USEC_PER_SEC / n_requests);
+
+  g_object_unref (tester);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int ret;
+
+  gtk_test_init (&argc, &argv);
+  ephy_debug_init ();
+
+  if (!ephy_file_helpers_init (NULL,
+                               EPHY_FILE_HELPERS_PRIVATE_PROFILE | EPHY_FILE_HELPERS_ENSURE_EXISTS,
+                               NULL)) {
+    g_debug ("Something wrong happened with ephy_file_helpers_init()");
+    return -1;
+  }
+
+  g_test_add_func ("/embed/uri-tester/verdicts",
+                   test_uri_tester_verdicts);
+  g_test_add_func ("/embed/uri-tester/shared_ruleset",
+                   test_uri_tester_shared_ruleset);
+  g_test_add_func ("/embed/uri-tester/threads",
+                   test_uri_tester_threads);
+  if (g_test_perf ())
+    g_test_add_func ("/embed/uri-tester/replay",
+                     test_uri_tester_replay);
+
+  ret = g_test_run ();
+
+  ephy_file_helpers_shutdown ();
+
+  return ret;
+}
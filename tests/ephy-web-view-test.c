@@ -30,6 +30,7 @@
 #include "ephy-history-service.h"
 #include "ephy-private.h"
 #include "ephy-shell.h"
+#include "ephy-test-utils.h"
 #include "ephy-web-view.h"
 
 #include <glib.h>
@@ -325,7 +326,7 @@ quit_main_loop_when_load_finished (WebKitWebView *view, WebKitLoadEvent load_eve
     return;
 
   g_main_loop_quit (loop);
-  g_signal_handlers_disconnect_by_func (view, quit_main_loop_when_load_finished, NULL);
+  g_signal_handlers_disconnect_by_func (view, quit_main_loop_when_load_finished, loop);
 }
 #else
 static void
@@ -483,6 +484,139 @@ test_ephy_web_view_error_pages_not_stored_in_history (void)
     g_object_unref (g_object_ref_sink (view));
 }
 
+#define FORM_HTML "<html><body><form><textarea id='text'></textarea></form></body></html>"
+
+static void
+load_and_wait (EphyWebView *view,
+               const char *html,
+               const char *url)
+{
+  GMainLoop *loop;
+
+  loop = g_main_loop_new (NULL, FALSE);
+
+#ifdef HAVE_WEBKIT2
+  g_signal_connect (view, "load-changed",
+                    G_CALLBACK (quit_main_loop_when_load_finished), loop);
+  if (html)
+    webkit_web_view_load_html (WEBKIT_WEB_VIEW (view), html, "http://localhost/");
+  else
+    ephy_web_view_load_url (view, url);
+#else
+  g_signal_connect (view, "notify::load-status",
+                    G_CALLBACK (quit_main_loop_when_load_finished), loop);
+  if (html)
+    webkit_web_view_load_string (WEBKIT_WEB_VIEW (view), html, NULL, NULL, "http://localhost/");
+  else
+    ephy_web_view_load_url (view, url);
+#endif
+
+  g_main_loop_run (loop);
+  g_main_loop_unref (loop);
+}
+
+#ifdef HAVE_WEBKIT2
+static void
+run_javascript_cb (WebKitWebView *view,
+                   GAsyncResult *result,
+                   GMainLoop *loop)
+{
+  WebKitJavascriptResult *js_result;
+  GError *error = NULL;
+
+  js_result = webkit_web_view_run_javascript_finish (view, result, &error);
+  g_assert_no_error (error);
+  webkit_javascript_result_unref (js_result);
+
+  g_main_loop_quit (loop);
+}
+#endif
+
+static void
+focus_form (EphyWebView *view)
+{
+  const char *script = "document.getElementById('text').focus();";
+#ifdef HAVE_WEBKIT2
+  GMainLoop *loop;
+
+  loop = g_main_loop_new (NULL, FALSE);
+  webkit_web_view_run_javascript (WEBKIT_WEB_VIEW (view), script, NULL,
+                                  (GAsyncReadyCallback)run_javascript_cb, loop);
+  g_main_loop_run (loop);
+  g_main_loop_unref (loop);
+#else
+  webkit_web_view_execute_script (WEBKIT_WEB_VIEW (view), script);
+#endif
+}
+
+static void
+test_ephy_web_view_modified_forms_input (void)
+{
+  GtkWidget *window;
+  EphyWebView *view;
+
+#ifdef HAVE_WEBKIT2
+  /* Under WebKit2 the state is pushed by the web extension. */
+  if (!ephy_embed_shell_get_web_extension_proxy (ephy_embed_shell_get_default ())) {
+    g_test_message ("Web extension not available, skipping");
+    return;
+  }
+#endif
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  view = EPHY_WEB_VIEW (ephy_web_view_new ());
+  gtk_container_add (GTK_CONTAINER (window), GTK_WIDGET (view));
+  gtk_widget_show_all (window);
+
+  load_and_wait (view, FORM_HTML, NULL);
+  g_assert (!ephy_web_view_has_modified_forms (view));
+
+  /* Typing in the form marks the page as modified. */
+  focus_form (view);
+  gtk_widget_grab_focus (GTK_WIDGET (view));
+  g_assert (gtk_test_widget_send_key (GTK_WIDGET (view), GDK_KEY_a, 0));
+
+  ephy_test_utils_wait_for_condition ((EphyTestUtilsConditionFunc)ephy_web_view_has_modified_forms, view);
+
+  /* The forms of the previous document are gone after navigating. */
+  load_and_wait (view, NULL, "http://localhost:" G_STRINGIFY (SERVER_PORT) "/");
+  g_assert (!ephy_web_view_has_modified_forms (view));
+
+  gtk_widget_destroy (window);
+}
+
+#ifdef HAVE_WEBKIT2
+static void
+test_ephy_web_view_modified_forms_pushed (void)
+{
+  EphyEmbedShell *shell = ephy_embed_shell_get_default ();
+  EphyWebView *view;
+  guint64 page_id;
+
+  view = EPHY_WEB_VIEW (g_object_ref_sink (ephy_web_view_new ()));
+  page_id = webkit_web_view_get_page_id (WEBKIT_WEB_VIEW (view));
+  g_assert (!ephy_web_view_has_modified_forms (view));
+
+  /* The view returns what the web extension reported for its page. */
+  g_signal_emit_by_name (shell, "page-has-modified-forms-changed", page_id, TRUE);
+  g_assert (ephy_web_view_has_modified_forms (view));
+
+  /* Changes of other pages are ignored. */
+  g_signal_emit_by_name (shell, "page-has-modified-forms-changed", page_id + 1, FALSE);
+  g_assert (ephy_web_view_has_modified_forms (view));
+
+  g_signal_emit_by_name (shell, "page-has-modified-forms-changed", page_id, FALSE);
+  g_assert (!ephy_web_view_has_modified_forms (view));
+
+  /* Navigating resets the state, even before the web extension says so. */
+  g_signal_emit_by_name (shell, "page-has-modified-forms-changed", page_id, TRUE);
+  load_and_wait (view, NULL, "http://localhost:" G_STRINGIFY (SERVER_PORT) "/");
+  g_assert (!ephy_web_view_has_modified_forms (view));
+
+  g_object_unref (view);
+}
+#endif
+
 int
 main (int argc, char *argv[])
 {
@@ -522,6 +656,14 @@ main (int argc, char *argv[])
   g_test_add_func ("/embed/ephy-web-view/error-pages-not-stored-in-history",
                    test_ephy_web_view_error_pages_not_stored_in_history);
 
+  g_test_add_func ("/embed/ephy-web-view/modified_forms_input",
+                   test_ephy_web_view_modified_forms_input);
+
+#ifdef HAVE_WEBKIT2
+  g_test_add_func ("/embed/ephy-web-view/modified_forms_pushed",
+                   test_ephy_web_view_modified_forms_pushed);
+#endif
+
   ret = g_test_run ();
 
   g_object_unref (server);